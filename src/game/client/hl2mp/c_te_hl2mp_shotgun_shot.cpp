@@ -145,16 +145,16 @@ IMPLEMENT_CLIENTCLASS_EVENT( C_TEHL2MPFireBullets, DT_TEHL2MPFireBullets, CTEHL2
 
 
 BEGIN_RECV_TABLE_NOBASE(C_TEHL2MPFireBullets, DT_TEHL2MPFireBullets )
-	RecvPropVector( RECVINFO( m_vecOrigin ) ),
-	RecvPropVector( RECVINFO( m_vecDir ) ),
-	RecvPropInt( RECVINFO( m_iAmmoID ) ),
-	RecvPropInt( RECVINFO( m_iSeed ) ),
-	RecvPropInt( RECVINFO( m_iShots ) ),
-	RecvPropInt( RECVINFO( m_iPlayer ) ),
-	RecvPropInt( RECVINFO( m_iWeaponIndex ) ),
-	RecvPropFloat( RECVINFO( m_flSpread ) ),
-	RecvPropBool( RECVINFO( m_bDoImpacts ) ),
-	RecvPropBool( RECVINFO( m_bDoTracers ) ),
+	RecvPropAuto( RECVINFO_AUTO( m_vecOrigin ) ),
+	RecvPropAuto( RECVINFO_AUTO( m_vecDir ) ),
+	RecvPropAuto( RECVINFO_AUTO( m_iAmmoID ) ),
+	RecvPropAuto( RECVINFO_AUTO( m_iSeed ) ),
+	RecvPropAuto( RECVINFO_AUTO( m_iShots ) ),
+	RecvPropAuto( RECVINFO_AUTO( m_iPlayer ) ),
+	RecvPropAuto( RECVINFO_AUTO( m_iWeaponIndex ) ),
+	RecvPropAuto( RECVINFO_AUTO( m_flSpread ) ),
+	RecvPropAuto( RECVINFO_AUTO( m_bDoImpacts ) ),
+	RecvPropAuto( RECVINFO_AUTO( m_bDoTracers ) ),
 END_RECV_TABLE()
 
 
@@ -15,6 +15,8 @@
 
 extern CTimedEventMgr g_NetworkPropertyEventMgr;
 
+EdictTransmitState_t g_EdictTransmitState[MAX_EDICTS];
+
 
 //-----------------------------------------------------------------------------
 // Save/load
@@ -51,6 +53,8 @@ CServerNetworkProperty::~CServerNetworkProperty()
 
 	// remove the attached edict if it exists
 	DetachEdict();
+
+	delete m_pPendingChanges;
 }
 
 
@@ -64,6 +68,8 @@ void CServerNetworkProperty::Init( CBaseEntity *pEntity )
 	m_pServerClass = NULL;
 //	m_pTransmitProxy = NULL;
 	m_bPendingStateChange = false;
+	m_bPendingFullStateChange = false;
+	m_pPendingChanges = NULL;
 	m_PVSInfo.m_nClusterCount = 0;
 	m_TimerEvent.Init( &g_NetworkPropertyEventMgr, this );
 }
@@ -84,12 +90,18 @@ void CServerNetworkProperty::AttachEdict( edict_t *pRequiredEdict )
 
 	m_pPev = pRequiredEdict;
 	m_pPev->SetEdict( GetBaseEntity(), true );
+	CopyToEdictTransmitState();
 }
 
 void CServerNetworkProperty::DetachEdict()
 {
 	if ( m_pPev )
 	{
+		EdictTransmitState_t &state = g_EdictTransmitState[ entindex() ];
+		state.m_nAreaNum = state.m_nAreaNum2 = 0;
+		state.m_nClusterCount = 0;
+		state.m_iParent = EDICT_TRANSMIT_NO_PARENT;
+
 		m_pPev->SetEdict( NULL, false );
 		engine->RemoveEdict( m_pPev );
 		m_pPev = NULL;
@@ -115,8 +127,14 @@ void CServerNetworkProperty::Release()
 
 
 //-----------------------------------------------------------------------------
-// Returns the network parent
+// Sets/returns the network parent
 //-----------------------------------------------------------------------------
+void CServerNetworkProperty::SetNetworkParent( EHANDLE hParent )
+{
+	m_hParent = hParent;
+	CopyToEdictTransmitState();
+}
+
 CServerNetworkProperty* CServerNetworkProperty::GetNetworkParent()
 {
 	CBaseEntity *pParent = m_hParent.Get();
@@ -147,7 +165,41 @@ void CServerNetworkProperty::RecomputePVSInformation()
 	{
 		m_pPev->m_fStateFlags &= ~FL_EDICT_DIRTY_PVS_INFORMATION;
 		engine->BuildEntityClusterList( edict(), &m_PVSInfo );
+		CopyToEdictTransmitState();
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// The parent is saved without going through SetNetworkParent
+//-----------------------------------------------------------------------------
+void CServerNetworkProperty::OnRestore()
+{
+	MarkPVSInformationDirty();
+	CopyToEdictTransmitState();
+}
+
+
+//-----------------------------------------------------------------------------
+// Mirrors what CheckTransmit needs into g_EdictTransmitState
+//-----------------------------------------------------------------------------
+void CServerNetworkProperty::CopyToEdictTransmitState()
+{
+	if ( !m_pPev )
+		return;
+
+	EdictTransmitState_t &state = g_EdictTransmitState[ entindex() ];
+	state.m_nAreaNum = m_PVSInfo.m_nAreaNum;
+	state.m_nAreaNum2 = m_PVSInfo.m_nAreaNum2;
+	state.m_nHeadNode = m_PVSInfo.m_nHeadNode;
+	state.m_nClusterCount = m_PVSInfo.m_nClusterCount;
+	for ( int i = MIN( m_PVSInfo.m_nClusterCount, MAX_FAST_ENT_CLUSTERS ); --i >= 0; )
+	{
+		state.m_Clusters[i] = m_PVSInfo.m_pClusters[i];
 	}
+
+	CBaseEntity *pParent = m_hParent.Get();
+	state.m_iParent = ( pParent && pParent->edict() ) ? pParent->entindex() : EDICT_TRANSMIT_NO_PARENT;
 }
 
 
@@ -218,20 +270,18 @@ bool CServerNetworkProperty::IsInPVS( const edict_t *pRecipient, const void *pvs
 //-----------------------------------------------------------------------------
 // PVS: this function is called a lot, so it avoids function calls
 //-----------------------------------------------------------------------------
-bool CServerNetworkProperty::IsInPVS( const CCheckTransmitInfo *pInfo )
+static inline bool IsInPVSInternal( int nAreaNum, int nAreaNum2, int nHeadNode, int nClusterCount,
+	const unsigned short *pClusters, const CCheckTransmitInfo *pInfo )
 {
-	// PVS data must be up to date
-	Assert( !m_pPev || ( ( m_pPev->m_fStateFlags & FL_EDICT_DIRTY_PVS_INFORMATION ) == 0 ) );
-	
 	int i;
 
 	// Early out if the areas are connected
-	if ( !m_PVSInfo.m_nAreaNum2 )
+	if ( !nAreaNum2 )
 	{
 		for ( i=0; i< pInfo->m_AreasNetworked; i++ )
 		{
 			int clientArea = pInfo->m_Areas[i];
-			if ( clientArea == m_PVSInfo.m_nAreaNum || engine->CheckAreasConnected( clientArea, m_PVSInfo.m_nAreaNum ) )
+			if ( clientArea == nAreaNum || engine->CheckAreasConnected( clientArea, nAreaNum ) )
 				break;
 		}
 	}
@@ -242,13 +292,13 @@ bool CServerNetworkProperty::IsInPVS( const CCheckTransmitInfo *pInfo )
 		for ( i=0; i< pInfo->m_AreasNetworked; i++ )
 		{
 			int clientArea = pInfo->m_Areas[i];
-			if ( clientArea == m_PVSInfo.m_nAreaNum || clientArea == m_PVSInfo.m_nAreaNum2 )
+			if ( clientArea == nAreaNum || clientArea == nAreaNum2 )
 				break;
 
-			if ( engine->CheckAreasConnected( clientArea, m_PVSInfo.m_nAreaNum ) )
+			if ( engine->CheckAreasConnected( clientArea, nAreaNum ) )
 				break;
 
-			if ( engine->CheckAreasConnected( clientArea, m_PVSInfo.m_nAreaNum2 ) )
+			if ( engine->CheckAreasConnected( clientArea, nAreaNum2 ) )
 				break;
 		}
 	}
@@ -263,18 +313,16 @@ bool CServerNetworkProperty::IsInPVS( const CCheckTransmitInfo *pInfo )
 	// negative leaf count is a node number
 	// If no pvs, add any entity
 
-	Assert( edict() != pInfo->m_pClientEnt );
-
 	unsigned char *pPVS = ( unsigned char * )pInfo->m_PVS;
 	
-	if ( m_PVSInfo.m_nClusterCount < 0 )   // too many clusters, use headnode
+	if ( nClusterCount < 0 )   // too many clusters, use headnode
 	{
-		return (engine->CheckHeadnodeVisible( m_PVSInfo.m_nHeadNode, pPVS, pInfo->m_nPVSSize ) != 0);
+		return (engine->CheckHeadnodeVisible( nHeadNode, pPVS, pInfo->m_nPVSSize ) != 0);
 	}
 	
-	for ( i = m_PVSInfo.m_nClusterCount; --i >= 0; )
+	for ( i = nClusterCount; --i >= 0; )
 	{
-		int nCluster = m_PVSInfo.m_pClusters[i];
+		int nCluster = pClusters[i];
 		if ( ((int)(pPVS[nCluster >> 3])) & BitVec_BitInByte( nCluster ) )
 			return true;
 	}
@@ -283,13 +331,75 @@ bool CServerNetworkProperty::IsInPVS( const CCheckTransmitInfo *pInfo )
 
 }
 
+bool CServerNetworkProperty::IsInPVS( const CCheckTransmitInfo *pInfo )
+{
+	// PVS data must be up to date
+	Assert( !m_pPev || ( ( m_pPev->m_fStateFlags & FL_EDICT_DIRTY_PVS_INFORMATION ) == 0 ) );
+	Assert( edict() != pInfo->m_pClientEnt );
+
+	return IsInPVSInternal( m_PVSInfo.m_nAreaNum, m_PVSInfo.m_nAreaNum2, m_PVSInfo.m_nHeadNode,
+		m_PVSInfo.m_nClusterCount, m_PVSInfo.m_pClusters, pInfo );
+}
+
+bool CServerNetworkProperty::IsEdictInPVS( int iEdict, const CCheckTransmitInfo *pInfo )
+{
+	const EdictTransmitState_t &state = g_EdictTransmitState[iEdict];
+	if ( state.m_nClusterCount > MAX_FAST_ENT_CLUSTERS )
+	{
+		// Only the network property has all of the clusters
+		edict_t *pEdict = engine->PEntityOfEntIndex( iEdict );
+		return static_cast<CServerNetworkProperty*>( pEdict->GetNetworkable() )->IsInPVS( pInfo );
+	}
+
+	return IsInPVSInternal( state.m_nAreaNum, state.m_nAreaNum2, state.m_nHeadNode,
+		state.m_nClusterCount, state.m_Clusters, pInfo );
+}
+
 
 void CServerNetworkProperty::SetUpdateInterval( float val )
 {
 	if ( val == 0 )
+	{
 		m_TimerEvent.StopUpdates();
+
+		// Don't sit on changes nobody is going to fire anymore
+		FireEvent();
+	}
 	else
+	{
+		if ( !m_pPendingChanges )
+		{
+			m_pPendingChanges = new CEdictChangeInfo;
+			m_pPendingChanges->m_nChangeOffsets = 0;
+		}
 		m_TimerEvent.SetUpdateInterval( val );
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Same bookkeeping edict_t::StateChanged( offset ) does, kept until FireEvent
+//-----------------------------------------------------------------------------
+void CServerNetworkProperty::QueueStateChange( unsigned short varOffset )
+{
+	m_bPendingStateChange = true;
+	if ( m_bPendingFullStateChange )
+		return;
+
+	CEdictChangeInfo *p = m_pPendingChanges;
+	if ( !p || p->m_nChangeOffsets == MAX_CHANGE_OFFSETS )
+	{
+		m_bPendingFullStateChange = true;
+		return;
+	}
+
+	for ( unsigned short i = 0; i < p->m_nChangeOffsets; i++ )
+	{
+		if ( p->m_ChangeOffsets[i] == varOffset )
+			return;
+	}
+
+	p->m_ChangeOffsets[p->m_nChangeOffsets++] = varOffset;
 }
 
 
@@ -299,8 +409,28 @@ void CServerNetworkProperty::FireEvent()
 	// trigger a state change in the edict.
 	if ( m_bPendingStateChange )
 	{
-		m_pPev->StateChanged();
+		if ( m_pPev )
+		{
+			if ( m_bPendingFullStateChange || !m_pPendingChanges )
+			{
+				m_pPev->StateChanged();
+			}
+			else
+			{
+				// Only the props that actually changed
+				for ( unsigned short i = 0; i < m_pPendingChanges->m_nChangeOffsets; i++ )
+				{
+					m_pPev->StateChanged( m_pPendingChanges->m_ChangeOffsets[i] );
+				}
+			}
+		}
+
 		m_bPendingStateChange = false;
+		m_bPendingFullStateChange = false;
+		if ( m_pPendingChanges )
+		{
+			m_pPendingChanges->m_nChangeOffsets = 0;
+		}
 	}
 }
 
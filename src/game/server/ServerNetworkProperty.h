@@ -16,6 +16,31 @@
 #include "edict.h"
 #include "timedeventmgr.h"
 
+//-----------------------------------------------------------------------------
+// The part of each edict's networking state that CheckTransmit reads, packed
+// by edict index so the transmit loops stream through one array instead of
+// going through every entity. Kept in sync by CServerNetworkProperty.
+//-----------------------------------------------------------------------------
+#define EDICT_TRANSMIT_NO_PARENT	0xFFFF
+
+struct EdictTransmitState_t
+{
+	short			m_nAreaNum;
+	short			m_nAreaNum2;
+	short			m_nHeadNode;
+
+	// -1 if too many clusters to list, in which case m_nHeadNode is used.
+	// Past MAX_FAST_ENT_CLUSTERS only the network property has the whole list.
+	short			m_nClusterCount;
+	unsigned short	m_Clusters[MAX_FAST_ENT_CLUSTERS];
+
+	// Network parent's edict index
+	unsigned short	m_iParent;
+};
+
+extern EdictTransmitState_t g_EdictTransmitState[MAX_EDICTS];
+
+
 //
 // Lightweight base class for networkable data on the server.
 //
@@ -92,6 +117,9 @@ public:
 	// This version does a PVS check which also checks for connected areas
 	bool IsInPVS( const CCheckTransmitInfo *pInfo );
 
+	// Same as IsInPVS( pInfo ), using g_EdictTransmitState. PVS information must be up to date.
+	static bool IsEdictInPVS( int iEdict, const CCheckTransmitInfo *pInfo );
+
 	// This version doesn't do the area check
 	bool IsInPVS( const edict_t *pRecipient, const void *pvs, int pvssize );
 
@@ -101,6 +129,9 @@ public:
 	// Recomputes PVS information
 	void RecomputePVSInformation();
 
+	// Called after a save game is restored
+	void OnRestore();
+
 private:
 	// Detaches the edict.. should only be called by CBaseNetworkable's destructor.
 	void DetachEdict();
@@ -109,6 +140,12 @@ private:
 	// Marks the networkable that it will should transmit
 	void SetTransmit( CCheckTransmitInfo *pInfo );
 
+	// Remembers a change made while waiting for the update timer
+	void QueueStateChange( unsigned short varOffset );
+
+	// Copies PVS information and the network parent into g_EdictTransmitState
+	void CopyToEdictTransmitState();
+
 private:
 	CBaseEntity *m_pOuter;
 	// CBaseTransmitProxy *m_pTransmitProxy;
@@ -123,6 +160,12 @@ private:
 	// Counters for SetUpdateInterval.
 	CEventRegister	m_TimerEvent;
 	bool m_bPendingStateChange : 1;
+	bool m_bPendingFullStateChange : 1;
+
+	// Offsets changed since the timer last went off, so it can hand the edict
+	// the individual props instead of a full change. Only allocated while an
+	// update interval is set.
+	CEdictChangeInfo *m_pPendingChanges;
 
 //	friend class CBaseTransmitProxy;
 };
@@ -164,15 +207,6 @@ inline void CServerNetworkProperty::MarkPVSInformationDirty()
 }
 
 
-//-----------------------------------------------------------------------------
-// Sets/gets the network parent
-//-----------------------------------------------------------------------------
-inline void CServerNetworkProperty::SetNetworkParent( EHANDLE hParent )
-{
-	m_hParent = hParent;
-}
-
-
 //-----------------------------------------------------------------------------
 // Methods related to the net state mgr
 //-----------------------------------------------------------------------------
@@ -190,6 +224,7 @@ inline void CServerNetworkProperty::NetworkStateChanged()
 		// If we're waiting for a timer event, then queue the change so it happens
 		// when the timer goes off.
 		m_bPendingStateChange = true;
+		m_bPendingFullStateChange = true;
 	}
 	else
 	{
@@ -205,7 +240,7 @@ inline void CServerNetworkProperty::NetworkStateChanged( unsigned short varOffse
 	{
 		// If we're waiting for a timer event, then queue the change so it happens
 		// when the timer goes off.
-		m_bPendingStateChange = true;
+		QueueStateChange( varOffset );
 	}
 	else
 	{
@@ -245,6 +280,7 @@ inline const edict_t *CServerNetworkProperty::edict() const
 inline void CServerNetworkProperty::SetEdict( edict_t *pEdict )
 {
 	m_pPev = pEdict;
+	CopyToEdictTransmitState();
 }
 
 
@@ -458,6 +458,9 @@ public:
 	void RemoveAI( CAI_BaseNPC *pAI );
 
 	bool FindAI( CAI_BaseNPC *pAI )	{ return ( m_AIs.Find( pAI ) != m_AIs.InvalidIndex() ); }
+
+	// Bumped whenever an AI is added or removed
+	int GetChangeCount() const		{ return m_iChangeCount; }
 	
 private:
 	enum
@@ -468,6 +471,7 @@ private:
 	typedef CUtlVector<CAI_BaseNPC *> CAIArray;
 	
 	CAIArray m_AIs;
+	int m_iChangeCount;
 
 };
 
@@ -23,6 +23,7 @@
 #include "ai_hint.h"
 #include "ai_memory.h"
 #include "ai_navigator.h"
+#include "ai_routequeue.h"
 #include "ai_tacticalservices.h"
 #include "ai_moveprobe.h"
 #include "ai_squadslot.h"
@@ -727,15 +728,30 @@ void CAI_BaseNPC::MaintainSchedule ( void )
 			m_ScheduleState.taskFailureCode    = NO_TASK_FAILURE;
 			m_ScheduleState.timeCurTaskStarted = gpGlobals->curtime;
 			
+			CAI_Schedule *pStartingSchedule = GetCurSchedule();
+			int iStartingTask = GetScheduleCurTaskIndex();
+			bool bRouteDeferred;
+
 			AI_PROFILE_SCOPE_BEGIN_( pszTaskName );
 			AI_PROFILE_SCOPE_BEGIN(CAI_BaseNPC_StartTask);
 
+			g_AIRouteQueue.BeginStartTask( this );
 			StartTask( pTask );
+			bRouteDeferred = g_AIRouteQueue.EndStartTask( this );
 
 			AI_PROFILE_SCOPE_END();
 			AI_PROFILE_SCOPE_END();
 
-			if ( TaskIsRunning() && !HasCondition(COND_TASK_FAILED) )
+			if ( bRouteDeferred && GetCurSchedule() == pStartingSchedule && GetScheduleCurTaskIndex() == iStartingTask )
+			{
+				// A node search ran out of time this tick. Start the task over
+				// next think, when the search carries on where it stopped
+				SetTaskStatus( TASKSTATUS_NEW );
+				ClearCondition( COND_TASK_FAILED );
+				m_ScheduleState.taskFailureCode = NO_TASK_FAILURE;
+				bStopProcessing = true;
+			}
+			else if ( TaskIsRunning() && !HasCondition(COND_TASK_FAILED) )
 				StartTaskOverlay();
 
 			g_AITaskTimings[curTiming].startTimer.End();
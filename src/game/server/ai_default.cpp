@@ -475,6 +475,7 @@ public:
 	void LevelShutdownPostEntity( void )
 	{
 		g_AI_SensedObjectsManager.Term();
+		g_AI_SenseCandidates.Clear();
 		g_pAINetworkManager->DeleteAllAINetworks();
 		g_AI_SchedulesManager.DeleteAllSchedules();
 		g_AI_SquadManager.DeleteAllSquads();
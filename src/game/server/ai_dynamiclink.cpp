@@ -15,6 +15,8 @@
 #include "ai_link.h"
 #include "ai_network.h"
 #include "ai_networkmanager.h"
+#include "ai_networkclusters.h"
+#include "ai_routequeue.h"
 #include "saverestore_utlvector.h"
 #include "editor_sendcommand.h"
 #include "bitstring.h"
@@ -494,6 +496,13 @@ void CAI_DynamicLink::SetLinkState(void)
 			{
 				pLink->m_LinkInfo &= ~bits_LINK_OFF;
 			}
+
+			if ( g_pBigAINet->GetClusters() )
+			{
+				g_pBigAINet->GetClusters()->OnLinkChanged( pLink );
+			}
+
+			g_AIRouteQueue.OnNetworkChanged();
 		}
 		else
 		{
@@ -120,6 +120,33 @@ void CAI_TestHull::ReturnTestHull(void)
 	pTestHull = NULL;
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Create a test hull apart from the shared one, so link tests can
+//			run on several threads at once
+//-----------------------------------------------------------------------------
+CAI_TestHull* CAI_TestHull::CreateWorkerHull(void)
+{
+	CAI_TestHull *pHull = CREATE_ENTITY( CAI_TestHull, "aitesthull" );
+	pHull->Spawn();
+	pHull->AddFlag( FL_NPC );
+	pHull->RemoveSolidFlags( FSOLID_NOT_SOLID );
+	pHull->bInUse = true;
+
+	return pHull;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Remove a hull made by CreateWorkerHull()
+//-----------------------------------------------------------------------------
+void CAI_TestHull::DestroyWorkerHull( CAI_TestHull *pHull )
+{
+	pHull->bInUse = false;
+	pHull->AddSolidFlags( FSOLID_NOT_SOLID );
+	UTIL_SetSize( pHull, vec3_origin, vec3_origin );
+
+	UTIL_RemoveImmediate( pHull );
+}
+
 //-----------------------------------------------------------------------------
 // Purpose: 
 // Input  : &startPos - 
@@ -141,7 +168,8 @@ bool CAI_TestHull::IsJumpLegal(const Vector &startPos, const Vector &apex, const
 //-----------------------------------------------------------------------------
 CAI_TestHull::~CAI_TestHull(void)
 {
-	CAI_TestHull::pTestHull = NULL;
+	if ( CAI_TestHull::pTestHull == this )
+		CAI_TestHull::pTestHull = NULL;
 }
 
 //###########################################################
@@ -90,6 +90,8 @@ private:
 public:
 	static CAI_TestHull*	GetTestHull(void);						// Get the test hull
 	static void				ReturnTestHull(void);					// Return the test hull
+	static CAI_TestHull*	CreateWorkerHull(void);					// Extra hull for a node graph build worker thread
+	static void				DestroyWorkerHull( CAI_TestHull *pHull );
 
 	bool					bInUse;
 	virtual void			Precache();
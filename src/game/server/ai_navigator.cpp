@@ -22,6 +22,7 @@
 #include "ai_routedist.h"
 #include "ai_waypoint.h"
 #include "ai_pathfinder.h"
+#include "ai_routequeue.h"
 #include "ai_link.h"
 #include "ai_memory.h"
 #include "ai_motor.h"
@@ -486,6 +487,14 @@ bool CAI_Navigator::SetGoal( const AI_NavGoal_t &goal, unsigned flags )
 		flags |= AIN_NO_PATH_TASK_FAIL;
 
 	bool result = FindPath( goal, flags );
+
+	// The node search ran out of time this tick. MaintainSchedule starts the
+	// task over next think, and the search carries on where it stopped
+	if ( result == false && g_AIRouteQueue.IsDeferred( GetOuter() ) )
+	{
+		DbgNavMsg( GetOuter(), "Node search put off until next think\n" );
+		return true;
+	}
 	
 	if ( result == false )
 	{
@@ -3384,6 +3393,10 @@ bool CAI_Navigator::FindPath( bool fSignalTaskStatus, bool bDontIgnoreBadLinks )
 
 	bool bFindResult = DoFindPath();
 
+	// The node search was put off until next think, which isn't a failure
+	if ( !bFindResult && g_AIRouteQueue.IsDeferred( GetOuter() ) )
+		return false;
+
 	if ( !bDontIgnoreBadLinks && !bFindResult && GetOuter()->IsNavigationUrgent() )
 	{
 		GetPathfinder()->SetIgnoreBadLinks();
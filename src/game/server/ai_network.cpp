@@ -15,6 +15,7 @@
 #include "ai_link.h"
 #include "ai_navigator.h"
 #include "ai_moveprobe.h"
+#include "ai_networkclusters.h"
 
 // memdbgon must be the last include file in a .cpp file!!!
 #include "tier0/memdbgon.h"
@@ -116,6 +117,9 @@ CAI_Network::CAI_Network()
 		m_NearestCache[node].expiration	= FLT_MIN;
 	}
 
+	m_pClusters = NULL;
+	ResetPathSearchStats();
+
 #ifdef AI_NODE_TREE
 	m_pNodeTree = NULL;
 #endif
@@ -125,6 +129,8 @@ CAI_Network::CAI_Network()
 
 CAI_Network::~CAI_Network()
 {
+	delete m_pClusters;
+
 #ifdef AI_NODE_TREE
 	if ( m_pNodeTree )
 	{
@@ -169,6 +175,17 @@ CAI_Network::~CAI_Network()
 	m_pAInode = NULL;
 }
 
+//-----------------------------------------------------------------------------
+
+void CAI_Network::BuildClusters()
+{
+	if ( !m_pClusters )
+	{
+		m_pClusters = new CAI_NetworkClusters( this );
+	}
+	m_pClusters->Build();
+}
+
 //-----------------------------------------------------------------------------
 // Purpose: Given an bitString and float array of size array_size, return the 
 //			index of the smallest number in the array whose it is set
@@ -25,6 +25,7 @@ struct AI_Waypoint_t;
 class CAI_BaseNPC;
 class CAI_Link;
 class CAI_DynamicLink;
+class CAI_NetworkClusters;
 
 //-----------------------------------------------------------------------------
 
@@ -78,6 +79,24 @@ public:
 	CNodeList( AI_NearNode_t *pMemory, int count ) : CUtlPriorityQueue<AI_NearNode_t>( pMemory, count, IsLowerPriority ) {}
 };
 
+//-----------------------------------------------------------------------------
+// Purpose: What CAI_Pathfinder::FindBestPath has cost on a network, for
+//			ai_pathfind_stats
+//-----------------------------------------------------------------------------
+
+struct AI_PathSearchStats_t
+{
+	int		nSearches;
+	int		nFound;
+	int		nCorridorSearches;
+	int		nCorridorFallbacks;	// Found nothing in the corridor and had to search everything
+	int64	nNodesExpanded;
+	int64	nNodesOpened;
+	int		nMostExpanded;
+	double	flTotalMS;
+	double	flWorstMS;
+};
+
 //-----------------------------------------------------------------------------
 // CAI_Network
 //
@@ -127,6 +146,13 @@ public:
 	}
 	
 	CAI_Node**		AccessNodes() const	{ return m_pAInode; }
+
+	// Rebuilt whenever the nodes or their links are
+	void			BuildClusters();
+	CAI_NetworkClusters *GetClusters()				{ return m_pClusters; }
+
+	AI_PathSearchStats_t &AccessPathSearchStats()	{ return m_PathSearchStats; }
+	void			ResetPathSearchStats()			{ memset( &m_PathSearchStats, 0, sizeof( m_PathSearchStats ) ); }
 	
 private:
 	friend class CAI_NetworkManager;
@@ -167,6 +193,9 @@ private:
 	NearNodeCache_T		m_NearestCache[NEARNODE_CACHE_SIZE];	// Cache of nearest nodes
 	int					m_iNearestCacheNext;					// Oldest record in the cache
 
+	CAI_NetworkClusters	*m_pClusters;
+	AI_PathSearchStats_t m_PathSearchStats;
+
 #ifdef AI_NODE_TREE
 	ISpatialPartition * m_pNodeTree;
 	CUtlVector<int>		m_GatheredNodes;
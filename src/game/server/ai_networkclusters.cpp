@@ -0,0 +1,317 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Coarse cluster graph over a CAI_Network, used to narrow long
+//			node graph searches down to a corridor of clusters.
+//
+// $NoKeywords: $
+//=============================================================================//
+
+#include "cbase.h"
+
+#include "ai_networkclusters.h"
+#include "ai_network.h"
+#include "ai_node.h"
+#include "ai_link.h"
+#include "ai_pathsearch.h"
+#include "bitstring.h"
+#include "utlmap.h"
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include "tier0/memdbgon.h"
+
+// Edge length of the cubes nodes are grouped by
+#define AI_CLUSTER_SIZE 1024.0f
+
+//-----------------------------------------------------------------------------
+// CAI_NetworkClusters
+//-----------------------------------------------------------------------------
+
+CAI_NetworkClusters::CAI_NetworkClusters( CAI_Network *pNetwork )
+ :	m_pNetwork( pNetwork )
+{
+}
+
+//-----------------------------------------------------------------------------
+
+CAI_NetworkClusters::~CAI_NetworkClusters()
+{
+	Clear();
+}
+
+//-----------------------------------------------------------------------------
+
+void CAI_NetworkClusters::Clear()
+{
+	m_Clusters.PurgeAndDeleteElements();
+	m_NodeCluster.Purge();
+	m_NodeLocal.Purge();
+	m_NodePortal.Purge();
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Groups the nodes and finds the portals. Portal distances are
+//			worked out the first time each cluster is searched through.
+//-----------------------------------------------------------------------------
+
+void CAI_NetworkClusters::Build()
+{
+	Clear();
+
+	int nNodes = m_pNetwork->NumNodes();
+	CAI_Node **ppNodes = m_pNetwork->AccessNodes();
+
+	m_NodeCluster.SetCount( nNodes );
+	m_NodeLocal.SetCount( nNodes );
+	m_NodePortal.SetCount( nNodes );
+
+	// Nodes in different zones can never reach each other, so never share a cluster
+	CUtlMap<uint64, int> clusterMap( DefLessFunc( uint64 ) );
+	for ( int i = 0; i < nNodes; i++ )
+	{
+		const Vector &vecOrigin = ppNodes[i]->GetOrigin();
+		uint64 key = ( (uint64)( ppNodes[i]->GetZone() & 0xffff ) << 48 ) |
+					 ( (uint64)( (int)floor( vecOrigin.x / AI_CLUSTER_SIZE ) & 0xffff ) << 32 ) |
+					 ( (uint64)( (int)floor( vecOrigin.y / AI_CLUSTER_SIZE ) & 0xffff ) << 16 ) |
+					 ( (uint64)( (int)floor( vecOrigin.z / AI_CLUSTER_SIZE ) & 0xffff ) );
+
+		unsigned short iMap = clusterMap.Find( key );
+		if ( iMap == clusterMap.InvalidIndex() )
+		{
+			iMap = clusterMap.Insert( key, m_Clusters.AddToTail( new Cluster_t ) );
+		}
+
+		int iCluster = clusterMap[iMap];
+		m_NodeCluster[i] = iCluster;
+		m_NodeLocal[i] = m_Clusters[iCluster]->nodes.AddToTail( i );
+		m_NodePortal[i] = -1;
+	}
+
+	for ( int i = 0; i < nNodes; i++ )
+	{
+		CAI_Node *pNode = ppNodes[i];
+		for ( int link = 0; link < pNode->NumLinks(); link++ )
+		{
+			int destID = pNode->GetLinkByIndex( link )->DestNodeID( i );
+			if ( m_NodeCluster[destID] != m_NodeCluster[i] )
+			{
+				Cluster_t *pCluster = m_Clusters[ m_NodeCluster[i] ];
+				m_NodePortal[i] = pCluster->portals.AddToTail( i );
+				break;
+			}
+		}
+	}
+
+	for ( int i = 0; i < m_Clusters.Count(); i++ )
+	{
+		m_Clusters[i]->bDistancesDirty = true;
+	}
+
+	DevMsg( "AI network: %d nodes in %d clusters\n", nNodes, m_Clusters.Count() );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Links between clusters are checked as they're searched, so only
+//			a link inside a cluster invalidates anything
+//-----------------------------------------------------------------------------
+
+void CAI_NetworkClusters::OnLinkChanged( CAI_Link *pLink )
+{
+	if ( pLink->m_iSrcID >= m_NodeCluster.Count() || pLink->m_iDestID >= m_NodeCluster.Count() )
+		return;
+
+	int iCluster = m_NodeCluster[pLink->m_iSrcID];
+	if ( iCluster == m_NodeCluster[pLink->m_iDestID] )
+	{
+		m_Clusters[iCluster]->bDistancesDirty = true;
+	}
+}
+
+//-----------------------------------------------------------------------------
+
+bool CAI_NetworkClusters::IsLinkOpen( CAI_Link *pLink, Hull_t hull, int capabilities ) const
+{
+	return ( !( pLink->m_LinkInfo & bits_LINK_OFF ) && ( pLink->m_iAcceptedMoveTypes[hull] & capabilities ) );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Shortest distances from one node to every node in its cluster,
+//			staying inside the cluster. Indexed like Cluster_t::nodes.
+//-----------------------------------------------------------------------------
+
+void CAI_NetworkClusters::GetLocalDistances( Cluster_t *pCluster, int iFromNode, Hull_t hull, float *pDistances )
+{
+	int nLocal = pCluster->nodes.Count();
+	bool *pDone = (bool *)stackalloc( nLocal * sizeof(bool) );
+	for ( int i = 0; i < nLocal; i++ )
+	{
+		pDistances[i] = FLT_MAX;
+		pDone[i] = false;
+	}
+	pDistances[ m_NodeLocal[iFromNode] ] = 0;
+
+	CAI_Node **ppNodes = m_pNetwork->AccessNodes();
+	int iCluster = m_NodeCluster[iFromNode];
+
+	for ( ;; )
+	{
+		// Clusters are small, so a scan does fine here
+		int iBest = -1;
+		for ( int i = 0; i < nLocal; i++ )
+		{
+			if ( !pDone[i] && pDistances[i] != FLT_MAX && ( iBest == -1 || pDistances[i] < pDistances[iBest] ) )
+			{
+				iBest = i;
+			}
+		}
+		if ( iBest == -1 )
+			break;
+
+		pDone[iBest] = true;
+
+		int iNode = pCluster->nodes[iBest];
+		CAI_Node *pNode = ppNodes[iNode];
+		Vector vecPos = pNode->GetPosition( hull );
+		for ( int link = 0; link < pNode->NumLinks(); link++ )
+		{
+			CAI_Link *pLink = pNode->GetLinkByIndex( link );
+			int destID = pLink->DestNodeID( iNode );
+			if ( m_NodeCluster[destID] != iCluster || !IsLinkOpen( pLink, hull, ~0 ) )
+				continue;
+
+			int iDestLocal = m_NodeLocal[destID];
+			float flDist = pDistances[iBest] + ( ppNodes[destID]->GetPosition( hull ) - vecPos ).Length();
+			if ( flDist < pDistances[iDestLocal] )
+			{
+				pDistances[iDestLocal] = flDist;
+			}
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+
+void CAI_NetworkClusters::UpdatePortalDistances( Cluster_t *pCluster )
+{
+	int nPortals = pCluster->portals.Count();
+	float *pDistances = (float *)stackalloc( pCluster->nodes.Count() * sizeof(float) );
+
+	for ( int hull = 0; hull < NUM_HULLS; hull++ )
+	{
+		CUtlVector<float> &portalDistances = pCluster->portalDistances[hull];
+		portalDistances.SetCount( nPortals * nPortals );
+
+		for ( int i = 0; i < nPortals; i++ )
+		{
+			GetLocalDistances( pCluster, pCluster->portals[i], (Hull_t)hull, pDistances );
+			for ( int j = 0; j < nPortals; j++ )
+			{
+				portalDistances[ i * nPortals + j ] = pDistances[ m_NodeLocal[ pCluster->portals[j] ] ];
+			}
+		}
+	}
+
+	pCluster->bDistancesDirty = false;
+}
+
+//-----------------------------------------------------------------------------
+
+float CAI_NetworkClusters::GetPortalDistance( Cluster_t *pCluster, Hull_t hull, int iFromPortal, int iToPortal )
+{
+	if ( pCluster->bDistancesDirty )
+	{
+		UpdatePortalDistances( pCluster );
+	}
+	return pCluster->portalDistances[hull][ iFromPortal * pCluster->portals.Count() + iToPortal ];
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: A* over the portals, plus the start and end nodes
+//-----------------------------------------------------------------------------
+
+static inline void RelaxCorridorNode( CAI_PathSearch *pSearch, CAI_Node **ppNodes, Hull_t hull, const Vector &vecEnd, int iFrom, int iNext, float flStep )
+{
+	if ( iNext == iFrom || flStep == FLT_MAX )
+		return;
+
+	float flNewCost = pSearch->GetCost( iFrom ) + flStep;
+	if ( !pSearch->IsReached( iNext ) || flNewCost < pSearch->GetCost( iNext ) )
+	{
+		pSearch->SetCost( iNext, iFrom, flNewCost, flNewCost + ( ppNodes[iNext]->GetPosition( hull ) - vecEnd ).Length() );
+	}
+}
+
+bool CAI_NetworkClusters::FindCorridor( int startID, int endID, Hull_t hull, int capabilities, CAI_PathSearch *pSearch, CVarBitVec *pCorridor )
+{
+	Assert( m_NodeCluster.Count() == m_pNetwork->NumNodes() );
+
+	CAI_Node **ppNodes = m_pNetwork->AccessNodes();
+	int iStartCluster = m_NodeCluster[startID];
+	int iEndCluster = m_NodeCluster[endID];
+	Cluster_t *pStartCluster = m_Clusters[iStartCluster];
+	Cluster_t *pEndCluster = m_Clusters[iEndCluster];
+
+	// How far each node in the end and start clusters is from the end and start
+	float *pEndDistances = (float *)stackalloc( pEndCluster->nodes.Count() * sizeof(float) );
+	GetLocalDistances( pEndCluster, endID, hull, pEndDistances );
+	float *pStartDistances = (float *)stackalloc( pStartCluster->nodes.Count() * sizeof(float) );
+	GetLocalDistances( pStartCluster, startID, hull, pStartDistances );
+
+	Vector vecEnd = ppNodes[endID]->GetPosition( hull );
+
+	pSearch->Begin( m_pNetwork->NumNodes() );
+	pSearch->SetCost( startID, NO_NODE, 0, ( ppNodes[startID]->GetPosition( hull ) - vecEnd ).Length() );
+
+	while ( pSearch->HasOpen() )
+	{
+		int iNode = pSearch->PopOpen();
+		if ( iNode == endID )
+		{
+			pCorridor->Resize( m_Clusters.Count(), true );
+			for ( int i = endID; i != NO_NODE; i = pSearch->GetParents()[i] )
+			{
+				pCorridor->Set( m_NodeCluster[i] );
+			}
+			return true;
+		}
+
+		int iCluster = m_NodeCluster[iNode];
+		Cluster_t *pCluster = m_Clusters[iCluster];
+
+		if ( iNode == startID )
+		{
+			for ( int i = 0; i < pCluster->portals.Count(); i++ )
+			{
+				int iPortal = pCluster->portals[i];
+				RelaxCorridorNode( pSearch, ppNodes, hull, vecEnd, iNode, iPortal, pStartDistances[ m_NodeLocal[iPortal] ] );
+			}
+		}
+
+		int iFromPortal = m_NodePortal[iNode];
+		if ( iFromPortal != -1 )
+		{
+			for ( int i = 0; i < pCluster->portals.Count(); i++ )
+			{
+				RelaxCorridorNode( pSearch, ppNodes, hull, vecEnd, iNode, pCluster->portals[i], GetPortalDistance( pCluster, hull, iFromPortal, i ) );
+			}
+
+			CAI_Node *pNode = ppNodes[iNode];
+			Vector vecPos = pNode->GetPosition( hull );
+			for ( int link = 0; link < pNode->NumLinks(); link++ )
+			{
+				CAI_Link *pLink = pNode->GetLinkByIndex( link );
+				int destID = pLink->DestNodeID( iNode );
+				if ( m_NodeCluster[destID] == iCluster || !IsLinkOpen( pLink, hull, capabilities ) )
+					continue;
+
+				RelaxCorridorNode( pSearch, ppNodes, hull, vecEnd, iNode, destID, ( ppNodes[destID]->GetPosition( hull ) - vecPos ).Length() );
+			}
+		}
+
+		if ( iCluster == iEndCluster )
+		{
+			RelaxCorridorNode( pSearch, ppNodes, hull, vecEnd, iNode, endID, pEndDistances[ m_NodeLocal[iNode] ] );
+		}
+	}
+
+	return false;
+}
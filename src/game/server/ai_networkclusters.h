@@ -0,0 +1,81 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Coarse cluster graph over a CAI_Network, used to narrow long
+//			node graph searches down to a corridor of clusters.
+//
+// $NoKeywords: $
+//=============================================================================//
+
+#ifndef AI_NETWORKCLUSTERS_H
+#define AI_NETWORKCLUSTERS_H
+
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include "utlvector.h"
+#include "ai_hull.h"
+#include "ai_network.h"
+
+class CAI_Link;
+class CAI_PathSearch;
+class CVarBitVec;
+
+//-----------------------------------------------------------------------------
+// CAI_NetworkClusters
+//
+// Purpose: Nodes are grouped into clusters by zone and by position. Nodes
+//			with links into another cluster are portals, and each cluster
+//			caches the distances between its portals for every hull. A search
+//			over portals then says which clusters a long route goes through.
+//-----------------------------------------------------------------------------
+
+class CAI_NetworkClusters
+{
+public:
+	CAI_NetworkClusters( CAI_Network *pNetwork );
+	~CAI_NetworkClusters();
+
+	void	Build();
+
+	// A dynamic link was turned on or off
+	void	OnLinkChanged( CAI_Link *pLink );
+
+	// False if nodes have been added since the last Build()
+	bool	IsCurrent() const				{ return m_NodeCluster.Count() == m_pNetwork->NumNodes(); }
+
+	int		NumClusters() const				{ return m_Clusters.Count(); }
+	int		GetNodeCluster( int iNode ) const	{ return m_NodeCluster[iNode]; }
+
+	// Sets the bits in pCorridor for the clusters the best route from startID
+	// to endID passes through. Uses pSearch as scratch. Returns false if the
+	// cluster graph has no route for the hull.
+	bool	FindCorridor( int startID, int endID, Hull_t hull, int capabilities, CAI_PathSearch *pSearch, CVarBitVec *pCorridor );
+
+private:
+	struct Cluster_t
+	{
+		CUtlVector<int>		nodes;
+		CUtlVector<int>		portals;
+
+		// portals x portals for each hull, FLT_MAX if not connected inside the cluster
+		CUtlVector<float>	portalDistances[NUM_HULLS];
+		bool				bDistancesDirty;
+	};
+
+	void	Clear();
+	bool	IsLinkOpen( CAI_Link *pLink, Hull_t hull, int capabilities ) const;
+	void	UpdatePortalDistances( Cluster_t *pCluster );
+	void	GetLocalDistances( Cluster_t *pCluster, int iFromNode, Hull_t hull, float *pDistances );
+	float	GetPortalDistance( Cluster_t *pCluster, Hull_t hull, int iFromPortal, int iToPortal );
+
+	CAI_Network *			m_pNetwork;
+	CUtlVector<Cluster_t *>	m_Clusters;
+	CUtlVector<int>			m_NodeCluster;
+	CUtlVector<int>			m_NodeLocal;		// Index into Cluster_t::nodes
+	CUtlVector<int>			m_NodePortal;		// Index into Cluster_t::portals, or -1
+};
+
+//-----------------------------------------------------------------------------
+
+#endif // AI_NETWORKCLUSTERS_H
@@ -25,6 +25,8 @@
 #include "ndebugoverlay.h"
 #include "ai_hint.h"
 #include "tier0/icommandline.h"
+#include "mathlib/ssemath.h"
+#include "vstdlib/jobthread.h"
 
 // memdbgon must be the last include file in a .cpp file!!!
 #include "tier0/memdbgon.h"
@@ -69,6 +71,7 @@ CON_COMMAND( ai_debug_node_connect, "Debug the attempted connection between two
 // line to properly override the node graph building.
 
 ConVar g_ai_norebuildgraph( "ai_norebuildgraph", "0" );
+ConVar ai_network_build_parallel( "ai_network_build_parallel", "0", 0, "Run the node graph build's line of sight and link tests on the thread pool. Off by default: the traces run CAI_TestHull and trace filter callbacks, which call into entity code that isn't known to be thread-safe." );
 
 
 //-----------------------------------------------------------------------------
@@ -180,6 +183,8 @@ void CAI_NetworkManager::StartRebuild( void )
 	// ------------------------
 	CAI_DynamicLink::ResetDynamicLinks();
 
+	m_pNetwork->BuildClusters();
+
 	// --------------------------------------------------
 	//  Update display of usable nodes for displayed hull
 	// --------------------------------------------------
@@ -1123,6 +1128,8 @@ void CAI_NetworkManager::DelayedInit( void )
 	// --------------------------------------------
 	CAI_DynamicLink::InitDynamicLinks();
 	FixupHints();
+
+	m_pNetwork->BuildClusters();
 	
 	GetEditOps()->OnInit();
 
@@ -2218,6 +2225,8 @@ void CAI_NetworkBuilder::EndBuild()
 {
 	m_NeighborsTable.SetSize(0);
 	m_DidSetNeighborsTable.Resize(0);
+	m_VisibleTable.SetSize(0);
+	m_Connections.Purge();
 	CAI_TestHull::ReturnTestHull();
 }
 
@@ -2276,6 +2285,7 @@ void CAI_NetworkBuilder::Build( CAI_Network *pNetwork )
 		m_NeighborsTable[i].Resize( nNodes );
 		m_NeighborsTable[i].ClearAll();
 	}
+	ComputeVisibility( pNetwork );
 	for (i = 0; i < nNodes; i++)
 	{	
 		InitNeighbors( pNetwork, ppNodes[i] );
@@ -2302,6 +2312,7 @@ void CAI_NetworkBuilder::Build( CAI_Network *pNetwork )
 		// Make sure all the links are clear
 		ppNodes[i]->ClearLinks();
 	}
+	ComputeConnections( pNetwork );
 	for (i = 0; i < nNodes; i++)
 	{	
 		InitLinks( pNetwork, ppNodes[i] );
@@ -2606,6 +2617,175 @@ void CAI_NetworkBuilder::InitNodePosition(CAI_Network *pNetwork, CAI_Node *pNode
 	}
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Line of sight test between two node positions, used to limit the
+//			nodes InitNeighbors() considers
+//-----------------------------------------------------------------------------
+static bool IsNodeVisible( const Vector &srcPos, const Vector &destPos )
+{
+	trace_t	tr;
+	tr.m_pEnt = NULL;
+
+	// Try several line of sight checks
+
+	bool isVisible = false;
+
+	// ------------------
+	//  Bottom to bottom
+	// ------------------
+	AI_TraceLine ( srcPos, destPos,MASK_NPCWORLDSTATIC,NULL,COLLISION_GROUP_NONE, &tr );
+	if (!tr.startsolid && tr.fraction == 1.0)
+	{
+		isVisible = true;
+	}
+
+	// ------------------
+	//  Top to top
+	// ------------------
+	if (!isVisible)
+	{
+		AI_TraceLine ( srcPos + Vector( 0, 0, 70 ),destPos + Vector( 0, 0, 70 ),MASK_NPCWORLDSTATIC,NULL,COLLISION_GROUP_NONE, &tr );
+		if (!tr.startsolid && tr.fraction == 1.0)
+		{	
+			isVisible = true;
+		}
+	}
+
+	// ------------------
+	//  Top to Bottom
+	// ------------------
+	if (!isVisible)
+	{
+		AI_TraceLine ( srcPos + Vector( 0, 0, 70 ),destPos,MASK_NPCWORLDSTATIC,NULL,COLLISION_GROUP_NONE, &tr );
+		if (!tr.startsolid && tr.fraction == 1.0)
+		{	
+			isVisible = true;
+		}
+	}
+
+	// ------------------
+	//  Bottom to Top
+	// ------------------
+	if (!isVisible)
+	{
+		AI_TraceLine ( srcPos,destPos + Vector( 0, 0, 70 ),MASK_NPCWORLDSTATIC,NULL,COLLISION_GROUP_NONE, &tr );
+		if (!tr.startsolid && tr.fraction == 1.0)
+		{	
+			isVisible = true;
+		}
+	}
+
+	return isVisible;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Does the line of sight tests for every node ahead of
+//			InitNeighbors(), spread over the thread pool. Node origins are
+//			compared four at a time to throw out pairs too far apart to link.
+//			Each row of m_VisibleTable is only written by the job for its
+//			node, and only holds the pairs InitVisibility() would trace
+//			itself, from the lower numbered node.
+//-----------------------------------------------------------------------------
+
+typedef CUtlVector< FourVectors, CUtlMemoryAligned< FourVectors, 16 > > FourVectorsList_t;
+typedef CUtlVector< fltx4, CUtlMemoryAligned< fltx4, 16 > > Fltx4List_t;
+
+static FourVectorsList_t	g_NodeOrigins;
+static Fltx4List_t			g_NodeLinkDistSq;		// Per node, -1 for deleted nodes and padding
+
+void CAI_NetworkBuilder::ComputeVisibility( CAI_Network *pNetwork )
+{
+	m_VisibleTable.SetSize( 0 );
+
+	if ( !ai_network_build_parallel.GetBool() )
+		return;
+
+	m_pBuildNetwork = pNetwork;
+
+	int nNodes = pNetwork->NumNodes();
+	int nBlocks = ( nNodes + 3 ) / 4;
+	g_NodeOrigins.SetCount( nBlocks );
+	g_NodeLinkDistSq.SetCount( nBlocks );
+
+	CUtlVector<int> rows;
+	for ( int i = 0; i < nBlocks * 4; i++ )
+	{
+		FourVectors &origins = g_NodeOrigins[i >> 2];
+		fltx4 &linkDistSq = g_NodeLinkDistSq[i >> 2];
+		int lane = i & 3;
+
+		CAI_Node *pNode = ( i < nNodes ) ? pNetwork->GetNode( i ) : NULL;
+		if ( !pNode || pNode->GetType() == NODE_DELETED )
+		{
+			origins.X( lane ) = origins.Y( lane ) = origins.Z( lane ) = 0;
+			SubFloat( linkDistSq, lane ) = -1;
+			continue;
+		}
+
+		const Vector &origin = pNode->GetOrigin();
+		origins.X( lane ) = origin.x;
+		origins.Y( lane ) = origin.y;
+		origins.Z( lane ) = origin.z;
+
+		// A little over the real limit, so rounding can't drop a pair
+		// InitVisibility() would keep
+		float flLinkDistSq = ( pNode->GetType() == NODE_AIR ) ? MAX_AIR_NODE_LINK_DIST_SQ : MAX_NODE_LINK_DIST_SQ;
+		SubFloat( linkDistSq, lane ) = flLinkDistSq * 1.01f;
+
+		rows.AddToTail( i );
+	}
+
+	m_VisibleTable.SetSize( nNodes );
+	for ( int i = 0; i < nNodes; i++ )
+	{
+		m_VisibleTable[i].Resize( nNodes );
+		m_VisibleTable[i].ClearAll();
+	}
+
+	ParallelProcess( "CAI_NetworkBuilder::ComputeVisibility", rows.Base(), rows.Count(), this, &CAI_NetworkBuilder::ComputeVisibilityRow );
+
+	g_NodeOrigins.Purge();
+	g_NodeLinkDistSq.Purge();
+}
+
+//-------------------------------------
+
+void CAI_NetworkBuilder::ComputeVisibilityRow( int &iNode )
+{
+	CAI_Node *pNode = m_pBuildNetwork->GetNode( iNode );
+	Vector srcPos = pNode->GetPosition(HULL_SMALL_CENTERED);
+
+	FourVectors origin;
+	origin.DuplicateVector( pNode->GetOrigin() );
+
+	const FourVectors *pOrigins = g_NodeOrigins.Base();
+	const fltx4 *pLinkDistSq = g_NodeLinkDistSq.Base();
+	int nBlocks = g_NodeOrigins.Count();
+
+	for ( int i = ( iNode + 1 ) >> 2; i < nBlocks; i++ )
+	{
+		FourVectors delta = pOrigins[i];
+		delta -= origin;
+
+		int inRange = TestSignSIMD( CmpLeSIMD( delta.length2(), pLinkDistSq[i] ) );
+		if ( !inRange )
+			continue;
+
+		for ( int lane = 0; lane < 4; lane++ )
+		{
+			int testnode = ( i << 2 ) + lane;
+			if ( testnode <= iNode || !( inRange & ( 1 << lane ) ) )
+				continue;
+
+			Vector destPos = m_pBuildNetwork->GetNode( testnode )->GetPosition(HULL_SMALL_CENTERED);
+			if ( IsNodeVisible( srcPos, destPos ) )
+			{
+				m_VisibleTable[iNode].Set( testnode );
+			}
+		}
+	}
+}
+
 //-----------------------------------------------------------------------------
 // Purpose: Set the visibility for this node.  (What nodes it can see with a
 //			line trace)
@@ -2678,61 +2858,20 @@ void CAI_NetworkBuilder::InitVisibility(CAI_Network *pNetwork, CAI_Node *pNode)
 				continue;
 		}
 
-		// The actual position of some nodes may be inside geometry as they have
-		// hull specific position offsets (e.g. climb nodes).  Get the hull specific 
-		// position using the smallest hull to make sure were not in geometry
-		Vector destPos = pNetwork->GetNode( testnode )->GetPosition(HULL_SMALL_CENTERED);
-
-		trace_t	tr;
-		tr.m_pEnt = NULL;
-
-		// Try several line of sight checks
-
-		bool isVisible = false;
-
-		// ------------------
-		//  Bottom to bottom
-		// ------------------
-		AI_TraceLine ( srcPos, destPos,MASK_NPCWORLDSTATIC,NULL,COLLISION_GROUP_NONE, &tr );
-		if (!tr.startsolid && tr.fraction == 1.0)
-		{
-			isVisible = true;
-		}
-
-		// ------------------
-		//  Top to top
-		// ------------------
-		if (!isVisible)
+		// ComputeVisibility() has already traced from the lower numbered node
+		bool isVisible;
+		if ( m_VisibleTable.Count() && pNode->m_iID < testnode )
 		{
-			AI_TraceLine ( srcPos + Vector( 0, 0, 70 ),destPos + Vector( 0, 0, 70 ),MASK_NPCWORLDSTATIC,NULL,COLLISION_GROUP_NONE, &tr );
-			if (!tr.startsolid && tr.fraction == 1.0)
-			{	
-				isVisible = true;
-			}
+			isVisible = m_VisibleTable[pNode->m_iID].IsBitSet( testnode );
 		}
-
-		// ------------------
-		//  Top to Bottom
-		// ------------------
-		if (!isVisible)
+		else
 		{
-			AI_TraceLine ( srcPos + Vector( 0, 0, 70 ),destPos,MASK_NPCWORLDSTATIC,NULL,COLLISION_GROUP_NONE, &tr );
-			if (!tr.startsolid && tr.fraction == 1.0)
-			{	
-				isVisible = true;
-			}
-		}
+			// The actual position of some nodes may be inside geometry as they have
+			// hull specific position offsets (e.g. climb nodes).  Get the hull specific 
+			// position using the smallest hull to make sure were not in geometry
+			Vector destPos = pNetwork->GetNode( testnode )->GetPosition(HULL_SMALL_CENTERED);
 
-		// ------------------
-		//  Bottom to Top
-		// ------------------
-		if (!isVisible)
-		{
-			AI_TraceLine ( srcPos,destPos + Vector( 0, 0, 70 ),MASK_NPCWORLDSTATIC,NULL,COLLISION_GROUP_NONE, &tr );
-			if (!tr.startsolid && tr.fraction == 1.0)
-			{	
-				isVisible = true;
-			}
+			isVisible = IsNodeVisible( srcPos, destPos );
 		}
 
 		// ------------------
@@ -2958,7 +3097,7 @@ static bool IsInLineForClimb( const Vector &srcPos, const Vector &srcFacing, con
 
 //-------------------------------------
 
-int CAI_NetworkBuilder::ComputeConnection( CAI_Node *pSrcNode, CAI_Node *pDestNode, Hull_t hull )
+int CAI_NetworkBuilder::ComputeConnection( CAI_Node *pSrcNode, CAI_Node *pDestNode, Hull_t hull, CAI_TestHull *pTestHull )
 {
 	int srcId = pSrcNode->m_iID;
 	int destId = pDestNode->m_iID;
@@ -2966,31 +3105,31 @@ int CAI_NetworkBuilder::ComputeConnection( CAI_Node *pSrcNode, CAI_Node *pDestNo
 	trace_t tr;
 	
 	// Set the size of the test hull
-	if ( m_pTestHull->GetHullType() != hull ) 
+	if ( pTestHull->GetHullType() != hull ) 
 	{
-		m_pTestHull->SetHullType( hull );
-		m_pTestHull->SetHullSizeNormal( true );
+		pTestHull->SetHullType( hull );
+		pTestHull->SetHullSizeNormal( true );
 	}
 
-	if ( !( m_pTestHull->GetFlags() & FL_ONGROUND ) )
+	if ( !( pTestHull->GetFlags() & FL_ONGROUND ) )
 	{
 		DevWarning( 2, "OFFGROUND!\n" );
 	}
-	m_pTestHull->AddFlag( FL_ONGROUND );
+	pTestHull->AddFlag( FL_ONGROUND );
 
 	// ==============================================================
 	// FIRST CHECK IF HULL CAN EVEN FIT AT THESE NODES
 	// ==============================================================
 	// @Note (toml 02-10-03): this should be optimized, caching the results of CanFitAtNode() 
 	if ( !( pSrcNode->m_eNodeInfo & ( HullToBit( hull ) << NODE_ENT_FLAGS_SHIFT ) ) &&
-		 !m_pTestHull->GetNavigator()->CanFitAtNode(srcId,MASK_NPCWORLDSTATIC) )
+		 !pTestHull->GetNavigator()->CanFitAtNode(srcId,MASK_NPCWORLDSTATIC) )
 	{
 		DebugConnectMsg( srcId, destId, "      Cannot fit at node %d\n", srcId );
 		return 0;
 	}
 	
 	if (  !( pDestNode->m_eNodeInfo & ( HullToBit( hull ) << NODE_ENT_FLAGS_SHIFT ) ) &&
-		 !m_pTestHull->GetNavigator()->CanFitAtNode(destId,MASK_NPCWORLDSTATIC) )
+		 !pTestHull->GetNavigator()->CanFitAtNode(destId,MASK_NPCWORLDSTATIC) )
 	{
 		DebugConnectMsg( srcId, destId, "      Cannot fit at node %d\n", destId );
 		return 0;
@@ -3006,7 +3145,7 @@ int CAI_NetworkBuilder::ComputeConnection( CAI_Node *pSrcNode, CAI_Node *pDestNo
 		// Air nodes only connect to other air nodes and nothing else
 		if (pSrcNode->m_eNodeType == NODE_AIR && pDestNode->GetType() == NODE_AIR)
 		{
-			AI_TraceHull( pSrcNode->GetOrigin(), pDestNode->GetOrigin(), NAI_Hull::Mins(hull),NAI_Hull::Maxs(hull), MASK_NPCWORLDSTATIC, m_pTestHull, COLLISION_GROUP_NONE, &tr );
+			AI_TraceHull( pSrcNode->GetOrigin(), pDestNode->GetOrigin(), NAI_Hull::Mins(hull),NAI_Hull::Maxs(hull), MASK_NPCWORLDSTATIC, pTestHull, COLLISION_GROUP_NONE, &tr );
 			if (!tr.startsolid && tr.fraction == 1.0)
 			{
 				result |= bits_CAP_MOVE_FLY;
@@ -3031,7 +3170,7 @@ int CAI_NetworkBuilder::ComputeConnection( CAI_Node *pSrcNode, CAI_Node *pDestNo
 		{
 			AI_TraceHull( srcPos, destPos, 
 							NAI_Hull::Mins(hull),NAI_Hull::Maxs(hull), 
-							MASK_NPCWORLDSTATIC, m_pTestHull, COLLISION_GROUP_NONE, &tr );
+							MASK_NPCWORLDSTATIC, pTestHull, COLLISION_GROUP_NONE, &tr );
 			if (!tr.startsolid && tr.fraction == 1.0)
 			{
 				result |= bits_CAP_MOVE_CLIMB;
@@ -3047,7 +3186,7 @@ int CAI_NetworkBuilder::ComputeConnection( CAI_Node *pSrcNode, CAI_Node *pDestNo
 				return 0;
 			}
 
-			AI_TraceHull( srcPos, destPos, NAI_Hull::Mins(hull),NAI_Hull::Maxs(hull), MASK_NPCWORLDSTATIC, m_pTestHull, COLLISION_GROUP_NONE, &tr );
+			AI_TraceHull( srcPos, destPos, NAI_Hull::Mins(hull),NAI_Hull::Maxs(hull), MASK_NPCWORLDSTATIC, pTestHull, COLLISION_GROUP_NONE, &tr );
 			if (!tr.startsolid && tr.fraction == 1.0)
 			{
 				result |= bits_CAP_MOVE_CLIMB;
@@ -3075,13 +3214,13 @@ int CAI_NetworkBuilder::ComputeConnection( CAI_Node *pSrcNode, CAI_Node *pDestNo
 		Vector srcPos	 = pSrcNode->GetPosition(hull);
 		Vector destPos	 = pDestNode->GetPosition(hull);
 
-		if (!m_pTestHull->GetMoveProbe()->CheckStandPosition( srcPos, MASK_NPCWORLDSTATIC))
+		if (!pTestHull->GetMoveProbe()->CheckStandPosition( srcPos, MASK_NPCWORLDSTATIC))
 		{
 			DebugConnectMsg( srcId, destId, "      Failed to stand at %d\n", srcId );
 			fStandFailed = true;
 		}
 
-		if (!m_pTestHull->GetMoveProbe()->CheckStandPosition( destPos, MASK_NPCWORLDSTATIC))
+		if (!pTestHull->GetMoveProbe()->CheckStandPosition( destPos, MASK_NPCWORLDSTATIC))
 		{
 			DebugConnectMsg( srcId, destId, "      Failed to stand at %d\n", destId );
 			fStandFailed = true;
@@ -3092,7 +3231,7 @@ int CAI_NetworkBuilder::ComputeConnection( CAI_Node *pSrcNode, CAI_Node *pDestNo
 
 		if ( !fStandFailed )
 		{
-			fWalkFailed = !m_pTestHull->GetMoveProbe()->TestGroundMove( srcPos, destPos, MASK_NPCWORLDSTATIC, AITGM_IGNORE_INITIAL_STAND_POS, NULL );
+			fWalkFailed = !pTestHull->GetMoveProbe()->TestGroundMove( srcPos, destPos, MASK_NPCWORLDSTATIC, AITGM_IGNORE_INITIAL_STAND_POS, NULL );
 			if ( fWalkFailed )
 				DebugConnectMsg( srcId, destId, "      Failed to walk between nodes\n" );
 		}
@@ -3118,15 +3257,15 @@ int CAI_NetworkBuilder::ComputeConnection( CAI_Node *pSrcNode, CAI_Node *pDestNo
 
 			// Jumps aren't bi-directional.  We can jump down further than we can jump up so
 			// we have to test for either one
-			bool canDestJump = m_pTestHull->IsJumpLegal(srcPos, destPos, destPos);
-			bool canSrcJump  = m_pTestHull->IsJumpLegal(destPos, srcPos, srcPos);
+			bool canDestJump = pTestHull->IsJumpLegal(srcPos, destPos, destPos);
+			bool canSrcJump  = pTestHull->IsJumpLegal(destPos, srcPos, srcPos);
 
 			if (canDestJump || canSrcJump) 
 			{
-				CAI_MoveProbe *pMoveProbe = m_pTestHull->GetMoveProbe();
+				CAI_MoveProbe *pMoveProbe = pTestHull->GetMoveProbe();
 
 				bool fJumpLegal = false;
-				m_pTestHull->SetGravity(1.0);
+				pTestHull->SetGravity(1.0);
 
 				AIMoveTrace_t moveTrace;
 				pMoveProbe->MoveLimit( NAV_JUMP, srcPos,destPos, MASK_NPCWORLDSTATIC, NULL, &moveTrace);
@@ -3154,6 +3293,166 @@ int CAI_NetworkBuilder::ComputeConnection( CAI_Node *pSrcNode, CAI_Node *pDestNo
 
 
 
+//-----------------------------------------------------------------------------
+// Purpose: Does the link tests InitLinks() will want ahead of time, spread
+//			over the thread pool. Each worker gets its own test hull for each
+//			hull type, sized up front, so the tests never move or resize an
+//			entity. Links are still made by InitLinks(), in the same order.
+//-----------------------------------------------------------------------------
+
+static CTHREADLOCALPTR( CAI_TestHull * ) g_ppWorkerHulls;
+
+void CAI_NetworkBuilder::ComputeConnections( CAI_Network *pNetwork )
+{
+	m_Connections.Purge();
+
+	if ( !ai_network_build_parallel.GetBool() )
+		return;
+
+	m_pBuildNetwork = pNetwork;
+
+	int nNodes = pNetwork->NumNodes();
+	CAI_Node **ppNodes = pNetwork->AccessNodes();
+
+	// InitLinks() tests a pair of neighbors from the node it reaches first,
+	// or only from the node that lists the other if just one of them does
+	for ( int i = 0; i < nNodes; i++ )
+	{
+		if ( ppNodes[i]->m_eNodeInfo & bits_NODE_FALLEN )
+			continue;
+
+		for ( int j = 0; j < nNodes; j++ )
+		{
+			if ( j == i || !m_NeighborsTable[i].IsBitSet( j ) )
+				continue;
+
+			if ( j < i && m_NeighborsTable[j].IsBitSet( i ) )
+				continue;
+
+			if ( ppNodes[j]->m_eNodeInfo & bits_NODE_FALLEN )
+				continue;
+
+			NodeConnection_t &connection = m_Connections[ m_Connections.AddToTail() ];
+			connection.iSrcNode = i;
+			connection.iDestNode = j;
+		}
+	}
+
+	int nWorkers = ( g_pThreadPool ? g_pThreadPool->NumThreads() : 0 ) + 1;
+	for ( int i = 0; i < nWorkers * NUM_HULLS; i++ )
+	{
+		CAI_TestHull *pHull = CAI_TestHull::CreateWorkerHull();
+		pHull->GetNavigator()->SetNetwork( pNetwork );
+		pHull->SetHullType( (Hull_t)( i % NUM_HULLS ) );
+		pHull->SetHullSizeNormal( true );
+		pHull->AddFlag( FL_ONGROUND );
+		m_WorkerHulls.AddToTail( pHull );
+	}
+
+	ComputeConnectionsFrom( 0 );
+
+	// A pair that failed from the first node is tested again from the second
+	// if it lists the first as a neighbor too
+	int nFirstPass = m_Connections.Count();
+	for ( int i = 0; i < nFirstPass; i++ )
+	{
+		int iSrcNode = m_Connections[i].iSrcNode;
+		int iDestNode = m_Connections[i].iDestNode;
+		if ( iSrcNode > iDestNode || !m_NeighborsTable[iDestNode].IsBitSet( iSrcNode ) )
+			continue;
+
+		bool bAllFailed = true;
+		for ( int hull = 0; hull < NUM_HULLS; hull++ )
+		{
+			if ( m_Connections[i].acceptedMotions[hull] != 0 )
+			{
+				bAllFailed = false;
+				break;
+			}
+		}
+
+		if ( bAllFailed )
+		{
+			NodeConnection_t &connection = m_Connections[ m_Connections.AddToTail() ];
+			connection.iSrcNode = iDestNode;
+			connection.iDestNode = iSrcNode;
+		}
+	}
+
+	ComputeConnectionsFrom( nFirstPass );
+
+	for ( int i = 0; i < m_WorkerHulls.Count(); i++ )
+	{
+		CAI_TestHull::DestroyWorkerHull( m_WorkerHulls[i] );
+	}
+	m_WorkerHulls.Purge();
+
+	m_Connections.Sort( &CAI_NetworkBuilder::CompareConnections );
+}
+
+//-------------------------------------
+
+void CAI_NetworkBuilder::ComputeConnectionsFrom( int iFirst )
+{
+	m_iNextWorker = 0;
+	ParallelProcess( "CAI_NetworkBuilder::ComputeConnections", m_Connections.Base() + iFirst, m_Connections.Count() - iFirst, 
+		this, &CAI_NetworkBuilder::ComputeNodeConnection, &CAI_NetworkBuilder::BeginConnectionWorker );
+}
+
+//-------------------------------------
+
+void CAI_NetworkBuilder::BeginConnectionWorker()
+{
+	int iWorker = m_iNextWorker++;
+	Assert( ( iWorker + 1 ) * NUM_HULLS <= m_WorkerHulls.Count() );
+	g_ppWorkerHulls = &m_WorkerHulls[ iWorker * NUM_HULLS ];
+}
+
+//-------------------------------------
+
+void CAI_NetworkBuilder::ComputeNodeConnection( NodeConnection_t &connection )
+{
+	CAI_TestHull **ppHulls = g_ppWorkerHulls;
+	CAI_Node *pSrcNode = m_pBuildNetwork->GetNode( connection.iSrcNode );
+	CAI_Node *pDestNode = m_pBuildNetwork->GetNode( connection.iDestNode );
+
+	for ( int hull = 0; hull < NUM_HULLS; hull++ )
+	{
+		connection.acceptedMotions[hull] = ComputeConnection( pSrcNode, pDestNode, (Hull_t)hull, ppHulls[hull] );
+	}
+}
+
+//-------------------------------------
+
+const CAI_NetworkBuilder::NodeConnection_t *CAI_NetworkBuilder::FindConnection( int iSrcNode, int iDestNode ) const
+{
+	int iLow = 0;
+	int iHigh = m_Connections.Count() - 1;
+	while ( iLow <= iHigh )
+	{
+		int iMid = ( iLow + iHigh ) / 2;
+		const NodeConnection_t &connection = m_Connections[iMid];
+		if ( connection.iSrcNode == iSrcNode && connection.iDestNode == iDestNode )
+			return &connection;
+
+		if ( connection.iSrcNode < iSrcNode || ( connection.iSrcNode == iSrcNode && connection.iDestNode < iDestNode ) )
+			iLow = iMid + 1;
+		else
+			iHigh = iMid - 1;
+	}
+
+	return NULL;
+}
+
+//-------------------------------------
+
+int __cdecl CAI_NetworkBuilder::CompareConnections( const NodeConnection_t *pLeft, const NodeConnection_t *pRight )
+{
+	if ( pLeft->iSrcNode != pRight->iSrcNode )
+		return pLeft->iSrcNode - pRight->iSrcNode;
+	return pLeft->iDestNode - pRight->iDestNode;
+}
+
 //-------------------------------------
 
 void CAI_NetworkBuilder::InitLinks(CAI_Network *pNetwork, CAI_Node *pNode)
@@ -3209,11 +3508,16 @@ void CAI_NetworkBuilder::InitLinks(CAI_Network *pNetwork, CAI_Node *pNode)
 
 			if ( !(pNode->m_eNodeInfo & bits_NODE_FALLEN) && !(pDestNode->m_eNodeInfo & bits_NODE_FALLEN) )
 			{
+				const NodeConnection_t *pConnection = FindConnection( pNode->m_iID, i );
+
 				for (int hull = 0 ; hull < NUM_HULLS; hull++ )
 				{
 					DebugConnectMsg( pNode->m_iID, i, "   Testing for hull %s\n", NAI_Hull::Name( (Hull_t)hull  ) );
 					
-					acceptedMotions[hull] = ComputeConnection( pNode, pDestNode, (Hull_t)hull );
+					if ( pConnection )
+						acceptedMotions[hull] = pConnection->acceptedMotions[hull];
+					else
+						acceptedMotions[hull] = ComputeConnection( pNode, pDestNode, (Hull_t)hull, m_pTestHull );
 					if ( acceptedMotions[hull] != 0 )
 						bAllFailed = false;
 				}
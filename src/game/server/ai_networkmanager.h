@@ -9,6 +9,7 @@
 
 #include "utlvector.h"
 #include "bitstring.h"
+#include "tier0/threadtools.h"
 
 #if defined( _WIN32 )
 #pragma once
@@ -112,7 +113,27 @@ private:
 	
 	void			FloodFillZone( CAI_Node **ppNodes, CAI_Node *pNode, int zone );
 
-	int				ComputeConnection( CAI_Node *pSrcNode, CAI_Node *pDestNode, Hull_t hull );
+	int				ComputeConnection( CAI_Node *pSrcNode, CAI_Node *pDestNode, Hull_t hull, CAI_TestHull *pTestHull );
+
+	// The line of sight and link tests for the whole network, run on the
+	// thread pool ahead of InitNeighbors() and InitLinks(), which then look
+	// the results up instead of testing each pair themselves
+	struct NodeConnection_t
+	{
+		int			iSrcNode;
+		int			iDestNode;
+		int			acceptedMotions[NUM_HULLS];
+	};
+
+	void			ComputeVisibility( CAI_Network *pNetwork );
+	void			ComputeVisibilityRow( int &iNode );
+	void			ComputeConnections( CAI_Network *pNetwork );
+	void			ComputeConnectionsFrom( int iFirst );
+	void			ComputeNodeConnection( NodeConnection_t &connection );
+	void			BeginConnectionWorker();
+	const NodeConnection_t *FindConnection( int iSrcNode, int iDestNode ) const;
+
+	static int __cdecl CompareConnections( const NodeConnection_t *pLeft, const NodeConnection_t *pRight );
 	
 	void 			BeginBuild();
 	void			EndBuild();
@@ -120,6 +141,12 @@ private:
 	CUtlVector<CVarBitVec>	m_NeighborsTable;
 	CVarBitVec				m_DidSetNeighborsTable;
 	CAI_TestHull *			m_pTestHull;
+
+	CAI_Network *			m_pBuildNetwork;
+	CUtlVector<CVarBitVec>	m_VisibleTable;		// Each node's line of sight to the nodes after it
+	CUtlVector<NodeConnection_t> m_Connections;	// Sorted by source node, then destination node
+	CUtlVector<CAI_TestHull *> m_WorkerHulls;	// NUM_HULLS test hulls for each worker
+	CInterlockedInt			m_iNextWorker;
 };
 
 extern CAI_NetworkBuilder g_AINetworkBuilder;
@@ -14,6 +14,9 @@
 #include "ai_basenpc.h"
 #include "ai_node.h"
 #include "ai_network.h"
+#include "ai_pathsearch.h"
+#include "ai_networkclusters.h"
+#include "ai_routequeue.h"
 #include "ai_waypoint.h"
 #include "ai_link.h"
 #include "ai_routedist.h"
@@ -170,17 +173,32 @@ Navigation_t CAI_Pathfinder::ComputeWaypointType( CAI_Node **ppNodes, int parent
 //			list of waypoints through those parents
 //-----------------------------------------------------------------------------
 AI_Waypoint_t* CAI_Pathfinder::MakeRouteFromParents( int *parentArray, int endID ) 
+{
+	CUtlVectorFixedGrowable<int, 64> nodes;
+	for ( int currentID = endID; currentID != NO_NODE; currentID = parentArray[currentID] )
+	{
+		nodes.AddToTail( currentID );
+	}
+
+	return MakeRouteFromNodes( nodes.Base(), nodes.Count() );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Same as above, with the nodes listed from endID back to the start
+//-----------------------------------------------------------------------------
+AI_Waypoint_t* CAI_Pathfinder::MakeRouteFromNodes( const int *pNodes, int nNodes ) 
 {
 	AI_Waypoint_t *pOldWaypoint = NULL;
 	AI_Waypoint_t *pNewWaypoint = NULL;
-	int	currentID = endID;
 
 	CAI_Node **pAInode = GetNetwork()->AccessNodes();
 
-	while (currentID != NO_NODE) 
+	for ( int i = 0; i < nNodes; i++ ) 
 	{
+		int currentID = pNodes[i];
+
 		// Try to link it to the previous waypoint
-		int prevID = parentArray[currentID];
+		int prevID = ( i + 1 < nNodes ) ? pNodes[i + 1] : NO_NODE;
 
 		int destID; 
 		if (prevID != NO_NODE)
@@ -211,8 +229,6 @@ AI_Waypoint_t* CAI_Pathfinder::MakeRouteFromParents( int *parentArray, int endID
 		// Link it up...
 		pNewWaypoint->SetNext( pOldWaypoint );
 		pOldWaypoint = pNewWaypoint;
-
-		currentID = prevID;
 	}
 
 	return pOldWaypoint;
@@ -272,6 +288,51 @@ int CAI_Pathfinder::NearestNodeToPoint( const Vector &vecOrigin )
 	return GetNetwork()->NearestNodeToPoint( GetOuter(), vecOrigin );
 }
 
+ConVar ai_pathfind_hierarchical( "ai_pathfind_hierarchical", "0", 0, "Search long node routes within a corridor of node clusters found first" );
+ConVar ai_pathfind_hierarchical_min_dist( "ai_pathfind_hierarchical_min_dist", "2048", 0, "Routes shorter than this, as the crow flies, always search the whole node graph" );
+
+//-----------------------------------------------------------------------------
+// Purpose: Search state reused by every FindBestPath on a thread
+//-----------------------------------------------------------------------------
+
+static CTHREADLOCALPTR( CAI_PathSearch ) g_pPathSearch;
+
+static CAI_PathSearch *GetThreadPathSearch()
+{
+	CAI_PathSearch *pSearch = g_pPathSearch;
+	if ( !pSearch )
+	{
+		pSearch = new CAI_PathSearch;
+		g_pPathSearch = pSearch;
+	}
+	return pSearch;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Is the route long enough to look for a corridor of clusters first?
+//-----------------------------------------------------------------------------
+
+bool CAI_Pathfinder::ShouldSearchCorridor( int startID, int endID )
+{
+	CAI_NetworkClusters *pClusters = GetNetwork()->GetClusters();
+	return ( ai_pathfind_hierarchical.GetBool() && pClusters && pClusters->IsCurrent() &&
+			 pClusters->GetNodeCluster( startID ) != pClusters->GetNodeCluster( endID ) &&
+			 ( GetNetwork()->GetNode( startID )->GetOrigin() - GetNetwork()->GetNode( endID )->GetOrigin() ).LengthSqr() > Square( ai_pathfind_hierarchical_min_dist.GetFloat() ) );
+}
+
+//-----------------------------------------------------------------------------
+
+static void AddPathSearchStats( AI_PathSearchStats_t &stats, bool bFound, int nExpanded, int nOpened, double flMS )
+{
+	stats.nSearches++;
+	stats.nFound += bFound;
+	stats.nNodesExpanded += nExpanded;
+	stats.nNodesOpened += nOpened;
+	stats.nMostExpanded = MAX( stats.nMostExpanded, nExpanded );
+	stats.flTotalMS += flMS;
+	stats.flWorstMS = MAX( stats.flWorstMS, flMS );
+}
+
 //-----------------------------------------------------------------------------
 // Purpose: Build a path between two nodes
 //-----------------------------------------------------------------------------
@@ -287,38 +348,176 @@ AI_Waypoint_t *CAI_Pathfinder::FindBestPath(int startID, int endID)
 	m_nPerfStatPB++;
 #endif
 
-	int nNodes = GetNetwork()->NumNodes();
-	CAI_Node **pAInode = GetNetwork()->AccessNodes();
+	// Searches made while starting a task share a time budget each tick
+	if ( g_AIRouteQueue.IsBudgeted( GetOuter() ) )
+		return FindBestPathBudgeted( startID, endID );
 
-	CVarBitVec	openBS(nNodes);
-	CVarBitVec	closeBS(nNodes);
+	CFastTimer timer;
+	timer.Start();
 
-	// ------------- INITIALIZE ------------------------
-	float* nodeG = (float *)stackalloc( nNodes * sizeof(float) );
-	float* nodeH = (float *)stackalloc( nNodes * sizeof(float) );
-	float* nodeF = (float *)stackalloc( nNodes * sizeof(float) );
-	int*   nodeP = (int *)stackalloc( nNodes * sizeof(int) );		// Node parent 
+	AI_PathSearchStats_t &stats = GetNetwork()->AccessPathSearchStats();
+	CAI_PathSearch *pSearch = GetThreadPathSearch();
+	int nExpanded = 0;
+	int nOpened = 0;
+	AI_Waypoint_t *route = NULL;
+
+	// Long routes look for a corridor of clusters first, and only search the nodes in it
+	if ( ShouldSearchCorridor( startID, endID ) )
+	{
+		CVarBitVec corridor;
+		if ( GetNetwork()->GetClusters()->FindCorridor( startID, endID, GetHullType(), CapabilitiesGet(), pSearch, &corridor ) )
+		{
+			stats.nCorridorSearches++;
+			route = FindBestPathInCorridor( pSearch, startID, endID, &corridor, &nExpanded, &nOpened );
+			
+			// Links this NPC can use but the clusters don't know about (or vice versa)
+			if ( !route )
+			{
+				stats.nCorridorFallbacks++;
+			}
+		}
+	}
+
+	if ( !route )
+	{
+		route = FindBestPathInCorridor( pSearch, startID, endID, NULL, &nExpanded, &nOpened );
+	}
+
+	timer.End();
+
+	AddPathSearchStats( stats, route != NULL, nExpanded, nOpened, timer.GetDuration().GetMillisecondsF() );
+
+	return route;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: FindBestPath() for an NPC starting a task while ai_route_budget_ms
+//			is on. A search that runs out of time is kept by the route queue
+//			and NULL is returned; the task starts over when the NPC next
+//			thinks, and the search carries on from where it stopped.
+//-----------------------------------------------------------------------------
+
+AI_Waypoint_t *CAI_Pathfinder::FindBestPathBudgeted( int startID, int endID )
+{
+	// A squadmate just found this route
+	CUtlVector<int> sharedNodes;
+	if ( g_AIRouteQueue.FindSharedRoute( GetOuter(), startID, endID, &sharedNodes ) )
+		return MakeRouteFromNodes( sharedNodes.Base(), sharedNodes.Count() );
+
+	AI_RouteRequest_t *pRequest = g_AIRouteQueue.GetRequest( GetOuter(), startID, endID );
+	if ( !pRequest )
+		return NULL;
+
+	CFastTimer timer;
+	timer.Start();
+
+	AI_PathSearchStats_t &stats = GetNetwork()->AccessPathSearchStats();
+	CAI_PathSearch *pSearch = &pRequest->search;
+	PathSearchStatus_t status = PATHSEARCH_RUNNING;
+
+	double flEndTime = g_AIRouteQueue.GetSliceEndTime( GetOuter(), pRequest );
+	if ( flEndTime >= 0 )
+	{
+		if ( !pRequest->bStarted )
+		{
+			pRequest->bStarted = true;
+			pRequest->bInCorridor = ( ShouldSearchCorridor( startID, endID ) &&
+									  GetNetwork()->GetClusters()->FindCorridor( startID, endID, GetHullType(), CapabilitiesGet(), pSearch, &pRequest->corridor ) );
+			if ( pRequest->bInCorridor )
+			{
+				stats.nCorridorSearches++;
+			}
+
+			BeginPathSearch( pSearch, startID, endID, &pRequest->nOpened );
+		}
+
+		status = ContinuePathSearch( pSearch, endID, ( pRequest->bInCorridor ) ? &pRequest->corridor : NULL, flEndTime, &pRequest->nExpanded, &pRequest->nOpened );
+
+		if ( status == PATHSEARCH_NO_ROUTE && pRequest->bInCorridor )
+		{
+			stats.nCorridorFallbacks++;
+			pRequest->bInCorridor = false;
+
+			BeginPathSearch( pSearch, startID, endID, &pRequest->nOpened );
+			status = ContinuePathSearch( pSearch, endID, NULL, flEndTime, &pRequest->nExpanded, &pRequest->nOpened );
+		}
+	}
+
+	timer.End();
+
+	double flMS = timer.GetDuration().GetMillisecondsF();
+	pRequest->flMS += flMS;
+
+	if ( status == PATHSEARCH_RUNNING )
+	{
+		g_AIRouteQueue.Defer( GetOuter(), pRequest, flMS );
+		return NULL;
+	}
+
+	g_AIRouteQueue.SpendTime( flMS );
 
-	for (int node=0;node<nNodes;node++)
+	AI_Waypoint_t *route = NULL;
+	if ( status == PATHSEARCH_FOUND )
 	{
-		nodeG[node] = FLT_MAX;
-		nodeP[node] = -1;
+		route = MakeRouteFromParents( pSearch->GetParents(), endID );
+		g_AIRouteQueue.ShareRoute( GetOuter(), startID, endID, pSearch->GetParents() );
 	}
 
-	nodeG[startID] = 0;
+	AddPathSearchStats( stats, route != NULL, pRequest->nExpanded, pRequest->nOpened, pRequest->flMS );
+	g_AIRouteQueue.RemoveRequest( pRequest );
 
-	nodeH[startID] = 0.1*(pAInode[startID]->GetPosition(GetHullType())-pAInode[endID]->GetPosition(GetHullType())).Length(); // Don't want to over estimate
-	nodeF[startID] = nodeG[startID] + nodeH[startID];
+	return route;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: A* between two nodes, only through nodes in the clusters set in
+//			pCorridor if there is one
+//-----------------------------------------------------------------------------
 
-	openBS.Set(startID);
-	closeBS.Set( startID );
+AI_Waypoint_t *CAI_Pathfinder::FindBestPathInCorridor( CAI_PathSearch *pSearch, int startID, int endID, const CVarBitVec *pCorridor, int *pExpanded, int *pOpened )
+{
+	BeginPathSearch( pSearch, startID, endID, pOpened );
+
+	if ( ContinuePathSearch( pSearch, endID, pCorridor, 0, pExpanded, pOpened ) != PATHSEARCH_FOUND )
+		return NULL;
+
+	return MakeRouteFromParents( pSearch->GetParents(), endID );
+}
+
+//-----------------------------------------------------------------------------
+
+void CAI_Pathfinder::BeginPathSearch( CAI_PathSearch *pSearch, int startID, int endID, int *pOpened )
+{
+	CAI_Node **pAInode = GetNetwork()->AccessNodes();
+
+	// ------------- INITIALIZE ------------------------
+	pSearch->Begin( GetNetwork()->NumNodes() );
+
+	float startH = 0.1*(pAInode[startID]->GetPosition(GetHullType())-pAInode[endID]->GetPosition(GetHullType())).Length(); // Don't want to over estimate
+	pSearch->SetCost( startID, NO_NODE, 0, startH );
+	(*pOpened)++;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Expands open nodes until endID is reached or there are none left.
+//			Stops early once Plat_FloatTime() passes flEndTime, if it isn't 0.
+//-----------------------------------------------------------------------------
+
+PathSearchStatus_t CAI_Pathfinder::ContinuePathSearch( CAI_PathSearch *pSearch, int endID, const CVarBitVec *pCorridor, double flEndTime, int *pExpanded, int *pOpened )
+{
+	CAI_Node **pAInode = GetNetwork()->AccessNodes();
+	CAI_NetworkClusters *pClusters = GetNetwork()->GetClusters();
+	int nExpandedHere = 0;
 
 	// --------------- FIND BEST PATH ------------------
-	while (!openBS.IsAllClear()) 
+	while ( pSearch->HasOpen() ) 
 	{
-		int smallestID = CAI_Network::FindBSSmallest(&openBS,nodeF,nNodes);
-	
-		openBS.Clear(smallestID);
+		// Only look at the clock every few nodes
+		if ( flEndTime != 0 && ( ++nExpandedHere % 16 ) == 0 && Plat_FloatTime() >= flEndTime )
+			return PATHSEARCH_RUNNING;
+
+		int smallestID = pSearch->PopOpen();
+		(*pExpanded)++;
 
 		CAI_Node *pSmallestNode = pAInode[smallestID];
 		
@@ -327,8 +526,7 @@ AI_Waypoint_t *CAI_Pathfinder::FindBestPath(int startID, int endID)
 
 		if (smallestID == endID) 
 		{
-			AI_Waypoint_t* route = MakeRouteFromParents(&nodeP[0], endID);
-			return route;
+			return PATHSEARCH_FOUND;
 		}
 
 		// Check this if the node is immediately in the path after the startNode 
@@ -344,6 +542,9 @@ AI_Waypoint_t *CAI_Pathfinder::FindBestPath(int startID, int endID)
 			int moveType = nodeLink->m_iAcceptedMoveTypes[GetHullType()] & CapabilitiesGet();
 			int testID	 = nodeLink->DestNodeID(smallestID);
 
+			if ( pCorridor && !pCorridor->IsBitSet( pClusters->GetNodeCluster( testID ) ) )
+				continue;
+
 			Vector r1 = pSmallestNode->GetPosition(GetHullType());
 			Vector r2 = pAInode[testID]->GetPosition(GetHullType());
 			float dist   = GetOuter()->GetNavigator()->MovementCost( moveType, r1, r2 ); // MovementCost takes ref parameters!!
@@ -351,22 +552,42 @@ AI_Waypoint_t *CAI_Pathfinder::FindBestPath(int startID, int endID)
 			if ( dist == FLT_MAX )
 				continue;
 
-			float new_g  = nodeG[smallestID] + dist;
+			float new_g  = pSearch->GetCost(smallestID) + dist;
 
-			if ( !closeBS.IsBitSet(testID) || (new_g < nodeG[testID]) ) 
+			if ( !pSearch->IsReached(testID) || (new_g < pSearch->GetCost(testID)) ) 
 			{
-				nodeP[testID] = smallestID;
-				nodeG[testID] = new_g;
-				nodeH[testID] = (pAInode[testID]->GetPosition(GetHullType())-pAInode[endID]->GetPosition(GetHullType())).Length();
-				nodeF[testID] = nodeG[testID] + nodeH[testID];
-
-				closeBS.Set( testID );
-				openBS.Set( testID );
+				float new_h = (pAInode[testID]->GetPosition(GetHullType())-pAInode[endID]->GetPosition(GetHullType())).Length();
+				pSearch->SetCost( testID, smallestID, new_g, new_g + new_h );
+				(*pOpened)++;
 			}
 		}
 	}
 
-	return NULL;   
+	return PATHSEARCH_NO_ROUTE;
+}
+
+//-----------------------------------------------------------------------------
+
+CON_COMMAND( ai_pathfind_stats, "Report the cost of node graph searches. Usage: ai_pathfind_stats [reset]" )
+{
+	if ( !UTIL_IsCommandIssuedByServerAdmin() || !g_pBigAINet )
+		return;
+
+	if ( args.ArgC() > 1 && !V_stricmp( args[1], "reset" ) )
+	{
+		g_pBigAINet->ResetPathSearchStats();
+		return;
+	}
+
+	const AI_PathSearchStats_t &stats = g_pBigAINet->AccessPathSearchStats();
+	Msg( "%d nodes, %d searches, %d found\n", g_pBigAINet->NumNodes(), stats.nSearches, stats.nFound );
+	Msg( "%d searched a cluster corridor first, %d of those then searched every node\n", stats.nCorridorSearches, stats.nCorridorFallbacks );
+	if ( stats.nSearches )
+	{
+		Msg( "per search: %.1f nodes expanded, %.1f opened, %.3f ms\n",
+			(double)stats.nNodesExpanded / stats.nSearches, (double)stats.nNodesOpened / stats.nSearches, stats.flTotalMS / stats.nSearches );
+		Msg( "worst: %d nodes expanded, %.3f ms\n", stats.nMostExpanded, stats.flWorstMS );
+	}
 }
 
 //-----------------------------------------------------------------------------
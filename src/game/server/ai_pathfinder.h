@@ -10,6 +10,7 @@
 
 #include "ai_component.h"
 #include "ai_navtype.h"
+#include "ai_pathsearch.h"
 
 #if defined( _WIN32 )
 #pragma once
@@ -21,6 +22,7 @@ struct AI_Waypoint_t;
 class CAI_Link;
 class CAI_Network;
 class CAI_Node;
+class CVarBitVec;
 
 
 //-----------------------------------------------------------------------------
@@ -116,7 +118,13 @@ private:
 
 	//---------------------------------
 	
+	bool			ShouldSearchCorridor( int startID, int endID );
+	AI_Waypoint_t*	FindBestPathBudgeted( int startID, int endID );
+	AI_Waypoint_t*	FindBestPathInCorridor( CAI_PathSearch *pSearch, int startID, int endID, const CVarBitVec *pCorridor, int *pExpanded, int *pOpened );
+	void			BeginPathSearch( CAI_PathSearch *pSearch, int startID, int endID, int *pOpened );
+	PathSearchStatus_t ContinuePathSearch( CAI_PathSearch *pSearch, int endID, const CVarBitVec *pCorridor, double flEndTime, int *pExpanded, int *pOpened );
 	AI_Waypoint_t*	MakeRouteFromParents(int *parentArray, int endID);
+	AI_Waypoint_t*	MakeRouteFromNodes( const int *pNodes, int nNodes );
 	AI_Waypoint_t*	CreateNodeWaypoint( Hull_t hullType, int nodeID, int nodeFlags = 0 );
 	
 	AI_Waypoint_t*	BuildRouteThroughPoints( Vector *vecPoints, int nNumPoints, int nDirection, int nStartIndex, int nEndIndex, Navigation_t navType, CBaseEntity *pTarget );
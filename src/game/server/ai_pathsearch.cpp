@@ -0,0 +1,141 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Open list and node costs for A* searches over a CAI_Network
+//
+// $NoKeywords: $
+//=============================================================================//
+
+#include "cbase.h"
+
+#include "ai_pathsearch.h"
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include "tier0/memdbgon.h"
+
+//-----------------------------------------------------------------------------
+// CAI_PathSearch
+//-----------------------------------------------------------------------------
+
+CAI_PathSearch::CAI_PathSearch()
+ :	m_nSearch( 0 )
+{
+}
+
+//-----------------------------------------------------------------------------
+
+void CAI_PathSearch::Begin( int nNodes )
+{
+	m_Open.RemoveAll();
+
+	// Stamps are only reset when the network size changes or they wrap
+	if ( m_Nodes.Count() != nNodes || ++m_nSearch == 0 )
+	{
+		m_Nodes.SetCount( nNodes );
+		m_Parents.SetCount( nNodes );
+		for ( int i = 0; i < nNodes; i++ )
+		{
+			m_Nodes[i].m_nSearch = 0;
+			m_Nodes[i].m_iOpen = -1;
+		}
+		m_nSearch = 1;
+	}
+}
+
+//-----------------------------------------------------------------------------
+
+void CAI_PathSearch::SetCost( int iNode, int iParent, float flG, float flF )
+{
+	Node_t &node = m_Nodes[iNode];
+	if ( node.m_nSearch != m_nSearch )
+	{
+		node.m_nSearch = m_nSearch;
+		node.m_iOpen = -1;
+	}
+
+	node.m_flG = flG;
+	node.m_flF = flF;
+	m_Parents[iNode] = iParent;
+
+	if ( node.m_iOpen == -1 )
+	{
+		node.m_iOpen = m_Open.AddToTail( iNode );
+		SiftUp( node.m_iOpen );
+	}
+	else
+	{
+		SiftUp( node.m_iOpen );
+		SiftDown( node.m_iOpen );
+	}
+}
+
+//-----------------------------------------------------------------------------
+
+int CAI_PathSearch::PopOpen()
+{
+	Assert( HasOpen() );
+
+	int iNode = m_Open[0];
+	m_Nodes[iNode].m_iOpen = -1;
+
+	int iLast = m_Open.Count() - 1;
+	if ( iLast > 0 )
+	{
+		m_Open[0] = m_Open[iLast];
+		m_Nodes[ m_Open[0] ].m_iOpen = 0;
+		m_Open.RemoveMultipleFromTail( 1 );
+		SiftDown( 0 );
+	}
+	else
+	{
+		m_Open.RemoveAll();
+	}
+
+	return iNode;
+}
+
+//-----------------------------------------------------------------------------
+
+void CAI_PathSearch::SiftUp( int iOpen )
+{
+	int iNode = m_Open[iOpen];
+	while ( iOpen > 0 )
+	{
+		int iParent = ( iOpen - 1 ) / 2;
+		if ( !IsBefore( iNode, m_Open[iParent] ) )
+			break;
+
+		m_Open[iOpen] = m_Open[iParent];
+		m_Nodes[ m_Open[iOpen] ].m_iOpen = iOpen;
+		iOpen = iParent;
+	}
+	m_Open[iOpen] = iNode;
+	m_Nodes[iNode].m_iOpen = iOpen;
+}
+
+//-----------------------------------------------------------------------------
+
+void CAI_PathSearch::SiftDown( int iOpen )
+{
+	int nOpen = m_Open.Count();
+	int iNode = m_Open[iOpen];
+	for ( ;; )
+	{
+		int iChild = iOpen * 2 + 1;
+		if ( iChild >= nOpen )
+			break;
+
+		if ( iChild + 1 < nOpen && IsBefore( m_Open[iChild + 1], m_Open[iChild] ) )
+		{
+			iChild++;
+		}
+
+		if ( !IsBefore( m_Open[iChild], iNode ) )
+			break;
+
+		m_Open[iOpen] = m_Open[iChild];
+		m_Nodes[ m_Open[iOpen] ].m_iOpen = iOpen;
+		iOpen = iChild;
+	}
+	m_Open[iOpen] = iNode;
+	m_Nodes[iNode].m_iOpen = iOpen;
+}
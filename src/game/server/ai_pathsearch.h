@@ -0,0 +1,90 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Open list and node costs for A* searches over a CAI_Network
+//
+// $NoKeywords: $
+//=============================================================================//
+
+#ifndef AI_PATHSEARCH_H
+#define AI_PATHSEARCH_H
+
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include "utlvector.h"
+
+//-----------------------------------------------------------------------------
+
+enum PathSearchStatus_t
+{
+	PATHSEARCH_RUNNING,		// Stopped for time, and can be carried on
+	PATHSEARCH_FOUND,
+	PATHSEARCH_NO_ROUTE,
+};
+
+//-----------------------------------------------------------------------------
+// CAI_PathSearch
+//
+// Purpose: Per-node costs and a binary heap of open nodes. Node records are
+//			stamped with the search that wrote them, so starting a search
+//			doesn't touch every node in the network.
+//-----------------------------------------------------------------------------
+
+class CAI_PathSearch
+{
+public:
+	CAI_PathSearch();
+
+	// Forgets the previous search
+	void	Begin( int nNodes );
+	int		NumNodes() const				{ return m_Nodes.Count(); }
+
+	// Has the node been given a cost this search?
+	bool	IsReached( int iNode ) const	{ return m_Nodes[iNode].m_nSearch == m_nSearch; }
+	float	GetCost( int iNode ) const		{ Assert( IsReached( iNode ) ); return m_Nodes[iNode].m_flG; }
+
+	// Gives the node a new cost and parent and puts it on the open list,
+	// whether or not it has been there before
+	void	SetCost( int iNode, int iParent, float flG, float flF );
+
+	bool	HasOpen() const					{ return m_Open.Count() != 0; }
+	int		NumOpen() const					{ return m_Open.Count(); }
+
+	// Lowest estimated total first, lowest node ID first on ties
+	int		PopOpen();
+
+	// Indexed by node ID, only meaningful for reached nodes
+	int *	GetParents()					{ return m_Parents.Base(); }
+
+private:
+	struct Node_t
+	{
+		float			m_flG;
+		float			m_flF;
+		int				m_iOpen;		// Index into m_Open, or -1
+		unsigned		m_nSearch;
+	};
+
+	bool	IsBefore( int iNode, int iOther ) const;
+	void	SiftUp( int iOpen );
+	void	SiftDown( int iOpen );
+
+	CUtlVector<Node_t>	m_Nodes;
+	CUtlVector<int>		m_Parents;
+	CUtlVector<int>		m_Open;
+	unsigned			m_nSearch;
+};
+
+//-----------------------------------------------------------------------------
+
+inline bool CAI_PathSearch::IsBefore( int iNode, int iOther ) const
+{
+	const Node_t &node = m_Nodes[iNode];
+	const Node_t &other = m_Nodes[iOther];
+	return ( node.m_flF < other.m_flF || ( node.m_flF == other.m_flF && iNode < iOther ) );
+}
+
+//-----------------------------------------------------------------------------
+
+#endif // AI_PATHSEARCH_H
@@ -0,0 +1,317 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Per-tick time budget for node graph searches started by NPC tasks
+//
+// $NoKeywords: $
+//=============================================================================//
+
+#include "cbase.h"
+
+#include "ai_routequeue.h"
+#include "ai_basenpc.h"
+#include "ai_network.h"
+#include "ai_node.h"
+#include "ai_squad.h"
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include "tier0/memdbgon.h"
+
+ConVar ai_route_budget_ms( "ai_route_budget_ms", "0", 0, "Milliseconds of node graph searching NPCs starting tasks get each tick, 0 for no limit" );
+ConVar ai_route_budget_max_wait( "ai_route_budget_max_wait", "8", 0, "Times a search can be put off before it's run to the end regardless of the budget" );
+ConVar ai_route_share_time( "ai_route_share_time", "0.5", 0, "Seconds a route found by one squad member is reused by squadmates searching between the same nodes while ai_route_budget_ms is on" );
+
+#define MAX_SHARED_ROUTES			32
+#define ROUTE_REQUEST_EXPIRE_TIME	1.0
+
+// Share of the budget an NPC can use, by efficiency
+static const float g_RouteBudgetShare[] =
+{
+	1.0,	// AIE_NORMAL
+	0.75,	// AIE_EFFICIENT
+	0.5,	// AIE_VERY_EFFICIENT
+	0.25,	// AIE_SUPER_EFFICIENT
+	0.1,	// AIE_DORMANT
+};
+
+CAI_RouteQueue g_AIRouteQueue( "CAI_RouteQueue" );
+
+//-----------------------------------------------------------------------------
+// CAI_RouteQueue
+//-----------------------------------------------------------------------------
+
+CAI_RouteQueue::CAI_RouteQueue( char const *name )
+ :	CAutoGameSystemPerFrame( name ),
+	m_pStartingNPC( NULL ),
+	m_bDeferred( false ),
+	m_flSpentMS( 0 )
+{
+	ResetStats();
+}
+
+//-----------------------------------------------------------------------------
+
+void CAI_RouteQueue::LevelShutdownPostEntity()
+{
+	Clear();
+	m_pStartingNPC = NULL;
+	m_bDeferred = false;
+}
+
+//-----------------------------------------------------------------------------
+
+void CAI_RouteQueue::FrameUpdatePreEntityThink()
+{
+	m_flSpentMS = 0;
+	m_nBusiestTick = MAX( m_nBusiestTick, m_nDeferredThisTick );
+	m_nDeferredThisTick = 0;
+
+	// NPCs that died or went on to something else don't come back for their searches
+	for ( int i = m_Requests.Count() - 1; i >= 0; i-- )
+	{
+		AI_RouteRequest_t *pRequest = m_Requests[i];
+		if ( !pRequest->hNPC || gpGlobals->curtime - pRequest->flLastRunTime > ROUTE_REQUEST_EXPIRE_TIME )
+		{
+			delete pRequest;
+			m_Requests.FastRemove( i );
+		}
+	}
+
+	for ( int i = m_SharedRoutes.Count() - 1; i >= 0; i-- )
+	{
+		if ( m_SharedRoutes[i]->flExpireTime < gpGlobals->curtime )
+		{
+			delete m_SharedRoutes[i];
+			m_SharedRoutes.Remove( i );
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+
+void CAI_RouteQueue::BeginStartTask( CAI_BaseNPC *pNPC )
+{
+	m_pStartingNPC = pNPC;
+	m_bDeferred = false;
+}
+
+//-----------------------------------------------------------------------------
+
+bool CAI_RouteQueue::EndStartTask( CAI_BaseNPC *pNPC )
+{
+	Assert( pNPC == m_pStartingNPC );
+	bool bDeferred = m_bDeferred;
+	m_pStartingNPC = NULL;
+	m_bDeferred = false;
+	return bDeferred;
+}
+
+//-----------------------------------------------------------------------------
+
+bool CAI_RouteQueue::IsBudgeted( CAI_BaseNPC *pNPC ) const
+{
+	// Searches made outside StartTask(), or by the post frame navigation
+	// thread, have callers that need an answer now
+	return ( ai_route_budget_ms.GetFloat() > 0 && pNPC == m_pStartingNPC && ThreadInMainThread() );
+}
+
+//-----------------------------------------------------------------------------
+
+AI_RouteRequest_t *CAI_RouteQueue::GetRequest( CAI_BaseNPC *pNPC, int startID, int endID )
+{
+	// Only one search is put off per task, anything after it fails until the task starts over
+	if ( IsDeferred( pNPC ) )
+		return NULL;
+
+	AI_RouteRequest_t *pRequest = NULL;
+	for ( int i = 0; i < m_Requests.Count(); i++ )
+	{
+		if ( m_Requests[i]->hNPC == pNPC )
+		{
+			pRequest = m_Requests[i];
+			break;
+		}
+	}
+
+	if ( !pRequest )
+	{
+		pRequest = new AI_RouteRequest_t;
+		pRequest->hNPC = pNPC;
+		pRequest->nTicksWaited = 0;
+		pRequest->bStarted = false;
+		m_Requests.AddToTail( pRequest );
+	}
+	else if ( pRequest->startID != startID || pRequest->endID != endID ||
+			  ( pRequest->bStarted && pRequest->search.NumNodes() != g_pBigAINet->NumNodes() ) )
+	{
+		// The NPC wants somewhere else now. The time it has waited still
+		// counts, so one that keeps changing its mind isn't put off forever
+		pRequest->bStarted = false;
+	}
+
+	if ( !pRequest->bStarted )
+	{
+		pRequest->startID = startID;
+		pRequest->endID = endID;
+		pRequest->bInCorridor = false;
+		pRequest->nExpanded = 0;
+		pRequest->nOpened = 0;
+		pRequest->flMS = 0;
+	}
+
+	pRequest->flLastRunTime = gpGlobals->curtime;
+	return pRequest;
+}
+
+//-----------------------------------------------------------------------------
+
+void CAI_RouteQueue::RemoveRequest( AI_RouteRequest_t *pRequest )
+{
+	m_Requests.FindAndFastRemove( pRequest );
+	delete pRequest;
+}
+
+//-----------------------------------------------------------------------------
+
+double CAI_RouteQueue::GetSliceEndTime( CAI_BaseNPC *pNPC, const AI_RouteRequest_t *pRequest )
+{
+	if ( pRequest->nTicksWaited >= ai_route_budget_max_wait.GetInt() )
+	{
+		m_nForced++;
+		return 0;
+	}
+
+	int iEfficiency = clamp( (int)pNPC->GetEfficiency(), 0, (int)ARRAYSIZE( g_RouteBudgetShare ) - 1 );
+	double flLeftMS = ai_route_budget_ms.GetFloat() * g_RouteBudgetShare[iEfficiency] - m_flSpentMS;
+	if ( flLeftMS <= 0 )
+		return -1;
+
+	return Plat_FloatTime() + flLeftMS * 0.001;
+}
+
+//-----------------------------------------------------------------------------
+
+void CAI_RouteQueue::Defer( CAI_BaseNPC *pNPC, AI_RouteRequest_t *pRequest, double flMS )
+{
+	Assert( pNPC == m_pStartingNPC );
+
+	m_flSpentMS += flMS;
+	m_bDeferred = true;
+	pRequest->nTicksWaited++;
+
+	m_nDeferrals++;
+	m_nDeferredThisTick++;
+}
+
+//-----------------------------------------------------------------------------
+
+void CAI_RouteQueue::SpendTime( double flMS )
+{
+	m_flSpentMS += flMS;
+}
+
+//-----------------------------------------------------------------------------
+
+bool CAI_RouteQueue::FindSharedRoute( CAI_BaseNPC *pNPC, int startID, int endID, CUtlVector<int> *pNodes )
+{
+	if ( !pNPC->GetSquad() )
+		return false;
+
+	for ( int i = 0; i < m_SharedRoutes.Count(); i++ )
+	{
+		SharedRoute_t *pRoute = m_SharedRoutes[i];
+		if ( pRoute->startID == startID && pRoute->endID == endID &&
+			 pRoute->pSquad == pNPC->GetSquad() &&
+			 pRoute->iClassname == pNPC->m_iClassname &&
+			 pRoute->hull == pNPC->GetHullType() &&
+			 pRoute->capabilities == pNPC->CapabilitiesGet() &&
+			 pRoute->flExpireTime >= gpGlobals->curtime )
+		{
+			pNodes->CopyArray( pRoute->nodes.Base(), pRoute->nodes.Count() );
+			m_nShared++;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+
+void CAI_RouteQueue::ShareRoute( CAI_BaseNPC *pNPC, int startID, int endID, const int *pParents )
+{
+	if ( ai_route_share_time.GetFloat() <= 0 || !pNPC->GetSquad() || pNPC->GetSquad()->NumMembers() < 2 )
+		return;
+
+	if ( m_SharedRoutes.Count() >= MAX_SHARED_ROUTES )
+	{
+		delete m_SharedRoutes[0];
+		m_SharedRoutes.Remove( 0 );
+	}
+
+	SharedRoute_t *pRoute = new SharedRoute_t;
+	pRoute->pSquad = pNPC->GetSquad();
+	pRoute->iClassname = pNPC->m_iClassname;
+	pRoute->startID = startID;
+	pRoute->endID = endID;
+	pRoute->hull = pNPC->GetHullType();
+	pRoute->capabilities = pNPC->CapabilitiesGet();
+	pRoute->flExpireTime = gpGlobals->curtime + ai_route_share_time.GetFloat();
+
+	for ( int iNode = endID; iNode != NO_NODE; iNode = pParents[iNode] )
+	{
+		pRoute->nodes.AddToTail( iNode );
+	}
+
+	m_SharedRoutes.AddToTail( pRoute );
+}
+
+//-----------------------------------------------------------------------------
+
+void CAI_RouteQueue::OnNetworkChanged()
+{
+	Clear();
+}
+
+//-----------------------------------------------------------------------------
+
+void CAI_RouteQueue::Clear()
+{
+	m_Requests.PurgeAndDeleteElements();
+	m_SharedRoutes.PurgeAndDeleteElements();
+}
+
+//-----------------------------------------------------------------------------
+
+void CAI_RouteQueue::PrintStats()
+{
+	Msg( "budget %.2f ms per tick, %d searches waiting\n", ai_route_budget_ms.GetFloat(), m_Requests.Count() );
+	Msg( "%d searches put off (at most %d in one tick), %d run to the end after waiting too long\n", m_nDeferrals, m_nBusiestTick, m_nForced );
+	Msg( "%d routes reused from squadmates\n", m_nShared );
+}
+
+//-----------------------------------------------------------------------------
+
+void CAI_RouteQueue::ResetStats()
+{
+	m_nDeferrals = 0;
+	m_nForced = 0;
+	m_nShared = 0;
+	m_nBusiestTick = 0;
+	m_nDeferredThisTick = 0;
+}
+
+//-----------------------------------------------------------------------------
+
+CON_COMMAND( ai_route_queue_stats, "Report how often node searches were put off by ai_route_budget_ms. Usage: ai_route_queue_stats [reset]" )
+{
+	if ( !UTIL_IsCommandIssuedByServerAdmin() )
+		return;
+
+	if ( args.ArgC() > 1 && !V_stricmp( args[1], "reset" ) )
+	{
+		g_AIRouteQueue.ResetStats();
+		return;
+	}
+
+	g_AIRouteQueue.PrintStats();
+}
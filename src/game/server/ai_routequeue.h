@@ -0,0 +1,128 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Per-tick time budget for node graph searches started by NPC tasks
+//
+// $NoKeywords: $
+//=============================================================================//
+
+#ifndef AI_ROUTEQUEUE_H
+#define AI_ROUTEQUEUE_H
+
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include "igamesystem.h"
+#include "utlvector.h"
+#include "bitvec.h"
+#include "ai_pathsearch.h"
+
+class CAI_BaseNPC;
+class CAI_Squad;
+
+//-----------------------------------------------------------------------------
+// A node search that ran out of time and is waiting for its NPC to think again
+//-----------------------------------------------------------------------------
+
+struct AI_RouteRequest_t
+{
+	EHANDLE			hNPC;
+	int				startID;
+	int				endID;
+	int				nTicksWaited;
+	float			flLastRunTime;
+	bool			bStarted;
+	bool			bInCorridor;		// Only searching the clusters in corridor
+	CVarBitVec		corridor;
+	CAI_PathSearch	search;
+
+	// Totals over every slice, for the search stats
+	int				nExpanded;
+	int				nOpened;
+	double			flMS;
+};
+
+//-----------------------------------------------------------------------------
+// CAI_RouteQueue
+//
+// Purpose: Node searches made while an NPC starts a task share a time budget
+//			each tick. A search that runs over is kept and the task is started
+//			again the next time the NPC thinks, when the search picks up where
+//			it stopped. Less efficient NPCs get a smaller share of the budget,
+//			and a route found for one member of a squad is handed to the others
+//			for a moment instead of being searched for again.
+//-----------------------------------------------------------------------------
+
+class CAI_RouteQueue : public CAutoGameSystemPerFrame
+{
+public:
+	CAI_RouteQueue( char const *name );
+
+	virtual void	LevelShutdownPostEntity();
+	virtual void	FrameUpdatePreEntityThink();
+
+	// MaintainSchedule brackets StartTask() with these. EndStartTask() returns
+	// true if a node search was put off and the task should start over
+	void			BeginStartTask( CAI_BaseNPC *pNPC );
+	bool			EndStartTask( CAI_BaseNPC *pNPC );
+
+	// Can a node search by pNPC be put off until it next thinks?
+	bool			IsBudgeted( CAI_BaseNPC *pNPC ) const;
+	bool			IsDeferred( CAI_BaseNPC *pNPC ) const	{ return ( m_bDeferred && pNPC == m_pStartingNPC ); }
+
+	// The search for pNPC, resumed if it's still for the same nodes.
+	// NULL if pNPC already put off a search this think
+	AI_RouteRequest_t *GetRequest( CAI_BaseNPC *pNPC, int startID, int endID );
+	void			RemoveRequest( AI_RouteRequest_t *pRequest );
+
+	// Plat_FloatTime() at which the search has to stop, 0 for no limit, or
+	// -1 if pNPC gets no time this tick
+	double			GetSliceEndTime( CAI_BaseNPC *pNPC, const AI_RouteRequest_t *pRequest );
+	void			SpendTime( double flMS );
+	void			Defer( CAI_BaseNPC *pNPC, AI_RouteRequest_t *pRequest, double flMS );
+
+	// Routes recently found by squadmates. pNodes runs from the end of the
+	// route back to the start
+	bool			FindSharedRoute( CAI_BaseNPC *pNPC, int startID, int endID, CUtlVector<int> *pNodes );
+	void			ShareRoute( CAI_BaseNPC *pNPC, int startID, int endID, const int *pParents );
+
+	// A link was turned on or off, so a resumed search could be out of date
+	void			OnNetworkChanged();
+
+	void			PrintStats();
+	void			ResetStats();
+
+private:
+	struct SharedRoute_t
+	{
+		CAI_Squad *		pSquad;
+		string_t		iClassname;
+		int				startID;
+		int				endID;
+		int				hull;
+		int				capabilities;
+		float			flExpireTime;
+		CUtlVector<int>	nodes;
+	};
+
+	void			Clear();
+
+	CUtlVector<AI_RouteRequest_t *>	m_Requests;
+	CUtlVector<SharedRoute_t *>		m_SharedRoutes;
+
+	CAI_BaseNPC *	m_pStartingNPC;
+	bool			m_bDeferred;
+	double			m_flSpentMS;		// This tick
+
+	int				m_nDeferrals;
+	int				m_nForced;
+	int				m_nShared;
+	int				m_nBusiestTick;		// Most searches put off in one tick
+	int				m_nDeferredThisTick;
+};
+
+extern CAI_RouteQueue g_AIRouteQueue;
+
+//-----------------------------------------------------------------------------
+
+#endif // AI_ROUTEQUEUE_H
@@ -35,9 +35,19 @@ const float AI_EFFICIENT_NPC_SEARCH_TIME = .35;
 const float AI_HIGH_PRIORITY_SEARCH_TIME = 0.15;
 const float AI_MISC_SEARCH_TIME  = 0.45;
 
+ConVar ai_sense_buckets( "ai_sense_buckets", "1", 0, "Gather the NPCs and objects an NPC looks at from position buckets built once per tick" );
+
+// Size of a bucket cell, and how far something can move during a tick and
+// still be found in the bucket it was put in when the buckets were built.
+// Anything teleported further than this by an earlier think in the same
+// tick is missed until the next rebuild.
+const float AI_SENSE_BUCKET_SIZE = 512;
+const float AI_SENSE_BUCKET_SLOP = 128;
+
 //-----------------------------------------------------------------------------
 
 CAI_SensedObjectsManager g_AI_SensedObjectsManager;
+CAI_SenseCandidates g_AI_SenseCandidates;
 
 //-----------------------------------------------------------------------------
 
@@ -458,13 +468,15 @@ int CAI_Senses::LookForNPCs( int iDistance )
 
 			BeginGather();
 
-			CAI_BaseNPC **ppAIs = g_AI_Manager.AccessAIs();
+			CUtlVector<CBaseEntity *> candidates;
+			g_AI_SenseCandidates.GetNPCs( origin, iDistance, &candidates );
 			
-			for ( i = 0; i < g_AI_Manager.NumAIs(); i++ )
+			for ( i = 0; i < candidates.Count(); i++ )
 			{
-				if ( ppAIs[i] != GetOuter() && ( ppAIs[i]->ShouldNotDistanceCull() || origin.DistToSqr(ppAIs[i]->GetAbsOrigin()) < distSq ) )
+				CAI_BaseNPC *pNPC = assert_cast<CAI_BaseNPC *>( candidates[i] );
+				if ( pNPC != GetOuter() && ( pNPC->ShouldNotDistanceCull() || origin.DistToSqr(pNPC->GetAbsOrigin()) < distSq ) )
 				{
-					if ( Look( ppAIs[i] ) )
+					if ( Look( pNPC ) )
 					{
 						nSeen++;
 					}
@@ -516,10 +528,13 @@ int CAI_Senses::LookForObjects( int iDistance )
 
 		float distSq = ( iDistance * iDistance );
 		const Vector &origin = GetAbsOrigin();
-		int iter;
-		CBaseEntity *pEnt = g_AI_SensedObjectsManager.GetFirst( &iter );
-		while ( pEnt )
+
+		CUtlVector<CBaseEntity *> candidates;
+		g_AI_SenseCandidates.GetObjects( origin, iDistance, &candidates );
+
+		for ( int i = 0; i < candidates.Count(); i++ )
 		{
+			CBaseEntity *pEnt = candidates[i];
 			if ( pEnt->GetFlags() & BOX_QUERY_MASK )
 			{
 				if ( origin.DistToSqr(pEnt->GetAbsOrigin()) < distSq && Look( pEnt) )
@@ -527,7 +542,6 @@ int CAI_Senses::LookForObjects( int iDistance )
 					nSeen++;
 				}
 			}
-			pEnt = g_AI_SensedObjectsManager.GetNext( &iter );
 		}
 		
 		EndGather( nSeen, &m_SeenMisc );
@@ -683,6 +697,7 @@ void CAI_SensedObjectsManager::Term()
 {
 	gEntList.RemoveListenerEntity( this );
 	m_SensedObjects.RemoveAll();
+	m_iChangeCount++;
 }
 
 //-----------------------------------------------------------------------------
@@ -721,6 +736,7 @@ void CAI_SensedObjectsManager::OnEntitySpawned( CBaseEntity *pEntity )
 	if ( ( pEntity->GetFlags() & FL_OBJECT ) && !pEntity->IsPlayer() && !pEntity->IsNPC() )
 	{
 		m_SensedObjects.AddToTail( pEntity );
+		m_iChangeCount++;
 	}
 }
 
@@ -732,7 +748,10 @@ void CAI_SensedObjectsManager::OnEntityDeleted( CBaseEntity *pEntity )
 	{
 		int i = m_SensedObjects.Find( pEntity );
 		if ( i != m_SensedObjects.InvalidIndex() )
+		{
 			m_SensedObjects.FastRemove( i );
+			m_iChangeCount++;
+		}
 	}
 }
 
@@ -747,6 +766,241 @@ void CAI_SensedObjectsManager::AddEntity( CBaseEntity *pEntity )
 	// Add the object flag so it gets removed when it dies
 	pEntity->AddFlag( FL_OBJECT );
 	m_SensedObjects.AddToTail( pEntity );
+	m_iChangeCount++;
+}
+
+//=============================================================================
+//
+// CAI_SenseCandidates
+//
+//=============================================================================
+
+CAI_SenseCandidates::CAI_SenseCandidates()
+ :	m_nBuildTick( -1 ),
+	m_iNPCChangeCount( 0 ),
+	m_iObjectChangeCount( 0 )
+{
+}
+
+//-----------------------------------------------------------------------------
+
+void CAI_SenseCandidates::Clear()
+{
+	m_NPCs.Clear();
+	m_Objects.Clear();
+	m_nBuildTick = -1;
+}
+
+//-----------------------------------------------------------------------------
+
+void CAI_SenseCandidates::GetNPCs( const Vector &vecOrigin, float flDist, CUtlVector<CBaseEntity *> *pResult )
+{
+	if ( !ai_sense_buckets.GetBool() )
+	{
+		CAI_BaseNPC **ppAIs = g_AI_Manager.AccessAIs();
+		pResult->EnsureCapacity( g_AI_Manager.NumAIs() );
+		for ( int i = 0; i < g_AI_Manager.NumAIs(); i++ )
+		{
+			pResult->AddToTail( ppAIs[i] );
+		}
+		return;
+	}
+
+	Update();
+	m_NPCs.Gather( vecOrigin, flDist, pResult );
+}
+
+//-----------------------------------------------------------------------------
+
+void CAI_SenseCandidates::GetObjects( const Vector &vecOrigin, float flDist, CUtlVector<CBaseEntity *> *pResult )
+{
+	if ( !ai_sense_buckets.GetBool() )
+	{
+		int iter;
+		CBaseEntity *pEnt = g_AI_SensedObjectsManager.GetFirst( &iter );
+		while ( pEnt )
+		{
+			pResult->AddToTail( pEnt );
+			pEnt = g_AI_SensedObjectsManager.GetNext( &iter );
+		}
+		return;
+	}
+
+	Update();
+	m_Objects.Gather( vecOrigin, flDist, pResult );
+}
+
+//-----------------------------------------------------------------------------
+
+void CAI_SenseCandidates::Update()
+{
+	// Rebuilt when anything spawns or dies during the tick, even if the
+	// counts come out the same, so the lists stay in the managers' order
+	if ( m_nBuildTick == gpGlobals->tickcount &&
+		 m_iNPCChangeCount == g_AI_Manager.GetChangeCount() &&
+		 m_iObjectChangeCount == g_AI_SensedObjectsManager.GetChangeCount() )
+	{
+		return;
+	}
+
+	AI_PROFILE_SENSES(CAI_SenseCandidates_Update);
+
+	m_nBuildTick = gpGlobals->tickcount;
+	m_iNPCChangeCount = g_AI_Manager.GetChangeCount();
+	m_iObjectChangeCount = g_AI_SensedObjectsManager.GetChangeCount();
+
+	m_NPCs.Clear();
+	CAI_BaseNPC **ppAIs = g_AI_Manager.AccessAIs();
+	for ( int i = 0; i < g_AI_Manager.NumAIs(); i++ )
+	{
+		m_NPCs.Add( ppAIs[i], ppAIs[i]->ShouldNotDistanceCull() );
+	}
+	m_NPCs.Finish();
+
+	m_Objects.Clear();
+	int iter;
+	CBaseEntity *pEnt = g_AI_SensedObjectsManager.GetFirst( &iter );
+	while ( pEnt )
+	{
+		m_Objects.Add( pEnt, false );
+		pEnt = g_AI_SensedObjectsManager.GetNext( &iter );
+	}
+	m_Objects.Finish();
+}
+
+//-----------------------------------------------------------------------------
+
+static inline int AI_SenseBucketCoord( float flCoord )
+{
+	return (int)floor( flCoord / AI_SENSE_BUCKET_SIZE );
+}
+
+static inline int AI_SenseBucket( int x, int y )
+{
+	// Unsigned, so the multiplies wrap instead of overflowing
+	return (int)( ( ( (unsigned)x * 73856093u ) ^ ( (unsigned)y * 19349663u ) ) & ( AI_SENSE_BUCKETS - 1 ) );
+}
+
+static int __cdecl AI_SenseCompareOrder( const int *pLeft, const int *pRight )
+{
+	return ( *pLeft - *pRight );
+}
+
+//-----------------------------------------------------------------------------
+
+void CAI_SenseCandidates::CBuckets::Clear()
+{
+	m_Handles.RemoveAll();
+	m_Entries.RemoveAll();
+	m_Always.RemoveAll();
+	memset( m_BucketStart, 0, sizeof( m_BucketStart ) );
+}
+
+//-----------------------------------------------------------------------------
+
+void CAI_SenseCandidates::CBuckets::Add( CBaseEntity *pEntity, bool bAlways )
+{
+	int iOrder = m_Handles.AddToTail( pEntity );
+
+	if ( bAlways )
+	{
+		m_Always.AddToTail( iOrder );
+		return;
+	}
+
+	const Vector &vecOrigin = pEntity->GetAbsOrigin();
+	Entry_t entry;
+	entry.iOrder = iOrder;
+	entry.x = AI_SenseBucketCoord( vecOrigin.x );
+	entry.y = AI_SenseBucketCoord( vecOrigin.y );
+	m_Entries.AddToTail( entry );
+}
+
+//-----------------------------------------------------------------------------
+// Sort the entries by bucket so each bucket is one run of m_Entries
+//-----------------------------------------------------------------------------
+
+void CAI_SenseCandidates::CBuckets::Finish()
+{
+	memset( m_BucketStart, 0, sizeof( m_BucketStart ) );
+
+	for ( int i = 0; i < m_Entries.Count(); i++ )
+	{
+		m_BucketStart[ AI_SenseBucket( m_Entries[i].x, m_Entries[i].y ) + 1 ]++;
+	}
+
+	for ( int i = 0; i < AI_SENSE_BUCKETS; i++ )
+	{
+		m_BucketStart[i + 1] += m_BucketStart[i];
+	}
+
+	int next[AI_SENSE_BUCKETS];
+	memcpy( next, m_BucketStart, sizeof( next ) );
+
+	CUtlVector<Entry_t> sorted;
+	sorted.SetCount( m_Entries.Count() );
+	for ( int i = 0; i < m_Entries.Count(); i++ )
+	{
+		sorted[ next[ AI_SenseBucket( m_Entries[i].x, m_Entries[i].y ) ]++ ] = m_Entries[i];
+	}
+	m_Entries.Swap( sorted );
+}
+
+//-----------------------------------------------------------------------------
+
+void CAI_SenseCandidates::CBuckets::Gather( const Vector &vecOrigin, float flDist, CUtlVector<CBaseEntity *> *pResult )
+{
+	float flReach = flDist + AI_SENSE_BUCKET_SLOP;
+	int x0 = AI_SenseBucketCoord( vecOrigin.x - flReach );
+	int x1 = AI_SenseBucketCoord( vecOrigin.x + flReach );
+	int y0 = AI_SenseBucketCoord( vecOrigin.y - flReach );
+	int y1 = AI_SenseBucketCoord( vecOrigin.y + flReach );
+
+	// Looking further than the buckets cover is no better than taking everything
+	if ( ( x1 - x0 + 1 ) * ( y1 - y0 + 1 ) >= AI_SENSE_BUCKETS )
+	{
+		pResult->EnsureCapacity( m_Handles.Count() );
+		for ( int i = 0; i < m_Handles.Count(); i++ )
+		{
+			CBaseEntity *pEntity = m_Handles[i];
+			if ( pEntity )
+			{
+				pResult->AddToTail( pEntity );
+			}
+		}
+		return;
+	}
+
+	CUtlVector<int> orders;
+	orders.CopyArray( m_Always.Base(), m_Always.Count() );
+
+	for ( int x = x0; x <= x1; x++ )
+	{
+		for ( int y = y0; y <= y1; y++ )
+		{
+			int iBucket = AI_SenseBucket( x, y );
+			for ( int i = m_BucketStart[iBucket]; i < m_BucketStart[iBucket + 1]; i++ )
+			{
+				// Other cells can share the bucket
+				if ( m_Entries[i].x == x && m_Entries[i].y == y )
+				{
+					orders.AddToTail( m_Entries[i].iOrder );
+				}
+			}
+		}
+	}
+
+	orders.Sort( AI_SenseCompareOrder );
+
+	pResult->EnsureCapacity( orders.Count() );
+	for ( int i = 0; i < orders.Count(); i++ )
+	{
+		CBaseEntity *pEntity = m_Handles[ orders[i] ];
+		if ( pEntity )
+		{
+			pResult->AddToTail( pEntity );
+		}
+	}
 }
 
 //=============================================================================
@@ -145,6 +145,8 @@ private:
 class CAI_SensedObjectsManager : public IEntityListener
 {
 public:
+	CAI_SensedObjectsManager() : m_iChangeCount( 0 ) {}
+
 	void Init();
 	void Term();
 
@@ -153,16 +155,84 @@ public:
 
 	virtual void 	AddEntity( CBaseEntity *pEntity );
 
+	// Bumped whenever an object is added or removed
+	int				GetChangeCount() const	{ return m_iChangeCount; }
+
 private:
 	virtual void 	OnEntitySpawned( CBaseEntity *pEntity );
 	virtual void 	OnEntityDeleted( CBaseEntity *pEntity );
 
 	CUtlVector<EHANDLE> m_SensedObjects;
+	int					m_iChangeCount;
 };
 
 extern CAI_SensedObjectsManager g_AI_SensedObjectsManager;
 
 //-----------------------------------------------------------------------------
+// CAI_SenseCandidates
+//
+// Purpose: NPCs and sensed objects are put in buckets by position once per
+//			tick, so an NPC looking around only tests the ones near it
+//			instead of every one in the level. Candidates come back in the
+//			order of the full lists, so the order an NPC sees things in
+//			doesn't change. Something that moves further than
+//			AI_SENSE_BUCKET_SLOP between the build and the look, such as an
+//			NPC teleported by an earlier think in the same tick, can be
+//			missed for that tick. ai_sense_buckets 0 goes back to the full
+//			lists.
+//-----------------------------------------------------------------------------
+
+#define AI_SENSE_BUCKETS	1024
+
+class CAI_SenseCandidates
+{
+public:
+	CAI_SenseCandidates();
+
+	void Clear();
+
+	// NPCs that could be within flDist of vecOrigin, plus every NPC that
+	// shouldn't be distance culled
+	void GetNPCs( const Vector &vecOrigin, float flDist, CUtlVector<CBaseEntity *> *pResult );
+
+	// Sensed objects that could be within flDist of vecOrigin
+	void GetObjects( const Vector &vecOrigin, float flDist, CUtlVector<CBaseEntity *> *pResult );
+
+private:
+	class CBuckets
+	{
+	public:
+		void		Clear();
+		void		Add( CBaseEntity *pEntity, bool bAlways );
+		void		Finish();
+		void		Gather( const Vector &vecOrigin, float flDist, CUtlVector<CBaseEntity *> *pResult );
+
+	private:
+		struct Entry_t
+		{
+			int		iOrder;		// Index in m_Handles
+			int		x;
+			int		y;
+		};
+
+		CUtlVector<EHANDLE>		m_Handles;		// In the order of the full list
+		CUtlVector<Entry_t>		m_Entries;		// Grouped by bucket once finished
+		CUtlVector<int>			m_Always;		// Entities that are candidates from anywhere
+		int						m_BucketStart[AI_SENSE_BUCKETS + 1];
+	};
+
+	void Update();
+
+	CBuckets	m_NPCs;
+	CBuckets	m_Objects;
+	int			m_nBuildTick;
+	int			m_iNPCChangeCount;		// CAI_Manager::GetChangeCount() when built
+	int			m_iObjectChangeCount;	// CAI_SensedObjectsManager::GetChangeCount() when built
+};
+
+extern CAI_SenseCandidates g_AI_SenseCandidates;
+
+//-----------------------------------------------------------------------------
 
 
 
@@ -61,6 +61,7 @@
 #include "env_debughistory.h"
 #include "tier1/utlstring.h"
 #include "utlhashtable.h"
+#include "trigger_broadphase.h"
 
 #if defined( TF_DLL )
 #include "tf_gamerules.h"
@@ -2622,7 +2623,7 @@ void CBaseEntity::PhysicsTouchTriggers( const Vector *pPrevAbsOrigin )
 		}
 
 		SetCheckUntouch( true );
-		if ( isSolidCheckTriggers )
+		if ( isSolidCheckTriggers && g_pTriggerBroadphase->MayTouchTriggers( this, pPrevAbsOrigin ) )
 		{
 			engine->SolidMoved( pEdict, CollisionProp(), pPrevAbsOrigin, sm_bAccurateTriggerBboxChecks );
 		}
@@ -3311,7 +3312,7 @@ void CBaseEntity::OnRestore()
 	}
 
 	// We're not save/loading the PVS dirty state. Assume everything is dirty after a restore
-	NetworkProp()->MarkPVSInformationDirty();
+	NetworkProp()->OnRestore();
 }
 
 
@@ -0,0 +1,436 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Compares the batched bf_write/bf_read paths against the
+//			field-at-a-time encoding they replaced, for speed, for
+//			producing the same bits and for decoding them to the same values.
+//
+// $NoKeywords: $
+//=============================================================================//
+
+#include "cbase.h"
+#include "tier0/fasttimer.h"
+#include "coordsize.h"
+#include "vstdlib/random.h"
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include "tier0/memdbgon.h"
+
+#define BITBUF_BENCHMARK_VALUES		1024
+#define BITBUF_BENCHMARK_VALUE_BITS	10
+#define BITBUF_BENCHMARK_VECTORS	256
+#define BITBUF_BENCHMARK_BYTES		( 16 * 1024 )
+
+struct BitBufBenchmarkData_t
+{
+	uint32	m_Values[BITBUF_BENCHMARK_VALUES];
+	Vector	m_Coords[BITBUF_BENCHMARK_VECTORS];
+	Vector	m_Normals[BITBUF_BENCHMARK_VECTORS];
+	byte	m_Source[BITBUF_BENCHMARK_BYTES / 2];
+};
+
+typedef void (*BitBufBenchmarkFn_t)( bf_write &buf, const BitBufBenchmarkData_t &data );
+typedef bool (*BitBufRoundTripFn_t)( bf_read &reference, bf_read &current, const BitBufBenchmarkData_t &data );
+
+//-----------------------------------------------------------------------------
+// The encodings as they were written before, one field at a time
+//-----------------------------------------------------------------------------
+static void ReferenceWriteBitCoord( bf_write &buf, float f )
+{
+	int		signbit = (f <= -COORD_RESOLUTION);
+	int		intval = (int)abs(f);
+	int		fractval = abs((int)(f*COORD_DENOMINATOR)) & (COORD_DENOMINATOR-1);
+
+	buf.WriteOneBit( intval );
+	buf.WriteOneBit( fractval );
+
+	if ( intval || fractval )
+	{
+		buf.WriteOneBit( signbit );
+		if ( intval )
+		{
+			buf.WriteUBitLong( (unsigned int)( intval - 1 ), COORD_INTEGER_BITS );
+		}
+		if ( fractval )
+		{
+			buf.WriteUBitLong( (unsigned int)fractval, COORD_FRACTIONAL_BITS );
+		}
+	}
+}
+
+static void ReferenceWriteBitNormal( bf_write &buf, float f )
+{
+	int	signbit = (f <= -NORMAL_RESOLUTION);
+	unsigned int fractval = abs( (int)(f*NORMAL_DENOMINATOR) );
+	if (fractval > NORMAL_DENOMINATOR)
+		fractval = NORMAL_DENOMINATOR;
+
+	buf.WriteOneBit( signbit );
+	buf.WriteUBitLong( fractval, NORMAL_FRACTIONAL_BITS );
+}
+
+static void ReferenceValues( bf_write &buf, const BitBufBenchmarkData_t &data )
+{
+	for ( int i = 0; i < BITBUF_BENCHMARK_VALUES; ++i )
+	{
+		buf.WriteUBitLong( data.m_Values[i], BITBUF_BENCHMARK_VALUE_BITS );
+	}
+}
+
+static void ReferenceCoords( bf_write &buf, const BitBufBenchmarkData_t &data )
+{
+	for ( int i = 0; i < BITBUF_BENCHMARK_VECTORS; ++i )
+	{
+		const Vector &fa = data.m_Coords[i];
+		int xflag = (fa[0] >= COORD_RESOLUTION) || (fa[0] <= -COORD_RESOLUTION);
+		int yflag = (fa[1] >= COORD_RESOLUTION) || (fa[1] <= -COORD_RESOLUTION);
+		int zflag = (fa[2] >= COORD_RESOLUTION) || (fa[2] <= -COORD_RESOLUTION);
+
+		buf.WriteOneBit( xflag );
+		buf.WriteOneBit( yflag );
+		buf.WriteOneBit( zflag );
+
+		if ( xflag )
+			ReferenceWriteBitCoord( buf, fa[0] );
+		if ( yflag )
+			ReferenceWriteBitCoord( buf, fa[1] );
+		if ( zflag )
+			ReferenceWriteBitCoord( buf, fa[2] );
+	}
+}
+
+static void ReferenceNormals( bf_write &buf, const BitBufBenchmarkData_t &data )
+{
+	for ( int i = 0; i < BITBUF_BENCHMARK_VECTORS; ++i )
+	{
+		const Vector &fa = data.m_Normals[i];
+		int xflag = (fa[0] >= NORMAL_RESOLUTION) || (fa[0] <= -NORMAL_RESOLUTION);
+		int yflag = (fa[1] >= NORMAL_RESOLUTION) || (fa[1] <= -NORMAL_RESOLUTION);
+
+		buf.WriteOneBit( xflag );
+		buf.WriteOneBit( yflag );
+
+		if ( xflag )
+			ReferenceWriteBitNormal( buf, fa[0] );
+		if ( yflag )
+			ReferenceWriteBitNormal( buf, fa[1] );
+
+		buf.WriteOneBit( fa[2] <= -NORMAL_RESOLUTION );
+	}
+}
+
+static void ReferenceScalars( bf_write &buf, const BitBufBenchmarkData_t &data )
+{
+	for ( int i = 0; i < BITBUF_BENCHMARK_VECTORS; ++i )
+	{
+		ReferenceWriteBitCoord( buf, data.m_Coords[i][0] );
+		ReferenceWriteBitNormal( buf, data.m_Normals[i][0] );
+	}
+}
+
+static void ReferenceCopy( bf_write &buf, const BitBufBenchmarkData_t &data )
+{
+	// Odd offsets on both sides, so nothing lines up
+	bf_read in( data.m_Source, sizeof( data.m_Source ) );
+	in.Seek( 3 );
+	buf.WriteOneBit( 1 );
+
+	int nBits = in.GetNumBitsLeft();
+	while ( nBits > 32 )
+	{
+		buf.WriteUBitLong( in.ReadUBitLong( 32 ), 32 );
+		nBits -= 32;
+	}
+	buf.WriteUBitLong( in.ReadUBitLong( nBits ), nBits );
+}
+
+//-----------------------------------------------------------------------------
+// The same data through the current bf_write
+//-----------------------------------------------------------------------------
+static void CurrentValues( bf_write &buf, const BitBufBenchmarkData_t &data )
+{
+	buf.WriteUBitLongArray( data.m_Values, BITBUF_BENCHMARK_VALUES, BITBUF_BENCHMARK_VALUE_BITS );
+}
+
+static void CurrentCoords( bf_write &buf, const BitBufBenchmarkData_t &data )
+{
+	for ( int i = 0; i < BITBUF_BENCHMARK_VECTORS; ++i )
+	{
+		buf.WriteBitVec3Coord( data.m_Coords[i] );
+	}
+}
+
+static void CurrentNormals( bf_write &buf, const BitBufBenchmarkData_t &data )
+{
+	for ( int i = 0; i < BITBUF_BENCHMARK_VECTORS; ++i )
+	{
+		buf.WriteBitVec3Normal( data.m_Normals[i] );
+	}
+}
+
+static void CurrentScalars( bf_write &buf, const BitBufBenchmarkData_t &data )
+{
+	for ( int i = 0; i < BITBUF_BENCHMARK_VECTORS; ++i )
+	{
+		buf.WriteBitCoord( data.m_Coords[i][0] );
+		buf.WriteBitNormal( data.m_Normals[i][0] );
+	}
+}
+
+static void CurrentCopy( bf_write &buf, const BitBufBenchmarkData_t &data )
+{
+	bf_read in( data.m_Source, sizeof( data.m_Source ) );
+	in.Seek( 3 );
+	buf.WriteOneBit( 1 );
+	buf.WriteBitsFromBuffer( &in, in.GetNumBitsLeft() );
+}
+
+//-----------------------------------------------------------------------------
+// The decoders as they were written before, one field at a time
+//-----------------------------------------------------------------------------
+static float ReferenceReadBitCoord( bf_read &buf )
+{
+	int		intval = buf.ReadOneBit();
+	int		fractval = buf.ReadOneBit();
+	float	value = 0.0f;
+
+	if ( intval || fractval )
+	{
+		int signbit = buf.ReadOneBit();
+		if ( intval )
+		{
+			intval = buf.ReadUBitLong( COORD_INTEGER_BITS ) + 1;
+		}
+		if ( fractval )
+		{
+			fractval = buf.ReadUBitLong( COORD_FRACTIONAL_BITS );
+		}
+
+		value = intval + ((float)fractval * COORD_RESOLUTION);
+		if ( signbit )
+			value = -value;
+	}
+
+	return value;
+}
+
+static void ReferenceReadBitVec3Coord( bf_read &buf, Vector &fa )
+{
+	fa.Init( 0, 0, 0 );
+
+	int xflag = buf.ReadOneBit();
+	int yflag = buf.ReadOneBit();
+	int zflag = buf.ReadOneBit();
+
+	if ( xflag )
+		fa[0] = ReferenceReadBitCoord( buf );
+	if ( yflag )
+		fa[1] = ReferenceReadBitCoord( buf );
+	if ( zflag )
+		fa[2] = ReferenceReadBitCoord( buf );
+}
+
+static float ReferenceReadBitNormal( bf_read &buf )
+{
+	int	signbit = buf.ReadOneBit();
+	unsigned int fractval = buf.ReadUBitLong( NORMAL_FRACTIONAL_BITS );
+
+	float value = (float)fractval * NORMAL_RESOLUTION;
+	if ( signbit )
+		value = -value;
+
+	return value;
+}
+
+static void ReferenceReadBitVec3Normal( bf_read &buf, Vector &fa )
+{
+	int xflag = buf.ReadOneBit();
+	int yflag = buf.ReadOneBit();
+
+	fa[0] = xflag ? ReferenceReadBitNormal( buf ) : 0.0f;
+	fa[1] = yflag ? ReferenceReadBitNormal( buf ) : 0.0f;
+
+	int znegative = buf.ReadOneBit();
+
+	float fafafbfb = fa[0] * fa[0] + fa[1] * fa[1];
+	if ( fafafbfb < 1.0f )
+		fa[2] = sqrt( 1.0f - fafafbfb );
+	else
+		fa[2] = 0.0f;
+
+	if ( znegative )
+		fa[2] = -fa[2];
+}
+
+//-----------------------------------------------------------------------------
+// Read every value back through both decoders; they must agree bit for bit
+//-----------------------------------------------------------------------------
+static bool SameBits( float a, float b )
+{
+	return !V_memcmp( &a, &b, sizeof( float ) );
+}
+
+static bool SameBits( const Vector &a, const Vector &b )
+{
+	return SameBits( a.x, b.x ) && SameBits( a.y, b.y ) && SameBits( a.z, b.z );
+}
+
+static bool RoundTripValues( bf_read &reference, bf_read &current, const BitBufBenchmarkData_t &data )
+{
+	uint32 values[BITBUF_BENCHMARK_VALUES];
+	current.ReadUBitLongArray( values, BITBUF_BENCHMARK_VALUES, BITBUF_BENCHMARK_VALUE_BITS );
+
+	for ( int i = 0; i < BITBUF_BENCHMARK_VALUES; ++i )
+	{
+		uint32 value = reference.ReadUBitLong( BITBUF_BENCHMARK_VALUE_BITS );
+		if ( value != values[i] || value != data.m_Values[i] )
+			return false;
+	}
+	return true;
+}
+
+static bool RoundTripCoords( bf_read &reference, bf_read &current, const BitBufBenchmarkData_t &data )
+{
+	for ( int i = 0; i < BITBUF_BENCHMARK_VECTORS; ++i )
+	{
+		Vector vecReference, vecCurrent;
+		ReferenceReadBitVec3Coord( reference, vecReference );
+		current.ReadBitVec3Coord( vecCurrent );
+		if ( !SameBits( vecReference, vecCurrent ) )
+			return false;
+	}
+	return true;
+}
+
+static bool RoundTripNormals( bf_read &reference, bf_read &current, const BitBufBenchmarkData_t &data )
+{
+	for ( int i = 0; i < BITBUF_BENCHMARK_VECTORS; ++i )
+	{
+		Vector vecReference, vecCurrent;
+		ReferenceReadBitVec3Normal( reference, vecReference );
+		current.ReadBitVec3Normal( vecCurrent );
+		if ( !SameBits( vecReference, vecCurrent ) )
+			return false;
+	}
+	return true;
+}
+
+static bool RoundTripScalars( bf_read &reference, bf_read &current, const BitBufBenchmarkData_t &data )
+{
+	for ( int i = 0; i < BITBUF_BENCHMARK_VECTORS; ++i )
+	{
+		if ( !SameBits( ReferenceReadBitCoord( reference ), current.ReadBitCoord() ) )
+			return false;
+		if ( !SameBits( ReferenceReadBitNormal( reference ), current.ReadBitNormal() ) )
+			return false;
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Times both versions, checks their output matches and that both
+//			decoders read the same values back
+//-----------------------------------------------------------------------------
+static void RunBitBufBenchmark( const char *pName, BitBufBenchmarkFn_t pfnReference, BitBufBenchmarkFn_t pfnCurrent,
+	BitBufRoundTripFn_t pfnRoundTrip, const BitBufBenchmarkData_t &data, int nIterations )
+{
+	static byte s_Reference[BITBUF_BENCHMARK_BYTES];
+	static byte s_Current[BITBUF_BENCHMARK_BYTES];
+
+	V_memset( s_Reference, 0, sizeof( s_Reference ) );
+	V_memset( s_Current, 0, sizeof( s_Current ) );
+
+	bf_write reference( "bitbuf_benchmark", s_Reference, sizeof( s_Reference ) );
+	bf_write current( "bitbuf_benchmark", s_Current, sizeof( s_Current ) );
+
+	CFastTimer timer;
+
+	timer.Start();
+	for ( int i = 0; i < nIterations; ++i )
+	{
+		reference.Reset();
+		pfnReference( reference, data );
+	}
+	timer.End();
+	float flReferenceMS = timer.GetDuration().GetMillisecondsF();
+
+	timer.Start();
+	for ( int i = 0; i < nIterations; ++i )
+	{
+		current.Reset();
+		pfnCurrent( current, data );
+	}
+	timer.End();
+	float flCurrentMS = timer.GetDuration().GetMillisecondsF();
+
+	bool bMatch = !reference.IsOverflowed() && !current.IsOverflowed() &&
+		reference.GetNumBitsWritten() == current.GetNumBitsWritten() &&
+		!V_memcmp( s_Reference, s_Current, reference.GetNumBytesWritten() );
+
+	// The copy has no decoder of its own to check
+	const char *pszRoundTrip = "";
+	if ( pfnRoundTrip && !current.IsOverflowed() )
+	{
+		bf_read referenceRead( s_Current, current.GetNumBytesWritten(), current.GetNumBitsWritten() );
+		bf_read currentRead( s_Current, current.GetNumBytesWritten(), current.GetNumBitsWritten() );
+
+		bool bRoundTrip = pfnRoundTrip( referenceRead, currentRead, data ) &&
+			!referenceRead.IsOverflowed() && !currentRead.IsOverflowed() &&
+			referenceRead.GetNumBitsRead() == current.GetNumBitsWritten() &&
+			currentRead.GetNumBitsRead() == current.GetNumBitsWritten();
+		AssertMsg( bRoundTrip, "bitbuf_benchmark: %s decoders disagree\n", pName );
+
+		pszRoundTrip = bRoundTrip ? "  read back identical" : "  read back MISMATCH";
+	}
+
+	AssertMsg( bMatch, "bitbuf_benchmark: %s encoders disagree\n", pName );
+
+	Msg( "  %-10s %6d bits  field-at-a-time %8.3f ms  batched %8.3f ms  (%.2fx)  %s%s\n",
+		pName, current.GetNumBitsWritten(), flReferenceMS, flCurrentMS,
+		flCurrentMS > 0.0f ? flReferenceMS / flCurrentMS : 0.0f, bMatch ? "identical" : "MISMATCH", pszRoundTrip );
+}
+
+CON_COMMAND( bitbuf_benchmark, "Compare batched bit buffer writes against field-at-a-time writes. Usage: bitbuf_benchmark [iterations]" )
+{
+	if ( !UTIL_IsCommandIssuedByServerAdmin() )
+		return;
+
+	int nIterations = ( args.ArgC() > 1 ) ? MAX( atoi( args[1] ), 1 ) : 1000;
+
+	// Same data every run so results can be compared between builds
+	static BitBufBenchmarkData_t s_Data;
+	CUniformRandomStream random;
+	random.SetSeed( 0x0b17b0f );
+
+	for ( int i = 0; i < BITBUF_BENCHMARK_VALUES; ++i )
+	{
+		s_Data.m_Values[i] = random.RandomInt( 0, ( 1 << BITBUF_BENCHMARK_VALUE_BITS ) - 1 );
+	}
+	for ( int i = 0; i < BITBUF_BENCHMARK_VECTORS; ++i )
+	{
+		// Mix in exact zeros and whole numbers, which take the short encodings
+		for ( int j = 0; j < 3; ++j )
+		{
+			switch ( random.RandomInt( 0, 3 ) )
+			{
+			case 0:		s_Data.m_Coords[i][j] = 0.0f; break;
+			case 1:		s_Data.m_Coords[i][j] = (float)random.RandomInt( -4096, 4096 ); break;
+			default:	s_Data.m_Coords[i][j] = random.RandomFloat( -MAX_COORD_FLOAT + 1.0f, MAX_COORD_FLOAT - 1.0f ); break;
+			}
+		}
+
+		Vector vecNormal( random.RandomFloat( -1.0f, 1.0f ), random.RandomFloat( -1.0f, 1.0f ), random.RandomFloat( -1.0f, 1.0f ) );
+		VectorNormalize( vecNormal );
+		s_Data.m_Normals[i] = vecNormal;
+	}
+	for ( int i = 0; i < (int)sizeof( s_Data.m_Source ); ++i )
+	{
+		s_Data.m_Source[i] = (byte)random.RandomInt( 0, 255 );
+	}
+
+	Msg( "bitbuf_benchmark: %d iterations\n", nIterations );
+	RunBitBufBenchmark( "values", ReferenceValues, CurrentValues, RoundTripValues, s_Data, nIterations );
+	RunBitBufBenchmark( "coords", ReferenceCoords, CurrentCoords, RoundTripCoords, s_Data, nIterations );
+	RunBitBufBenchmark( "normals", ReferenceNormals, CurrentNormals, RoundTripNormals, s_Data, nIterations );
+	RunBitBufBenchmark( "scalars", ReferenceScalars, CurrentScalars, RoundTripScalars, s_Data, nIterations );
+	RunBitBufBenchmark( "copy", ReferenceCopy, CurrentCopy, NULL, s_Data, nIterations );
+}
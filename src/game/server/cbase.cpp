@@ -86,6 +86,7 @@ OUTPUTS:
 #include "env_debughistory.h"
 
 #include "tier0/vprof.h"
+#include "tickprofiler.h"
 
 // memdbgon must be the last include file in a .cpp file!!!
 #include "tier0/memdbgon.h"
@@ -930,6 +931,7 @@ void CEventQueue::ServiceEvents( void )
 					break;
 
 				// pump the action into the target
+				TICKPROF_SCOPE( TICKPROF_EVENTQUEUE, target->GetClassname() );
 				target->AcceptInput( STRING(pe->m_iTargetInput), pe->m_pActivator, pe->m_pCaller, pe->m_VariantValue, pe->m_iOutputID );
 				targetFound = true;
 			}
@@ -938,6 +940,7 @@ void CEventQueue::ServiceEvents( void )
 		// direct pointer
 		if ( pe->m_pEntTarget != NULL )
 		{
+			TICKPROF_SCOPE( TICKPROF_EVENTQUEUE, pe->m_pEntTarget->GetClassname() );
 			pe->m_pEntTarget->AcceptInput( STRING(pe->m_iTargetInput), pe->m_pActivator, pe->m_pCaller, pe->m_VariantValue, pe->m_iOutputID );
 			targetFound = true;
 		}
@@ -955,6 +958,7 @@ void CEventQueue::ServiceEvents( void )
 						break;
 
 					// pump the action into the target
+					TICKPROF_SCOPE( TICKPROF_EVENTQUEUE, target->GetClassname() );
 					target->AcceptInput( STRING(pe->m_iTargetInput), pe->m_pActivator, pe->m_pCaller, pe->m_VariantValue, pe->m_iOutputID );
 					targetFound = true;
 				}
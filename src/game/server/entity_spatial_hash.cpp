@@ -0,0 +1,448 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Loose grid over the world bounds of the entities in the spatial
+//			partition's PARTITION_ENGINE_NON_STATIC_EDICTS list.
+//
+// Each entity lives in exactly one bucket, chosen by the cell holding the
+// center of its bounds. Entities up to a cell in half-size are stored in the
+// grid; a query looks at the cells covering its bounds grown by one cell.
+// Larger entities (big brush models, mostly) go in a separate list that every
+// query walks. Cells are hashed into a fixed number of buckets, so the grid
+// has no fixed extent.
+//
+//=============================================================================//
+
+#include "cbase.h"
+#include "entity_spatial_hash.h"
+#include "collisionutils.h"
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include "tier0/memdbgon.h"
+
+static ConVar sv_entity_spatial_hash( "sv_entity_spatial_hash", "1", 0, "Answer UTIL_EntitiesInBox/Sphere and FindEntityInSphere from the game's entity grid instead of the engine partition." );
+
+#define SPATIALHASH_CELL_SIZE		256.0f
+#define SPATIALHASH_BUCKET_BITS		12
+#define SPATIALHASH_NUM_BUCKETS		( 1 << SPATIALHASH_BUCKET_BITS )
+#define SPATIALHASH_OVERSIZED		SPATIALHASH_NUM_BUCKETS
+#define SPATIALHASH_NOT_LISTED		-1
+#define SPATIALHASH_INVALID_ENTRY	-1
+
+//-----------------------------------------------------------------------------
+// Purpose: 
+//-----------------------------------------------------------------------------
+class CEntitySpatialHash : public CAutoGameSystem, public IEntitySpatialHash
+{
+public:
+	CEntitySpatialHash() : CAutoGameSystem( "CEntitySpatialHash" )
+	{
+		Clear();
+	}
+
+	// IGameSystem
+	virtual void LevelShutdownPostEntity() { Clear(); }
+
+	// IEntitySpatialHash
+	virtual void SetListed( CBaseEntity *pEntity, bool bListed );
+	virtual void ElementMoved( CBaseEntity *pEntity, const Vector &vecWorldMins, const Vector &vecWorldMaxs );
+	virtual void RemoveElement( CBaseEntity *pEntity );
+	virtual bool IsEnabled() const;
+	virtual int EntitiesInBoxes( int nQueries, const Vector *pMins, const Vector *pMaxs, CUtlVector< unsigned short > &entities, int *pCounts );
+	virtual int EntitiesInSpheres( int nQueries, const Vector *pCenters, const float *pRadii, CUtlVector< unsigned short > &entities, int *pCounts );
+	virtual void MarkEntitiesNearSphere( const Vector &vecCenter, float flRadius );
+	virtual bool IsMarked( CBaseEntity *pEntity ) const;
+
+	struct Entry_t
+	{
+		Vector	m_vecPartitionMins;	// exactly what the partition has
+		Vector	m_vecPartitionMaxs;
+		Vector	m_vecMins;			// also encloses the OBB
+		Vector	m_vecMaxs;
+		int		m_nBucket;			// SPATIALHASH_NOT_LISTED if not in the list
+		short	m_nNext;
+		short	m_nPrev;
+		bool	m_bBoundsKnown;
+	};
+
+private:
+	void Clear();
+	void Link( int nEntry );
+	void Unlink( int nEntry );
+	static int CellCoord( float flCoord );
+	static int BucketForCell( int x, int y );
+	int BucketForEntry( const Entry_t &entry ) const;
+
+	// Calls func( nEntry ) for every entry whose grid bounds might overlap the box,
+	// each exactly once
+	template< class FUNC >
+	void ForEachCandidate( const Vector &vecMins, const Vector &vecMaxs, FUNC &func );
+
+	template< class FUNC >
+	void ForEachInBucket( int nBucket, const Vector &vecMins, const Vector &vecMaxs, FUNC &func );
+
+	Entry_t m_Entries[NUM_ENT_ENTRIES];
+	short m_BucketHead[SPATIALHASH_NUM_BUCKETS + 1];
+
+	// Stops a query visiting a bucket twice when several cells hash to it
+	unsigned int m_BucketVisited[SPATIALHASH_NUM_BUCKETS];
+	unsigned int m_nVisitStamp;
+
+	// MarkEntitiesNearSphere results
+	unsigned int m_EntryMark[NUM_ENT_ENTRIES];
+	unsigned int m_nMarkStamp;
+	Vector m_vecLastMarkCenter;
+	float m_flLastMarkRadius;
+	unsigned int m_nLastMarkModification;
+	unsigned int m_nModificationCount;
+};
+
+static CEntitySpatialHash g_EntitySpatialHash;
+IEntitySpatialHash *g_pEntitySpatialHash = &g_EntitySpatialHash;
+
+
+//-----------------------------------------------------------------------------
+// Purpose: 
+//-----------------------------------------------------------------------------
+void CEntitySpatialHash::Clear()
+{
+	for ( int i = 0; i < NUM_ENT_ENTRIES; i++ )
+	{
+		m_Entries[i].m_nBucket = SPATIALHASH_NOT_LISTED;
+		m_Entries[i].m_nNext = m_Entries[i].m_nPrev = SPATIALHASH_INVALID_ENTRY;
+		m_Entries[i].m_bBoundsKnown = false;
+		m_EntryMark[i] = 0;
+	}
+
+	for ( int i = 0; i <= SPATIALHASH_NUM_BUCKETS; i++ )
+	{
+		m_BucketHead[i] = SPATIALHASH_INVALID_ENTRY;
+	}
+
+	for ( int i = 0; i < SPATIALHASH_NUM_BUCKETS; i++ )
+	{
+		m_BucketVisited[i] = 0;
+	}
+
+	m_nVisitStamp = 0;
+	m_nMarkStamp = 1;
+	m_flLastMarkRadius = -1.0f;
+	m_nLastMarkModification = 0;
+	m_nModificationCount = 1;
+}
+
+bool CEntitySpatialHash::IsEnabled() const
+{
+	return sv_entity_spatial_hash.GetBool() && ThreadInMainThread();
+}
+
+//-----------------------------------------------------------------------------
+// Grid helpers
+//-----------------------------------------------------------------------------
+inline int CEntitySpatialHash::CellCoord( float flCoord )
+{
+	return (int)floor( flCoord * ( 1.0f / SPATIALHASH_CELL_SIZE ) );
+}
+
+inline int CEntitySpatialHash::BucketForCell( int x, int y )
+{
+	return ( ( (unsigned int)x * 73856093u ) ^ ( (unsigned int)y * 19349663u ) ) & ( SPATIALHASH_NUM_BUCKETS - 1 );
+}
+
+int CEntitySpatialHash::BucketForEntry( const Entry_t &entry ) const
+{
+	// Until we know where it is, it could be anywhere
+	if ( !entry.m_bBoundsKnown )
+		return SPATIALHASH_OVERSIZED;
+
+	if ( entry.m_vecMaxs.x - entry.m_vecMins.x > 2.0f * SPATIALHASH_CELL_SIZE ||
+		 entry.m_vecMaxs.y - entry.m_vecMins.y > 2.0f * SPATIALHASH_CELL_SIZE )
+		return SPATIALHASH_OVERSIZED;
+
+	float flCenterX = ( entry.m_vecMins.x + entry.m_vecMaxs.x ) * 0.5f;
+	float flCenterY = ( entry.m_vecMins.y + entry.m_vecMaxs.y ) * 0.5f;
+	return BucketForCell( CellCoord( flCenterX ), CellCoord( flCenterY ) );
+}
+
+void CEntitySpatialHash::Link( int nEntry )
+{
+	Entry_t &entry = m_Entries[nEntry];
+	entry.m_nBucket = BucketForEntry( entry );
+	entry.m_nPrev = SPATIALHASH_INVALID_ENTRY;
+	entry.m_nNext = m_BucketHead[entry.m_nBucket];
+	if ( entry.m_nNext != SPATIALHASH_INVALID_ENTRY )
+	{
+		m_Entries[entry.m_nNext].m_nPrev = nEntry;
+	}
+	m_BucketHead[entry.m_nBucket] = nEntry;
+}
+
+void CEntitySpatialHash::Unlink( int nEntry )
+{
+	Entry_t &entry = m_Entries[nEntry];
+	if ( entry.m_nPrev != SPATIALHASH_INVALID_ENTRY )
+	{
+		m_Entries[entry.m_nPrev].m_nNext = entry.m_nNext;
+	}
+	else
+	{
+		m_BucketHead[entry.m_nBucket] = entry.m_nNext;
+	}
+
+	if ( entry.m_nNext != SPATIALHASH_INVALID_ENTRY )
+	{
+		m_Entries[entry.m_nNext].m_nPrev = entry.m_nPrev;
+	}
+
+	entry.m_nNext = entry.m_nPrev = SPATIALHASH_INVALID_ENTRY;
+	entry.m_nBucket = SPATIALHASH_NOT_LISTED;
+}
+
+//-----------------------------------------------------------------------------
+// Partition bookkeeping
+//-----------------------------------------------------------------------------
+void CEntitySpatialHash::SetListed( CBaseEntity *pEntity, bool bListed )
+{
+	int nEntry = pEntity->GetRefEHandle().GetEntryIndex();
+	bool bWasListed = ( m_Entries[nEntry].m_nBucket != SPATIALHASH_NOT_LISTED );
+	if ( bWasListed == bListed )
+		return;
+
+	if ( bListed )
+	{
+		Link( nEntry );
+	}
+	else
+	{
+		Unlink( nEntry );
+	}
+	++m_nModificationCount;
+}
+
+void CEntitySpatialHash::ElementMoved( CBaseEntity *pEntity, const Vector &vecWorldMins, const Vector &vecWorldMaxs )
+{
+	int nEntry = pEntity->GetRefEHandle().GetEntryIndex();
+	Entry_t &entry = m_Entries[nEntry];
+
+	Vector vecOBBMins, vecOBBMaxs;
+	pEntity->CollisionProp()->WorldSpaceAABB( &vecOBBMins, &vecOBBMaxs );
+
+	entry.m_vecPartitionMins = vecWorldMins;
+	entry.m_vecPartitionMaxs = vecWorldMaxs;
+	entry.m_vecMins = vecWorldMins.Min( vecOBBMins );
+	entry.m_vecMaxs = vecWorldMaxs.Max( vecOBBMaxs );
+	entry.m_bBoundsKnown = true;
+	++m_nModificationCount;
+
+	if ( entry.m_nBucket != SPATIALHASH_NOT_LISTED && entry.m_nBucket != BucketForEntry( entry ) )
+	{
+		Unlink( nEntry );
+		Link( nEntry );
+	}
+}
+
+void CEntitySpatialHash::RemoveElement( CBaseEntity *pEntity )
+{
+	int nEntry = pEntity->GetRefEHandle().GetEntryIndex();
+	if ( m_Entries[nEntry].m_nBucket != SPATIALHASH_NOT_LISTED )
+	{
+		Unlink( nEntry );
+	}
+	m_Entries[nEntry].m_bBoundsKnown = false;
+	++m_nModificationCount;
+}
+
+//-----------------------------------------------------------------------------
+// Candidate gathering
+//-----------------------------------------------------------------------------
+template< class FUNC >
+inline void CEntitySpatialHash::ForEachInBucket( int nBucket, const Vector &vecMins, const Vector &vecMaxs, FUNC &func )
+{
+	for ( int nEntry = m_BucketHead[nBucket]; nEntry != SPATIALHASH_INVALID_ENTRY; nEntry = m_Entries[nEntry].m_nNext )
+	{
+		const Entry_t &entry = m_Entries[nEntry];
+		if ( entry.m_bBoundsKnown && !IsBoxIntersectingBox( entry.m_vecMins, entry.m_vecMaxs, vecMins, vecMaxs ) )
+			continue;
+
+		func( nEntry );
+	}
+}
+
+template< class FUNC >
+void CEntitySpatialHash::ForEachCandidate( const Vector &vecMins, const Vector &vecMaxs, FUNC &func )
+{
+	ForEachInBucket( SPATIALHASH_OVERSIZED, vecMins, vecMaxs, func );
+
+	// Entities are filed by their center, so grow the query by the largest half-size we allow
+	int x0 = CellCoord( vecMins.x - SPATIALHASH_CELL_SIZE );
+	int y0 = CellCoord( vecMins.y - SPATIALHASH_CELL_SIZE );
+	int x1 = CellCoord( vecMaxs.x + SPATIALHASH_CELL_SIZE );
+	int y1 = CellCoord( vecMaxs.y + SPATIALHASH_CELL_SIZE );
+
+	if ( ++m_nVisitStamp == 0 )
+	{
+		V_memset( m_BucketVisited, 0, sizeof( m_BucketVisited ) );
+		m_nVisitStamp = 1;
+	}
+
+	// Huge queries would visit every bucket anyway
+	if ( (int64)( x1 - x0 + 1 ) * (int64)( y1 - y0 + 1 ) >= SPATIALHASH_NUM_BUCKETS )
+	{
+		for ( int nBucket = 0; nBucket < SPATIALHASH_NUM_BUCKETS; ++nBucket )
+		{
+			ForEachInBucket( nBucket, vecMins, vecMaxs, func );
+		}
+		return;
+	}
+
+	for ( int x = x0; x <= x1; ++x )
+	{
+		for ( int y = y0; y <= y1; ++y )
+		{
+			int nBucket = BucketForCell( x, y );
+			if ( m_BucketVisited[nBucket] == m_nVisitStamp )
+				continue;
+
+			m_BucketVisited[nBucket] = m_nVisitStamp;
+			ForEachInBucket( nBucket, vecMins, vecMaxs, func );
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Queries. The tests match what the partition does with its own bounds.
+//-----------------------------------------------------------------------------
+class CSpatialHashBoxQuery
+{
+public:
+	CSpatialHashBoxQuery( const CEntitySpatialHash::Entry_t *pEntries, const Vector &vecMins, const Vector &vecMaxs, CUtlVector< unsigned short > &entities ) :
+		m_pEntries( pEntries ), m_vecMins( vecMins ), m_vecMaxs( vecMaxs ), m_Entities( entities ) {}
+
+	void operator()( int nEntry )
+	{
+		const CEntitySpatialHash::Entry_t &entry = m_pEntries[nEntry];
+		if ( entry.m_bBoundsKnown && IsBoxIntersectingBox( entry.m_vecPartitionMins, entry.m_vecPartitionMaxs, m_vecMins, m_vecMaxs ) )
+		{
+			m_Entities.AddToTail( nEntry );
+		}
+	}
+
+private:
+	const CEntitySpatialHash::Entry_t *m_pEntries;
+	const Vector &m_vecMins;
+	const Vector &m_vecMaxs;
+	CUtlVector< unsigned short > &m_Entities;
+};
+
+class CSpatialHashSphereQuery
+{
+public:
+	CSpatialHashSphereQuery( const CEntitySpatialHash::Entry_t *pEntries, const Vector &vecCenter, float flRadius, CUtlVector< unsigned short > &entities ) :
+		m_pEntries( pEntries ), m_vecCenter( vecCenter ), m_flRadius( flRadius ), m_Entities( entities ) {}
+
+	void operator()( int nEntry )
+	{
+		const CEntitySpatialHash::Entry_t &entry = m_pEntries[nEntry];
+		if ( entry.m_bBoundsKnown && IsBoxIntersectingSphere( entry.m_vecPartitionMins, entry.m_vecPartitionMaxs, m_vecCenter, m_flRadius ) )
+		{
+			m_Entities.AddToTail( nEntry );
+		}
+	}
+
+private:
+	const CEntitySpatialHash::Entry_t *m_pEntries;
+	const Vector &m_vecCenter;
+	float m_flRadius;
+	CUtlVector< unsigned short > &m_Entities;
+};
+
+int CEntitySpatialHash::EntitiesInBoxes( int nQueries, const Vector *pMins, const Vector *pMaxs, CUtlVector< unsigned short > &entities, int *pCounts )
+{
+	Assert( ThreadInMainThread() );
+	UpdateDirtySpatialPartitionEntities();
+
+	int nStart = entities.Count();
+	for ( int i = 0; i < nQueries; ++i )
+	{
+		int nQueryStart = entities.Count();
+		CSpatialHashBoxQuery query( m_Entries, pMins[i], pMaxs[i], entities );
+		ForEachCandidate( pMins[i], pMaxs[i], query );
+		if ( pCounts )
+		{
+			pCounts[i] = entities.Count() - nQueryStart;
+		}
+	}
+
+	return entities.Count() - nStart;
+}
+
+int CEntitySpatialHash::EntitiesInSpheres( int nQueries, const Vector *pCenters, const float *pRadii, CUtlVector< unsigned short > &entities, int *pCounts )
+{
+	Assert( ThreadInMainThread() );
+	UpdateDirtySpatialPartitionEntities();
+
+	int nStart = entities.Count();
+	for ( int i = 0; i < nQueries; ++i )
+	{
+		int nQueryStart = entities.Count();
+		Vector vecExtents( pRadii[i], pRadii[i], pRadii[i] );
+		CSpatialHashSphereQuery query( m_Entries, pCenters[i], pRadii[i], entities );
+		ForEachCandidate( pCenters[i] - vecExtents, pCenters[i] + vecExtents, query );
+		if ( pCounts )
+		{
+			pCounts[i] = entities.Count() - nQueryStart;
+		}
+	}
+
+	return entities.Count() - nStart;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Sphere pre-pass for FindEntityInSphere. Callers usually iterate the
+//			same sphere many times in a row, so the marks are reused until
+//			something in the hash changes.
+//-----------------------------------------------------------------------------
+class CSpatialHashMarker
+{
+public:
+	CSpatialHashMarker( unsigned int *pMarks, unsigned int nStamp ) : m_pMarks( pMarks ), m_nStamp( nStamp ) {}
+	void operator()( int nEntry ) { m_pMarks[nEntry] = m_nStamp; }
+
+private:
+	unsigned int *m_pMarks;
+	unsigned int m_nStamp;
+};
+
+void CEntitySpatialHash::MarkEntitiesNearSphere( const Vector &vecCenter, float flRadius )
+{
+	Assert( ThreadInMainThread() );
+	UpdateDirtySpatialPartitionEntities();
+
+	if ( m_nLastMarkModification == m_nModificationCount && m_flLastMarkRadius == flRadius && m_vecLastMarkCenter == vecCenter )
+		return;
+
+	if ( ++m_nMarkStamp == 0 )
+	{
+		V_memset( m_EntryMark, 0, sizeof( m_EntryMark ) );
+		m_nMarkStamp = 1;
+	}
+
+	Vector vecExtents( flRadius, flRadius, flRadius );
+	CSpatialHashMarker marker( m_EntryMark, m_nMarkStamp );
+	ForEachCandidate( vecCenter - vecExtents, vecCenter + vecExtents, marker );
+
+	m_vecLastMarkCenter = vecCenter;
+	m_flLastMarkRadius = flRadius;
+	m_nLastMarkModification = m_nModificationCount;
+}
+
+bool CEntitySpatialHash::IsMarked( CBaseEntity *pEntity ) const
+{
+	int nEntry = pEntity->GetRefEHandle().GetEntryIndex();
+	const Entry_t &entry = m_Entries[nEntry];
+
+	// Not something we track, so we can't rule it out
+	if ( entry.m_nBucket == SPATIALHASH_NOT_LISTED || !entry.m_bBoundsKnown )
+		return true;
+
+	return m_EntryMark[nEntry] == m_nMarkStamp;
+}
@@ -0,0 +1,61 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Loose grid over the world bounds of every entity in the
+//			PARTITION_ENGINE_NON_STATIC_EDICTS list, for game-side radius and
+//			box queries that don't need the engine's enumerator callbacks.
+//
+// $NoKeywords: $
+//=============================================================================//
+
+#ifndef ENTITY_SPATIAL_HASH_H
+#define ENTITY_SPATIAL_HASH_H
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include "utlvector.h"
+
+class CBaseEntity;
+
+//-----------------------------------------------------------------------------
+// Kept in sync with the spatial partition by CCollisionProperty, so it is
+// updated lazily whenever MarkSurroundingBoundsDirty has been called.
+// Queries return entity indices and must be made from the main thread.
+//-----------------------------------------------------------------------------
+abstract_class IEntitySpatialHash
+{
+public:
+	// Partition bookkeeping
+	virtual void SetListed( CBaseEntity *pEntity, bool bListed ) = 0;
+	virtual void ElementMoved( CBaseEntity *pEntity, const Vector &vecWorldMins, const Vector &vecWorldMaxs ) = 0;
+	virtual void RemoveElement( CBaseEntity *pEntity ) = 0;
+
+	// Returns false if queries should go through the partition instead
+	virtual bool IsEnabled() const = 0;
+
+	// Run a batch of queries. The matching entity indices for all the queries
+	// are appended to entities, in query order, and pCounts[i] receives the
+	// number belonging to query i. Returns the total number appended.
+	virtual int EntitiesInBoxes( int nQueries, const Vector *pMins, const Vector *pMaxs, CUtlVector< unsigned short > &entities, int *pCounts = NULL ) = 0;
+	virtual int EntitiesInSpheres( int nQueries, const Vector *pCenters, const float *pRadii, CUtlVector< unsigned short > &entities, int *pCounts = NULL ) = 0;
+
+	// Single query conveniences
+	int EntitiesInBox( const Vector &vecMins, const Vector &vecMaxs, CUtlVector< unsigned short > &entities )
+	{
+		return EntitiesInBoxes( 1, &vecMins, &vecMaxs, entities );
+	}
+	int EntitiesInSphere( const Vector &vecCenter, float flRadius, CUtlVector< unsigned short > &entities )
+	{
+		return EntitiesInSpheres( 1, &vecCenter, &flRadius, entities );
+	}
+
+	// Marks every entity whose OBB might touch the sphere; anything the hash
+	// doesn't know about counts as possibly touching. Call IsMarked on the
+	// results before a more expensive exact test.
+	virtual void MarkEntitiesNearSphere( const Vector &vecCenter, float flRadius ) = 0;
+	virtual bool IsMarked( CBaseEntity *pEntity ) const = 0;
+};
+
+extern IEntitySpatialHash *g_pEntitySpatialHash;
+
+#endif // ENTITY_SPATIAL_HASH_H
@@ -17,6 +17,7 @@
 #include "ai_initutils.h"
 #include "globalstate.h"
 #include "datacache/imdlcache.h"
+#include "entity_spatial_hash.h"
 
 #ifdef HL2_DLL
 #include "npc_playercompanion.h"
@@ -686,6 +687,14 @@ CBaseEntity *CGlobalEntityList::FindEntityInSphere( CBaseEntity *pStartEntity, c
 {
 	const CEntInfo *pInfo = pStartEntity ? GetEntInfoPtr( pStartEntity->GetRefEHandle() )->m_pNext : FirstEntInfo();
 
+	// Rule out most entities with the spatial hash. The walk still goes in
+	// list order so callers see the same sequence as before.
+	bool bUseSpatialHash = g_pEntitySpatialHash->IsEnabled();
+	if ( bUseSpatialHash )
+	{
+		g_pEntitySpatialHash->MarkEntitiesNearSphere( vecCenter, flRadius );
+	}
+
 	for ( ;pInfo; pInfo = pInfo->m_pNext )
 	{
 		CBaseEntity *ent = (CBaseEntity *)pInfo->m_pEntity;
@@ -698,6 +707,9 @@ CBaseEntity *CGlobalEntityList::FindEntityInSphere( CBaseEntity *pStartEntity, c
 		if ( !ent->edict() )
 			continue;
 
+		if ( bUseSpatialHash && !g_pEntitySpatialHash->IsMarked( ent ) )
+			continue;
+
 		Vector vecRelativeCenter;
 		ent->CollisionProp()->WorldToCollisionSpace( vecCenter, &vecRelativeCenter );
 		if ( !IsBoxIntersectingSphere( ent->CollisionProp()->OBBMins(),	ent->CollisionProp()->OBBMaxs(), vecRelativeCenter, flRadius ) )
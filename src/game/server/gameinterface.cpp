@@ -89,6 +89,9 @@
 #include "tier3/tier3.h"
 #include "serverbenchmark_base.h"
 #include "querycache.h"
+#include "tickprofiler.h"
+#include "transmitcache.h"
+#include "usermessagebatch.h"
 
 
 #ifdef TF_DLL
@@ -1207,6 +1210,8 @@ void CServerGameDLL::GameFrame( bool simulating )
 
 	float oldframetime = gpGlobals->frametime;
 
+	TickProfiler_BeginTick();
+
 #ifdef _DEBUG
 	// For profiling.. let them enable/disable the networkvar manual mode stuff.
 	g_bUseNetworkVars = s_UseNetworkVars.GetBool();
@@ -1279,6 +1284,8 @@ void CServerGameDLL::GameFrame( bool simulating )
 	g_NetworkPropertyEventMgr.FireEvents();
 
 	gpGlobals->frametime = oldframetime;
+
+	TickProfiler_EndTick();
 }
 
 //-----------------------------------------------------------------------------
@@ -1287,8 +1294,14 @@ void CServerGameDLL::GameFrame( bool simulating )
 //-----------------------------------------------------------------------------
 void CServerGameDLL::PreClientUpdate( bool simulating )
 {
+	// Client updates for this frame happen after this
+	g_TransmitCache.NewFrame();
+
 	if ( !simulating )
+	{
+		g_UserMessageBatch.Flush();
 		return;
+	}
 
 	/*
 	if (game_speeds.GetInt())
@@ -1303,6 +1316,9 @@ void CServerGameDLL::PreClientUpdate( bool simulating )
 	
 	IGameSystem::PreClientUpdateAllSystems();
 
+	// Everything held back this tick goes out with this frame's client updates
+	g_UserMessageBatch.Flush();
+
 #ifdef _DEBUG
 	if ( sv_showhitboxes.GetInt() == -1 )
 		return;
@@ -1386,6 +1402,8 @@ void CServerGameDLL::LevelShutdown( void )
 
 	InvalidateQueryCache();
 
+	g_UserMessageBatch.Clear();
+
 	IGameSystem::LevelShutdownPostEntityAllSystems();
 
 	// In case we quit out during initial load
@@ -2448,6 +2466,16 @@ inline void CServerNetworkProperty::CheckTransmit( CCheckTransmitInfo *pInfo )
 	}
 } */
 
+// Brings the edict's PVS information up to date only if it has changed
+static inline const EdictTransmitState_t &GetEdictTransmitState( edict_t *pEdict, int iEdict )
+{
+	if ( pEdict->m_fStateFlags & FL_EDICT_DIRTY_PVS_INFORMATION )
+	{
+		static_cast<CServerNetworkProperty*>( pEdict->GetNetworkable() )->RecomputePVSInformation();
+	}
+	return g_EdictTransmitState[iEdict];
+}
+
 void CServerGameEnts::CheckTransmit( CCheckTransmitInfo *pInfo, const unsigned short *pEdictIndices, int nEdicts )
 {
 	// NOTE: for speed's sake, this assumes that all networkables are CBaseEntities and that the edict list
@@ -2476,6 +2504,23 @@ void CServerGameEnts::CheckTransmit( CCheckTransmitInfo *pInfo, const unsigned s
 		    bIsReplay == ( pInfo->m_pTransmitAlways != NULL) );
 #endif
 
+	// Everything that doesn't depend on who's receiving is worked out once
+	// per frame: always-sent edicts go straight into the transmit bits, and
+	// PVS tests are shared by clients that see the same PVS.
+	CTransmitVisibility *pVisibility = NULL;
+	CShouldTransmitCache shouldTransmitCache;
+	const CTransmitEdictList *pEdictList = NULL;
+	if ( g_TransmitCache.IsEnabled() )
+	{
+		// Always-sent edicts are merged in after the loop, so edicts that are also
+		// forced down by an always-sent child still get their own SetTransmit()
+		pEdictList = g_TransmitCache.GetEdictList( pEdictIndices, nEdicts );
+		pEdictIndices = pEdictList->m_Check.Base();
+		nEdicts = pEdictList->m_Check.Count();
+
+		pVisibility = g_TransmitCache.GetVisibility( pInfo );
+	}
+
 	for ( int i=0; i < nEdicts; i++ )
 	{
 		int iEdict = pEdictIndices[i];
@@ -2507,16 +2552,9 @@ void CServerGameEnts::CheckTransmit( CCheckTransmitInfo *pInfo, const unsigned s
 					pInfo->m_pTransmitAlways->Set( iEdict );
 				}
 #endif	
-				CServerNetworkProperty *pEnt = static_cast<CServerNetworkProperty*>( pEdict->GetNetworkable() );
-				if ( !pEnt )
-					break;
-
-				CServerNetworkProperty *pParent = pEnt->GetNetworkParent();
-				if ( !pParent )
+				iEdict = g_EdictTransmitState[iEdict].m_iParent;
+				if ( iEdict == EDICT_TRANSMIT_NO_PARENT )
 					break;
-
-				pEdict = pParent->edict();
-				iEdict = pParent->entindex();
 			}
 			continue;
 		}
@@ -2528,7 +2566,7 @@ void CServerGameEnts::CheckTransmit( CCheckTransmitInfo *pInfo, const unsigned s
 		if ( nFlags == FL_EDICT_FULLCHECK )
 		{
 			// do a full ShouldTransmit() check, may return FL_EDICT_CHECKPVS
-			nFlags = pEnt->ShouldTransmit( pInfo );
+			nFlags = shouldTransmitCache.ShouldTransmit( pEnt, iEdict, pInfo );
 
 			Assert( !(nFlags & FL_EDICT_FULLCHECK) );
 
@@ -2543,13 +2581,13 @@ void CServerGameEnts::CheckTransmit( CCheckTransmitInfo *pInfo, const unsigned s
 		if ( !( nFlags & FL_EDICT_PVSCHECK ) )
 			continue;
 
-		CServerNetworkProperty *netProp = static_cast<CServerNetworkProperty*>( pEdict->GetNetworkable() );
+		const EdictTransmitState_t &transmitState = GetEdictTransmitState( pEdict, iEdict );
 
 #ifndef _X360
 		if ( bIsHLTV || bIsReplay )
 		{
 			// for the HLTV/Replay we don't cull against PVS
-			if ( netProp->AreaNum() == skyBoxArea )
+			if ( transmitState.m_nAreaNum == skyBoxArea )
 			{
 				pEnt->SetTransmit( pInfo, true );
 			}
@@ -2562,15 +2600,15 @@ void CServerGameEnts::CheckTransmit( CCheckTransmitInfo *pInfo, const unsigned s
 #endif
 
 		// Always send entities in the player's 3d skybox.
-		// Sidenote: call of AreaNum() ensures that PVS data is up to date for this entity
-		bool bSameAreaAsSky = netProp->AreaNum() == skyBoxArea;
+		// Sidenote: GetEdictTransmitState() ensures that PVS data is up to date for this entity
+		bool bSameAreaAsSky = transmitState.m_nAreaNum == skyBoxArea;
 		if ( bSameAreaAsSky )
 		{
 			pEnt->SetTransmit( pInfo, true );
 			continue;
 		}
 
-		bool bInPVS = netProp->IsInPVS( pInfo );
+		bool bInPVS = pVisibility ? pVisibility->IsInPVS( iEdict, pInfo ) : CServerNetworkProperty::IsEdictInPVS( iEdict, pInfo );
 		if ( bInPVS || sv_force_transmit_ents.GetBool() )
 		{
 			// only send if entity is in PVS
@@ -2581,22 +2619,20 @@ void CServerGameEnts::CheckTransmit( CCheckTransmitInfo *pInfo, const unsigned s
 		// If the entity is marked "check PVS" but it's in hierarchy, walk up the hierarchy looking for the
 		//  for any parent which is also in the PVS.  If none are found, then we don't need to worry about sending ourself
 		CBaseEntity *orig = pEnt;
-		CServerNetworkProperty *check = netProp->GetNetworkParent();
+		int checkIndex = transmitState.m_iParent;
 
 		// BUG BUG:  I think it might be better to build up a list of edict indices which "depend" on other answers and then
 		// resolve them in a second pass.  Not sure what happens if an entity has two parents who both request PVS check?
-        while ( check )
+        while ( checkIndex != EDICT_TRANSMIT_NO_PARENT )
 		{
-			int checkIndex = check->entindex();
-
 			// Parent already being sent
-			if ( pInfo->m_pTransmitEdict->Get( checkIndex ) )
+			if ( pInfo->m_pTransmitEdict->Get( checkIndex ) || ( pEdictList && pEdictList->m_Always.IsBitSet( checkIndex ) ) )
 			{
 				orig->SetTransmit( pInfo, true );
 				break;
 			}
 
-			edict_t *checkEdict = check->edict();
+			edict_t *checkEdict = &pBaseEdict[checkIndex];
 			int checkFlags = checkEdict->m_fStateFlags & (FL_EDICT_DONTSEND|FL_EDICT_ALWAYS|FL_EDICT_PVSCHECK|FL_EDICT_FULLCHECK);
 			if ( checkFlags & FL_EDICT_DONTSEND )
 				break;
@@ -2610,8 +2646,8 @@ void CServerGameEnts::CheckTransmit( CCheckTransmitInfo *pInfo, const unsigned s
 			if ( checkFlags == FL_EDICT_FULLCHECK )
 			{
 				// do a full ShouldTransmit() check, may return FL_EDICT_CHECKPVS
-				CBaseEntity *pCheckEntity = check->GetBaseEntity();
-				nFlags = pCheckEntity->ShouldTransmit( pInfo );
+				CBaseEntity *pCheckEntity = ( CBaseEntity * )checkEdict->GetUnknown();
+				nFlags = shouldTransmitCache.ShouldTransmit( pCheckEntity, checkIndex, pInfo );
 				Assert( !(nFlags & FL_EDICT_FULLCHECK) );
 				if ( nFlags & FL_EDICT_ALWAYS )
 				{
@@ -2624,8 +2660,8 @@ void CServerGameEnts::CheckTransmit( CCheckTransmitInfo *pInfo, const unsigned s
 			if ( checkFlags & FL_EDICT_PVSCHECK )
 			{
 				// Check pvs
-				check->RecomputePVSInformation();
-				bool bMoveParentInPVS = check->IsInPVS( pInfo );
+				GetEdictTransmitState( checkEdict, checkIndex );
+				bool bMoveParentInPVS = pVisibility ? pVisibility->IsInPVS( checkIndex, pInfo ) : CServerNetworkProperty::IsEdictInPVS( checkIndex, pInfo );
 				if ( bMoveParentInPVS )
 				{
 					orig->SetTransmit( pInfo, true );
@@ -2634,10 +2670,21 @@ void CServerGameEnts::CheckTransmit( CCheckTransmitInfo *pInfo, const unsigned s
 			}
 
 			// Continue up chain just in case the parent itself has a parent that's in the PVS...
-			check = check->GetNetworkParent();
+			checkIndex = g_EdictTransmitState[checkIndex].m_iParent;
 		}
 	}
 
+	if ( pEdictList )
+	{
+		MergeTransmitBits( pInfo->m_pTransmitEdict, pEdictList->m_Always );
+#ifndef _X360
+		if ( bIsHLTV || bIsReplay )
+		{
+			MergeTransmitBits( pInfo->m_pTransmitAlways, pEdictList->m_Always );
+		}
+#endif
+	}
+
 //	Msg("A:%i, N:%i, F: %i, P: %i\n", always, dontSend, fullCheck, PVS );
 }
 
@@ -2789,6 +2836,9 @@ void CServerGameClients::ClientDisconnect( edict_t *pEdict )
 			}
 		#endif
 	}
+
+	// Whoever takes the slot next shouldn't get what was meant for this client
+	g_UserMessageBatch.RemoveRecipient( ENTINDEX( pEdict ) );
 }
 
 void CServerGameClients::ClientPutInServer( edict_t *pEntity, const char *playername )
@@ -3244,6 +3294,7 @@ void CServerGameClients::ClientCommandKeyValues( edict_t *pEntity, KeyValues *pK
 // Purpose: 
 //-----------------------------------------------------------------------------
 static bf_write *g_pMsgBuffer = NULL;
+static bool g_bMsgBatched = false;
 
 void EntityMessageBegin( CBaseEntity * entity, bool reliable /*= false*/ ) 
 {
@@ -3251,6 +3302,9 @@ void EntityMessageBegin( CBaseEntity * entity, bool reliable /*= false*/ )
 
 	Assert ( entity );
 
+	// Held back user messages go first, so they aren't overtaken
+	g_UserMessageBatch.Flush();
+
 	g_pMsgBuffer = engine->EntityMessageBegin( entity->entindex(), entity->GetServerClass(), reliable );
 }
 
@@ -3267,16 +3321,29 @@ void UserMessageBegin( IRecipientFilter& filter, const char *messagename )
 		Error( "UserMessageBegin:  Unregistered message '%s'\n", messagename );
 	}
 
-	g_pMsgBuffer = engine->UserMessageBegin( &filter, msg_type );
+	g_pMsgBuffer = g_UserMessageBatch.Begin( filter, msg_type );
+	g_bMsgBatched = ( g_pMsgBuffer != NULL );
+	if ( !g_bMsgBatched )
+	{
+		g_pMsgBuffer = engine->UserMessageBegin( &filter, msg_type );
+	}
 }
 
 void MessageEnd( void )
 {
 	Assert( g_pMsgBuffer );
 
-	engine->MessageEnd();
+	if ( g_bMsgBatched )
+	{
+		g_UserMessageBatch.End();
+	}
+	else
+	{
+		engine->MessageEnd();
+	}
 
 	g_pMsgBuffer = NULL;
+	g_bMsgBatched = false;
 }
 
 void MessageWriteByte( int iValue)
@@ -58,15 +58,15 @@ CTEHL2MPFireBullets::~CTEHL2MPFireBullets( void )
 }
 
 IMPLEMENT_SERVERCLASS_ST_NOBASE(CTEHL2MPFireBullets, DT_TEHL2MPFireBullets)
-	SendPropVector( SENDINFO(m_vecOrigin), -1, SPROP_COORD ),
-	SendPropVector( SENDINFO(m_vecDir), -1 ),
-	SendPropInt( SENDINFO( m_iAmmoID ), 5, SPROP_UNSIGNED ),
-	SendPropInt( SENDINFO( m_iSeed ), NUM_BULLET_SEED_BITS, SPROP_UNSIGNED ),
-	SendPropInt( SENDINFO( m_iShots ), 5, SPROP_UNSIGNED ),
-	SendPropInt( SENDINFO( m_iPlayer ), 6, SPROP_UNSIGNED ), 	// max 64 players, see MAX_PLAYERS
+	SendPropAuto( SENDINFO_AUTO(m_vecOrigin), -1, SPROP_COORD ),
+	SendPropAuto( SENDINFO_AUTO(m_vecDir), -1 ),
+	SendPropAuto( SENDINFO_AUTO( m_iAmmoID ), 5, SPROP_UNSIGNED ),
+	SendPropAuto( SENDINFO_AUTO( m_iSeed ), NUM_BULLET_SEED_BITS, SPROP_UNSIGNED ),
+	SendPropAuto( SENDINFO_AUTO( m_iShots ), 5, SPROP_UNSIGNED ),
+	SendPropAuto( SENDINFO_AUTO( m_iPlayer ), 6, SPROP_UNSIGNED ), 	// max 64 players, see MAX_PLAYERS
 	SendPropFloat( SENDINFO( m_flSpread ), 10, 0, 0, 1 ),	
-	SendPropBool( SENDINFO( m_bDoImpacts ) ),
-	SendPropBool( SENDINFO( m_bDoTracers ) ),
+	SendPropAuto( SENDINFO_AUTO( m_bDoImpacts ) ),
+	SendPropAuto( SENDINFO_AUTO( m_bDoTracers ) ),
 END_SEND_TABLE()
 
 
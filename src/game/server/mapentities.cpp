@@ -19,6 +19,8 @@
 
 #include "entities/CWorld.h"
 #include "tools/NWCEdit.h"
+#include "tier0/fasttimer.h"
+#include "vstdlib/jobthread.h"
 
 // memdbgon must be the last include file in a .cpp file!!!
 #include "tier0/memdbgon.h"
@@ -30,9 +32,113 @@ struct HierarchicalSpawnMapData_t
 	int			m_iMapDataLength;
 };
 
+//-----------------------------------------------------------------------------
+// An entity block from the map data whose keys have been tokenized ahead of
+// entity creation. Once parsed, a block is never modified.
+//-----------------------------------------------------------------------------
+struct MapEntityParseBlock_t
+{
+	const char	*m_pEntData;		// first character after the opening brace
+	const char	*m_pKeysEnd;		// where a text parse of the keys stops (CEntityMapData::CurrentBufferPosition)
+	CUtlVector< MapEntityKeyValue_t > m_KeyValues;
+	CUtlVector< char > m_StringData;
+};
+
+//-----------------------------------------------------------------------------
+// Per-class spawn timing, gathered while parsing the map entities
+//-----------------------------------------------------------------------------
+struct EntitySpawnTiming_t
+{
+	int		m_nCount;
+	double	m_flTotalMS;
+	double	m_flMaxMS;
+};
+
+static ConVar sv_parallel_entity_parse( "sv_parallel_entity_parse", "1", 0, "Tokenize the map entity keyvalues on worker threads before entities are created." );
+static ConVar sv_entity_spawn_timings( "sv_entity_spawn_timings", "0", 0, "If non-zero, report the N slowest entity classes to spawn after the map entities are created." );
+
 static CStringRegistry *g_pClassnameSpawnPriority = NULL;
+static CUtlDict< EntitySpawnTiming_t, int > g_EntitySpawnTimings;
+static bool g_bRecordSpawnTimings = false;
 extern edict_t *g_pForceAttachEdict;
 
+static void RecordSpawnTime( const char *pszClassname, const CFastTimer &timer )
+{
+	int i = g_EntitySpawnTimings.Find( pszClassname );
+	if ( i == g_EntitySpawnTimings.InvalidIndex() )
+	{
+		i = g_EntitySpawnTimings.Insert( pszClassname );
+		g_EntitySpawnTimings[i].m_nCount = 0;
+		g_EntitySpawnTimings[i].m_flTotalMS = 0.0;
+		g_EntitySpawnTimings[i].m_flMaxMS = 0.0;
+	}
+
+	EntitySpawnTiming_t &timing = g_EntitySpawnTimings[i];
+	double flMS = timer.GetDuration().GetMillisecondsF();
+	timing.m_nCount++;
+	timing.m_flTotalMS += flMS;
+	timing.m_flMaxMS = MAX( timing.m_flMaxMS, flMS );
+}
+
+//-----------------------------------------------------------------------------
+// DispatchSpawn, with the time spent attributed to the entity's class
+//-----------------------------------------------------------------------------
+static int MapEntity_DispatchSpawn( CBaseEntity *pEntity )
+{
+	if ( !g_bRecordSpawnTimings )
+		return DispatchSpawn( pEntity );
+
+	// Grab this first, the entity may be gone if the spawn fails
+	const char *pszClassname = pEntity->GetClassname();
+
+	CFastTimer timer;
+	timer.Start();
+	int nResult = DispatchSpawn( pEntity );
+	timer.End();
+
+	RecordSpawnTime( pszClassname, timer );
+	return nResult;
+}
+
+static int __cdecl SpawnTimingLessFunc( const int *pLeft, const int *pRight )
+{
+	double flLeft = g_EntitySpawnTimings[*pLeft].m_flTotalMS;
+	double flRight = g_EntitySpawnTimings[*pRight].m_flTotalMS;
+	if ( flLeft == flRight )
+		return 0;
+	return ( flLeft > flRight ) ? -1 : 1;
+}
+
+static void ReportEntitySpawnTimings( int nMaxClasses )
+{
+	CUtlVector< int > sorted( 0, g_EntitySpawnTimings.Count() );
+	double flTotalMS = 0.0;
+	for ( int i = g_EntitySpawnTimings.First(); i != g_EntitySpawnTimings.InvalidIndex(); i = g_EntitySpawnTimings.Next( i ) )
+	{
+		sorted.AddToTail( i );
+		flTotalMS += g_EntitySpawnTimings[i].m_flTotalMS;
+	}
+	sorted.Sort( SpawnTimingLessFunc );
+
+	Msg( "Entity spawn times (%d classes, %.2f ms total):\n", sorted.Count(), flTotalMS );
+	Msg( "  %-40s %6s %10s %10s %10s\n", "class", "count", "total ms", "avg ms", "max ms" );
+	for ( int i = 0; i < sorted.Count() && i < nMaxClasses; i++ )
+	{
+		const EntitySpawnTiming_t &timing = g_EntitySpawnTimings[ sorted[i] ];
+		Msg( "  %-40s %6d %10.3f %10.3f %10.3f\n", g_EntitySpawnTimings.GetElementName( sorted[i] ), 
+			timing.m_nCount, timing.m_flTotalMS, timing.m_flTotalMS / timing.m_nCount, timing.m_flMaxMS );
+	}
+}
+
+CON_COMMAND( dump_entity_spawn_timings, "Report the per-class spawn times recorded during the last map load (requires sv_entity_spawn_timings)." )
+{
+	if ( !UTIL_IsCommandIssuedByServerAdmin() )
+		return;
+
+	int nMaxClasses = ( args.ArgC() > 1 ) ? atoi( args[1] ) : INT_MAX;
+	ReportEntitySpawnTimings( nMaxClasses );
+}
+
 // creates an entity by string name, but does not spawn it
 CBaseEntity *CreateEntityByName( const char *className, int iForceEdictIndex )
 {
@@ -268,7 +374,7 @@ void SpawnAllEntities( int nEntities, HierarchicalSpawn_t *pSpawnList, bool bAct
 		}
 		if ( pEntity )
 		{
-			if (DispatchSpawn(pEntity) < 0)
+			if (MapEntity_DispatchSpawn(pEntity) < 0)
 			{
 				for ( int i = nEntity+1; i < nEntities; i++ )
 				{
@@ -305,34 +411,180 @@ void SpawnAllEntities( int nEntities, HierarchicalSpawn_t *pSpawnList, bool bAct
 }
 
 //-----------------------------------------------------------------------------
-// Purpose: Only called on BSP load. Parses and spawns all the entities in the BSP.
-// Input  : pMapData - Pointer to the entity data block to parse.
+// Purpose: Steps over one token exactly as MapEntity_ParseToken would, without
+//			copying it out. Returns NULL at the end of the data.
+// Input  : pFirstChar - Receives the first character of the token.
+//			pLength - Receives the length of the token.
 //-----------------------------------------------------------------------------
-void MapEntity_ParseAllEntities(const char *pMapData, IMapEntityFilter *pFilter, bool bActivateEntities)
+static inline bool IsMapEntityBraceChar( int c )
 {
-	VPROF("MapEntity_ParseAllEntities");
+	return ( c == '{' || c == '}' || c == '(' || c == ')' || c == '\'' );
+}
 
-	HierarchicalSpawnMapData_t *pSpawnMapData = new HierarchicalSpawnMapData_t[NUM_ENT_ENTRIES];
-	HierarchicalSpawn_t *pSpawnList = new HierarchicalSpawn_t[NUM_ENT_ENTRIES];
+static const char *MapEntity_SkipToken( const char *data, char *pFirstChar, int *pLength )
+{
+	int c;
+	*pFirstChar = 0;
+	*pLength = 0;
 
-	CUtlVector< CPointTemplate* > pPointTemplates;
-	int nEntities = 0;
+	if ( !data )
+		return NULL;
 
-	char szTokenBuffer[MAPKEY_MAXLENGTH];
+// skip whitespace
+skipwhite:
+	while ( (c = *data) <= ' ')
+	{
+		if (c == 0)
+			return NULL;
+		data++;
+	}
 
-	// Allow the tools to spawn different things
-	if ( serverenginetools )
+// skip // comments
+	if (c=='/' && data[1] == '/')
 	{
-		pMapData = serverenginetools->GetEntityData( pMapData );
+		while (*data && *data != '\n')
+			data++;
+		goto skipwhite;
+	}
+
+// quoted strings
+	if (c == '\"')
+	{
+		const char *pStart = ++data;
+		while ( *data && *data != '\"' )
+			data++;
+
+		*pFirstChar = *pStart;
+		*pLength = data - pStart;
+		return *data ? data + 1 : data;
+	}
+
+// single characters
+	*pFirstChar = c;
+	if ( IsMapEntityBraceChar( c ) )
+	{
+		*pLength = 1;
+		return data+1;
+	}
+
+// regular word
+	const char *pStart = data;
+	do
+	{
+		data++;
+		c = *data;
+		if ( IsMapEntityBraceChar( c ) )
+			break;
+	} while (c>32);
+
+	*pLength = data - pStart;
+	return data;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Finds where CEntityMapData::GetNextKey would stop reading the keys
+//			of the entity block, and where the next entity starts.
+// Output : Returns the position after the entity's closing brace, or NULL at
+//			the end of the data.
+//-----------------------------------------------------------------------------
+static const char *MapEntity_FindBlockEnd( const char *pEntData, const char **ppKeysEnd )
+{
+	char chFirst;
+	int nLength;
+
+	const char *pKeysEnd = pEntData;
+	for (;;)
+	{
+		const char *pData = MapEntity_SkipToken( pKeysEnd, &chFirst, &nLength );
+		if ( chFirst == '}' )
+			break;
+
+		if ( pData )
+		{
+			pData = MapEntity_SkipToken( pData, &chFirst, &nLength );
+		}
+
+		pKeysEnd = pData;
+		if ( !pData || chFirst == '}' )
+			break;
+	}
+
+	*ppKeysEnd = pKeysEnd;
+
+	// Same as MapEntity_SkipToNextEntity
+	int openBraceCount = 1;
+	const char *pMapData = pKeysEnd;
+	while ( pMapData != NULL )
+	{
+		pMapData = MapEntity_SkipToken( pMapData, &chFirst, &nLength );
+		if ( nLength != 1 )
+			continue;
+
+		if ( chFirst == '{' )
+		{
+			openBraceCount++;
+		}
+		else if ( chFirst == '}' && --openBraceCount == 0 )
+		{
+			return pMapData;
+		}
+	}
+
+	return NULL;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Tokenizes the keys of one entity block. Runs on worker threads, so
+//			it must not touch anything but the block.
+//-----------------------------------------------------------------------------
+static void MapEntity_ParseBlock( MapEntityParseBlock_t &block )
+{
+	char keyName[MAPKEY_MAXLENGTH];
+	char value[MAPKEY_MAXLENGTH];
+
+	// Offsets into the string data, fixed up to pointers once it's stopped growing
+	CUtlVector< int > offsets;
+
+	CEntityMapData entData( (char*)block.m_pEntData );
+	if ( entData.GetFirstKey( keyName, value ) )
+	{
+		do
+		{
+			int nKeyLength = Q_strlen( keyName ) + 1;
+			int nValueLength = Q_strlen( value ) + 1;
+			offsets.AddToTail( block.m_StringData.AddMultipleToTail( nKeyLength, keyName ) );
+			offsets.AddToTail( block.m_StringData.AddMultipleToTail( nValueLength, value ) );
+		}
+		while ( entData.GetNextKey( keyName, value ) );
+	}
+
+	Assert( entData.CurrentBufferPosition() == block.m_pKeysEnd );
+
+	const char *pStrings = block.m_StringData.Base();
+	block.m_KeyValues.SetCount( offsets.Count() / 2 );
+	for ( int i = 0; i < block.m_KeyValues.Count(); i++ )
+	{
+		block.m_KeyValues[i].m_pszKey = pStrings + offsets[ i * 2 ];
+		block.m_KeyValues[i].m_pszValue = pStrings + offsets[ i * 2 + 1 ];
 	}
+}
 
-	//  Loop through all entities in the map data, creating each.
-	for ( ; true; pMapData = MapEntity_SkipToNextEntity(pMapData, szTokenBuffer) )
+//-----------------------------------------------------------------------------
+// Purpose: Splits the map data into entity blocks and tokenizes them, in
+//			parallel if allowed.
+//-----------------------------------------------------------------------------
+static void MapEntity_ParseAllBlocks( const char *pMapData, CUtlVector< MapEntityParseBlock_t > &blocks )
+{
+	VPROF( "MapEntity_ParseAllEntities_Tokenize" );
+
+	char token[MAPKEY_MAXLENGTH];
+
+	//  Loop through all entities in the map data, finding the extent of each.
+	while ( pMapData )
 	{
 		//
 		// Parse the opening brace.
 		//
-		char token[MAPKEY_MAXLENGTH];
 		pMapData = MapEntity_ParseToken( pMapData, token );
 
 		//
@@ -347,12 +599,62 @@ void MapEntity_ParseAllEntities(const char *pMapData, IMapEntityFilter *pFilter,
 			continue;
 		}
 
+		MapEntityParseBlock_t &block = blocks[ blocks.AddToTail() ];
+		block.m_pEntData = pMapData;
+		pMapData = MapEntity_FindBlockEnd( pMapData, &block.m_pKeysEnd );
+	}
+
+	// MapEntity_ParseToken has built its tables by now, so the workers can share it
+	ParallelProcess( "MapEntity_ParseAllEntities", blocks.Base(), blocks.Count(), &MapEntity_ParseBlock, 
+		NULL, NULL, sv_parallel_entity_parse.GetBool() ? INT_MAX : 0 );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Only called on BSP load. Parses and spawns all the entities in the BSP.
+// Input  : pMapData - Pointer to the entity data block to parse.
+//-----------------------------------------------------------------------------
+void MapEntity_ParseAllEntities(const char *pMapData, IMapEntityFilter *pFilter, bool bActivateEntities)
+{
+	VPROF("MapEntity_ParseAllEntities");
+
+	HierarchicalSpawnMapData_t *pSpawnMapData = new HierarchicalSpawnMapData_t[NUM_ENT_ENTRIES];
+	HierarchicalSpawn_t *pSpawnList = new HierarchicalSpawn_t[NUM_ENT_ENTRIES];
+
+	CUtlVector< CPointTemplate* > pPointTemplates;
+	int nEntities = 0;
+
+	int nReportSpawnTimings = sv_entity_spawn_timings.GetInt();
+	g_bRecordSpawnTimings = ( nReportSpawnTimings > 0 );
+	g_EntitySpawnTimings.Purge();
+
+	CFastTimer parseTimer, createTimer, spawnTimer;
+
+	// Allow the tools to spawn different things
+	if ( serverenginetools )
+	{
+		pMapData = serverenginetools->GetEntityData( pMapData );
+	}
+
+	// Stage one: tokenize every entity's keys up front
+	parseTimer.Start();
+	CUtlVector< MapEntityParseBlock_t > blocks;
+	MapEntity_ParseAllBlocks( pMapData, blocks );
+	parseTimer.End();
+
+	// Stage two: create and spawn serially, in map order
+	createTimer.Start();
+	for ( int iBlock = 0; iBlock < blocks.Count(); iBlock++ )
+	{
 		//
-		// Parse the entity and add it to the spawn list.
+		// Create the entity and add it to the spawn list.
 		//
 		CBaseEntity *pEntity;
-		const char *pCurMapData = pMapData;
-		pMapData = MapEntity_ParseEntity(pEntity, pMapData, pFilter);
+		const MapEntityParseBlock_t &block = blocks[iBlock];
+		const char *pCurMapData = block.m_pEntData;
+		pMapData = block.m_pKeysEnd;
+
+		CEntityMapData entData( (char*)pCurMapData, block.m_KeyValues.Base(), block.m_KeyValues.Count(), (char*)block.m_pKeysEnd );
+		MapEntity_CreateEntity( pEntity, &entData, pFilter );
 		if (pEntity == NULL)
 			continue;
 
@@ -376,7 +678,7 @@ void MapEntity_ParseAllEntities(const char *pMapData, IMapEntityFilter *pFilter,
 
 			pEntity->m_iParent = NULL_STRING;	// don't allow a parent on the first entity (worldspawn)
 
-			DispatchSpawn(pEntity);
+			MapEntity_DispatchSpawn(pEntity);
 			continue;
 		}
 				
@@ -393,7 +695,17 @@ void MapEntity_ParseAllEntities(const char *pMapData, IMapEntityFilter *pFilter,
 			// NOTE: Nodes spawn other entities (ai_hint) if they need to have a persistent presence.
 			//		 To ensure keys are copied over into the new entity, we pass the mapdata into the
 			//		 node spawn function.
-			if ( pNode->Spawn( pCurMapData ) < 0 )
+			const char *pszClassname = pNode->GetClassname();
+			CFastTimer nodeTimer;
+			nodeTimer.Start();
+			int nResult = pNode->Spawn( pCurMapData );
+			nodeTimer.End();
+			if ( g_bRecordSpawnTimings )
+			{
+				RecordSpawnTime( pszClassname, nodeTimer );
+			}
+
+			if ( nResult < 0 )
 			{
 				gEntList.CleanupDeleteList();
 			}
@@ -408,7 +720,7 @@ void MapEntity_ParseAllEntities(const char *pMapData, IMapEntityFilter *pFilter,
 			// Nodes & Lights remove themselves immediately on Spawn(), so dispatch their
 			// spawn now, to free up the slot inside this loop.
 			// NOTE: This solution prevents nodes & lights from being used inside point_templates.
-			if (DispatchSpawn(pEntity) < 0)
+			if (MapEntity_DispatchSpawn(pEntity) < 0)
 			{
 				gEntList.CleanupDeleteList();
 			}
@@ -434,7 +746,9 @@ void MapEntity_ParseAllEntities(const char *pMapData, IMapEntityFilter *pFilter,
 			nEntities++;
 		}
 	}
+	createTimer.End();
 
+	spawnTimer.Start();
 	// Now loop through all our point_template entities and tell them to make templates of everything they're pointing to
 	int iTemplates = pPointTemplates.Count();
 	for ( int i = 0; i < iTemplates; i++ )
@@ -443,7 +757,7 @@ void MapEntity_ParseAllEntities(const char *pMapData, IMapEntityFilter *pFilter,
 		CPointTemplate *pPointTemplate = pPointTemplates[i];
 
 		// First, tell the Point template to Spawn
-		if ( DispatchSpawn(pPointTemplate) < 0 )
+		if ( MapEntity_DispatchSpawn(pPointTemplate) < 0 )
 		{
 			UTIL_Remove(pPointTemplate);
 			gEntList.CleanupDeleteList();
@@ -483,6 +797,15 @@ void MapEntity_ParseAllEntities(const char *pMapData, IMapEntityFilter *pFilter,
 	}
 
 	SpawnHierarchicalList( nEntities, pSpawnList, bActivateEntities );
+	spawnTimer.End();
+
+	if ( g_bRecordSpawnTimings )
+	{
+		Msg( "MapEntity_ParseAllEntities: %d entity blocks, tokenize %.2f ms, create %.2f ms, spawn %.2f ms\n", blocks.Count(),
+			parseTimer.GetDuration().GetMillisecondsF(), createTimer.GetDuration().GetMillisecondsF(), spawnTimer.GetDuration().GetMillisecondsF() );
+		ReportEntitySpawnTimings( nReportSpawnTimings );
+		g_bRecordSpawnTimings = false;
+	}
 
 	delete [] pSpawnMapData;
 	delete [] pSpawnList;
@@ -541,17 +864,15 @@ void MapEntity_PrecacheEntity( const char *pEntData, int &nStringSize )
 }
 
 //-----------------------------------------------------------------------------
-// Purpose: Takes a block of character data as the input
+// Purpose: Creates the entity described by the map data and applies its keys
 // Input  : pEntity - Receives the newly constructed entity, NULL on failure.
-//			pEntData - Data block to parse to extract entity keys.
-// Output : Returns the current position in the entity data block.
+//			pEntData - Keys of the entity.
 //-----------------------------------------------------------------------------
-const char *MapEntity_ParseEntity(CBaseEntity *&pEntity, const char *pEntData, IMapEntityFilter *pFilter)
+void MapEntity_CreateEntity( CBaseEntity *&pEntity, CEntityMapData *pEntData, IMapEntityFilter *pFilter )
 {
-	CEntityMapData entData( (char*)pEntData );
 	char className[MAPKEY_MAXLENGTH];
 	
-	if (!entData.ExtractValue("classname", className))
+	if (!pEntData->ExtractValue("classname", className))
 	{
 		Error( "classname missing from entity!\n" );
 	}
@@ -572,7 +893,7 @@ const char *MapEntity_ParseEntity(CBaseEntity *&pEntity, const char *pEntData, I
 		//
 		if (pEntity != NULL)
 		{
-			pEntity->ParseMapData(&entData);
+			pEntity->ParseMapData(pEntData);
 		}
 		else
 		{
@@ -584,19 +905,29 @@ const char *MapEntity_ParseEntity(CBaseEntity *&pEntity, const char *pEntData, I
 		// Just skip past all the keys.
 		char keyName[MAPKEY_MAXLENGTH];
 		char value[MAPKEY_MAXLENGTH];
-		if ( entData.GetFirstKey(keyName, value) )
+		if ( pEntData->GetFirstKey(keyName, value) )
 		{
 			do 
 			{
 			} 
-			while ( entData.GetNextKey(keyName, value) );
+			while ( pEntData->GetNextKey(keyName, value) );
 		}
 	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Takes a block of character data as the input
+// Input  : pEntity - Receives the newly constructed entity, NULL on failure.
+//			pEntData - Data block to parse to extract entity keys.
+// Output : Returns the current position in the entity data block.
+//-----------------------------------------------------------------------------
+const char *MapEntity_ParseEntity(CBaseEntity *&pEntity, const char *pEntData, IMapEntityFilter *pFilter)
+{
+	CEntityMapData entData( (char*)pEntData );
+	MapEntity_CreateEntity( pEntity, &entData, pFilter );
 
 	//
 	// Return the current parser position in the data block
 	//
 	return entData.CurrentBufferPosition();
 }
-
-
@@ -0,0 +1,521 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Records a player's movement input and replays it through
+//			gamemovement on its own, to time movement changes and to check
+//			that they leave the player in exactly the same place.
+//
+// $NoKeywords: $
+//=============================================================================//
+
+#include "cbase.h"
+#include "player.h"
+#include "igamemovement.h"
+#include "imovehelper.h"
+#include "movehelper_server.h"
+#include "filesystem.h"
+#include "tier0/fasttimer.h"
+#include "tier1/utlbuffer.h"
+
+#if defined( HL2_DLL )
+#include "hl2_player.h"
+#include "hl_movedata.h"
+#endif
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include "tier0/memdbgon.h"
+
+extern IGameMovement *g_pGameMovement;
+extern CMoveData *g_pMoveData;
+extern IPhysicsSurfaceProps *physprops;
+
+// The movement code casts to the game's CMoveData, so that's what gets recorded
+#if defined( HL2_DLL )
+typedef CHLMoveData CRecordedMoveData;
+#else
+typedef CMoveData CRecordedMoveData;
+#endif
+
+#define MOVEMENT_RECORDING_VERSION	1
+#define MOVEMENT_RECORDING_DIR		"movement"
+
+//-----------------------------------------------------------------------------
+// One usercmd, as it was handed to ProcessMovement
+//-----------------------------------------------------------------------------
+struct RecordedMove_t
+{
+	CRecordedMoveData	m_Move;
+	float				m_flCurTime;
+	float				m_flFrameTime;
+	int					m_nTickBase;
+};
+
+//-----------------------------------------------------------------------------
+// Everything gamemovement reads from or writes to the player outside of
+// CMoveData. Written to recordings as is, so it only holds plain data.
+//-----------------------------------------------------------------------------
+struct MovementState_t
+{
+	Vector	m_vecOrigin;
+	Vector	m_vecVelocity;
+	Vector	m_vecViewOffset;
+	int		m_fFlags;
+	int		m_iGroundEntity;		// -1 for none
+	int		m_nWaterLevel;
+	int		m_nWaterType;
+	int		m_MoveType;
+	int		m_MoveCollide;
+	float	m_flMaxspeed;
+	int		m_nTickBase;
+
+	bool	m_bDucked;
+	bool	m_bDucking;
+	bool	m_bInDuckJump;
+	float	m_flDucktime;
+	float	m_flDuckJumpTime;
+	float	m_flJumpTime;
+	float	m_flFallVelocity;
+	int		m_nOldButtons;
+	QAngle	m_vecPunchAngle;
+	QAngle	m_vecPunchAngleVel;
+
+	float	m_flWaterJumpTime;
+	Vector	m_vecWaterJumpVel;
+	float	m_flStepSoundTime;
+	float	m_flSwimSoundTime;
+	float	m_surfaceFriction;
+	int		m_surfaceProps;
+	char	m_chTextureType;
+	char	m_chPreviousTextureType;
+	int		m_StuckLast;
+	Vector	m_vecLadderNormal;
+};
+
+//-----------------------------------------------------------------------------
+// Stands in for the server's move helper during replays, so that replayed
+// moves don't hurt the player, touch entities or make sounds.
+//-----------------------------------------------------------------------------
+class CReplayMoveHelper : public IMoveHelper
+{
+public:
+	void Install()		{ m_pServerHelper = MoveHelper(); SetSingleton( this ); }
+	void Uninstall()	{ SetSingleton( m_pServerHelper ); }
+
+	virtual	char const*		GetName( EntityHandle_t handle ) const	{ return m_pServerHelper->GetName( handle ); }
+	virtual void	ResetTouchList( void )	{}
+	virtual bool	AddToTouched( const CGameTrace& tr, const Vector& impactvelocity )	{ return false; }
+	virtual void	ProcessImpacts( void )	{}
+	virtual void	Con_NPrintf( int idx, char const* fmt, ... )	{}
+	virtual void	StartSound( const Vector& origin, int channel, char const* sample, float volume, soundlevel_t soundlevel, int fFlags, int pitch )	{}
+	virtual void	StartSound( const Vector& origin, const char *soundname )	{}
+	virtual void	PlaybackEventFull( int flags, int clientindex, unsigned short eventindex, float delay, Vector& origin, Vector& angles, float fparam1, float fparam2, int iparam1, int iparam2, int bparam1, int bparam2 )	{}
+	virtual bool	PlayerFallingDamage( void )	{ return true; }
+	virtual void	PlayerSetAnimation( PLAYER_ANIM playerAnim )	{}
+	virtual IPhysicsSurfaceProps *GetSurfaceProps( void )	{ return physprops; }
+	virtual bool	IsWorldEntity( const CBaseHandle &handle )	{ return m_pServerHelper->IsWorldEntity( handle ); }
+
+private:
+	IMoveHelper		*m_pServerHelper;
+};
+
+static CReplayMoveHelper s_ReplayMoveHelper;
+
+//-----------------------------------------------------------------------------
+// Purpose: A recorded stream of moves and the state the player started in
+//-----------------------------------------------------------------------------
+class CMovementReplay
+{
+public:
+	CMovementReplay() { m_bRecording = false; }
+
+	void StartRecording( CBasePlayer *pPlayer );
+	void StopRecording();
+	bool IsRecording() const	{ return m_bRecording; }
+	void RecordMove( CBasePlayer *pPlayer, const CMoveData *pMove );
+
+	int Count() const			{ return m_Moves.Count(); }
+
+	// Runs every move from the start state. pResults gets the origin and velocity after each.
+	void Replay( CBasePlayer *pPlayer, Vector *pResults ) const;
+
+	bool Save( const char *pFilename ) const;
+	bool Load( const char *pFilename );
+
+	static void SaveState( CBasePlayer *pPlayer, MovementState_t *pState );
+	static void RestoreState( CBasePlayer *pPlayer, const MovementState_t &state );
+
+private:
+	bool						m_bRecording;
+	CHandle< CBasePlayer >		m_hPlayer;
+	MovementState_t				m_StartState;
+	CUtlVector< RecordedMove_t >	m_Moves;
+};
+
+static CMovementReplay s_MovementReplay;
+
+void CMovementReplay::StartRecording( CBasePlayer *pPlayer )
+{
+	m_bRecording = true;
+	m_hPlayer = pPlayer;
+	m_Moves.RemoveAll();
+}
+
+void CMovementReplay::StopRecording()
+{
+	m_bRecording = false;
+	m_hPlayer = NULL;
+}
+
+void CMovementReplay::RecordMove( CBasePlayer *pPlayer, const CMoveData *pMove )
+{
+	if ( m_hPlayer.Get() != pPlayer )
+		return;
+
+	if ( !m_Moves.Count() )
+	{
+		// Ladder attachment isn't part of the saved state, so start off of one
+		if ( pPlayer->GetMoveType() == MOVETYPE_LADDER )
+			return;
+
+		SaveState( pPlayer, &m_StartState );
+	}
+
+	RecordedMove_t &move = m_Moves[ m_Moves.AddToTail() ];
+	move.m_Move = *static_cast< const CRecordedMoveData * >( pMove );
+	move.m_flCurTime = gpGlobals->curtime;
+	move.m_flFrameTime = gpGlobals->frametime;
+	move.m_nTickBase = pPlayer->m_nTickBase;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Does what CPlayerMove::RunCommand does around ProcessMovement, and
+//			nothing else, so only the movement code is being measured.
+//-----------------------------------------------------------------------------
+void CMovementReplay::Replay( CBasePlayer *pPlayer, Vector *pResults ) const
+{
+	RestoreState( pPlayer, m_StartState );
+
+	for ( int i = 0; i < m_Moves.Count(); ++i )
+	{
+		const RecordedMove_t &recorded = m_Moves[i];
+
+		CRecordedMoveData move = recorded.m_Move;
+		move.m_nPlayerHandle = pPlayer;
+		move.m_bFirstRunOfFunctions = false;
+		move.SetAbsOrigin( pPlayer->GetAbsOrigin() );
+		move.m_vecVelocity = pPlayer->GetAbsVelocity();
+		move.m_nOldButtons = pPlayer->m_Local.m_nOldButtons;
+
+		gpGlobals->curtime = recorded.m_flCurTime;
+		gpGlobals->frametime = recorded.m_flFrameTime;
+		pPlayer->m_nTickBase = recorded.m_nTickBase;
+
+		g_pGameMovement->StartTrackPredictionErrors( pPlayer );
+		g_pGameMovement->ProcessMovement( pPlayer, &move );
+		g_pGameMovement->FinishTrackPredictionErrors( pPlayer );
+
+		pPlayer->SetAbsOrigin( move.GetAbsOrigin() );
+		pPlayer->SetAbsVelocity( move.m_vecVelocity );
+		pPlayer->m_Local.m_nOldButtons = move.m_nButtons;
+
+		if ( pResults )
+		{
+			pResults[ i * 2 ] = move.GetAbsOrigin();
+			pResults[ i * 2 + 1 ] = move.m_vecVelocity;
+		}
+	}
+}
+
+void CMovementReplay::SaveState( CBasePlayer *pPlayer, MovementState_t *pState )
+{
+	V_memset( pState, 0, sizeof( *pState ) );
+
+	pState->m_vecOrigin = pPlayer->GetAbsOrigin();
+	pState->m_vecVelocity = pPlayer->GetAbsVelocity();
+	pState->m_vecViewOffset = pPlayer->GetViewOffset();
+	pState->m_fFlags = pPlayer->GetFlags();
+	pState->m_iGroundEntity = pPlayer->GetGroundEntity() ? pPlayer->GetGroundEntity()->entindex() : -1;
+	pState->m_nWaterLevel = pPlayer->GetWaterLevel();
+	pState->m_nWaterType = pPlayer->GetWaterType();
+	pState->m_MoveType = pPlayer->GetMoveType();
+	pState->m_MoveCollide = pPlayer->GetMoveCollide();
+	pState->m_flMaxspeed = pPlayer->m_flMaxspeed;
+	pState->m_nTickBase = pPlayer->m_nTickBase;
+
+	pState->m_bDucked = pPlayer->m_Local.m_bDucked;
+	pState->m_bDucking = pPlayer->m_Local.m_bDucking;
+	pState->m_bInDuckJump = pPlayer->m_Local.m_bInDuckJump;
+	pState->m_flDucktime = pPlayer->m_Local.m_flDucktime;
+	pState->m_flDuckJumpTime = pPlayer->m_Local.m_flDuckJumpTime;
+	pState->m_flJumpTime = pPlayer->m_Local.m_flJumpTime;
+	pState->m_flFallVelocity = pPlayer->m_Local.m_flFallVelocity;
+	pState->m_nOldButtons = pPlayer->m_Local.m_nOldButtons;
+	pState->m_vecPunchAngle = pPlayer->m_Local.m_vecPunchAngle;
+	pState->m_vecPunchAngleVel = pPlayer->m_Local.m_vecPunchAngleVel;
+
+	pState->m_flWaterJumpTime = pPlayer->m_flWaterJumpTime;
+	pState->m_vecWaterJumpVel = pPlayer->m_vecWaterJumpVel;
+	pState->m_flStepSoundTime = pPlayer->m_flStepSoundTime;
+	pState->m_flSwimSoundTime = pPlayer->m_flSwimSoundTime;
+	pState->m_surfaceFriction = pPlayer->m_surfaceFriction;
+	pState->m_surfaceProps = pPlayer->m_surfaceProps;
+	pState->m_chTextureType = pPlayer->m_chTextureType;
+	pState->m_chPreviousTextureType = pPlayer->m_chPreviousTextureType;
+	pState->m_StuckLast = pPlayer->m_StuckLast;
+	pState->m_vecLadderNormal = pPlayer->m_vecLadderNormal;
+}
+
+void CMovementReplay::RestoreState( CBasePlayer *pPlayer, const MovementState_t &state )
+{
+#if defined( HL2_DLL )
+	// Let go of any ladder an earlier replay climbed onto
+	CHL2_Player *pHL2Player = dynamic_cast< CHL2_Player * >( pPlayer );
+	if ( pHL2Player )
+	{
+		pHL2Player->ExitLadder();
+		pHL2Player->GetLadderMove()->m_bForceLadderMove = false;
+	}
+#endif
+
+	pPlayer->SetAbsOrigin( state.m_vecOrigin );
+	pPlayer->SetAbsVelocity( state.m_vecVelocity );
+	pPlayer->SetViewOffset( state.m_vecViewOffset );
+	pPlayer->ClearFlags();
+	pPlayer->AddFlag( state.m_fFlags );
+	pPlayer->SetGroundEntity( state.m_iGroundEntity >= 0 ? CBaseEntity::Instance( state.m_iGroundEntity ) : NULL );
+	pPlayer->SetWaterLevel( state.m_nWaterLevel );
+	pPlayer->SetWaterType( state.m_nWaterType );
+	pPlayer->SetMoveType( (MoveType_t)state.m_MoveType, (MoveCollide_t)state.m_MoveCollide );
+	pPlayer->m_flMaxspeed = state.m_flMaxspeed;
+	pPlayer->m_nTickBase = state.m_nTickBase;
+
+	pPlayer->m_Local.m_bDucked = state.m_bDucked;
+	pPlayer->m_Local.m_bDucking = state.m_bDucking;
+	pPlayer->m_Local.m_bInDuckJump = state.m_bInDuckJump;
+	pPlayer->m_Local.m_flDucktime = state.m_flDucktime;
+	pPlayer->m_Local.m_flDuckJumpTime = state.m_flDuckJumpTime;
+	pPlayer->m_Local.m_flJumpTime = state.m_flJumpTime;
+	pPlayer->m_Local.m_flFallVelocity = state.m_flFallVelocity;
+	pPlayer->m_Local.m_nOldButtons = state.m_nOldButtons;
+	pPlayer->m_Local.m_vecPunchAngle = state.m_vecPunchAngle;
+	pPlayer->m_Local.m_vecPunchAngleVel = state.m_vecPunchAngleVel;
+
+	pPlayer->m_flWaterJumpTime = state.m_flWaterJumpTime;
+	pPlayer->m_vecWaterJumpVel = state.m_vecWaterJumpVel;
+	pPlayer->m_flStepSoundTime = state.m_flStepSoundTime;
+	pPlayer->m_flSwimSoundTime = state.m_flSwimSoundTime;
+	pPlayer->m_surfaceFriction = state.m_surfaceFriction;
+	pPlayer->m_surfaceProps = state.m_surfaceProps;
+	pPlayer->m_pSurfaceData = physprops->GetSurfaceData( state.m_surfaceProps );
+	pPlayer->m_chTextureType = state.m_chTextureType;
+	pPlayer->m_chPreviousTextureType = state.m_chPreviousTextureType;
+	pPlayer->m_StuckLast = state.m_StuckLast;
+	pPlayer->m_vecLadderNormal = state.m_vecLadderNormal;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Recordings are only good for the build and map they were made on
+//-----------------------------------------------------------------------------
+bool CMovementReplay::Save( const char *pFilename ) const
+{
+	CUtlBuffer buf;
+	buf.PutInt( MOVEMENT_RECORDING_VERSION );
+	buf.PutInt( sizeof( MovementState_t ) );
+	buf.PutInt( sizeof( RecordedMove_t ) );
+	buf.PutString( STRING( gpGlobals->mapname ) );
+	buf.PutInt( m_Moves.Count() );
+	buf.Put( &m_StartState, sizeof( m_StartState ) );
+	buf.Put( m_Moves.Base(), m_Moves.Count() * sizeof( RecordedMove_t ) );
+
+	filesystem->CreateDirHierarchy( MOVEMENT_RECORDING_DIR, "MOD" );
+	return filesystem->WriteFile( pFilename, "MOD", buf );
+}
+
+bool CMovementReplay::Load( const char *pFilename )
+{
+	CUtlBuffer buf;
+	if ( !filesystem->ReadFile( pFilename, "MOD", buf ) )
+	{
+		Warning( "Couldn't read %s\n", pFilename );
+		return false;
+	}
+
+	if ( buf.GetInt() != MOVEMENT_RECORDING_VERSION || buf.GetInt() != (int)sizeof( MovementState_t ) ||
+		buf.GetInt() != (int)sizeof( RecordedMove_t ) )
+	{
+		Warning( "%s was recorded by a different build\n", pFilename );
+		return false;
+	}
+
+	char szMapName[MAX_PATH];
+	buf.GetString( szMapName );
+	if ( V_stricmp( szMapName, STRING( gpGlobals->mapname ) ) )
+	{
+		Warning( "%s was recorded on %s\n", pFilename, szMapName );
+		return false;
+	}
+
+	int nMoves = buf.GetInt();
+	if ( nMoves < 0 || buf.GetBytesRemaining() != (int)( sizeof( MovementState_t ) + nMoves * sizeof( RecordedMove_t ) ) )
+	{
+		Warning( "%s is truncated\n", pFilename );
+		return false;
+	}
+
+	StopRecording();
+	buf.Get( &m_StartState, sizeof( m_StartState ) );
+	m_Moves.SetCount( nMoves );
+	buf.Get( m_Moves.Base(), nMoves * sizeof( RecordedMove_t ) );
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Called by CPlayerMove::RunCommand right before ProcessMovement
+//-----------------------------------------------------------------------------
+void MovementReplay_RecordMove( CBasePlayer *pPlayer, const CMoveData *pMove )
+{
+	if ( s_MovementReplay.IsRecording() )
+	{
+		s_MovementReplay.RecordMove( pPlayer, pMove );
+	}
+}
+
+static CBasePlayer *GetMovementReplayPlayer()
+{
+	CBasePlayer *pPlayer = UTIL_GetCommandClient();
+	if ( !pPlayer )
+	{
+		// From the dedicated server console
+		pPlayer = UTIL_PlayerByIndex( 1 );
+	}
+	return pPlayer;
+}
+
+static void GetMovementRecordingFilename( const char *pName, char *pFilename, int nFilenameSize )
+{
+	V_snprintf( pFilename, nFilenameSize, "%s/%s", MOVEMENT_RECORDING_DIR, pName );
+	V_DefaultExtension( pFilename, ".mvr", nFilenameSize );
+	V_FixSlashes( pFilename );
+}
+
+CON_COMMAND( movement_record_start, "Start recording your movement for movement_benchmark." )
+{
+	if ( !UTIL_IsCommandIssuedByServerAdmin() )
+		return;
+
+	CBasePlayer *pPlayer = GetMovementReplayPlayer();
+	if ( !pPlayer )
+		return;
+
+	s_MovementReplay.StartRecording( pPlayer );
+	Msg( "Recording movement for %s\n", pPlayer->GetPlayerName() );
+}
+
+CON_COMMAND( movement_record_stop, "Stop recording movement." )
+{
+	if ( !UTIL_IsCommandIssuedByServerAdmin() )
+		return;
+
+	s_MovementReplay.StopRecording();
+	Msg( "Recorded %d moves\n", s_MovementReplay.Count() );
+}
+
+CON_COMMAND( movement_record_save, "Save the movement recording. Usage: movement_record_save <name>" )
+{
+	if ( !UTIL_IsCommandIssuedByServerAdmin() || args.ArgC() < 2 )
+		return;
+
+	char szFilename[MAX_PATH];
+	GetMovementRecordingFilename( args[1], szFilename, sizeof( szFilename ) );
+	if ( s_MovementReplay.Save( szFilename ) )
+	{
+		Msg( "Saved %d moves to %s\n", s_MovementReplay.Count(), szFilename );
+	}
+}
+
+CON_COMMAND( movement_record_load, "Load a movement recording saved on this map. Usage: movement_record_load <name>" )
+{
+	if ( !UTIL_IsCommandIssuedByServerAdmin() || args.ArgC() < 2 )
+		return;
+
+	char szFilename[MAX_PATH];
+	GetMovementRecordingFilename( args[1], szFilename, sizeof( szFilename ) );
+	if ( s_MovementReplay.Load( szFilename ) )
+	{
+		Msg( "Loaded %d moves from %s\n", s_MovementReplay.Count(), szFilename );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Replays the recording with the convar off and on, timing both and
+//			checking every move ends up bit for bit the same
+//-----------------------------------------------------------------------------
+CON_COMMAND( movement_benchmark, "Replay the movement recording with a convar off and on. Usage: movement_benchmark [iterations] [convar, default sv_movement_tracelist]" )
+{
+	if ( !UTIL_IsCommandIssuedByServerAdmin() )
+		return;
+
+	CBasePlayer *pPlayer = GetMovementReplayPlayer();
+	if ( !pPlayer || !pPlayer->IsAlive() || pPlayer->IsInAVehicle() )
+	{
+		Msg( "movement_benchmark needs a living player on foot\n" );
+		return;
+	}
+
+	int nMoves = s_MovementReplay.Count();
+	if ( !nMoves || s_MovementReplay.IsRecording() )
+	{
+		Msg( "Record movement with movement_record_start/movement_record_stop first\n" );
+		return;
+	}
+
+	int nIterations = ( args.ArgC() > 1 ) ? MAX( atoi( args[1] ), 1 ) : 100;
+	ConVarRef optimization( ( args.ArgC() > 2 ) ? args[2] : "sv_movement_tracelist" );
+	if ( !optimization.IsValid() )
+	{
+		Msg( "No convar named %s\n", args[2] );
+		return;
+	}
+
+	// Put everything back the way the game left it afterwards
+	MovementState_t liveState;
+	CMovementReplay::SaveState( pPlayer, &liveState );
+	float flSaveCurTime = gpGlobals->curtime;
+	float flSaveFrameTime = gpGlobals->frametime;
+	int nSaveOptimization = optimization.GetInt();
+	s_ReplayMoveHelper.Install();
+
+	CUtlVector< Vector > reference, results;
+	reference.SetCount( nMoves * 2 );
+	results.SetCount( nMoves * 2 );
+
+	Msg( "movement_benchmark: %d moves, %d iterations\n", nMoves, nIterations );
+
+	CFastTimer timer;
+	for ( int nValue = 0; nValue <= 1; ++nValue )
+	{
+		optimization.SetValue( nValue );
+
+		// The first pass with the convar off is what everything else has to match
+		Vector *pFirstResults = nValue ? results.Base() : reference.Base();
+		s_MovementReplay.Replay( pPlayer, pFirstResults );
+		bool bMatch = !V_memcmp( reference.Base(), pFirstResults, nMoves * 2 * sizeof( Vector ) );
+
+		timer.Start();
+		for ( int i = 0; i < nIterations; ++i )
+		{
+			s_MovementReplay.Replay( pPlayer, results.Base() );
+			bMatch = bMatch && !V_memcmp( reference.Base(), results.Base(), nMoves * 2 * sizeof( Vector ) );
+		}
+		timer.End();
+
+		float flMS = timer.GetDuration().GetMillisecondsF();
+		Msg( "  %s %d: %8.3f ms  %10.0f moves/sec  %s\n", optimization.GetName(), nValue, flMS,
+			flMS > 0.0f ? ( nMoves * nIterations ) / ( flMS * 0.001f ) : 0.0f, bMatch ? "identical" : "MISMATCH" );
+	}
+
+	optimization.SetValue( nSaveOptimization );
+	s_ReplayMoveHelper.Uninstall();
+	CMovementReplay::RestoreState( pPlayer, liveState );
+	gpGlobals->curtime = flSaveCurTime;
+	gpGlobals->frametime = flSaveFrameTime;
+}
@@ -56,6 +56,7 @@ const float CliffHeight = 300.0f;				// height which we consider a significant c
 
 
 #define NAV_MAGIC_NUMBER 0xFEEDFACE				// to help identify nav files
+#define NAV_MAX_AREA_ID 0x000FFFFF				// area IDs index a lookup table directly, so they are kept below this
 
 /**
  * A place is a named group of navigation areas
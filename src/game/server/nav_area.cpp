@@ -44,8 +44,8 @@ unsigned int CNavArea::m_nextID = 1;
 NavAreaVector TheNavAreas;
 
 unsigned int CNavArea::m_masterMarker = 1;
-CNavArea *CNavArea::m_openList = NULL;
-CNavArea *CNavArea::m_openListTail = NULL;
+CUtlVector< CNavArea::OpenEntry > CNavArea::m_openList;
+unsigned int CNavArea::m_openListOrder = 0;
 
 bool CNavArea::m_isReset = false;
 uint32 CNavArea::s_nCurrVisTestCounter = 0;
@@ -161,12 +161,15 @@ void CNavArea::CompressIDs( void )
 {
 	m_nextID = 1;
 
+	// every slot of the ID lookup is about to be reassigned - clear it so none keep an area under its old ID
+	TheNavMesh->m_areasByID.RemoveAll();
+
 	FOR_EACH_VEC( TheNavAreas, id )
 	{
 		CNavArea *area = TheNavAreas[id];
 		area->m_id = m_nextID++;
 
-		// remove and re-add the area from the nav mesh to update the hashed ID
+		// remove and re-add the area from the nav mesh to update the ID lookup
 		TheNavMesh->RemoveNavArea( area );
 		TheNavMesh->AddNavArea( area );
 	}
@@ -183,6 +186,7 @@ CNavArea::CNavArea( void )
 	m_nearNavSearchMarker = 0;
 	m_damagingTickCount = 0;
 	m_openMarker = 0;
+	m_openIndex = -1;
 
 	m_parent = NULL;
 	m_parentHow = GO_NORTH;
@@ -216,9 +220,6 @@ CNavArea::CNavArea( void )
 	m_id = m_nextID++;
 	m_debugid = 0;
 
-	m_prevHash = NULL;
-	m_nextHash = NULL;
-
 	m_isBattlefront = false;
 
 	for( i = 0; i<NUM_DIRECTIONS; ++i )
@@ -936,6 +937,8 @@ void CNavArea::FinishMerge( CNavArea *adjArea )
 		m_invDxCorners = m_invDyCorners = 0;
 	}
 
+	TheNavMesh->m_gridIndex.Invalidate();
+
 	// reassign the adjacent area's internal nodes to the final area
 	adjArea->AssignNodes( this );
 
@@ -1761,6 +1764,8 @@ bool CNavArea::MergeEdit( CNavArea *adj )
 		m_invDxCorners = m_invDyCorners = 0;
 	}
 
+	TheNavMesh->m_gridIndex.Invalidate();
+
 	if (m_seCorner.x > originalSECorner.x || m_nwCorner.y < originalNWCorner.y)
 		m_neZ = adj->GetZ( m_seCorner.x, m_nwCorner.y );
 	else
@@ -3359,12 +3364,11 @@ void CNavArea::DrawConnectedAreas( void ) const
 
 //--------------------------------------------------------------------------------------------------------------
 /**
- * Add to open list in decreasing value order
+ * Add to open list in increasing cost order. Areas with equal costs come off the list in the
+ * order they were added, as they did when the open list was a sorted linked list.
  */
 void CNavArea::AddToOpenList( void )
 {
-	Assert( (m_openList && m_openList->m_prevOpen == NULL) || m_openList == NULL );
-
 	if ( IsOpen() )
 	{
 		// already on list
@@ -3374,56 +3378,13 @@ void CNavArea::AddToOpenList( void )
 	// mark as being on open list for quick check
 	m_openMarker = m_masterMarker;
 
-	// if list is empty, add and return
-	if ( m_openList == NULL )
-	{
-		m_openList = this;
-		m_openListTail = this;
-		this->m_prevOpen = NULL;
-		this->m_nextOpen = NULL;
-		return;
-	}
+	m_openIndex = m_openList.AddToTail();
+	OpenEntry &entry = m_openList[ m_openIndex ];
+	entry.cost = GetTotalCost();
+	entry.order = m_openListOrder++;
+	entry.area = this;
 
-	// insert self in ascending cost order
-	CNavArea *area, *last = NULL;
-	for( area = m_openList; area; area = area->m_nextOpen )
-	{
-		if ( GetTotalCost() < area->GetTotalCost() )
-		{
-			break;
-		}
-		last = area;
-	}
-
-	if ( area )
-	{
-		// insert before this area
-		this->m_prevOpen = area->m_prevOpen;
-
-		if ( this->m_prevOpen )
-		{
-			this->m_prevOpen->m_nextOpen = this;
-		}
-		else
-		{
-			m_openList = this;
-		}
-
-		this->m_nextOpen = area;
-		area->m_prevOpen = this;
-	}
-	else
-	{
-		// append to end of list
-		last->m_nextOpen = this;
-		this->m_prevOpen = last;
-	
-		this->m_nextOpen = NULL;
-
-		m_openListTail = this;
-	}
-
-	Assert( (m_openList && m_openList->m_prevOpen == NULL) || m_openList == NULL );
+	SiftUpOpenList( m_openIndex );
 }
 
 
@@ -3433,8 +3394,6 @@ void CNavArea::AddToOpenList( void )
  */
 void CNavArea::AddToOpenListTail( void )
 {
-	Assert( (m_openList && m_openList->m_prevOpen == NULL) || m_openList == NULL );
-
 	if ( IsOpen() )
 	{
 		// already on list
@@ -3444,99 +3403,63 @@ void CNavArea::AddToOpenListTail( void )
 	// mark as being on open list for quick check
 	m_openMarker = m_masterMarker;
 
-	// if list is empty, add and return
-	if ( m_openList == NULL )
-	{
-		m_openList = this;
-		m_openListTail = this;
-		this->m_prevOpen = NULL;
-		this->m_nextOpen = NULL;
-
-		Assert( (m_openList && m_openList->m_prevOpen == NULL) || m_openList == NULL );
-		return;
-	}
-
-	// append to end of list
-	m_openListTail->m_nextOpen = this;
-
-	this->m_prevOpen = m_openListTail;
-	this->m_nextOpen = NULL;
-
-	m_openListTail = this;
-
-	Assert( (m_openList && m_openList->m_prevOpen == NULL) || m_openList == NULL );
+	// the open list is a heap - going after everything that has a cost is as close to the tail as it gets
+	m_openIndex = m_openList.AddToTail();
+	OpenEntry &entry = m_openList[ m_openIndex ];
+	entry.cost = FLT_MAX;
+	entry.order = m_openListOrder++;
+	entry.area = this;
 }
 
 //--------------------------------------------------------------------------------------------------------------
 /**
  * A smaller value has been found, update this area on the open list
- * @todo "bubbling" does unnecessary work, since the order of all other nodes will be unchanged - only this node is altered
  */
 void CNavArea::UpdateOnOpenList( void )
 {
-	// since value can only decrease, bubble this area up from current spot
-	while( m_prevOpen && this->GetTotalCost() < m_prevOpen->GetTotalCost() )
-	{
-		// swap position with predecessor
-		CNavArea *other = m_prevOpen;
-		CNavArea *before = other->m_prevOpen;
-		CNavArea *after  = this->m_nextOpen;
-
-		this->m_nextOpen = other;
-		this->m_prevOpen = before;
-
-		other->m_prevOpen = this;
-		other->m_nextOpen = after;
-
-		if ( before )
-		{
-			before->m_nextOpen = this;
-		}
-		else
-		{
-			m_openList = this;
-		}
+	if ( !IsOpen() )
+		return;
 
-		if ( after )
-		{
-			after->m_prevOpen = other;
-		}
-		else
-		{
-			m_openListTail = this;
-		}
+	// since value can only decrease, move this area up from its current spot. Like the
+	// old sorted list, it only passes areas that cost strictly more, so it ends up after
+	// every area of equal cost - the same place it would go if it were added now.
+	OpenEntry &entry = m_openList[ m_openIndex ];
+	if ( GetTotalCost() < entry.cost )
+	{
+		entry.cost = GetTotalCost();
+		entry.order = m_openListOrder++;
+		SiftUpOpenList( m_openIndex );
 	}
 }
 
 //--------------------------------------------------------------------------------------------------------------
 void CNavArea::RemoveFromOpenList( void )
 {
-	if ( m_openMarker == 0 )
+	if ( !IsOpen() )
 	{
 		// not on the list
 		return;
 	}
 
-	if ( m_prevOpen )
-	{
-		m_prevOpen->m_nextOpen = m_nextOpen;
-	}
-	else
-	{
-		m_openList = m_nextOpen;
-	}
-	
-	if ( m_nextOpen )
+	// zero is an invalid marker
+	m_openMarker = 0;
+
+	int index = m_openIndex;
+	int last = m_openList.Count() - 1;
+	if ( index != last )
 	{
-		m_nextOpen->m_prevOpen = m_prevOpen;
+		// move the last entry into the hole and let it find its place
+		CNavArea *moved = m_openList[ last ].area;
+		m_openList[ index ] = m_openList[ last ];
+		m_openList.RemoveMultipleFromTail( 1 );
+
+		SiftUpOpenList( index );
+		SiftDownOpenList( moved->m_openIndex );
 	}
 	else
 	{
-		m_openListTail = m_prevOpen;
+		m_openList.RemoveMultipleFromTail( 1 );
 	}
-	
-	// zero is an invalid marker
-	m_openMarker = 0;
 }
 
 //--------------------------------------------------------------------------------------------------------------
@@ -3548,8 +3471,51 @@ void CNavArea::ClearSearchLists( void )
 	// effectively clears all open list pointers and closed flags
 	CNavArea::MakeNewMarker();
 
-	m_openList = NULL;
-	m_openListTail = NULL;
+	m_openList.RemoveAll();
+	m_openListOrder = 0;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+void CNavArea::SiftUpOpenList( int index )
+{
+	OpenEntry entry = m_openList[ index ];
+	while( index > 0 )
+	{
+		int parent = ( index - 1 ) / 2;
+		if ( !IsBeforeOnOpenList( entry, m_openList[ parent ] ) )
+			break;
+
+		m_openList[ index ] = m_openList[ parent ];
+		m_openList[ index ].area->m_openIndex = index;
+		index = parent;
+	}
+	m_openList[ index ] = entry;
+	entry.area->m_openIndex = index;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+void CNavArea::SiftDownOpenList( int index )
+{
+	int count = m_openList.Count();
+	OpenEntry entry = m_openList[ index ];
+	for( ;; )
+	{
+		int child = index * 2 + 1;
+		if ( child >= count )
+			break;
+
+		if ( child + 1 < count && IsBeforeOnOpenList( m_openList[ child + 1 ], m_openList[ child ] ) )
+			++child;
+
+		if ( !IsBeforeOnOpenList( m_openList[ child ], entry ) )
+			break;
+
+		m_openList[ index ] = m_openList[ child ];
+		m_openList[ index ].area->m_openIndex = index;
+		index = child;
+	}
+	m_openList[ index ] = entry;
+	entry.area->m_openIndex = index;
 }
 
 //--------------------------------------------------------------------------------------------------------------
@@ -3602,6 +3568,8 @@ void CNavArea::SetCorner( NavCornerType corner, const Vector& newPosition )
 		m_invDxCorners = m_invDyCorners = 0;
 	}
 
+	TheNavMesh->m_gridIndex.Invalidate();
+
 	CalcDebugID();
 }
 
@@ -4363,6 +4331,8 @@ void CNavArea::RaiseCorner( NavCornerType corner, int amount, bool raiseAdjacent
 		m_invDxCorners = m_invDyCorners = 0;
 	}
 
+	TheNavMesh->m_gridIndex.Invalidate();
+
 	if ( !raiseAdjacentCorners || nav_corner_adjust_adjacent.GetFloat() <= 0.0f )
 	{
 		return;
@@ -4562,6 +4532,8 @@ void CNavArea::Shift( const Vector &shift )
 	m_seCorner += shift;
 	
 	m_center += shift;
+
+	TheNavMesh->m_gridIndex.Invalidate();
 }
 
 
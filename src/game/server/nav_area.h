@@ -234,26 +234,24 @@ protected:
 	/* 60 */	float m_totalCost;											// the distance so far plus an estimate of the distance left
 	/* 64 */	float m_costSoFar;											// distance travelled so far
 
-	/* 68 */	CNavArea *m_nextOpen, *m_prevOpen;							// only valid if m_openMarker == m_masterMarker
-	/* 76 */	unsigned int m_openMarker;									// if this equals the current marker value, we are on the open list
+	/* 68 */	int m_openIndex;											// position in the open list heap, only valid if m_openMarker == m_masterMarker
+	/* 72 */	unsigned int m_openMarker;									// if this equals the current marker value, we are on the open list
 
-	/* 80 */	int	m_attributeFlags;										// set of attribute bit flags (see NavAttributeType)
+	/* 76 */	int	m_attributeFlags;										// set of attribute bit flags (see NavAttributeType)
 
 	//- connections to adjacent areas -------------------------------------------------------------------
-	/* 84 */	NavConnectVector m_connect[ NUM_DIRECTIONS ];				// a list of adjacent areas for each direction
-	/* 100*/	NavLadderConnectVector m_ladder[ CNavLadder::NUM_LADDER_DIRECTIONS ];	// list of ladders leading up and down from this area
-	/* 108*/	NavConnectVector m_elevatorAreas;							// a list of areas reachable via elevator from this area
+	/* 80 */	NavConnectVector m_connect[ NUM_DIRECTIONS ];				// a list of adjacent areas for each direction
+	/* 96 */	NavLadderConnectVector m_ladder[ CNavLadder::NUM_LADDER_DIRECTIONS ];	// list of ladders leading up and down from this area
+	/* 104*/	NavConnectVector m_elevatorAreas;							// a list of areas reachable via elevator from this area
 
-	/* 112*/	unsigned int m_nearNavSearchMarker;							// used in GetNearestNavArea()
+	/* 108*/	unsigned int m_nearNavSearchMarker;							// used in GetNearestNavArea()
 
-	/* 116*/	CNavArea *m_parent;											// the area just prior to this on in the search path
-	/* 120*/	NavTraverseType m_parentHow;								// how we get from parent to us
+	/* 112*/	CNavArea *m_parent;											// the area just prior to this on in the search path
+	/* 116*/	NavTraverseType m_parentHow;								// how we get from parent to us
 
-	/* 124*/	float m_pathLengthSoFar;									// length of path so far, needed for limiting pathfind max path length
+	/* 120*/	float m_pathLengthSoFar;									// length of path so far, needed for limiting pathfind max path length
 
-	/* *************** 360 cache line *************** */
-
-	/* 128*/	CFuncElevator *m_elevator;									// if non-NULL, this area is in an elevator's path. The elevator can transport us vertically to another area.
+	/* 124*/	CFuncElevator *m_elevator;									// if non-NULL, this area is in an elevator's path. The elevator can transport us vertically to another area.
 
 	// --- End critical data --- 
 };
@@ -713,8 +711,18 @@ private:
 	//- A* pathfinding algorithm ------------------------------------------------------------------------
 	static unsigned int m_masterMarker;
 
-	static CNavArea *m_openList;
-	static CNavArea *m_openListTail;
+	struct OpenEntry
+	{
+		float cost;
+		unsigned int order;										// areas with equal costs come off the list in the order they got that cost
+		CNavArea *area;
+	};
+	static CUtlVector< OpenEntry > m_openList;					// binary heap, lowest cost first
+	static unsigned int m_openListOrder;
+
+	static bool IsBeforeOnOpenList( const OpenEntry &a, const OpenEntry &b )	{ return ( a.cost < b.cost ) || ( a.cost == b.cost && a.order < b.order ); }
+	static void SiftUpOpenList( int index );
+	static void SiftDownOpenList( int index );
 
 	//- connections to adjacent areas -------------------------------------------------------------------
 	NavConnectVector m_incomingConnect[ NUM_DIRECTIONS ];		// a list of adjacent areas for each direction that connect TO us, but we have no connection back to them
@@ -737,8 +745,6 @@ private:
 	CUtlVector< CHandle< CFuncNavPrerequisite > > m_prerequisiteVector;		// list of prerequisites that must be met before this area can be traversed
 #endif
 
-	CNavArea *m_prevHash, *m_nextHash;							// for hash table in CNavMesh
-
 	void ConnectElevators( void );								// find elevator connections between areas
 
 	int m_damagingTickCount;									// this area is damaging through this tick count
@@ -837,32 +843,18 @@ inline bool CNavArea::IsOpen( void ) const
 //--------------------------------------------------------------------------------------------------------------
 inline bool CNavArea::IsOpenListEmpty( void )
 {
-	Assert( (m_openList && m_openList->m_prevOpen == NULL) || m_openList == NULL );
-	return (m_openList) ? false : true;
+	return (m_openList.Count()) ? false : true;
 }
 
 //--------------------------------------------------------------------------------------------------------------
 inline CNavArea *CNavArea::PopOpenList( void )
 {
-	Assert( (m_openList && m_openList->m_prevOpen == NULL) || m_openList == NULL );
-
-	if ( m_openList )
-	{
-		CNavArea *area = m_openList;
-	
-		// disconnect from list
-		area->RemoveFromOpenList();
-		area->m_prevOpen = NULL;
-		area->m_nextOpen = NULL;
-
-		Assert( (m_openList && m_openList->m_prevOpen == NULL) || m_openList == NULL );
-
-		return area;
-	}
-
-	Assert( (m_openList && m_openList->m_prevOpen == NULL) || m_openList == NULL );
+	if ( m_openList.Count() == 0 )
+		return NULL;
 
-	return NULL;
+	CNavArea *area = m_openList[0].area;
+	area->RemoveFromOpenList();
+	return area;
 }
 
 //--------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,440 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose:
+//
+// $NoKeywords: $
+//
+//=============================================================================//
+// nav_distance.cpp
+// Precomputed area-to-area travel distances
+
+#include "cbase.h"
+
+#include "nav_mesh.h"
+#include "nav_distance.h"
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include "tier0/memdbgon.h"
+
+ConVar nav_travel_distance_max_areas( "nav_travel_distance_max_areas", "2048", FCVAR_CHEAT, "Meshes with more areas than this don't get a precomputed travel distance table when analyzed.", true, 0, true, NAV_DISTANCE_MAX_TABLE_AREAS );
+ConVar nav_travel_distance_cache_rows( "nav_travel_distance_cache_rows", "64", FCVAR_CHEAT, "How many rows of travel distances are kept for meshes without a precomputed table." );
+
+
+//--------------------------------------------------------------------------------------------------------------
+CNavTravelDistances::CNavTravelDistances( void )
+{
+	m_quantum = 1.0f;
+	m_openList.SetLessFunc( IsLessPriority );
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Discard the table and cached rows
+ */
+void CNavTravelDistances::Reset( void )
+{
+	m_areaIDs.Purge();
+	m_areas.Purge();
+	m_indexByID.Purge();
+	m_table.Purge();
+	m_buildDistances.Purge();
+	m_quantum = 1.0f;
+
+	m_cachedRows.PurgeAndDeleteElements();
+	m_cachedRowByIndex.Purge();
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Return the shortest distance traveled from 'from' to 'to', or -1 if 'to' can't be reached
+ */
+float CNavTravelDistances::GetTravelDistance( const CNavArea *from, const CNavArea *to )
+{
+	if ( from == NULL || to == NULL )
+		return -1.0f;
+
+	if ( from == to )
+		return 0.0f;
+
+	if ( !UpdateIndex() )
+		return -1.0f;
+
+	int fromIndex = GetIndex( from );
+	int toIndex = GetIndex( to );
+	if ( fromIndex < 0 || toIndex < 0 )
+		return -1.0f;
+
+	if ( HasTable() )
+	{
+		unsigned short distance = m_table[ fromIndex * m_areas.Count() + toIndex ];
+		return ( distance == NAV_DISTANCE_UNREACHABLE ) ? -1.0f : distance * m_quantum;
+	}
+
+	return GetCachedRow( fromIndex )[ toIndex ];
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Start building a full table for the current mesh. Return false if the mesh is too big for one.
+ */
+bool CNavTravelDistances::BeginBuild( void )
+{
+	Reset();
+
+	int count = TheNavAreas.Count();
+	if ( count == 0 || count > nav_travel_distance_max_areas.GetInt() )
+		return false;
+
+	if ( !UpdateIndex() )
+		return false;
+
+	m_buildDistances.SetCount( count * count );
+	return true;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Compute the distances from TheNavAreas[ index ] to every other area
+ */
+void CNavTravelDistances::BuildRow( int index )
+{
+	int count = m_areas.Count();
+	if ( index < 0 || index >= count || m_buildDistances.Count() != count * count )
+		return;
+
+	ComputeRow( index, &m_buildDistances[ index * count ] );
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Quantize the built rows into the table, scaled so the longest distance still fits
+ */
+void CNavTravelDistances::EndBuild( void )
+{
+	int count = m_areas.Count();
+	if ( count == 0 || m_buildDistances.Count() != count * count )
+		return;
+
+	float longest = 0.0f;
+	FOR_EACH_VEC( m_buildDistances, it )
+	{
+		longest = MAX( longest, m_buildDistances[ it ] );
+	}
+
+	m_quantum = ( longest > 0.0f ) ? longest / ( NAV_DISTANCE_UNREACHABLE - 1 ) : 1.0f;
+
+	m_table.SetCount( count * count );
+	FOR_EACH_VEC( m_buildDistances, it )
+	{
+		float distance = m_buildDistances[ it ];
+		if ( distance < 0.0f )
+		{
+			m_table[ it ] = NAV_DISTANCE_UNREACHABLE;
+		}
+		else
+		{
+			m_table[ it ] = (unsigned short)MIN( RoundFloatToInt( distance / m_quantum ), NAV_DISTANCE_UNREACHABLE - 1 );
+		}
+	}
+
+	m_buildDistances.Purge();
+
+	m_areaIDs.SetCount( count );
+	FOR_EACH_VEC( m_areas, it )
+	{
+		m_areaIDs[ it ] = m_areas[ it ]->GetID();
+	}
+
+	DevMsg( "Travel distance table for %d areas is %d bytes, %.2f units per step.\n", count, m_table.Count() * (int)sizeof( unsigned short ), m_quantum );
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Store the table, or just a zero count if there isn't one for the current mesh
+ */
+void CNavTravelDistances::Save( CUtlBuffer &fileBuffer ) const
+{
+	if ( !HasTable() || m_areaIDs.Count() != TheNavAreas.Count() )
+	{
+		fileBuffer.PutUnsignedInt( 0 );
+		return;
+	}
+
+	fileBuffer.PutUnsignedInt( m_areaIDs.Count() );
+	FOR_EACH_VEC( m_areaIDs, it )
+	{
+		fileBuffer.PutUnsignedInt( m_areaIDs[ it ] );
+	}
+
+	fileBuffer.PutFloat( m_quantum );
+	fileBuffer.Put( m_table.Base(), m_table.Count() * sizeof( unsigned short ) );
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Load the table. Areas have been loaded, but are not bound to rows until the first query.
+ * Return false if the table runs past the end of the file.
+ */
+bool CNavTravelDistances::Load( CUtlBuffer &fileBuffer, unsigned int version )
+{
+	Reset();
+
+	if ( version < 17 )
+		return true;
+
+	unsigned int count = fileBuffer.GetUnsignedInt();
+	if ( count == 0 )
+		return fileBuffer.IsValid();
+
+	// the count comes from the file, so sizes are worked out in 64 bits and checked against what's there
+	int64 tableSize = (int64)count * count * sizeof( unsigned short );
+	int64 recordSize = (int64)count * sizeof( unsigned int ) + sizeof( float ) + tableSize;
+	if ( recordSize > fileBuffer.GetBytesRemaining() )
+	{
+		Warning( "Travel distance table for %u areas runs past the end of the file\n", count );
+		return false;
+	}
+
+	if ( count != (unsigned int)TheNavAreas.Count() || count > (unsigned int)nav_travel_distance_max_areas.GetInt() )
+	{
+		// can't be for these areas, or too big to keep - skip it, the rows will be searched on demand
+		Warning( "Ignoring travel distance table for %u areas in a mesh of %d areas\n", count, TheNavAreas.Count() );
+		fileBuffer.SeekGet( CUtlBuffer::SEEK_CURRENT, (int)recordSize );
+		return true;
+	}
+
+	m_areaIDs.SetCount( count );
+	for( unsigned int i=0; i<count; ++i )
+	{
+		m_areaIDs[i] = fileBuffer.GetUnsignedInt();
+	}
+
+	m_quantum = fileBuffer.GetFloat();
+
+	// the whole table comes straight out of the file buffer in one copy
+	m_table.SetCount( count * count );
+	fileBuffer.Get( m_table.Base(), (int)tableSize );
+
+	if ( !fileBuffer.IsValid() )
+	{
+		Reset();
+		return false;
+	}
+
+	return true;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Bind areas to rows, discarding everything if areas were added or removed since.
+ * Return false if there are no areas.
+ */
+bool CNavTravelDistances::UpdateIndex( void )
+{
+	if ( m_areas.Count() )
+	{
+		if ( m_areas.Count() == TheNavAreas.Count() )
+			return true;
+
+		Reset();
+	}
+
+	if ( m_areaIDs.Count() )
+	{
+		// bind the loaded table
+		m_areas.SetCount( m_areaIDs.Count() );
+		FOR_EACH_VEC( m_areaIDs, it )
+		{
+			m_areas[ it ] = TheNavMesh->GetNavAreaByID( m_areaIDs[ it ] );
+			if ( m_areas[ it ] == NULL )
+			{
+				Warning( "Travel distance table refers to missing area #%d, ignoring it\n", m_areaIDs[ it ] );
+				Reset();
+				break;
+			}
+		}
+	}
+
+	if ( m_areas.Count() == 0 )
+	{
+		if ( TheNavAreas.Count() == 0 )
+			return false;
+
+		m_areas.CopyArray( TheNavAreas.Base(), TheNavAreas.Count() );
+	}
+
+	unsigned int maxID = 0;
+	FOR_EACH_VEC( m_areas, it )
+	{
+		maxID = MAX( maxID, m_areas[ it ]->GetID() );
+	}
+
+	m_indexByID.SetCount( maxID + 1 );
+	FOR_EACH_VEC( m_indexByID, it )
+	{
+		m_indexByID[ it ] = -1;
+	}
+
+	FOR_EACH_VEC( m_areas, it )
+	{
+		m_indexByID[ m_areas[ it ]->GetID() ] = it;
+	}
+
+	m_cachedRowByIndex.SetCount( m_areas.Count() );
+	FOR_EACH_VEC( m_cachedRowByIndex, it )
+	{
+		m_cachedRowByIndex[ it ] = m_cachedRows.InvalidIndex();
+	}
+
+	return true;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Return row for the given area, or -1 if it isn't one of the bound areas
+ */
+int CNavTravelDistances::GetIndex( const CNavArea *area ) const
+{
+	unsigned int id = area->GetID();
+	if ( id >= (unsigned int)m_indexByID.Count() )
+		return -1;
+
+	int index = m_indexByID[ id ];
+	if ( index < 0 || m_areas[ index ] != area )
+		return -1;
+
+	return index;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Search outward from the given row's area, storing the distance to each row's area, or -1 if unreachable.
+ * Edges are the distances between area centers, the same measure NavAreaTravelDistance() sums along its path.
+ */
+void CNavTravelDistances::ComputeRow( int index, float *distances )
+{
+	int count = m_areas.Count();
+	for( int i=0; i<count; ++i )
+	{
+		distances[i] = -1.0f;
+	}
+
+	m_openList.RemoveAll();
+
+	OpenEntry start;
+	start.cost = 0.0f;
+	start.index = index;
+	distances[ index ] = 0.0f;
+	m_openList.Insert( start );
+
+	while( m_openList.Count() )
+	{
+		OpenEntry entry = m_openList.ElementAtHead();
+		m_openList.RemoveAtHead();
+
+		// skip entries left behind when a shorter way to the area was found
+		if ( entry.cost > distances[ entry.index ] )
+			continue;
+
+		const CNavArea *area = m_areas[ entry.index ];
+
+		// collect the areas reachable from this one, on the floor and by ladder
+		CUtlVectorFixedGrowable< const CNavArea *, 32 > adjacent;
+
+		for( int dir=0; dir<NUM_DIRECTIONS; ++dir )
+		{
+			const NavConnectVector *floorList = area->GetAdjacentAreas( (NavDirType)dir );
+			FOR_EACH_VEC( (*floorList), it )
+			{
+				adjacent.AddToTail( floorList->Element( it ).area );
+			}
+		}
+
+		const NavLadderConnectVector *ladderList = area->GetLadders( CNavLadder::LADDER_UP );
+		FOR_EACH_VEC( (*ladderList), it )
+		{
+			// as with path finding, the BEHIND connection at the top isn't used going up
+			const CNavLadder *ladder = ladderList->Element( it ).ladder;
+			adjacent.AddToTail( ladder->m_topForwardArea );
+			adjacent.AddToTail( ladder->m_topLeftArea );
+			adjacent.AddToTail( ladder->m_topRightArea );
+		}
+
+		ladderList = area->GetLadders( CNavLadder::LADDER_DOWN );
+		FOR_EACH_VEC( (*ladderList), it )
+		{
+			adjacent.AddToTail( ladderList->Element( it ).ladder->m_bottomArea );
+		}
+
+		FOR_EACH_VEC( adjacent, it )
+		{
+			if ( adjacent[ it ] == NULL )
+				continue;
+
+			int newIndex = GetIndex( adjacent[ it ] );
+			if ( newIndex < 0 )
+				continue;
+
+			float newCost = entry.cost + ( adjacent[ it ]->GetCenter() - area->GetCenter() ).Length();
+			if ( distances[ newIndex ] >= 0.0f && distances[ newIndex ] <= newCost )
+				continue;
+
+			distances[ newIndex ] = newCost;
+
+			OpenEntry next;
+			next.cost = newCost;
+			next.index = newIndex;
+			m_openList.Insert( next );
+		}
+	}
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Return distances from the given row's area, searching for them if they aren't cached.
+ * The least recently used row is reused once the cache is full.
+ */
+const float *CNavTravelDistances::GetCachedRow( int index )
+{
+	int handle = m_cachedRowByIndex[ index ];
+	if ( handle != m_cachedRows.InvalidIndex() )
+	{
+		m_cachedRows.Unlink( handle );
+		m_cachedRows.LinkToHead( handle );
+		return m_cachedRows[ handle ]->distances.Base();
+	}
+
+	CachedRow *row;
+	if ( m_cachedRows.Count() >= MAX( 1, nav_travel_distance_cache_rows.GetInt() ) )
+	{
+		handle = m_cachedRows.Tail();
+		row = m_cachedRows[ handle ];
+		m_cachedRowByIndex[ row->index ] = m_cachedRows.InvalidIndex();
+
+		m_cachedRows.Unlink( handle );
+		m_cachedRows.LinkToHead( handle );
+	}
+	else
+	{
+		row = new CachedRow;
+		handle = m_cachedRows.AddToHead( row );
+	}
+
+	row->index = index;
+	row->distances.SetCount( m_areas.Count() );
+	ComputeRow( index, row->distances.Base() );
+
+	m_cachedRowByIndex[ index ] = handle;
+	return row->distances.Base();
+}
@@ -0,0 +1,91 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose:
+//
+// $NoKeywords: $
+//
+//=============================================================================//
+// nav_distance.h
+// Precomputed area-to-area travel distances
+
+#ifndef _NAV_DISTANCE_H_
+#define _NAV_DISTANCE_H_
+
+#include "utlvector.h"
+#include "utllinkedlist.h"
+#include "utlbuffer.h"
+#include "utlpriorityqueue.h"
+
+class CNavArea;
+
+extern ConVar nav_travel_distance_max_areas;
+
+#define NAV_DISTANCE_UNREACHABLE	0xFFFF		// stored distance for areas with no route between them
+#define NAV_DISTANCE_MAX_TABLE_AREAS	16384		// largest mesh nav_travel_distance_max_areas can allow a full table for
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Shortest travel distances between nav areas, measured center to center along adjacent
+ * areas and ladders. Blocked areas, team restrictions, and cost penalties are ignored -
+ * use NavAreaTravelDistance() with a cost functor when those matter, and the two argument
+ * NavAreaTravelDistance() when they don't.
+ *
+ * Meshes with no more than nav_travel_distance_max_areas areas get a full table, built by
+ * nav_generate/nav_analyze and saved in the .nav file with each distance quantized to 16 bits.
+ * For larger meshes, or meshes saved without a table, rows are searched on demand and the
+ * most recently used nav_travel_distance_cache_rows of them are kept.
+ *
+ * Only used from the main thread.
+ */
+class CNavTravelDistances
+{
+public:
+	CNavTravelDistances( void );
+
+	void Reset( void );												// discard the table and cached rows - the mesh is changing
+
+	float GetTravelDistance( const CNavArea *from, const CNavArea *to );	// return travel distance, or -1 if 'to' can't be reached from 'from'
+	bool HasTable( void ) const		{ return m_table.Count() > 0; }	// return true if a full table is loaded or built
+
+	bool BeginBuild( void );										// start building a full table, return false if the mesh is too big for one
+	void BuildRow( int index );										// compute distances from TheNavAreas[ index ]
+	void EndBuild( void );											// quantize the built rows into the table
+
+	void Save( CUtlBuffer &fileBuffer ) const;
+	bool Load( CUtlBuffer &fileBuffer, unsigned int version );		// return false if the file is corrupt
+
+private:
+	bool UpdateIndex( void );										// bind areas to rows, return false if there are no areas
+	int GetIndex( const CNavArea *area ) const;						// return row for the given area, or -1
+	void ComputeRow( int index, float *distances );					// search outward from the given row's area
+	const float *GetCachedRow( int index );
+
+	CUtlVector< unsigned int > m_areaIDs;							// area ID of each row, in the order they were saved
+	CUtlVector< CNavArea * > m_areas;								// area of each row, once bound
+	CUtlVector< int > m_indexByID;									// row for each area ID, or -1
+
+	float m_quantum;												// world units per step of a stored distance
+	CUtlVector< unsigned short > m_table;							// rows x rows, row-major by starting area
+
+	CUtlVector< float > m_buildDistances;							// unquantized rows while the table is being built
+
+	struct CachedRow
+	{
+		int index;
+		CUtlVector< float > distances;								// -1 for unreachable
+	};
+	CUtlLinkedList< CachedRow *, int > m_cachedRows;				// most recently used at the head
+	CUtlVector< int > m_cachedRowByIndex;							// cache handle for each row, or m_cachedRows.InvalidIndex()
+
+	struct OpenEntry
+	{
+		float cost;
+		int index;
+	};
+	static bool IsLessPriority( const OpenEntry &lhs, const OpenEntry &rhs )	{ return lhs.cost > rhs.cost; }
+	CUtlPriorityQueue< OpenEntry > m_openList;						// scratch for ComputeRow()
+};
+
+
+#endif // _NAV_DISTANCE_H_
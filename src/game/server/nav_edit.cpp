@@ -621,6 +621,9 @@ void CNavMesh::OnEditModeStart( void )
 	ClearSelectedSet();
 	m_isContinuouslySelecting = false;
 	m_isContinuouslyDeselecting = false;
+
+	// edits change the areas and connections travel distances were computed from
+	m_travelDistances.Reset();
 }
 
 
@@ -36,7 +36,7 @@
 /// IMPORTANT: If this version changes, the swap function in makegamedata 
 /// must be updated to match. If not, this will break the Xbox 360.
 // TODO: Was changed from 15, update when latest 360 code is integrated (MSB 5/5/09)
-const int NavCurrentVersion = 16;
+const int NavCurrentVersion = 17;
 
 //--------------------------------------------------------------------------------------------------------------
 //
@@ -642,6 +642,15 @@ NavErrorType CNavArea::Load( CUtlBuffer &fileBuffer, unsigned int version, unsig
 
 	// load visibility information
 	unsigned int visibleAreaCount = fileBuffer.GetUnsignedInt();
+
+	// the visible set is a run of fixed-size (ID, attributes) records, so the count can't claim more than are left in the file
+	const int visibleRecordSize = sizeof( unsigned int ) + sizeof( unsigned char );
+	if ( visibleAreaCount > (unsigned int)fileBuffer.GetBytesRemaining() / visibleRecordSize )
+	{
+		Msg( "Navigation area #%d has more visible areas (%u) than are left in the file.\n", m_id, visibleAreaCount );
+		return NAV_CORRUPT_DATA;
+	}
+
 	if ( !IsX360() )
 	{
 		m_potentiallyVisibleAreas.EnsureCapacity( visibleAreaCount );
@@ -655,13 +664,31 @@ NavErrorType CNavArea::Load( CUtlBuffer &fileBuffer, unsigned int version, unsig
 */
 	}
 
-	for( unsigned int j=0; j<visibleAreaCount; ++j )
+	// read the records straight out of the file buffer
+	const unsigned char *record = (const unsigned char *)fileBuffer.PeekGet( visibleAreaCount * visibleRecordSize, 0 );
+	if ( record )
 	{
-		AreaBindInfo info;
-		info.id = fileBuffer.GetUnsignedInt();
-		info.attributes = fileBuffer.GetUnsignedChar();
+		m_potentiallyVisibleAreas.SetCount( visibleAreaCount );
+		for( unsigned int j=0; j<visibleAreaCount; ++j, record += visibleRecordSize )
+		{
+			AreaBindInfo &info = m_potentiallyVisibleAreas[ j ];
+			info.area = NULL;
+			V_memcpy( &info.id, record, sizeof( unsigned int ) );
+			info.attributes = record[ sizeof( unsigned int ) ];
+		}
 
-		m_potentiallyVisibleAreas.AddToTail( info );
+		fileBuffer.SeekGet( CUtlBuffer::SEEK_CURRENT, visibleAreaCount * visibleRecordSize );
+	}
+	else
+	{
+		for( unsigned int j=0; j<visibleAreaCount; ++j )
+		{
+			AreaBindInfo info;
+			info.id = fileBuffer.GetUnsignedInt();
+			info.attributes = fileBuffer.GetUnsignedChar();
+
+			m_potentiallyVisibleAreas.AddToTail( info );
+		}
 	}
 
 	// read area from which we inherit visibility
@@ -766,26 +793,26 @@ NavErrorType CNavArea::PostLoad( void )
 		}
 	}
 
-	// convert visible ID's to pointers to actual areas
+	// convert visible ID's to pointers to actual areas, removing any invalid areas from the list
+	int validCount = 0;
 	for ( int it=0; it<m_potentiallyVisibleAreas.Count(); ++it )
 	{
-		AreaBindInfo &info = m_potentiallyVisibleAreas[ it ];
+		AreaBindInfo info = m_potentiallyVisibleAreas[ it ];
 
 		info.area = TheNavMesh->GetNavAreaByID( info.id );
 		if ( info.area == NULL )
 		{
 			Warning( "Invalid area in visible set for area #%d\n", GetID() );
-		}		
+			continue;
+		}
+
+		m_potentiallyVisibleAreas[ validCount++ ] = info;
 	}
+	m_potentiallyVisibleAreas.RemoveMultipleFromTail( m_potentiallyVisibleAreas.Count() - validCount );
 
 	m_inheritVisibilityFrom.area = TheNavMesh->GetNavAreaByID( m_inheritVisibilityFrom.id );
 	Assert( m_inheritVisibilityFrom.area != this );
 
-	// remove any invalid areas from the list
-	AreaBindInfo bad;
-	bad.area = NULL;
-	while( m_potentiallyVisibleAreas.FindAndRemove( bad ) );
-
 	// func avoid/prefer attributes are controlled by func_nav_cost entities
 	ClearAllNavCostEntities();
 
@@ -1114,6 +1141,7 @@ bool CNavMesh::Save( void ) const
 	// 14 - Added a bool for if the nav needs analysis
 	// 15 - removed approach areas
 	// 16 - Added visibility data to the base mesh
+	// 17 - Added area-to-area travel distance table
 	fileBuffer.PutUnsignedInt( NavCurrentVersion );
 
 	// The sub-version number is maintained and owned by classes derived from CNavMesh and CNavArea
@@ -1180,6 +1208,11 @@ bool CNavMesh::Save( void ) const
 		}
 	}
 	
+	//
+	// Store travel distances
+	//
+	m_travelDistances.Save( fileBuffer );
+
 	//
 	// Store derived class mesh info
 	//
@@ -1501,6 +1534,14 @@ NavErrorType CNavMesh::Load( void )
 		return NAV_INVALID_FILE;
 	}
 
+	// the count comes from the file - IDs are unique, and every area has at least its ID, corners and corner heights
+	const unsigned int minAreaSize = sizeof( unsigned int ) + 2 * sizeof( Vector ) + 2 * sizeof( float );
+	if ( count > NAV_MAX_AREA_ID || count > (unsigned int)fileBuffer.GetBytesRemaining() / minAreaSize )
+	{
+		Msg( "Navigation mesh claims more areas (%u) than the file can hold.\n", count );
+		return NAV_CORRUPT_DATA;
+	}
+
 	Extent extent;
 	extent.lo.x = 9999999999.9f;
 	extent.lo.y = 9999999999.9f;
@@ -1509,13 +1550,31 @@ NavErrorType CNavMesh::Load( void )
 
 	// load the areas and compute total extent
 	TheNavMesh->PreLoadAreas( count );
+	TheNavAreas.EnsureCapacity( count );
+	m_areasByID.EnsureCapacity( count + 1 );
 	Extent areaExtent;
 	for( i=0; i<count; ++i )
 	{
 		CNavArea *area = TheNavMesh->CreateArea();
-		area->Load( fileBuffer, version, subVersion );
+		NavErrorType areaResult = area->Load( fileBuffer, version, subVersion );
 		TheNavAreas.AddToTail( area );
 
+		if ( areaResult == NAV_CORRUPT_DATA )
+		{
+			DestroyNavigationMesh();
+			CNavArea::m_nextID = 1;
+			return NAV_CORRUPT_DATA;
+		}
+
+		// area IDs index the ID lookup directly, so a corrupt one can't be allowed to size it
+		if ( area->GetID() == 0 || area->GetID() > NAV_MAX_AREA_ID )
+		{
+			Msg( "Navigation area has an invalid ID (%u).\n", area->GetID() );
+			DestroyNavigationMesh();
+			CNavArea::m_nextID = 1;
+			return NAV_CORRUPT_DATA;
+		}
+
 		area->GetExtent( &areaExtent );
 
 		if (areaExtent.lo.x < extent.lo.x)
@@ -1561,6 +1620,17 @@ NavErrorType CNavMesh::Load( void )
 	// mark stairways (TODO: this can be removed once all maps are re-saved with this attribute in them)
 	MarkStairAreas();
 
+	//
+	// Load travel distances
+	//
+	if ( !m_travelDistances.Load( fileBuffer, version ) )
+	{
+		Msg( "Navigation travel distance table is corrupt.\n" );
+		DestroyNavigationMesh();
+		CNavArea::m_nextID = 1;
+		return NAV_CORRUPT_DATA;
+	}
+
 	//
 	// Load derived class mesh info
 	//
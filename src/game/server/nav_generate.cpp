@@ -14,6 +14,7 @@
 #include "nav_mesh.h"
 #include "nav_node.h"
 #include "nav_pathfind.h"
+#include "vstdlib/jobthread.h"
 #include "viewport_panel_names.h"
 //#include "terror/TerrorShared.h"
 #include "fmtstr.h"
@@ -42,6 +43,7 @@ ConVar nav_generate_fixup_jump_areas( "nav_generate_fixup_jump_areas", "1", FCVA
 ConVar nav_generate_incremental_range( "nav_generate_incremental_range", "2000", FCVAR_CHEAT );
 ConVar nav_generate_incremental_tolerance( "nav_generate_incremental_tolerance", "0", FCVAR_CHEAT, "Z tolerance for adding new nav areas." );
 ConVar nav_area_max_size( "nav_area_max_size", "50", FCVAR_CHEAT, "Max area size created in nav generation" );
+ConVar nav_generate_parallel( "nav_generate_parallel", "0", FCVAR_CHEAT, "Sample walkable space and test where areas fit on the thread pool while generating. Sampling breadth-first visits nodes in a different order, so the mesh can differ slightly from a serial generate." );
 
 // Common bounding box for traces
 Vector NavTraceMins( -0.45, -0.45, 0 );
@@ -3270,6 +3272,16 @@ int CNavMesh::BuildArea( CNavNode *node, int width, int height )
 }
 
 
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Thread pool job for CreateNavAreasFromNodes()
+ */
+void CNavMesh::TestAreaCandidate( NavAreaCandidate &candidate )
+{
+	candidate.isValid = TestArea( candidate.node, m_candidateWidth, m_candidateHeight );
+}
+
+
 //--------------------------------------------------------------------------------------------------------------
 /**
  * This function uses the CNavNodes that have been sampled from the map to
@@ -3287,13 +3299,37 @@ void CNavMesh::CreateNavAreasFromNodes( void )
 	int tryHeight = tryWidth;
 	int uncoveredNodes = CNavNode::GetListLength();
 
+	CUtlVector< NavAreaCandidate > candidates;
+
 	while( uncoveredNodes > 0 )
 	{
+		// every uncovered node is a possible NW corner for an area of this size
+		candidates.RemoveAll();
 		for( CNavNode *node = CNavNode::GetFirst(); node; node = node->GetNext() )
 		{
 			if (node->IsCovered())
 				continue;
 
+			NavAreaCandidate &candidate = candidates[ candidates.AddToTail() ];
+			candidate.node = node;
+			candidate.isValid = true;
+		}
+
+		if ( m_generateInParallel )
+		{
+			// Test them all on the thread pool first. Building an area only covers nodes, which can
+			// only make TestArea() fail, so nodes that fail here would fail when tested below too.
+			m_candidateWidth = tryWidth;
+			m_candidateHeight = tryHeight;
+			ParallelProcess( "CNavMesh::TestAreaCandidate", candidates.Base(), candidates.Count(), this, &CNavMesh::TestAreaCandidate );
+		}
+
+		FOR_EACH_VEC( candidates, it )
+		{
+			CNavNode *node = candidates[ it ].node;
+			if (!candidates[ it ].isValid || node->IsCovered())
+				continue;
+
 			if (TestArea( node, tryWidth, tryHeight ))
 			{
 				int covered = BuildArea( node, tryWidth, tryHeight );
@@ -3469,8 +3505,13 @@ void CNavMesh::BeginGeneration( bool incremental )
 	// initialize seed list index
 	m_seedIdx = 0;
 
+	m_generateInParallel = nav_generate_parallel.GetBool();
+	m_sampleOpenList.RemoveAll();
+	m_sampleOpenIndex = 0;
+
 	Msg( "Generating Navigation Mesh...\n" );
 	m_generationStartTime = Plat_FloatTime();
+	ResetGenerationStateTimes();
 }
 
 
@@ -3538,6 +3579,7 @@ void CNavMesh::BeginAnalysis( bool quitWhenFinished )
 	m_bQuitWhenFinished = quitWhenFinished;
 	lastMsgTime = 0.0f;
 	m_generationStartTime = Plat_FloatTime();
+	ResetGenerationStateTimes();
 }
 
 
@@ -3617,6 +3659,48 @@ static void HideAnalysisProgress( void )
 }
 
 
+//--------------------------------------------------------------------------------------------------------------
+void CNavMesh::ResetGenerationStateTimes( void )
+{
+	for ( int i=0; i<NUM_GENERATION_STATES; ++i )
+	{
+		m_generationStateTime[i] = 0.0f;
+	}
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Report how long each step of generation or analysis took
+ */
+void CNavMesh::PrintGenerationStateTimes( void ) const
+{
+	static const char *stateName[] =
+	{
+		"Sampling walkable space",
+		"Creating areas from samples",
+		"Finding hiding spots",
+		"Finding encounter spots",
+		"Finding sniper spots",
+		"Finding earliest occupy times",
+		"Finding light intensity",
+		"Computing mesh visibility",
+		"Custom analysis",
+		"Computing travel distances",
+		"Saving",
+	};
+	COMPILE_TIME_ASSERT( ARRAYSIZE( stateName ) == NUM_GENERATION_STATES );
+
+	for ( int i=0; i<NUM_GENERATION_STATES; ++i )
+	{
+		if ( m_generationStateTime[i] > 0.0f )
+		{
+			Msg( "  %-32s %8.2f seconds\n", stateName[i], m_generationStateTime[i] );
+		}
+	}
+}
+
+
 //--------------------------------------------------------------------------------------------------------------
 /**
  * Process the auto-generation for 'maxTime' seconds. return false if generation is complete.
@@ -3639,11 +3723,24 @@ bool CNavMesh::UpdateGeneration( float maxTime )
 			AnalysisProgress( "Sampling walkable space...", 100, m_sampleTick / 10, false );
 			m_sampleTick = ( m_sampleTick + 1 ) % 1000;
 
-			while ( SampleStep() )
+			if ( m_generateInParallel )
 			{
-				if ( Plat_FloatTime() - startTime > maxTime )
+				while ( SampleWave() )
 				{
-					return true;
+					if ( Plat_FloatTime() - startTime > maxTime )
+					{
+						return true;
+					}
+				}
+			}
+			else
+			{
+				while ( SampleStep() )
+				{
+					if ( Plat_FloatTime() - startTime > maxTime )
+					{
+						return true;
+					}
 				}
 			}
 
@@ -3971,7 +4068,7 @@ bool CNavMesh::UpdateGeneration( float maxTime )
 			EndCustomAnalysis();
 			Msg( "Custom game-specific analysis...DONE\n" );
 
-			m_generationState = SAVE_NAV_MESH;
+			m_generationState = COMPUTE_TRAVEL_DISTANCES;
 			m_generationIndex = 0;
 			ConVarRef mat_queue_mode( "mat_queue_mode" );
 			mat_queue_mode.SetValue( -1 );
@@ -3979,6 +4076,41 @@ bool CNavMesh::UpdateGeneration( float maxTime )
 			return true;
 		}
 
+		//---------------------------------------------------------------------------
+		case COMPUTE_TRAVEL_DISTANCES:
+		{
+			if ( m_generationIndex == 0 )
+			{
+				if ( !m_travelDistances.BeginBuild() )
+				{
+					Msg( "Skipping travel distances for %d areas, nav_travel_distance_max_areas is %d\n", TheNavAreas.Count(), nav_travel_distance_max_areas.GetInt() );
+
+					m_generationState = SAVE_NAV_MESH;
+					return true;
+				}
+			}
+
+			while( m_generationIndex < TheNavAreas.Count() )
+			{
+				m_travelDistances.BuildRow( m_generationIndex );
+				++m_generationIndex;
+
+				// don't go over our time allotment
+				if( Plat_FloatTime() - startTime > maxTime )
+				{
+					AnalysisProgress( "Computing travel distances...", 100, 100 * m_generationIndex / TheNavAreas.Count() );
+					return true;
+				}
+			}
+
+			m_travelDistances.EndBuild();
+			Msg( "Computing travel distances...DONE\n" );
+
+			m_generationState = SAVE_NAV_MESH;
+			m_generationIndex = 0;
+			return true;
+		}
+
 		//---------------------------------------------------------------------------
 		case SAVE_NAV_MESH:
 		{
@@ -3990,6 +4122,7 @@ bool CNavMesh::UpdateGeneration( float maxTime )
 			// generation complete!
 			float generationTime = Plat_FloatTime() - m_generationStartTime;
 			Msg( "Generation complete!  %0.1f seconds elapsed.\n", generationTime );
+			PrintGenerationStateTimes();
 			bool restart = m_generationMode != GENERATE_INCREMENTAL;
 			m_generationMode = GENERATE_NONE;
 			m_isLoaded = true;
@@ -4079,7 +4212,7 @@ const char *CNavMesh::GetPlayerSpawnName( void ) const
  * Node Z positions are ground level.
  */
 CNavNode *CNavMesh::AddNode( const Vector &destPos, const Vector &normal, NavDirType dir, CNavNode *source, bool isOnDisplacement, 
-							float obstacleHeight, float obstacleStartDist, float obstacleEndDist )
+							float obstacleHeight, float obstacleStartDist, float obstacleEndDist, bool updateAttributes )
 {
 	// check if a node exists at this location
 	CNavNode *node = CNavNode::GetNode( destPos );
@@ -4116,6 +4249,22 @@ CNavNode *CNavMesh::AddNode( const Vector &destPos, const Vector &normal, NavDir
 		m_currentNode = node;
 	}
 
+	if ( updateAttributes )
+	{
+		UpdateNodeAttributes( node );
+	}
+
+	return node;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Check the space around a node for crouch and cliff attributes. Only touches the given node,
+ * so different nodes can be checked on different threads.
+ */
+void CNavMesh::UpdateNodeAttributes( CNavNode *&node )
+{
 	node->CheckCrouch();
 
 	// determine if there's a cliff nearby and set an attribute on this node
@@ -4128,8 +4277,6 @@ CNavNode *CNavMesh::AddNode( const Vector &destPos, const Vector &normal, NavDir
 			break;
 		}
 	}
-
-	return node;
 }
 
 //--------------------------------------------------------------------------------------------------------------
@@ -4396,233 +4543,400 @@ bool CNavMesh::SampleStep( void )
 			if (!m_currentNode->HasVisited( (NavDirType)dir ))
 			{
 				// have not searched in this direction yet
+				m_generationDir = (NavDirType)dir;
 
-				// start at current node position
-				Vector pos = *m_currentNode->GetPosition();
-
-				// snap to grid
-				int cx = SnapToGrid( pos.x );
-				int cy = SnapToGrid( pos.y );
+				// mark direction as visited
+				m_currentNode->MarkAsVisited( m_generationDir );
 
-				// attempt to move to adjacent node
-				switch( dir )
+				// test if we can move to new position
+				NavSample sample;
+				if ( SampleAdjacent( m_currentNode, m_generationDir, &sample ) )
 				{
-					case NORTH:		cy -= GenerationStepSize; break;
-					case SOUTH:		cy += GenerationStepSize; break;
-					case EAST:		cx += GenerationStepSize; break;
-					case WEST:		cx -= GenerationStepSize; break;
+					// create a new navigation node, and update current node pointer
+					AddNode( sample.pos, sample.normal, m_generationDir, m_currentNode, sample.isOnDisplacement, sample.obstacleHeight, sample.obstacleStartDist, sample.obstacleEndDist );
 				}
 
-				pos.x = cx;
-				pos.y = cy;
+				return true;
+			}
+		}
 
-				m_generationDir = (NavDirType)dir;
+		// all directions have been searched from this node - pop back to its parent and continue
+		m_currentNode = m_currentNode->GetParent();
+	}
+}
 
-				// mark direction as visited
-				m_currentNode->MarkAsVisited( m_generationDir );
 
-				// sanity check to not generate across the world for incremental generation
-				const float incrementalRange = nav_generate_incremental_range.GetFloat();
-				if ( m_generationMode == GENERATE_INCREMENTAL && incrementalRange > 0 )
-				{
-					bool inRange = false;
-					for ( int i=0; i<m_walkableSeeds.Count(); ++i )
-					{
-						const Vector &seedPos = m_walkableSeeds[i].pos;
-						if ( (seedPos - pos).IsLengthLessThan( incrementalRange ) )
-						{
-							inRange = true;
-							break;
-						}
-					}
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Try to take one step from 'node' in direction 'dir'. Return true and fill in 'sample' if
+ * there is walkable space for a node there. Only traces, so this can run on worker threads.
+ */
+bool CNavMesh::SampleAdjacent( CNavNode *node, NavDirType dir, NavSample *sample ) const
+{
+	// start at current node position
+	Vector pos = *node->GetPosition();
 
-					if ( !inRange )
-					{
-						return true;
-					}
-				}
+	// snap to grid
+	int cx = SnapToGrid( pos.x );
+	int cy = SnapToGrid( pos.y );
+
+	// attempt to move to adjacent node
+	switch( dir )
+	{
+		case NORTH:		cy -= GenerationStepSize; break;
+		case SOUTH:		cy += GenerationStepSize; break;
+		case EAST:		cx += GenerationStepSize; break;
+		case WEST:		cx -= GenerationStepSize; break;
+	}
 
-				if ( m_generationMode == GENERATE_SIMPLIFY )
+	pos.x = cx;
+	pos.y = cy;
+
+	// sanity check to not generate across the world for incremental generation
+	const float incrementalRange = nav_generate_incremental_range.GetFloat();
+	if ( m_generationMode == GENERATE_INCREMENTAL && incrementalRange > 0 )
+	{
+		bool inRange = false;
+		for ( int i=0; i<m_walkableSeeds.Count(); ++i )
+		{
+			const Vector &seedPos = m_walkableSeeds[i].pos;
+			if ( (seedPos - pos).IsLengthLessThan( incrementalRange ) )
+			{
+				inRange = true;
+				break;
+			}
+		}
+
+		if ( !inRange )
+		{
+			return false;
+		}
+	}
+
+	if ( m_generationMode == GENERATE_SIMPLIFY )
+	{
+		if ( !m_simplifyGenerationExtent.Contains( pos ) )
+		{
+			return false;
+		}
+	}
+
+	// test if we can move to new position
+	trace_t result;
+	Vector from( *node->GetPosition() );
+	CTraceFilterWalkableEntities filter( NULL, COLLISION_GROUP_NONE, WALK_THRU_EVERYTHING );
+	Vector to, toNormal;
+	float obstacleHeight = 0, obstacleStartDist = 0, obstacleEndDist = GenerationStepSize;
+	if ( TraceAdjacentNode( 0, from, pos, &result ) )
+	{
+		to = result.endpos;
+		toNormal = result.plane.normal;
+	}
+	else
+	{
+		// test going up ClimbUpHeight
+		bool success = false;
+		for ( float height = StepHeight; height <= ClimbUpHeight; height += 1.0f )
+		{						
+			trace_t tr;
+			Vector start( from );
+			Vector end( pos );
+			start.z += height;
+			end.z += height;
+			UTIL_TraceHull( start, end, NavTraceMins, NavTraceMaxs, GetGenerationTraceMask(), &filter, &tr );
+			if ( !tr.startsolid && tr.fraction == 1.0f )
+			{
+				if ( !StayOnFloor( &tr ) )
 				{
-					if ( !m_simplifyGenerationExtent.Contains( pos ) )
-					{
-						return true;
-					}
+					break;
 				}
 
-				// test if we can move to new position
-				trace_t result;
-				Vector from( *m_currentNode->GetPosition() );
-				CTraceFilterWalkableEntities filter( NULL, COLLISION_GROUP_NONE, WALK_THRU_EVERYTHING );
-				Vector to, toNormal;
-				float obstacleHeight = 0, obstacleStartDist = 0, obstacleEndDist = GenerationStepSize;
-				if ( TraceAdjacentNode( 0, from, pos, &result ) )
+				to = tr.endpos;
+				toNormal = tr.plane.normal;
+
+				start = end = from;
+				end.z += height;
+				UTIL_TraceHull( start, end, NavTraceMins, NavTraceMaxs, GetGenerationTraceMask(), &filter, &tr );
+				if ( tr.fraction < 1.0f )
 				{
-					to = result.endpos;
-					toNormal = result.plane.normal;
+					break;
 				}
-				else
+
+				// keep track of far up we had to go to find a path to the next node
+				obstacleHeight = height;
+				success = true;
+				break;
+			}
+			else
+			{
+				// Could not trace from node to node at this height, something is in the way.
+				// Trace in the other direction to see if we hit something
+				Vector vecToObstacleStart = tr.endpos - start;
+				Assert( vecToObstacleStart.LengthSqr() <= Square( GenerationStepSize ) );
+				if ( vecToObstacleStart.LengthSqr() <= Square( GenerationStepSize ) )
 				{
-					// test going up ClimbUpHeight
-					bool success = false;
-					for ( float height = StepHeight; height <= ClimbUpHeight; height += 1.0f )
-					{						
-						trace_t tr;
-						Vector start( from );
-						Vector end( pos );
-						start.z += height;
-						end.z += height;
-						UTIL_TraceHull( start, end, NavTraceMins, NavTraceMaxs, GetGenerationTraceMask(), &filter, &tr );
-						if ( !tr.startsolid && tr.fraction == 1.0f )
+					UTIL_TraceHull( end, start, NavTraceMins, NavTraceMaxs, GetGenerationTraceMask(), &filter, &tr );
+					if ( !tr.startsolid && tr.fraction < 1.0 )
+					{
+						// We hit something going the other direction.  There is some obstacle between the two nodes.
+						Vector vecToObstacleEnd = tr.endpos - start;
+						Assert( vecToObstacleEnd.LengthSqr() <= Square( GenerationStepSize ) );
+						if ( vecToObstacleEnd.LengthSqr() <= Square( GenerationStepSize )  )
 						{
-							if ( !StayOnFloor( &tr ) )
+							// Remember the distances to start and end of the obstacle (with respect to the "from" node).
+							// Keep track of the last distances to obstacle as we keep increasing the height we do a trace for.
+							// If we do eventually clear the obstacle, these values will be the start and end distance to the
+							// very tip of the obstacle.
+							obstacleStartDist = vecToObstacleStart.Length();
+							obstacleEndDist = vecToObstacleEnd.Length();
+							if ( obstacleEndDist == 0 )
 							{
-								break;
+								obstacleEndDist = GenerationStepSize;
 							}
+						}								
+					}
+				}
+			}
+		}
 
-							to = tr.endpos;
-							toNormal = tr.plane.normal;
+		if ( !success )
+		{
+			return false;
+		}
+	}
 
-							start = end = from;
-							end.z += height;
-							UTIL_TraceHull( start, end, NavTraceMins, NavTraceMaxs, GetGenerationTraceMask(), &filter, &tr );
-							if ( tr.fraction < 1.0f )
-							{
-								break;
-							}
+	// Don't generate nodes if we spill off the end of the world onto skybox
+	if ( result.surface.flags & ( SURF_SKY|SURF_SKY2D ) )
+	{
+		return false;
+	}
 
-							// keep track of far up we had to go to find a path to the next node
-							obstacleHeight = height;
-							success = true;
-							break;
-						}
-						else
-						{
-							// Could not trace from node to node at this height, something is in the way.
-							// Trace in the other direction to see if we hit something
-							Vector vecToObstacleStart = tr.endpos - start;
-							Assert( vecToObstacleStart.LengthSqr() <= Square( GenerationStepSize ) );
-							if ( vecToObstacleStart.LengthSqr() <= Square( GenerationStepSize ) )
-							{
-								UTIL_TraceHull( end, start, NavTraceMins, NavTraceMaxs, GetGenerationTraceMask(), &filter, &tr );
-								if ( !tr.startsolid && tr.fraction < 1.0 )
-								{
-									// We hit something going the other direction.  There is some obstacle between the two nodes.
-									Vector vecToObstacleEnd = tr.endpos - start;
-									Assert( vecToObstacleEnd.LengthSqr() <= Square( GenerationStepSize ) );
-									if ( vecToObstacleEnd.LengthSqr() <= Square( GenerationStepSize )  )
-									{
-										// Remember the distances to start and end of the obstacle (with respect to the "from" node).
-										// Keep track of the last distances to obstacle as we keep increasing the height we do a trace for.
-										// If we do eventually clear the obstacle, these values will be the start and end distance to the
-										// very tip of the obstacle.
-										obstacleStartDist = vecToObstacleStart.Length();
-										obstacleEndDist = vecToObstacleEnd.Length();
-										if ( obstacleEndDist == 0 )
-										{
-											obstacleEndDist = GenerationStepSize;
-										}
-									}								
-								}
-							}
-						}
-					}
+	// If we're incrementally generating, don't overlap existing nav areas.
+	Vector testPos( to );
+	bool overlapSE = IsNodeOverlapped( testPos, Vector(  1,  1, HalfHumanHeight ) );
+	bool overlapSW = IsNodeOverlapped( testPos, Vector( -1,  1, HalfHumanHeight ) );
+	bool overlapNE = IsNodeOverlapped( testPos, Vector(  1, -1, HalfHumanHeight ) );
+	bool overlapNW = IsNodeOverlapped( testPos, Vector( -1, -1, HalfHumanHeight ) );
+	if ( overlapSE && overlapSW && overlapNE && overlapNW && m_generationMode != GENERATE_SIMPLIFY )
+	{
+		return false;
+	}
 
-					if ( !success )
-					{
-						return true;
-					}
-				}
+	int nTolerance = nav_generate_incremental_tolerance.GetInt();
+	if ( nTolerance > 0 && m_generationMode == GENERATE_INCREMENTAL )
+	{
+		bool bValid = false;
+		int zPos = to.z;
+		for ( int i=0; i<m_walkableSeeds.Count(); ++i )
+		{
+			const Vector &seedPos = m_walkableSeeds[i].pos;
+			int zMin = seedPos.z - nTolerance;
+			int zMax = seedPos.z + nTolerance;
+
+			if ( zPos >= zMin && zPos <= zMax )
+			{
+				bValid = true;
+				break;
+			}
+		}
+
+		if ( !bValid )
+			return false;
+	}
 
-				// Don't generate nodes if we spill off the end of the world onto skybox
-				if ( result.surface.flags & ( SURF_SKY|SURF_SKY2D ) )
-				{
-					return true;
-				}
 
-				// If we're incrementally generating, don't overlap existing nav areas.
-				Vector testPos( to );
-				bool overlapSE = IsNodeOverlapped( testPos, Vector(  1,  1, HalfHumanHeight ) );
-				bool overlapSW = IsNodeOverlapped( testPos, Vector( -1,  1, HalfHumanHeight ) );
-				bool overlapNE = IsNodeOverlapped( testPos, Vector(  1, -1, HalfHumanHeight ) );
-				bool overlapNW = IsNodeOverlapped( testPos, Vector( -1, -1, HalfHumanHeight ) );
-				if ( overlapSE && overlapSW && overlapNE && overlapNW && m_generationMode != GENERATE_SIMPLIFY )
+	bool isOnDisplacement = result.IsDispSurface();
+
+	if ( nav_displacement_test.GetInt() > 0 )
+	{
+		// Test for nodes under displacement surfaces.
+		// This happens during development, and is a pain because the space underneath a displacement
+		// is not 'solid'.
+		Vector start = to + Vector( 0, 0, 0 );
+		Vector end = start + Vector( 0, 0, nav_displacement_test.GetInt() );
+		UTIL_TraceHull( start, end, NavTraceMins, NavTraceMaxs, GetGenerationTraceMask(), &filter, &result );
+
+		if ( result.fraction > 0 )
+		{
+			end = start;
+			start = result.endpos;
+			UTIL_TraceHull( start, end, NavTraceMins, NavTraceMaxs, GetGenerationTraceMask(), &filter, &result );
+			if ( result.fraction < 1 )
+			{
+				// if we made it down to within StepHeight, maybe we're on a static prop
+				if ( result.endpos.z > to.z + StepHeight )
 				{
-					return true;
+					return false;
 				}
+			}
+		}
+	}
 
-				int nTolerance = nav_generate_incremental_tolerance.GetInt();
-				if ( nTolerance > 0 && m_generationMode == GENERATE_INCREMENTAL )
-				{
-					bool bValid = false;
-					int zPos = to.z;
-					for ( int i=0; i<m_walkableSeeds.Count(); ++i )
-					{
-						const Vector &seedPos = m_walkableSeeds[i].pos;
-						int zMin = seedPos.z - nTolerance;
-						int zMax = seedPos.z + nTolerance;
+	float deltaZ = to.z - node->GetPosition()->z;
+	// If there's an obstacle in the way and it's traversable, or the obstacle is not higher than the destination node itself minus a small epsilon
+	// (meaning the obstacle was just the height change to get to the destination node, no extra obstacle between the two), clear obstacle height
+	// and distances
+	if ( ( obstacleHeight < MaxTraversableHeight ) || ( deltaZ > ( obstacleHeight - 2.0f ) ) )
+	{
+		obstacleHeight = 0;
+		obstacleStartDist = 0;
+		obstacleEndDist = GenerationStepSize;
+	}
 
-						if ( zPos >= zMin && zPos <= zMax )
-						{
-							bValid = true;
-							break;
-						}
-					}
+	// we can move here
+	sample->pos = to;
+	sample->normal = toNormal;
+	sample->isOnDisplacement = isOnDisplacement;
+	sample->obstacleHeight = obstacleHeight;
+	sample->obstacleStartDist = obstacleStartDist;
+	sample->obstacleEndDist = obstacleEndDist;
+
+	return true;
+}
 
-					if ( !bValid )
-						return true;
-				}
 
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Thread pool job for SampleWave()
+ */
+void CNavMesh::ComputeSample( NavSample &sample )
+{
+	sample.isValid = SampleAdjacent( sample.node, sample.dir, &sample );
+}
 
-				bool isOnDisplacement = result.IsDispSurface();
 
-				if ( nav_displacement_test.GetInt() > 0 )
+//--------------------------------------------------------------------------------------------------------------
+static int __cdecl CompareNodeIDs( CNavNode * const *lhs, CNavNode * const *rhs )
+{
+	return ( (*lhs)->GetID() < (*rhs)->GetID() ) ? -1 : ( (*lhs)->GetID() > (*rhs)->GetID() );
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Sample the map like SampleStep(), but flood outward from all of the seeds at once, a wave of
+ * steps at a time. The traces for a wave run on the thread pool, then the nodes they found are
+ * added on the main thread in the order the steps were queued, so the result doesn't depend on
+ * how the work was split between threads.
+ *
+ * Returns true if sampling needs to continue, or false if done.
+ */
+bool CNavMesh::SampleWave( void )
+{
+	const int maxWaveSamples = 4096;
+
+	if ( m_sampleOpenIndex >= m_sampleOpenList.Count() )
+	{
+		m_sampleOpenList.RemoveAll();
+		m_sampleOpenIndex = 0;
+
+		// the regions around each seed are flooded side by side
+		while ( m_seedIdx < m_walkableSeeds.Count() )
+		{
+			const WalkableSeedSpot &spot = m_walkableSeeds[ m_seedIdx ];
+			++m_seedIdx;
+
+			if ( CNavNode::GetNode( spot.pos ) == NULL )
+			{
+				m_sampleOpenList.AddToTail( new CNavNode( spot.pos, spot.normal, NULL, false ) );
+			}
+		}
+
+		if ( m_sampleOpenList.Count() == 0 )
+		{
+			if ( m_generationMode == GENERATE_INCREMENTAL || m_generationMode == GENERATE_SIMPLIFY )
+			{
+				return false;
+			}
+
+			// search is exhausted - continue search from ends of ladders
+			for ( int i=0; i<m_ladders.Count(); ++i )
+			{
+				CNavLadder *ladder = m_ladders[i];
+
+				// check ladder bottom, then ladder top
+				CNavNode *node = LadderEndSearch( &ladder->m_bottom, ladder->GetDir() );
+				if ( node == NULL )
 				{
-					// Test for nodes under displacement surfaces.
-					// This happens during development, and is a pain because the space underneath a displacement
-					// is not 'solid'.
-					Vector start = to + Vector( 0, 0, 0 );
-					Vector end = start + Vector( 0, 0, nav_displacement_test.GetInt() );
-					UTIL_TraceHull( start, end, NavTraceMins, NavTraceMaxs, GetGenerationTraceMask(), &filter, &result );
-
-					if ( result.fraction > 0 )
-					{
-						end = start;
-						start = result.endpos;
-						UTIL_TraceHull( start, end, NavTraceMins, NavTraceMaxs, GetGenerationTraceMask(), &filter, &result );
-						if ( result.fraction < 1 )
-						{
-							// if we made it down to within StepHeight, maybe we're on a static prop
-							if ( result.endpos.z > to.z + StepHeight )
-							{
-								return true;
-							}
-						}
-					}
+					node = LadderEndSearch( &ladder->m_top, ladder->GetDir() );
 				}
 
-				float deltaZ = to.z - m_currentNode->GetPosition()->z;
-				// If there's an obstacle in the way and it's traversable, or the obstacle is not higher than the destination node itself minus a small epsilon
-				// (meaning the obstacle was just the height change to get to the destination node, no extra obstacle between the two), clear obstacle height
-				// and distances
-				if ( ( obstacleHeight < MaxTraversableHeight ) || ( deltaZ > ( obstacleHeight - 2.0f ) ) )
+				if ( node )
 				{
-					obstacleHeight = 0;
-					obstacleStartDist = 0;
-					obstacleEndDist = GenerationStepSize;
+					m_sampleOpenList.AddToTail( node );
+					break;
 				}
+			}
 
-				// we can move here
-				// create a new navigation node, and update current node pointer
-				AddNode( to, toNormal, m_generationDir, m_currentNode, isOnDisplacement, obstacleHeight, obstacleStartDist, obstacleEndDist );
-
-				return true;
+			if ( m_sampleOpenList.Count() == 0 )
+			{
+				// all seeds exhausted, sampling complete
+				m_sampleOpenList.Purge();
+				m_samples.Purge();
+				return false;
 			}
 		}
+	}
 
-		// all directions have been searched from this node - pop back to its parent and continue
-		m_currentNode = m_currentNode->GetParent();
+	// queue a step in each unsearched direction from the oldest open nodes
+	m_samples.RemoveAll();
+	while ( m_sampleOpenIndex < m_sampleOpenList.Count() && m_samples.Count() < maxWaveSamples )
+	{
+		CNavNode *node = m_sampleOpenList[ m_sampleOpenIndex ];
+		++m_sampleOpenIndex;
+
+		for( int dir = NORTH; dir < NUM_DIRECTIONS; dir++ )
+		{
+			if ( node->HasVisited( (NavDirType)dir ) )
+				continue;
+
+			node->MarkAsVisited( (NavDirType)dir );
+
+			NavSample &sample = m_samples[ m_samples.AddToTail() ];
+			sample.node = node;
+			sample.dir = (NavDirType)dir;
+			sample.isValid = false;
+		}
 	}
+
+	ParallelProcess( "CNavMesh::SampleWave", m_samples.Base(), m_samples.Count(), this, &CNavMesh::ComputeSample );
+
+	CUtlVector< CNavNode * > addedTo;
+	FOR_EACH_VEC( m_samples, it )
+	{
+		const NavSample &sample = m_samples[ it ];
+		if ( !sample.isValid )
+			continue;
+
+		// a step earlier in this wave came the other way and already connected these nodes
+		if ( sample.node->GetConnectedNode( sample.dir ) )
+			continue;
+
+		unsigned int nodeCount = CNavNode::GetListLength();
+
+		CNavNode *node = AddNode( sample.pos, sample.normal, sample.dir, sample.node, sample.isOnDisplacement, sample.obstacleHeight, sample.obstacleStartDist, sample.obstacleEndDist, false );
+		if ( CNavNode::GetListLength() != nodeCount )
+		{
+			// new node, search from it in a later wave
+			m_sampleOpenList.AddToTail( node );
+		}
+
+		addedTo.AddToTail( node );
+	}
+
+	// check each node that was connected to once, also on the thread pool
+	addedTo.Sort( CompareNodeIDs );
+	for ( int i = addedTo.Count() - 1; i > 0; --i )
+	{
+		if ( addedTo[i] == addedTo[i-1] )
+		{
+			addedTo.Remove( i );
+		}
+	}
+
+	ParallelProcess( "CNavMesh::UpdateNodeAttributes", addedTo.Base(), addedTo.Count(), this, &CNavMesh::UpdateNodeAttributes );
+
+	return true;
 }
 
 
@@ -0,0 +1,130 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose:
+//
+// $NoKeywords: $
+//
+//=============================================================================//
+// nav_grid.cpp
+// Packed area bounds for each cell of the nav mesh grid
+
+#include "cbase.h"
+
+#include "nav_mesh.h"
+#include "nav_grid.h"
+#include "tier0/vprof.h"
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include "tier0/memdbgon.h"
+
+ConVar nav_grid_index( "nav_grid_index", "1", FCVAR_CHEAT, "Test nav areas four at a time against packed copies of their bounds in spatial queries." );
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Discard all blocks
+ */
+void CNavGridIndex::Reset( void )
+{
+	m_blocks.Purge();
+	m_cellFirstBlock.Purge();
+	m_isDirty = true;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Return the blocks for the given cell, rebuilding the index first if it is out of date.
+ * Returns NULL if the index is disabled.
+ */
+const NavGridBlock *CNavGridIndex::GetCell( const CUtlVector< NavAreaVector > &grid, int iGrid )
+{
+	if ( !nav_grid_index.GetBool() )
+		return NULL;
+
+	if ( m_isDirty || m_cellFirstBlock.Count() != grid.Count() + 1 )
+	{
+		Build( grid );
+	}
+
+	return m_blocks.Base() + m_cellFirstBlock[ iGrid ];
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Copy the bounds of every area in the grid into blocks, four areas per block
+ */
+void CNavGridIndex::Build( const CUtlVector< NavAreaVector > &grid )
+{
+	VPROF_BUDGET( "CNavGridIndex::Build", "NextBot" );
+
+	m_cellFirstBlock.SetCount( grid.Count() + 1 );
+
+	int blockCount = 0;
+	FOR_EACH_VEC( grid, it )
+	{
+		m_cellFirstBlock[ it ] = blockCount;
+		blockCount += ( grid[ it ].Count() + 3 ) / 4;
+	}
+	m_cellFirstBlock[ grid.Count() ] = blockCount;
+
+	m_blocks.SetCount( blockCount );
+
+	// lanes past the end of a cell have inverted extents, so they never pass a test
+	for( int b=0; b<blockCount; ++b )
+	{
+		NavGridBlock &block = m_blocks[ b ];
+		block.loX = block.loY = block.loZ = Four_FLT_MAX;
+		block.hiX = block.hiY = block.hiZ = Four_Negative_FLT_MAX;
+		block.invDx = block.invDy = Four_Zeros;
+		block.nwZ = block.neZ = block.swZ = block.seZ = Four_Zeros;
+	}
+
+	FOR_EACH_VEC( grid, it )
+	{
+		const NavAreaVector &areaVector = grid[ it ];
+		NavGridBlock *cellBlocks = &m_blocks[ m_cellFirstBlock[ it ] ];
+
+		FOR_EACH_VEC( areaVector, a )
+		{
+			const CNavArea *area = areaVector[ a ];
+			NavGridBlock &block = cellBlocks[ a / 4 ];
+			int lane = a & 3;
+
+			Vector nw = area->GetCorner( NORTH_WEST );
+			Vector ne = area->GetCorner( NORTH_EAST );
+			Vector sw = area->GetCorner( SOUTH_WEST );
+			Vector se = area->GetCorner( SOUTH_EAST );
+
+			SubFloat( block.loX, lane ) = nw.x;
+			SubFloat( block.loY, lane ) = nw.y;
+			SubFloat( block.loZ, lane ) = MIN( MIN( nw.z, se.z ), MIN( ne.z, sw.z ) );
+			SubFloat( block.hiX, lane ) = se.x;
+			SubFloat( block.hiY, lane ) = se.y;
+			SubFloat( block.hiZ, lane ) = MAX( MAX( nw.z, se.z ), MAX( ne.z, sw.z ) );
+
+			if ( ( se.x - nw.x ) > 0.0f && ( se.y - nw.y ) > 0.0f )
+			{
+				SubFloat( block.invDx, lane ) = 1.0f / ( se.x - nw.x );
+				SubFloat( block.invDy, lane ) = 1.0f / ( se.y - nw.y );
+				SubFloat( block.nwZ, lane ) = nw.z;
+				SubFloat( block.neZ, lane ) = ne.z;
+				SubFloat( block.swZ, lane ) = sw.z;
+				SubFloat( block.seZ, lane ) = se.z;
+			}
+			else
+			{
+				// degenerate areas are flat at their north-east height
+				SubFloat( block.invDx, lane ) = 0.0f;
+				SubFloat( block.invDy, lane ) = 0.0f;
+				SubFloat( block.nwZ, lane ) = ne.z;
+				SubFloat( block.neZ, lane ) = ne.z;
+				SubFloat( block.swZ, lane ) = ne.z;
+				SubFloat( block.seZ, lane ) = ne.z;
+			}
+		}
+	}
+
+	m_isDirty = false;
+}
@@ -0,0 +1,120 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose:
+//
+// $NoKeywords: $
+//
+//=============================================================================//
+// nav_grid.h
+// Packed area bounds for each cell of the nav mesh grid
+
+#ifndef _NAV_GRID_H_
+#define _NAV_GRID_H_
+
+#include "utlvector.h"
+#include "mathlib/ssemath.h"
+#include "nav.h"
+#include "nav_area.h"
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * The extents and corner heights of four areas in a grid cell, stored one value per lane so a
+ * position or extent can be tested against all four at once. Lanes follow the order of the areas
+ * in the cell's NavAreaVector, so block N holds areas 4N through 4N+3.
+ */
+struct NavGridBlock
+{
+	fltx4 loX, loY, loZ;
+	fltx4 hiX, hiY, hiZ;
+	fltx4 invDx, invDy;						// zero for degenerate areas
+	fltx4 nwZ, neZ, swZ, seZ;				// corner heights - all the north-east height for degenerate areas, matching CNavArea::GetZ()
+
+	/**
+	 * Return a mask of the lanes whose 2D extents contain (x,y), as in CNavArea::IsOverlapping( pos )
+	 */
+	int ContainsMask( const fltx4 &x, const fltx4 &y ) const
+	{
+		fltx4 inside = AndSIMD( CmpGeSIMD( x, loX ), CmpLeSIMD( x, hiX ) );
+		inside = AndSIMD( inside, AndSIMD( CmpGeSIMD( y, loY ), CmpLeSIMD( y, hiY ) ) );
+		return TestSignSIMD( inside );
+	}
+
+	/**
+	 * Return a mask of the lanes whose extents overlap the given one, as in Extent::IsOverlapping()
+	 */
+	int OverlapMask( const fltx4 &queryLoX, const fltx4 &queryLoY, const fltx4 &queryLoZ,
+					 const fltx4 &queryHiX, const fltx4 &queryHiY, const fltx4 &queryHiZ ) const
+	{
+		fltx4 overlap = AndSIMD( CmpLeSIMD( loX, queryHiX ), CmpGeSIMD( hiX, queryLoX ) );
+		overlap = AndSIMD( overlap, AndSIMD( CmpLeSIMD( loY, queryHiY ), CmpGeSIMD( hiY, queryLoY ) ) );
+		overlap = AndSIMD( overlap, AndSIMD( CmpLeSIMD( loZ, queryHiZ ), CmpGeSIMD( hiZ, queryLoZ ) ) );
+		return TestSignSIMD( overlap );
+	}
+
+	/**
+	 * Return the height of each area at (x,y), as in CNavArea::GetZ()
+	 */
+	fltx4 GetZ( const fltx4 &x, const fltx4 &y ) const
+	{
+		fltx4 u = MulSIMD( SubSIMD( x, loX ), invDx );
+		fltx4 v = MulSIMD( SubSIMD( y, loY ), invDy );
+
+		// clamp Z values to (x,y) volume
+		u = MinSIMD( MaxSIMD( u, Four_Zeros ), Four_Ones );
+		v = MinSIMD( MaxSIMD( v, Four_Zeros ), Four_Ones );
+
+		fltx4 northZ = AddSIMD( nwZ, MulSIMD( u, SubSIMD( neZ, nwZ ) ) );
+		fltx4 southZ = AddSIMD( swZ, MulSIMD( u, SubSIMD( seZ, swZ ) ) );
+
+		return AddSIMD( northZ, MulSIMD( v, SubSIMD( southZ, northZ ) ) );
+	}
+
+	/**
+	 * Return the squared distance from 'pos' to the point on each area closest to (x,y),
+	 * as in CNavArea::GetClosestPointOnArea()
+	 */
+	fltx4 GetClosestPointDistanceSqr( const fltx4 &x, const fltx4 &y, const FourVectors &pos ) const
+	{
+		fltx4 closeX = MinSIMD( MaxSIMD( x, loX ), hiX );
+		fltx4 closeY = MinSIMD( MaxSIMD( y, loY ), hiY );
+		fltx4 closeZ = GetZ( closeX, closeY );
+
+		fltx4 dx = SubSIMD( closeX, pos.x );
+		fltx4 dy = SubSIMD( closeY, pos.y );
+		fltx4 dz = SubSIMD( closeZ, pos.z );
+
+		return AddSIMD( AddSIMD( MulSIMD( dx, dx ), MulSIMD( dy, dy ) ), MulSIMD( dz, dz ) );
+	}
+};
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Packed copies of the area bounds in each cell of CNavMesh's grid, so spatial queries can rule
+ * out areas four at a time without touching the areas themselves. Only the areas that pass are
+ * dereferenced to finish the query.
+ *
+ * The copies are rebuilt on the first lookup after the grid or any area's shape changes. Areas
+ * are reshaped in place while editing and generating, so the mesh doesn't use the index then.
+ */
+class CNavGridIndex
+{
+public:
+	CNavGridIndex( void ) : m_isDirty( true ) { }
+
+	void Reset( void );											// discard all blocks
+	void Invalidate( void )		{ m_isDirty = true; }			// the grid or an area's shape changed
+
+	const NavGridBlock *GetCell( const CUtlVector< NavAreaVector > &grid, int iGrid );	// return the blocks for the given cell, or NULL if the index can't be used right now
+
+private:
+	void Build( const CUtlVector< NavAreaVector > &grid );
+
+	CUtlVector< NavGridBlock, CUtlMemoryAligned< NavGridBlock, 16 > > m_blocks;
+	CUtlVector< int > m_cellFirstBlock;							// index of each cell's first block in m_blocks
+	bool m_isDirty;
+};
+
+
+#endif // _NAV_GRID_H_
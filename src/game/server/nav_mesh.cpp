@@ -206,21 +206,22 @@ void CNavMesh::DestroyNavigationMesh( bool incremental )
 	{
 		// destroy the grid
 		m_grid.RemoveAll();
+		m_gridIndex.Reset();
 		m_gridSizeX = 0;
 		m_gridSizeY = 0;
 	}
 
-	// clear the hash table
-	for( int i=0; i<HASH_TABLE_SIZE; ++i )
-	{
-		m_hashTable[i] = NULL;
-	}
+	// clear the ID lookup
+	m_areasByID.RemoveAll();
 
 	if ( !incremental )
 	{
 		m_areaCount = 0;
 	}
 
+	// travel distances are recomputed by analysis, or searched as needed
+	m_travelDistances.Reset();
+
 	if ( !incremental )
 	{
 		// Reset the next area and ladder IDs to 1
@@ -254,7 +255,12 @@ void CNavMesh::Update( void )
 
 	if (IsGenerating())
 	{
+		GenerationStateType state = m_generationState;
+		double startTime = Plat_FloatTime();
+
 		UpdateGeneration( 0.03 );
+
+		m_generationStateTime[ state ] += Plat_FloatTime() - startTime;
 		return; // don't bother trying to draw stuff while we're generating
 	}
 
@@ -458,6 +464,7 @@ void CNavMesh::AllocateGrid( float minX, float maxX, float minY, float maxY )
 	m_gridSizeY = (int)((maxY - minY) / m_gridCellSize) + 1;
 
 	m_grid.SetCount( m_gridSizeX * m_gridSizeY );
+	m_gridIndex.Invalidate();
 }
 
 //--------------------------------------------------------------------------------------------------------------
@@ -485,24 +492,26 @@ void CNavMesh::AddNavArea( CNavArea *area )
 			m_grid[ x + y*m_gridSizeX ].AddToTail( const_cast<CNavArea *>( area ) );
 		}
 	}
+	m_gridIndex.Invalidate();
 
-	// add to hash table
-	int key = ComputeHashKey( area->GetID() );
-
-	if (m_hashTable[key])
+	// add to ID lookup
+	unsigned int id = area->GetID();
+	if ( id > NAV_MAX_AREA_ID )
 	{
-		// add to head of list in this slot
-		area->m_prevHash = NULL;
-		area->m_nextHash = m_hashTable[key];
-		m_hashTable[key]->m_prevHash = area;
-		m_hashTable[key] = area;
+		ExecuteNTimes( 10, Warning( "Nav area #%u is past the largest area ID and can't be looked up by ID - use nav_compress_id\n", id ) );
 	}
-	else
+	else if ( id >= (unsigned int)m_areasByID.Count() )
 	{
-		// first entry in this slot
-		m_hashTable[key] = area;
-		area->m_nextHash = NULL;
-		area->m_prevHash = NULL;
+		int oldCount = m_areasByID.Count();
+		m_areasByID.SetCount( id + 1 );
+		for( int i=oldCount; i<m_areasByID.Count(); ++i )
+		{
+			m_areasByID[i] = NULL;
+		}
+	}
+	if ( id <= NAV_MAX_AREA_ID )
+	{
+		m_areasByID[ id ] = area;
 	}
 
 	if ( area->GetAttributes() & NAV_MESH_TRANSIENT )
@@ -532,28 +541,13 @@ void CNavMesh::RemoveNavArea( CNavArea *area )
 			m_grid[ x + y*m_gridSizeX ].FindAndRemove( area );
 		}
 	}
+	m_gridIndex.Invalidate();
 
-	// remove from hash table
-	int key = ComputeHashKey( area->GetID() );
-
-	if (area->m_prevHash)
+	// remove from ID lookup - the slot may already belong to another area
+	unsigned int id = area->GetID();
+	if ( id < (unsigned int)m_areasByID.Count() && m_areasByID[ id ] == area )
 	{
-		area->m_prevHash->m_nextHash = area->m_nextHash;
-	}
-	else
-	{
-		// area was at start of list
-		m_hashTable[key] = area->m_nextHash;
-
-		if (m_hashTable[key])
-		{
-			m_hashTable[key]->m_prevHash = NULL;
-		}
-	}
-
-	if (area->m_nextHash)
-	{
-		area->m_nextHash->m_prevHash = area->m_prevHash;
+		m_areasByID[ id ] = NULL;
 	}
 
 	if ( area->GetAttributes() & NAV_MESH_TRANSIENT )
@@ -698,14 +692,39 @@ CNavArea *CNavMesh::GetNavArea( const Vector &pos, float beneathLimit ) const
 	int x = WorldToGridX( pos.x );
 	int y = WorldToGridY( pos.y );
 	NavAreaVector *areaVector = &m_grid[ x + y*m_gridSizeX ];
+	const NavGridBlock *blocks = GetGridBlocks( x + y*m_gridSizeX );
 
 	// search cell list to find correct area
 	CNavArea *use = NULL;
 	float useZ = -99999999.9f;
 	Vector testPos = pos + Vector( 0, 0, 5 );
 
+	fltx4 testX = ReplicateX4( testPos.x );
+	fltx4 testY = ReplicateX4( testPos.y );
+	fltx4 testHiZ = ReplicateX4( testPos.z );
+	fltx4 testLoZ = ReplicateX4( pos.z - beneathLimit );
+	int candidates = 0xF;
+
 	FOR_EACH_VEC( (*areaVector), it )
 	{
+		// only look at areas whose packed bounds put them under the position and in height range
+		if ( blocks )
+		{
+			if ( ( it & 3 ) == 0 )
+			{
+				const NavGridBlock &block = blocks[ it >> 2 ];
+				candidates = block.ContainsMask( testX, testY );
+				if ( candidates )
+				{
+					fltx4 z = block.GetZ( testX, testY );
+					candidates &= TestSignSIMD( AndSIMD( CmpLeSIMD( z, testHiZ ), CmpGeSIMD( z, testLoZ ) ) );
+				}
+			}
+
+			if ( !( candidates & ( 1 << ( it & 3 ) ) ) )
+				continue;
+		}
+
 		CNavArea *area = (*areaVector)[ it ];
 
 		// check if position is within 2D boundaries of this area
@@ -766,14 +785,39 @@ CNavArea *CNavMesh::GetNavArea( CBaseEntity *pEntity, int nFlags, float flBeneat
 	int x = WorldToGridX( testPos.x );
 	int y = WorldToGridY( testPos.y );
 	NavAreaVector *areaVector = &m_grid[ x + y*m_gridSizeX ];
+	const NavGridBlock *blocks = GetGridBlocks( x + y*m_gridSizeX );
 
 	// search cell list to find correct area
 	CNavArea *use = NULL;
 	float useZ = -99999999.9f;
 
+	fltx4 testX = ReplicateX4( testPos.x );
+	fltx4 testY = ReplicateX4( testPos.y );
+	fltx4 testHiZ = ReplicateX4( testPos.z + flStepHeight );
+	fltx4 testLoZ = ReplicateX4( testPos.z - flBeneathLimit );
+	int candidates = 0xF;
+
 	bool bSkipBlockedAreas = ( ( nFlags & GETNAVAREA_ALLOW_BLOCKED_AREAS ) == 0 );
 	FOR_EACH_VEC( (*areaVector), it )
 	{
+		// only look at areas whose packed bounds put them under the position and in height range
+		if ( blocks )
+		{
+			if ( ( it & 3 ) == 0 )
+			{
+				const NavGridBlock &block = blocks[ it >> 2 ];
+				candidates = block.ContainsMask( testX, testY );
+				if ( candidates )
+				{
+					fltx4 z = block.GetZ( testX, testY );
+					candidates &= TestSignSIMD( AndSIMD( CmpLeSIMD( z, testHiZ ), CmpGeSIMD( z, testLoZ ) ) );
+				}
+			}
+
+			if ( !( candidates & ( 1 << ( it & 3 ) ) ) )
+				continue;
+		}
+
 		CNavArea *pArea = (*areaVector)[ it ];
 
 		// check if position is within 2D boundaries of this area
@@ -880,6 +924,11 @@ CNavArea *CNavMesh::GetNearestNavArea( const Vector &pos, bool anyZ, float maxDi
 
 	int shiftLimit = ceil(maxDist / m_gridCellSize);
 
+	fltx4 sourceX = ReplicateX4( source.x );
+	fltx4 sourceY = ReplicateX4( source.y );
+	FourVectors queryPos;
+	queryPos.DuplicateVector( pos );
+
 	//
 	// Search in increasing rings out from origin, starting with cell
 	// that contains the given position.
@@ -907,10 +956,25 @@ CNavArea *CNavMesh::GetNearestNavArea( const Vector &pos, bool anyZ, float maxDi
 					continue;
 
 				NavAreaVector *areaVector = &m_grid[ x + y*m_gridSizeX ];
+				const NavGridBlock *blocks = GetGridBlocks( x + y*m_gridSizeX );
+				int candidates = 0xF;
 
 				// find closest area in this cell
 				FOR_EACH_VEC( (*areaVector), it )
 				{
+					// only look at areas whose packed bounds could be closer than the closest so far
+					if ( blocks )
+					{
+						if ( ( it & 3 ) == 0 )
+						{
+							fltx4 distSq = blocks[ it >> 2 ].GetClosestPointDistanceSqr( sourceX, sourceY, queryPos );
+							candidates = TestSignSIMD( CmpLtSIMD( distSq, ReplicateX4( closeDistSq ) ) );
+						}
+
+						if ( !( candidates & ( 1 << ( it & 3 ) ) ) )
+							continue;
+					}
+
 					CNavArea *area = (*areaVector)[ it ];
 
 					// skip if we've already visited this area
@@ -1026,17 +1090,10 @@ CNavArea *CNavMesh::GetNavAreaByID( unsigned int id ) const
 	if (id == 0)
 		return NULL;
 
-	int key = ComputeHashKey( id );
-
-	for( CNavArea *area = m_hashTable[key]; area; area = area->m_nextHash )
-	{
-		if (area->GetID() == id)
-		{
-			return area;
-		}
-	}
+	if (id >= (unsigned int)m_areasByID.Count())
+		return NULL;
 
-	return NULL;
+	return m_areasByID[ id ];
 }
 
 //--------------------------------------------------------------------------------------------------------------
@@ -2733,6 +2790,9 @@ void CommandNavCompressID( void )
 
 	CNavArea::CompressIDs();
 	CNavLadder::CompressIDs();
+
+	// the travel distance table is keyed by area ID
+	TheNavMesh->ResetTravelDistances();
 }
 static ConCommand nav_compress_id( "nav_compress_id", CommandNavCompressID, "Re-orders area and ladder ID's so they are continuous.", FCVAR_GAMEDLL | FCVAR_CHEAT );
 
@@ -26,6 +26,8 @@
 #include "nav.h"
 #include "nav_area.h"
 #include "nav_colors.h"
+#include "nav_distance.h"
+#include "nav_grid.h"
 
 
 class CNavArea;
@@ -323,6 +325,9 @@ public:
 	CNavArea *GetNearestNavArea( const Vector &pos, bool anyZ = false, float maxDist = 10000.0f, bool checkLOS = false, bool checkGround = true, int team = TEAM_ANY ) const;
 	CNavArea *GetNearestNavArea( CBaseEntity *pEntity, int nGetNavAreaFlags = GETNAVAREA_CHECK_GROUND, float maxDist = 10000.0f ) const;
 
+	float GetTravelDistance( const CNavArea *from, const CNavArea *to )	{ return m_travelDistances.GetTravelDistance( from, to ); }	// return shortest travel distance between areas from the precomputed table or cache, -1 if unreachable
+	void ResetTravelDistances( void )		{ m_travelDistances.Reset(); }		// discard travel distances when the areas they were computed for change
+
 	Place GetPlace( const Vector &pos ) const;							// return Place at given coordinate
 	const char *PlaceToName( Place place ) const;						// given a place, return its name
 	Place NameToPlace( const char *name ) const;						// given a place name, return a place ID or zero if no place is defined
@@ -570,6 +575,9 @@ public:
 
 		Extent areaExtent;
 
+		fltx4 queryLoX = ReplicateX4( extent.lo.x ), queryLoY = ReplicateX4( extent.lo.y ), queryLoZ = ReplicateX4( extent.lo.z );
+		fltx4 queryHiX = ReplicateX4( extent.hi.x ), queryHiY = ReplicateX4( extent.hi.y ), queryHiZ = ReplicateX4( extent.hi.z );
+
 		// get list in cell that contains position
 		int startX = WorldToGridX( extent.lo.x );
 		int endX = WorldToGridX( extent.hi.x );
@@ -588,10 +596,24 @@ public:
 				}
 
 				NavAreaVector *areaVector = &m_grid[ iGrid ];
+				const NavGridBlock *blocks = GetGridBlocks( iGrid );
+				int overlapMask = 0xF;
 
 				// find closest area in this cell
 				FOR_EACH_VEC( (*areaVector), it )
 				{
+					// rule out four areas at a time by their packed extents
+					if ( blocks )
+					{
+						if ( ( it & 3 ) == 0 )
+						{
+							overlapMask = blocks[ it >> 2 ].OverlapMask( queryLoX, queryLoY, queryLoZ, queryHiX, queryHiY, queryHiZ );
+						}
+
+						if ( !( overlapMask & ( 1 << ( it & 3 ) ) ) )
+							continue;
+					}
+
 					CNavArea *area = (*areaVector)[ it ];
 
 					// skip if we've already visited this area
@@ -633,6 +655,9 @@ public:
 
 		Extent areaExtent;
 
+		fltx4 queryLoX = ReplicateX4( extent.lo.x ), queryLoY = ReplicateX4( extent.lo.y ), queryLoZ = ReplicateX4( extent.lo.z );
+		fltx4 queryHiX = ReplicateX4( extent.hi.x ), queryHiY = ReplicateX4( extent.hi.y ), queryHiZ = ReplicateX4( extent.hi.z );
+
 		// get list in cell that contains position
 		int startX = WorldToGridX( extent.lo.x );
 		int endX = WorldToGridX( extent.hi.x );
@@ -651,10 +676,24 @@ public:
 				}
 
 				NavAreaVector *areaVector = &m_grid[ iGrid ];
+				const NavGridBlock *blocks = GetGridBlocks( iGrid );
+				int overlapMask = 0xF;
 
 				// find closest area in this cell
 				for( int v=0; v<areaVector->Count(); ++v )
 				{
+					// rule out four areas at a time by their packed extents
+					if ( blocks )
+					{
+						if ( ( v & 3 ) == 0 )
+						{
+							overlapMask = blocks[ v >> 2 ].OverlapMask( queryLoX, queryLoY, queryLoZ, queryHiX, queryHiY, queryHiZ );
+						}
+
+						if ( !( overlapMask & ( 1 << ( v & 3 ) ) ) )
+							continue;
+					}
+
 					CNavArea *area = areaVector->Element( v );
 
 					// skip if we've already visited this area
@@ -1065,6 +1104,7 @@ private:
 	friend class CNavUIBasePanel;
 
 	mutable CUtlVector<NavAreaVector> m_grid;
+	mutable CNavGridIndex m_gridIndex;							// packed area bounds for each grid cell
 	float m_gridCellSize;										// the width/height of a grid cell for spatially partitioning nav areas for fast access
 	int m_gridSizeX;
 	int m_gridSizeY;
@@ -1076,12 +1116,13 @@ private:
 	bool m_isOutOfDate;											// true if the Navigation Mesh is older than the actual BSP
 	bool m_isAnalyzed;											// true if the Navigation Mesh needs analysis
 
-	enum { HASH_TABLE_SIZE = 256 };
-	CNavArea *m_hashTable[ HASH_TABLE_SIZE ];					// hash table to optimize lookup by ID
-	int ComputeHashKey( unsigned int id ) const;				// returns a hash key for the given nav area ID
+	CNavTravelDistances m_travelDistances;						// area-to-area travel distances, stored with the mesh when small enough
+
+	CUtlVector< CNavArea * > m_areasByID;						// areas indexed by ID for fast lookup, NULL for unused IDs
 
 	int WorldToGridX( float wx ) const;							// given X component, return grid index
 	int WorldToGridY( float wy ) const;							// given Y component, return grid index
+	const NavGridBlock *GetGridBlocks( int iGrid ) const;		// return packed bounds of the areas in the given cell, or NULL if they can't be used
 	void AllocateGrid( float minX, float maxX, float minY, float maxY );	// clear and reset the grid to the given extents
 	void GridToWorld( int gridX, int gridY, Vector *pos ) const;
 
@@ -1156,15 +1197,46 @@ private:
 
 	CNavNode *m_currentNode;									// the current node we are sampling from
 	NavDirType m_generationDir;
-	CNavNode *AddNode( const Vector &destPos, const Vector &destNormal, NavDirType dir, CNavNode *source, bool isOnDisplacement, float obstacleHeight, float flObstacleStartDist, float flObstacleEndDist );		// add a nav node and connect it, update current node
+	CNavNode *AddNode( const Vector &destPos, const Vector &destNormal, NavDirType dir, CNavNode *source, bool isOnDisplacement, float obstacleHeight, float flObstacleStartDist, float flObstacleEndDist, bool updateAttributes = true );		// add a nav node and connect it, update current node
+	void UpdateNodeAttributes( CNavNode *&node );				// check for crouch and cliff attributes of a sampled node
 
 	NavLadderVector m_ladders;									// list of ladder navigation representations
 	void BuildLadders( void );
 	void DestroyLadders( void );
 
 	bool SampleStep( void );									// sample the walkable areas of the map
+
+	struct NavSample											// a step from a sampled node in one direction
+	{
+		CNavNode *node;
+		NavDirType dir;
+		bool isValid;											// true if there is walkable space for a node at the end of the step
+		Vector pos;
+		Vector normal;
+		bool isOnDisplacement;
+		float obstacleHeight;
+		float obstacleStartDist;
+		float obstacleEndDist;
+	};
+	bool SampleAdjacent( CNavNode *node, NavDirType dir, NavSample *sample ) const;	// trace a step from node, return true if there's walkable space at the end
+	bool SampleWave( void );									// sample the walkable areas of the map, a wave of steps at a time on the thread pool
+	void ComputeSample( NavSample &sample );
+	bool m_generateInParallel;									// use SampleWave() and test areas on the thread pool for this generation
+	CUtlVector< CNavNode * > m_sampleOpenList;					// nodes to search from in coming waves
+	int m_sampleOpenIndex;
+	CUtlVector< NavSample > m_samples;							// steps in the current wave
+
 	void CreateNavAreasFromNodes( void );						// cover all of the sampled nodes with nav areas
 
+	struct NavAreaCandidate
+	{
+		CNavNode *node;
+		bool isValid;
+	};
+	void TestAreaCandidate( NavAreaCandidate &candidate );		// TestArea() for m_candidateWidth x m_candidateHeight, on the thread pool
+	int m_candidateWidth;
+	int m_candidateHeight;
+
 	bool TestArea( CNavNode *node, int width, int height );		// check if an area of size (width, height) can fit, starting from node as upper left corner
 	int BuildArea( CNavNode *node, int width, int height );		// create a CNavArea of size (width, height) starting fom node at upper left corner
 	bool CheckObstacles( CNavNode *node, int width, int height, int x, int y );
@@ -1201,11 +1273,15 @@ private:
 		FIND_LIGHT_INTENSITY,
 		COMPUTE_MESH_VISIBILITY,
 		CUSTOM,													// mod-specific generation step
+		COMPUTE_TRAVEL_DISTANCES,
 		SAVE_NAV_MESH,
 
 		NUM_GENERATION_STATES
 	}
 	m_generationState;											// the state of the generation process
+	float m_generationStateTime[ NUM_GENERATION_STATES ];		// seconds spent in each state of the current generation
+	void ResetGenerationStateTimes( void );
+	void PrintGenerationStateTimes( void ) const;
 	enum GenerationModeType
 	{
 		GENERATE_NONE,
@@ -1296,12 +1372,6 @@ inline void CNavMesh::DestroyArea( CNavArea *pArea ) const
 	delete pArea;
 }
 
-//--------------------------------------------------------------------------------------------------------------
-inline int CNavMesh::ComputeHashKey( unsigned int id ) const
-{
-	return id & 0xFF;
-}
-
 //--------------------------------------------------------------------------------------------------------------
 inline int CNavMesh::WorldToGridX( float wx ) const
 { 
@@ -1329,6 +1399,17 @@ inline int CNavMesh::WorldToGridY( float wy ) const
 }
 
 
+//--------------------------------------------------------------------------------------------------------------
+inline const NavGridBlock *CNavMesh::GetGridBlocks( int iGrid ) const
+{
+	// areas are reshaped in place while editing and generating, without the index knowing
+	if ( m_isEditing || IsGenerating() )
+		return NULL;
+
+	return m_gridIndex.GetCell( m_grid, iGrid );
+}
+
+
 //--------------------------------------------------------------------------------------------------------------
 inline unsigned int CNavMesh::GetGenerationTraceMask( void ) const
 {
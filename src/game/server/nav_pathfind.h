@@ -14,7 +14,7 @@
 
 #include "tier0/vprof.h"
 #include "mathlib/ssemath.h"
-#include "nav_area.h"
+#include "nav_mesh.h"
 
 #ifdef STAGING_ONLY
 extern int g_DebugPathfindCounter;
@@ -458,6 +458,18 @@ float NavAreaTravelDistance( CNavArea *startArea, CNavArea *endArea, CostFunctor
 }
 
 
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Compute the shortest distance between two areas, from the mesh's travel distance table when
+ * it has one. Blocked areas and cost penalties are ignored - use the version that takes a cost
+ * functor when they matter. Return -1 if can't reach 'endArea' from 'startArea'.
+ */
+inline float NavAreaTravelDistance( CNavArea *startArea, CNavArea *endArea )
+{
+	return TheNavMesh->GetTravelDistance( startArea, endArea );
+}
+
+
 
 //--------------------------------------------------------------------------------------------------------------
 /**
@@ -44,6 +44,7 @@
 #include "positionwatcher.h"
 #include "tier1/callqueue.h"
 #include "vphysics/constraints.h"
+#include "tickprofiler.h"
 
 #ifdef PORTAL
 #include "portal_physics_collisionevent.h"
@@ -1677,6 +1678,8 @@ void PhysFrame( float deltaTime )
 	if ( !g_PhysicsHook.ShouldSimulate() )
 		return;
 
+	TICKPROF_SCOPE( TICKPROF_PHYSICS, "PhysFrame" );
+
 	// Trap interrupts and clock changes
 	if ( deltaTime > 1.0f || deltaTime < 0.0f )
 	{
@@ -33,6 +33,7 @@
 #include "vphysicsupdateai.h"
 #include "tier0/vcrmode.h"
 #include "pushentity.h"
+#include "tickprofiler.h"
 
 // memdbgon must be the last include file in a .cpp file!!!
 #include "tier0/memdbgon.h"
@@ -938,6 +939,7 @@ void CBaseEntity::PhysicsDispatchThink( BASEPTR thinkFunc )
 	if ( thinkFunc )
 	{
 		MDLCACHE_CRITICAL_SECTION();
+		TICKPROF_SCOPE( TICKPROF_THINK, GetClassname() );
 		(this->*thinkFunc)();
 	}
 
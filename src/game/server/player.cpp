@@ -68,6 +68,7 @@
 #include "dt_utlvector_send.h"
 #include "vote_controller.h"
 #include "ai_speech.h"
+#include "tickprofiler.h"
 
 #if defined USES_ECON_ITEMS
 #include "econ_wearable.h"
@@ -3431,6 +3432,8 @@ ConVar sv_usercmd_custom_random_seed( "sv_usercmd_custom_random_seed", "1", FCVA
 void CBasePlayer::ProcessUsercmds( CUserCmd *cmds, int numcmds, int totalcmds,
 	int dropped_packets, bool paused )
 {
+	TICKPROF_SCOPE( TICKPROF_USERCMD, GetClassname() );
+
 	CCommandContext *ctx = AllocCommandContext();
 	Assert( ctx );
 
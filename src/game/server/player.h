@@ -1134,6 +1134,7 @@ private:
 
 	friend class CPlayerMove;
 	friend class CPlayerClass;
+	friend class CMovementReplay;
 
 	// Player name
 	char					m_szNetname[MAX_PLAYER_NAME_LENGTH];
@@ -304,6 +304,7 @@ void CPlayerMove::RunPostThink( CBasePlayer *player )
 }
 
 void CommentarySystem_PePlayerRunCommand( CBasePlayer *player, CUserCmd *ucmd );
+void MovementReplay_RecordMove( CBasePlayer *pPlayer, const CMoveData *pMove );
 
 //-----------------------------------------------------------------------------
 // Purpose: Runs movement commands for the player
@@ -432,6 +433,7 @@ void CPlayerMove::RunCommand ( CBasePlayer *player, CUserCmd *ucmd, IMoveHelper
 	{
 		VPROF( "g_pGameMovement->ProcessMovement()" );
 		Assert( g_pGameMovement );
+		MovementReplay_RecordMove( player, g_pMoveData );
 		g_pGameMovement->ProcessMovement( player, g_pMoveData );
 	}
 	else
@@ -0,0 +1,473 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Always-on server tick profiler.
+//
+// Every profiled scope becomes an event in a large ring buffer, and every
+// tick a record with the tick's total time and per-category self time. Ticks
+// keep a range of event indices; once the event ring wraps past the start of
+// a tick, its per-class breakdown is no longer complete, but its totals are.
+//
+// $NoKeywords: $
+//=============================================================================//
+
+#include "cbase.h"
+#include "tickprofiler.h"
+#include "tier0/fasttimer.h"
+#include "filesystem.h"
+#include "utlbuffer.h"
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include "tier0/memdbgon.h"
+
+static ConVar sv_tickprofile( "sv_tickprofile", "1", 0, "Record where the time goes in each server tick. See tickprofile_dump and tickprofile_trace." );
+static ConVar sv_tickprofile_budget( "sv_tickprofile_budget", "0", 0, "Print a breakdown of any tick that takes longer than this many milliseconds (0 disables)." );
+
+#define TICKPROF_MAX_TICKS		256
+#define TICKPROF_MAX_EVENTS		( 1 << 17 )
+#define TICKPROF_MAX_DEPTH		32
+#define TICKPROF_REPORT_ENTRIES	10
+
+static const char *s_pszCategoryNames[TICKPROF_CATEGORY_COUNT] =
+{
+	"gamesystem",
+	"think",
+	"eventqueue",
+	"physics",
+	"usercmd",
+};
+
+struct TickProfileEvent_t
+{
+	const char	*m_pszName;
+	uint64		m_nStart;
+	uint32		m_nCycles;
+	uint32		m_nSelfCycles;
+	uint8		m_nCategory;
+	uint8		m_nDepth;
+};
+
+struct TickProfileRecord_t
+{
+	int			m_nTick;
+	uint64		m_nFrameStart;
+	uint64		m_nFrameCycles;		// Just GameFrame
+	uint64		m_nCycles;			// GameFrame plus anything profiled between frames
+	uint64		m_nCategoryCycles[TICKPROF_CATEGORY_COUNT];
+	uint64		m_nFirstEvent;
+	uint64		m_nEndEvent;
+};
+
+struct TickProfileStackEntry_t
+{
+	const char	*m_pszName;
+	uint64		m_nStart;
+	uint64		m_nChildCycles;
+	int			m_nCategory;
+};
+
+// Self time of one name within a tick, for reports
+struct TickProfileTotal_t
+{
+	const char	*m_pszName;
+	int			m_nCategory;
+	int			m_nCalls;
+	uint64		m_nSelfCycles;
+};
+
+static inline uint32 ClampCycles( uint64 nCycles )
+{
+	return ( nCycles > 0xFFFFFFFFull ) ? 0xFFFFFFFF : (uint32)nCycles;
+}
+
+static inline float CyclesToMilliseconds( uint64 nCycles )
+{
+	return (float)CCycleCount( nCycles ).GetMillisecondsF();
+}
+
+static int __cdecl TickProfileTotalCompare( const TickProfileTotal_t *pLeft, const TickProfileTotal_t *pRight )
+{
+	if ( pLeft->m_nSelfCycles == pRight->m_nSelfCycles )
+		return 0;
+	return ( pLeft->m_nSelfCycles > pRight->m_nSelfCycles ) ? -1 : 1;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose:
+//-----------------------------------------------------------------------------
+class CTickProfiler : public CAutoGameSystem
+{
+public:
+	CTickProfiler() : CAutoGameSystem( "CTickProfiler" )
+	{
+		m_nDepth = 0;
+		m_bInTick = false;
+		m_flNextBudgetReport = 0.0f;
+		Clear();
+	}
+
+	// IGameSystem
+	virtual bool Init()
+	{
+		m_Events.SetCount( TICKPROF_MAX_EVENTS );
+		m_Ticks.SetCount( TICKPROF_MAX_TICKS );
+		return true;
+	}
+
+	// Event names are mostly pooled strings, which don't outlive the level
+	virtual void LevelShutdownPostEntity() { Clear(); }
+
+	void BeginTick();
+	void EndTick();
+	int Push( TickProfileCategory_t category, const char *pszName );
+	void Pop( int nDepth );
+
+	void ReportSlowestTicks( int nCount );
+	void WriteTrace( const char *pszFileName );
+
+private:
+	void Clear();
+	bool HasEvents( const TickProfileRecord_t &record ) const;
+	void ReportTick( const TickProfileRecord_t &record );
+
+	CUtlVector< TickProfileEvent_t > m_Events;
+	uint64 m_nEventsWritten;
+
+	CUtlVector< TickProfileRecord_t > m_Ticks;
+	int m_nTicksWritten;
+
+	TickProfileRecord_t m_Current;
+	bool m_bInTick;
+
+	TickProfileStackEntry_t m_Stack[TICKPROF_MAX_DEPTH];
+	int m_nDepth;
+
+	float m_flNextBudgetReport;
+};
+
+static CTickProfiler g_TickProfiler;
+
+
+//-----------------------------------------------------------------------------
+// Purpose:
+//-----------------------------------------------------------------------------
+void CTickProfiler::Clear()
+{
+	m_nEventsWritten = 0;
+	m_nTicksWritten = 0;
+	V_memset( &m_Current, 0, sizeof( m_Current ) );
+}
+
+bool CTickProfiler::HasEvents( const TickProfileRecord_t &record ) const
+{
+	return m_nEventsWritten - record.m_nFirstEvent <= TICKPROF_MAX_EVENTS;
+}
+
+//-----------------------------------------------------------------------------
+// Tick bracketing
+//-----------------------------------------------------------------------------
+void CTickProfiler::BeginTick()
+{
+	if ( !sv_tickprofile.GetBool() || m_Events.Count() == 0 )
+		return;
+
+	m_bInTick = true;
+	m_Current.m_nFrameStart = CCycleCount::GetTimestamp();
+}
+
+void CTickProfiler::EndTick()
+{
+	if ( !m_bInTick )
+		return;
+
+	m_bInTick = false;
+	m_Current.m_nFrameCycles = CCycleCount::GetTimestamp() - m_Current.m_nFrameStart;
+	m_Current.m_nCycles += m_Current.m_nFrameCycles;
+	m_Current.m_nTick = gpGlobals->tickcount;
+	m_Current.m_nEndEvent = m_nEventsWritten;
+
+	TickProfileRecord_t &record = m_Ticks[m_nTicksWritten % TICKPROF_MAX_TICKS];
+	record = m_Current;
+	++m_nTicksWritten;
+
+	V_memset( &m_Current, 0, sizeof( m_Current ) );
+	m_Current.m_nFirstEvent = m_nEventsWritten;
+
+	float flBudget = sv_tickprofile_budget.GetFloat();
+	if ( flBudget > 0.0f && CyclesToMilliseconds( record.m_nCycles ) > flBudget && Plat_FloatTime() >= m_flNextBudgetReport )
+	{
+		// Don't let a string of slow ticks turn into a string of slower ones
+		m_flNextBudgetReport = Plat_FloatTime() + 1.0f;
+		Msg( "Tick over %.2f ms budget:\n", flBudget );
+		ReportTick( record );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Scopes
+//-----------------------------------------------------------------------------
+int CTickProfiler::Push( TickProfileCategory_t category, const char *pszName )
+{
+	if ( m_nDepth >= TICKPROF_MAX_DEPTH || m_Events.Count() == 0 )
+		return -1;
+
+	TickProfileStackEntry_t &entry = m_Stack[m_nDepth];
+	entry.m_pszName = pszName ? pszName : "unnamed";
+	entry.m_nCategory = category;
+	entry.m_nChildCycles = 0;
+	entry.m_nStart = CCycleCount::GetTimestamp();
+	return m_nDepth++;
+}
+
+void CTickProfiler::Pop( int nDepth )
+{
+	uint64 nEnd = CCycleCount::GetTimestamp();
+
+	Assert( nDepth == m_nDepth - 1 );
+	m_nDepth = nDepth;
+
+	const TickProfileStackEntry_t &entry = m_Stack[nDepth];
+	uint64 nCycles = nEnd - entry.m_nStart;
+	uint64 nSelfCycles = ( nCycles > entry.m_nChildCycles ) ? nCycles - entry.m_nChildCycles : 0;
+
+	if ( nDepth > 0 )
+	{
+		m_Stack[nDepth - 1].m_nChildCycles += nCycles;
+	}
+	else if ( !m_bInTick )
+	{
+		// Work done between frames (user commands) counts towards the next tick
+		m_Current.m_nCycles += nCycles;
+	}
+
+	m_Current.m_nCategoryCycles[entry.m_nCategory] += nSelfCycles;
+
+	TickProfileEvent_t &event = m_Events[m_nEventsWritten % TICKPROF_MAX_EVENTS];
+	event.m_pszName = entry.m_pszName;
+	event.m_nStart = entry.m_nStart;
+	event.m_nCycles = ClampCycles( nCycles );
+	event.m_nSelfCycles = ClampCycles( nSelfCycles );
+	event.m_nCategory = entry.m_nCategory;
+	event.m_nDepth = nDepth;
+	++m_nEventsWritten;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Prints a tick's totals and the names that took the most time in it
+//-----------------------------------------------------------------------------
+void CTickProfiler::ReportTick( const TickProfileRecord_t &record )
+{
+	Msg( "Tick %d: %.3f ms (%.3f ms in GameFrame)\n", record.m_nTick, CyclesToMilliseconds( record.m_nCycles ), CyclesToMilliseconds( record.m_nFrameCycles ) );
+
+	uint64 nAttributed = 0;
+	for ( int i = 0; i < TICKPROF_CATEGORY_COUNT; ++i )
+	{
+		nAttributed += record.m_nCategoryCycles[i];
+		Msg( "  %-12s %8.3f ms\n", s_pszCategoryNames[i], CyclesToMilliseconds( record.m_nCategoryCycles[i] ) );
+	}
+	Msg( "  %-12s %8.3f ms\n", "other", CyclesToMilliseconds( ( record.m_nCycles > nAttributed ) ? record.m_nCycles - nAttributed : 0 ) );
+
+	if ( !HasEvents( record ) )
+	{
+		Msg( "  (per-class breakdown has been overwritten)\n" );
+		return;
+	}
+
+	CUtlVector< TickProfileTotal_t > totals;
+	for ( uint64 nEvent = record.m_nFirstEvent; nEvent < record.m_nEndEvent; ++nEvent )
+	{
+		const TickProfileEvent_t &event = m_Events[nEvent % TICKPROF_MAX_EVENTS];
+
+		int j;
+		for ( j = 0; j < totals.Count(); ++j )
+		{
+			if ( totals[j].m_pszName == event.m_pszName && totals[j].m_nCategory == event.m_nCategory )
+				break;
+		}
+
+		if ( j == totals.Count() )
+		{
+			j = totals.AddToTail();
+			totals[j].m_pszName = event.m_pszName;
+			totals[j].m_nCategory = event.m_nCategory;
+			totals[j].m_nCalls = 0;
+			totals[j].m_nSelfCycles = 0;
+		}
+
+		++totals[j].m_nCalls;
+		totals[j].m_nSelfCycles += event.m_nSelfCycles;
+	}
+
+	totals.Sort( TickProfileTotalCompare );
+
+	int nCount = MIN( totals.Count(), TICKPROF_REPORT_ENTRIES );
+	for ( int i = 0; i < nCount; ++i )
+	{
+		Msg( "    %8.3f ms  %5d x  %-10s %s\n", CyclesToMilliseconds( totals[i].m_nSelfCycles ), totals[i].m_nCalls,
+			s_pszCategoryNames[totals[i].m_nCategory], totals[i].m_pszName );
+	}
+}
+
+void CTickProfiler::ReportSlowestTicks( int nCount )
+{
+	int nTicks = MIN( m_nTicksWritten, TICKPROF_MAX_TICKS );
+	if ( nTicks == 0 )
+	{
+		Msg( "No ticks recorded (sv_tickprofile %d)\n", sv_tickprofile.GetInt() );
+		return;
+	}
+
+	// Selection, since we only want a handful out of a couple hundred
+	CUtlVector< bool > reported;
+	reported.SetCount( nTicks );
+	for ( int i = 0; i < nTicks; ++i )
+	{
+		reported[i] = false;
+	}
+
+	nCount = clamp( nCount, 1, nTicks );
+	Msg( "Slowest %d of the last %d ticks:\n", nCount, nTicks );
+	for ( int n = 0; n < nCount; ++n )
+	{
+		int nSlowest = -1;
+		for ( int i = 0; i < nTicks; ++i )
+		{
+			if ( !reported[i] && ( nSlowest < 0 || m_Ticks[i].m_nCycles > m_Ticks[nSlowest].m_nCycles ) )
+			{
+				nSlowest = i;
+			}
+		}
+
+		reported[nSlowest] = true;
+		ReportTick( m_Ticks[nSlowest] );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Writes the retained ticks in the Chrome trace event format
+//			(chrome://tracing, Perfetto)
+//-----------------------------------------------------------------------------
+static void WriteTraceString( CUtlBuffer &buf, const char *pszString )
+{
+	buf.PutChar( '"' );
+	for ( const char *p = pszString; *p; ++p )
+	{
+		if ( *p == '"' || *p == '\\' )
+		{
+			buf.PutChar( '\\' );
+		}
+
+		if ( (unsigned char)*p >= ' ' )
+		{
+			buf.PutChar( *p );
+		}
+	}
+	buf.PutChar( '"' );
+}
+
+void CTickProfiler::WriteTrace( const char *pszFileName )
+{
+	int nTicks = MIN( m_nTicksWritten, TICKPROF_MAX_TICKS );
+	if ( nTicks == 0 )
+	{
+		Msg( "No ticks recorded (sv_tickprofile %d)\n", sv_tickprofile.GetInt() );
+		return;
+	}
+
+	// Oldest tick first
+	int nFirstTick = m_nTicksWritten - nTicks;
+	uint64 nBase = m_Ticks[nFirstTick % TICKPROF_MAX_TICKS].m_nFrameStart;
+
+	CUtlBuffer buf( 0, 0, CUtlBuffer::TEXT_BUFFER );
+	buf.PutString( "{\"traceEvents\":[\n" );
+
+	bool bFirst = true;
+	int nEvents = 0;
+	for ( int nTick = nFirstTick; nTick < m_nTicksWritten; ++nTick )
+	{
+		const TickProfileRecord_t &record = m_Ticks[nTick % TICKPROF_MAX_TICKS];
+		if ( record.m_nFrameStart < nBase )
+			continue;
+
+		buf.Printf( "%s{\"name\":\"tick %d\",\"cat\":\"tick\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f}",
+			bFirst ? "" : ",\n", record.m_nTick,
+			CCycleCount( record.m_nFrameStart - nBase ).GetMicrosecondsF(), CCycleCount( record.m_nFrameCycles ).GetMicrosecondsF() );
+		bFirst = false;
+
+		if ( !HasEvents( record ) )
+			continue;
+
+		for ( uint64 nEvent = record.m_nFirstEvent; nEvent < record.m_nEndEvent; ++nEvent )
+		{
+			const TickProfileEvent_t &event = m_Events[nEvent % TICKPROF_MAX_EVENTS];
+			if ( event.m_nStart < nBase )
+				continue;
+
+			buf.PutString( ",\n{\"name\":" );
+			WriteTraceString( buf, event.m_pszName );
+			buf.Printf( ",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"tick\":%d,\"self_us\":%.3f}}",
+				s_pszCategoryNames[event.m_nCategory],
+				CCycleCount( event.m_nStart - nBase ).GetMicrosecondsF(), CCycleCount( event.m_nCycles ).GetMicrosecondsF(),
+				record.m_nTick, CCycleCount( event.m_nSelfCycles ).GetMicrosecondsF() );
+			++nEvents;
+		}
+	}
+
+	buf.PutString( "\n]}\n" );
+
+	if ( !filesystem->WriteFile( pszFileName, "MOD", buf ) )
+	{
+		Warning( "Unable to write tick profile to '%s'\n", pszFileName );
+		return;
+	}
+
+	Msg( "Wrote %d ticks, %d events to '%s'\n", nTicks, nEvents, pszFileName );
+}
+
+
+//-----------------------------------------------------------------------------
+// Public interface
+//-----------------------------------------------------------------------------
+void TickProfiler_BeginTick()
+{
+	g_TickProfiler.BeginTick();
+}
+
+void TickProfiler_EndTick()
+{
+	g_TickProfiler.EndTick();
+}
+
+CTickProfileScope::CTickProfileScope( TickProfileCategory_t category, const char *pszName )
+{
+	m_nDepth = -1;
+	if ( sv_tickprofile.GetBool() && ThreadInMainThread() )
+	{
+		m_nDepth = g_TickProfiler.Push( category, pszName );
+	}
+}
+
+CTickProfileScope::~CTickProfileScope()
+{
+	if ( m_nDepth >= 0 )
+	{
+		g_TickProfiler.Pop( m_nDepth );
+	}
+}
+
+CON_COMMAND( tickprofile_dump, "Report the slowest recently recorded server ticks. Usage: tickprofile_dump [count]" )
+{
+	if ( !UTIL_IsCommandIssuedByServerAdmin() )
+		return;
+
+	int nCount = ( args.ArgC() > 1 ) ? atoi( args[1] ) : 5;
+	g_TickProfiler.ReportSlowestTicks( nCount );
+}
+
+CON_COMMAND( tickprofile_trace, "Write the recently recorded server ticks as a Chrome trace. Usage: tickprofile_trace [filename]" )
+{
+	if ( !UTIL_IsCommandIssuedByServerAdmin() )
+		return;
+
+	g_TickProfiler.WriteTrace( ( args.ArgC() > 1 ) ? args[1] : "tickprofile.json" );
+}
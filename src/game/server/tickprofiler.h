@@ -0,0 +1,55 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Always-on server tick profiler. Attributes the time spent in a
+//			tick to game systems, entity classes and the other large pieces of
+//			work the server does, and keeps the last few seconds of ticks around
+//			so slow ones can be looked at after the fact.
+//
+// $NoKeywords: $
+//=============================================================================//
+
+#ifndef TICKPROFILER_H
+#define TICKPROFILER_H
+#ifdef _WIN32
+#pragma once
+#endif
+
+//-----------------------------------------------------------------------------
+// What a profiled scope is spending its time on
+//-----------------------------------------------------------------------------
+enum TickProfileCategory_t
+{
+	TICKPROF_GAMESYSTEM = 0,	// IGameSystemPerFrame callbacks, by system
+	TICKPROF_THINK,				// Entity think functions, by class
+	TICKPROF_EVENTQUEUE,		// Entity I/O fired from the event queue, by target class
+	TICKPROF_PHYSICS,			// VPhysics simulation
+	TICKPROF_USERCMD,			// Player user command processing, by class
+
+	TICKPROF_CATEGORY_COUNT
+};
+
+//-----------------------------------------------------------------------------
+// Brackets a single server tick. Scopes entered outside of a tick (user
+// commands, which arrive between frames) count towards the next one.
+//-----------------------------------------------------------------------------
+void TickProfiler_BeginTick();
+void TickProfiler_EndTick();
+
+//-----------------------------------------------------------------------------
+// Times the enclosing block. The name must stay valid until the level ends,
+// so use class names, pooled strings or literals. Only the main thread is
+// recorded; nested scopes report their own time without their children's.
+//-----------------------------------------------------------------------------
+class CTickProfileScope
+{
+public:
+	CTickProfileScope( TickProfileCategory_t category, const char *pszName );
+	~CTickProfileScope();
+
+private:
+	int m_nDepth;
+};
+
+#define TICKPROF_SCOPE( category, name )	CTickProfileScope tickProfileScope( category, name )
+
+#endif // TICKPROFILER_H
@@ -0,0 +1,212 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Per-frame caches used by CServerGameEnts::CheckTransmit
+//
+// $NoKeywords: $
+//=============================================================================//
+
+#include "cbase.h"
+#include "transmitcache.h"
+#include "ServerNetworkProperty.h"
+#include "generichash.h"
+#include "mathlib/ssemath.h"
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include "tier0/memdbgon.h"
+
+static ConVar sv_transmit_cache( "sv_transmit_cache", "1", 0, "Share client-independent transmit work (always-sent edicts, PVS tests) between clients." );
+
+// Clients beyond this many distinct PVSes in a frame fall back to uncached PVS tests
+#define MAX_TRANSMIT_VISIBILITY_SETS	64
+
+CTransmitCache g_TransmitCache;
+
+
+//-----------------------------------------------------------------------------
+// Purpose:
+//-----------------------------------------------------------------------------
+bool CTransmitVisibility::Matches( const CCheckTransmitInfo *pInfo, unsigned int nHash ) const
+{
+	return m_nHash == nHash &&
+		m_nPVSSize == pInfo->m_nPVSSize &&
+		m_nAreasNetworked == pInfo->m_AreasNetworked &&
+		!V_memcmp( m_Areas, pInfo->m_Areas, m_nAreasNetworked * sizeof( int ) ) &&
+		!V_memcmp( m_PVS, pInfo->m_PVS, m_nPVSSize );
+}
+
+bool CTransmitVisibility::IsInPVS( int iEdict, const CCheckTransmitInfo *pInfo )
+{
+	if ( m_Evaluated.IsBitSet( iEdict ) )
+		return m_Visible.IsBitSet( iEdict );
+
+	bool bInPVS = CServerNetworkProperty::IsEdictInPVS( iEdict, pInfo );
+	m_Evaluated.Set( iEdict );
+	if ( bInPVS )
+	{
+		m_Visible.Set( iEdict );
+	}
+	else
+	{
+		m_Visible.Clear( iEdict );
+	}
+	return bInPVS;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose:
+//-----------------------------------------------------------------------------
+int CShouldTransmitCache::ShouldTransmit( CBaseEntity *pEntity, int iEdict, const CCheckTransmitInfo *pInfo )
+{
+	if ( !m_Evaluated.IsBitSet( iEdict ) )
+	{
+		m_nResult[iEdict] = pEntity->ShouldTransmit( pInfo );
+		m_Evaluated.Set( iEdict );
+	}
+	return m_nResult[iEdict];
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose:
+//-----------------------------------------------------------------------------
+CTransmitCache::CTransmitCache()
+{
+	m_nTick = -1;
+	m_nEdictListsUsed = 0;
+	m_nVisibilityUsed = 0;
+}
+
+CTransmitCache::~CTransmitCache()
+{
+	m_EdictLists.PurgeAndDeleteElements();
+	m_Visibility.PurgeAndDeleteElements();
+}
+
+bool CTransmitCache::IsEnabled() const
+{
+	return sv_transmit_cache.GetBool();
+}
+
+void CTransmitCache::NewFrame()
+{
+	m_nTick = gpGlobals->tickcount;
+	m_nEdictListsUsed = 0;
+	m_nVisibilityUsed = 0;
+}
+
+// In case a frame's client updates ever happen without PreClientUpdate
+inline void CTransmitCache::CheckFrame()
+{
+	if ( m_nTick != gpGlobals->tickcount )
+	{
+		NewFrame();
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Splits the edict list into edicts every client gets and edicts
+//			that need checking per client. The engine hands every client the
+//			same list in a frame, so this normally runs once.
+//-----------------------------------------------------------------------------
+const CTransmitEdictList *CTransmitCache::GetEdictList( const unsigned short *pEdictIndices, int nEdicts )
+{
+	CheckFrame();
+
+	for ( int i = 0; i < m_nEdictListsUsed; ++i )
+	{
+		if ( m_EdictLists[i]->m_pSource == pEdictIndices && m_EdictLists[i]->m_nSource == nEdicts )
+			return m_EdictLists[i];
+	}
+
+	if ( m_nEdictListsUsed == m_EdictLists.Count() )
+	{
+		m_EdictLists.AddToTail( new CTransmitEdictList );
+	}
+
+	CTransmitEdictList *pList = m_EdictLists[m_nEdictListsUsed++];
+	pList->m_pSource = pEdictIndices;
+	pList->m_nSource = nEdicts;
+	pList->m_Always.ClearAll();
+	pList->m_Check.RemoveAll();
+
+	edict_t *pBaseEdict = engine->PEntityOfEntIndex( 0 );
+	for ( int i = 0; i < nEdicts; ++i )
+	{
+		int iEdict = pEdictIndices[i];
+		int nFlags = pBaseEdict[iEdict].m_fStateFlags & (FL_EDICT_DONTSEND|FL_EDICT_ALWAYS|FL_EDICT_PVSCHECK|FL_EDICT_FULLCHECK);
+
+		if ( nFlags & FL_EDICT_DONTSEND )
+			continue;
+
+		if ( !( nFlags & FL_EDICT_ALWAYS ) )
+		{
+			pList->m_Check.AddToTail( iEdict );
+			continue;
+		}
+
+		// Same walk CheckTransmit does for always-sent edicts
+		while ( !pList->m_Always.IsBitSet( iEdict ) )
+		{
+			pList->m_Always.Set( iEdict );
+
+			iEdict = g_EdictTransmitState[iEdict].m_iParent;
+			if ( iEdict == EDICT_TRANSMIT_NO_PARENT )
+				break;
+		}
+	}
+
+	return pList;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Finds or creates the shared PVS results for this client's view
+//-----------------------------------------------------------------------------
+CTransmitVisibility *CTransmitCache::GetVisibility( const CCheckTransmitInfo *pInfo )
+{
+	CheckFrame();
+
+	unsigned int nHash = HashBlock( pInfo->m_PVS, pInfo->m_nPVSSize );
+	nHash ^= HashBlock( pInfo->m_Areas, pInfo->m_AreasNetworked * sizeof( int ) ) * 31;
+
+	for ( int i = 0; i < m_nVisibilityUsed; ++i )
+	{
+		if ( m_Visibility[i]->Matches( pInfo, nHash ) )
+			return m_Visibility[i];
+	}
+
+	if ( m_nVisibilityUsed == MAX_TRANSMIT_VISIBILITY_SETS )
+		return NULL;
+
+	if ( m_nVisibilityUsed == m_Visibility.Count() )
+	{
+		m_Visibility.AddToTail( new CTransmitVisibility );
+	}
+
+	CTransmitVisibility *pVisibility = m_Visibility[m_nVisibilityUsed++];
+	pVisibility->m_nHash = nHash;
+	pVisibility->m_nPVSSize = pInfo->m_nPVSSize;
+	V_memcpy( pVisibility->m_PVS, pInfo->m_PVS, pInfo->m_nPVSSize );
+	pVisibility->m_nAreasNetworked = pInfo->m_AreasNetworked;
+	V_memcpy( pVisibility->m_Areas, pInfo->m_Areas, pInfo->m_AreasNetworked * sizeof( int ) );
+	pVisibility->m_Evaluated.ClearAll();
+	return pVisibility;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: *pDest |= src
+//-----------------------------------------------------------------------------
+void MergeTransmitBits( CBitVec<MAX_EDICTS> *pDest, const CBitVec<MAX_EDICTS> &src )
+{
+	COMPILE_TIME_ASSERT( ( MAX_EDICTS % 128 ) == 0 );
+
+	uint32 *pDestInts = pDest->Base();
+	const uint32 *pSrcInts = src.Base();
+	int nInts = src.GetNumDWords();
+	for ( int i = 0; i < nInts; i += 4 )
+	{
+		fltx4 result = OrSIMD( LoadUnalignedSIMD( pDestInts + i ), LoadUnalignedSIMD( pSrcInts + i ) );
+		StoreUnalignedSIMD( (float *)( pDestInts + i ), result );
+	}
+}
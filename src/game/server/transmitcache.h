@@ -0,0 +1,117 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Per-frame caches used by CServerGameEnts::CheckTransmit so that
+//			the work that doesn't depend on the recipient is done once per
+//			frame instead of once per client.
+//
+// $NoKeywords: $
+//=============================================================================//
+
+#ifndef TRANSMITCACHE_H
+#define TRANSMITCACHE_H
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include "iservernetworkable.h"
+#include "bitvec.h"
+#include "utlvector.h"
+
+class CBaseEntity;
+
+//-----------------------------------------------------------------------------
+// The client-independent part of an edict list handed to CheckTransmit
+//-----------------------------------------------------------------------------
+class CTransmitEdictList
+{
+public:
+	// FL_EDICT_ALWAYS edicts and everything they force down through their network parents
+	CBitVec<MAX_EDICTS>				m_Always;
+
+	// Edicts that need a per-client decision (PVS and full checks)
+	CUtlVector< unsigned short >	m_Check;
+
+private:
+	friend class CTransmitCache;
+	const unsigned short			*m_pSource;
+	int								m_nSource;
+};
+
+//-----------------------------------------------------------------------------
+// PVS/area test results shared by every client with the same PVS and areas,
+// which in practice means every client standing in the same cluster.
+//-----------------------------------------------------------------------------
+class CTransmitVisibility
+{
+public:
+	// Same answer as CServerNetworkProperty::IsEdictInPVS(). PVS information must be up to date.
+	bool IsInPVS( int iEdict, const CCheckTransmitInfo *pInfo );
+
+private:
+	friend class CTransmitCache;
+
+	bool Matches( const CCheckTransmitInfo *pInfo, unsigned int nHash ) const;
+
+	CBitVec<MAX_EDICTS>	m_Evaluated;
+	CBitVec<MAX_EDICTS>	m_Visible;
+
+	unsigned int		m_nHash;
+	int					m_nPVSSize;
+	byte				m_PVS[PAD_NUMBER( MAX_MAP_CLUSTERS, 8 ) / 8];
+	int					m_nAreasNetworked;
+	int					m_Areas[MAX_WORLD_AREAS];
+};
+
+//-----------------------------------------------------------------------------
+// Remembers ShouldTransmit answers for the duration of one CheckTransmit call,
+// so parents asked about by several children are only asked once.
+//-----------------------------------------------------------------------------
+class CShouldTransmitCache
+{
+public:
+	CShouldTransmitCache() { m_Evaluated.ClearAll(); }
+
+	int ShouldTransmit( CBaseEntity *pEntity, int iEdict, const CCheckTransmitInfo *pInfo );
+
+private:
+	CBitVec<MAX_EDICTS>	m_Evaluated;
+	unsigned short		m_nResult[MAX_EDICTS];
+};
+
+//-----------------------------------------------------------------------------
+// Purpose:
+//-----------------------------------------------------------------------------
+class CTransmitCache
+{
+public:
+	CTransmitCache();
+	~CTransmitCache();
+
+	// Everything cached is thrown away at the start of each frame's client updates
+	void NewFrame();
+
+	bool IsEnabled() const;
+
+	const CTransmitEdictList *GetEdictList( const unsigned short *pEdictIndices, int nEdicts );
+
+	// Returns NULL if too many different PVSes have been seen this frame
+	CTransmitVisibility *GetVisibility( const CCheckTransmitInfo *pInfo );
+
+private:
+	void CheckFrame();
+
+	int m_nTick;
+
+	CUtlVector< CTransmitEdictList * > m_EdictLists;
+	int m_nEdictListsUsed;
+
+	CUtlVector< CTransmitVisibility * > m_Visibility;
+	int m_nVisibilityUsed;
+};
+
+extern CTransmitCache g_TransmitCache;
+
+// *pDest |= src, four dwords at a time
+void MergeTransmitBits( CBitVec<MAX_EDICTS> *pDest, const CBitVec<MAX_EDICTS> &src );
+
+#endif // TRANSMITCACHE_H
@@ -0,0 +1,226 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Game-side broadphase over the world bounds of every trigger.
+//
+// The engine finds the triggers a moving solid touches by querying the spatial
+// partition for each solid that moves. On maps with hundreds of triggers most
+// of those queries come back empty, so we keep the trigger bounds in a flat
+// SIMD-friendly array and only hand the solid to the engine when its swept
+// bounds overlap at least one of them. Skipping the query is safe: touch links
+// that are not refreshed this tick get their EndTouch from the untouch pass.
+//
+//=============================================================================//
+
+#include "cbase.h"
+#include "trigger_broadphase.h"
+#include "collisionproperty.h"
+#include "mathlib/ssemath.h"
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include "tier0/memdbgon.h"
+
+static ConVar sv_trigger_broadphase( "sv_trigger_broadphase", "1", 0, "Only query the engine for trigger touches when a moving solid overlaps the bounds of some trigger." );
+
+#define TRIGGER_SLOT_INVALID	0xFFFF
+
+typedef CUtlVector< FourVectors, CUtlMemoryAligned< FourVectors, 16 > > FourVectorsList_t;
+
+//-----------------------------------------------------------------------------
+// Purpose: Trigger bounds stored four to an entry so they can be tested in one go
+//-----------------------------------------------------------------------------
+class CTriggerBroadphase : public CAutoGameSystem, public ITriggerBroadphase
+{
+public:
+	CTriggerBroadphase() : CAutoGameSystem( "CTriggerBroadphase" )
+	{
+		Clear();
+	}
+
+	// IGameSystem
+	virtual void LevelShutdownPostEntity() { Clear(); }
+
+	// ITriggerBroadphase
+	virtual void SetTriggerListed( CBaseEntity *pEntity, bool bIsTrigger );
+	virtual void ElementMoved( CBaseEntity *pEntity, const Vector &vecWorldMins, const Vector &vecWorldMaxs );
+	virtual void RemoveElement( CBaseEntity *pEntity );
+	virtual bool MayTouchTriggers( CBaseEntity *pSolid, const Vector *pPrevAbsOrigin );
+
+private:
+	void Clear();
+	void WriteSlot( int nSlot, const Vector &vecMins, const Vector &vecMaxs );
+	void FreeSlot( int nEntry );
+
+	FourVectorsList_t m_Mins;
+	FourVectorsList_t m_Maxs;
+	CUtlVector< unsigned short > m_FreeSlots;
+	int m_nTriggers;
+
+	// Indexed by entity handle entry
+	unsigned short m_EntrySlot[NUM_ENT_ENTRIES];
+
+	// Last bounds each entity had in the partition, so an entity that
+	// becomes a trigger without moving can still be placed
+	Vector m_vecEntryMins[NUM_ENT_ENTRIES];
+	Vector m_vecEntryMaxs[NUM_ENT_ENTRIES];
+	bool m_bEntryBoundsKnown[NUM_ENT_ENTRIES];
+};
+
+static CTriggerBroadphase g_TriggerBroadphase;
+ITriggerBroadphase *g_pTriggerBroadphase = &g_TriggerBroadphase;
+
+
+//-----------------------------------------------------------------------------
+// Purpose: 
+//-----------------------------------------------------------------------------
+void CTriggerBroadphase::Clear()
+{
+	m_Mins.Purge();
+	m_Maxs.Purge();
+	m_FreeSlots.Purge();
+	m_nTriggers = 0;
+
+	for ( int i = 0; i < NUM_ENT_ENTRIES; i++ )
+	{
+		m_EntrySlot[i] = TRIGGER_SLOT_INVALID;
+		m_bEntryBoundsKnown[i] = false;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Unused slots have inverted bounds, which never overlap anything
+//-----------------------------------------------------------------------------
+void CTriggerBroadphase::WriteSlot( int nSlot, const Vector &vecMins, const Vector &vecMaxs )
+{
+	FourVectors &mins = m_Mins[ nSlot >> 2 ];
+	FourVectors &maxs = m_Maxs[ nSlot >> 2 ];
+	int nLane = nSlot & 3;
+
+	mins.X( nLane ) = vecMins.x;
+	mins.Y( nLane ) = vecMins.y;
+	mins.Z( nLane ) = vecMins.z;
+	maxs.X( nLane ) = vecMaxs.x;
+	maxs.Y( nLane ) = vecMaxs.y;
+	maxs.Z( nLane ) = vecMaxs.z;
+}
+
+void CTriggerBroadphase::FreeSlot( int nEntry )
+{
+	int nSlot = m_EntrySlot[nEntry];
+	if ( nSlot == TRIGGER_SLOT_INVALID )
+		return;
+
+	WriteSlot( nSlot, Vector( FLT_MAX, FLT_MAX, FLT_MAX ), Vector( -FLT_MAX, -FLT_MAX, -FLT_MAX ) );
+	m_FreeSlots.AddToTail( nSlot );
+	m_EntrySlot[nEntry] = TRIGGER_SLOT_INVALID;
+	--m_nTriggers;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Mirrors insertion into/removal from PARTITION_ENGINE_TRIGGER_EDICTS
+//-----------------------------------------------------------------------------
+void CTriggerBroadphase::SetTriggerListed( CBaseEntity *pEntity, bool bIsTrigger )
+{
+	int nEntry = pEntity->GetRefEHandle().GetEntryIndex();
+	if ( !bIsTrigger )
+	{
+		FreeSlot( nEntry );
+		return;
+	}
+
+	if ( m_EntrySlot[nEntry] != TRIGGER_SLOT_INVALID )
+		return;
+
+	if ( !m_FreeSlots.Count() )
+	{
+		// Grow by one entry's worth of empty slots
+		int nFirstSlot = m_Mins.Count() * 4;
+		m_Mins.AddToTail();
+		m_Maxs.AddToTail();
+		for ( int i = 3; i >= 0; --i )
+		{
+			WriteSlot( nFirstSlot + i, Vector( FLT_MAX, FLT_MAX, FLT_MAX ), Vector( -FLT_MAX, -FLT_MAX, -FLT_MAX ) );
+			m_FreeSlots.AddToTail( nFirstSlot + i );
+		}
+	}
+
+	int nSlot = m_FreeSlots.Tail();
+	m_FreeSlots.RemoveMultipleFromTail( 1 );
+	m_EntrySlot[nEntry] = nSlot;
+	++m_nTriggers;
+
+	if ( m_bEntryBoundsKnown[nEntry] )
+	{
+		WriteSlot( nSlot, m_vecEntryMins[nEntry], m_vecEntryMaxs[nEntry] );
+	}
+	else
+	{
+		// We don't know where it is yet, so it has to be assumed to be everywhere
+		WriteSlot( nSlot, Vector( -FLT_MAX, -FLT_MAX, -FLT_MAX ), Vector( FLT_MAX, FLT_MAX, FLT_MAX ) );
+	}
+}
+
+void CTriggerBroadphase::ElementMoved( CBaseEntity *pEntity, const Vector &vecWorldMins, const Vector &vecWorldMaxs )
+{
+	int nEntry = pEntity->GetRefEHandle().GetEntryIndex();
+	m_vecEntryMins[nEntry] = vecWorldMins;
+	m_vecEntryMaxs[nEntry] = vecWorldMaxs;
+	m_bEntryBoundsKnown[nEntry] = true;
+
+	if ( m_EntrySlot[nEntry] != TRIGGER_SLOT_INVALID )
+	{
+		WriteSlot( m_EntrySlot[nEntry], vecWorldMins, vecWorldMaxs );
+	}
+}
+
+void CTriggerBroadphase::RemoveElement( CBaseEntity *pEntity )
+{
+	int nEntry = pEntity->GetRefEHandle().GetEntryIndex();
+	FreeSlot( nEntry );
+	m_bEntryBoundsKnown[nEntry] = false;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Conservative test of the solid's swept surrounding bounds against
+//			every trigger, four at a time
+//-----------------------------------------------------------------------------
+bool CTriggerBroadphase::MayTouchTriggers( CBaseEntity *pSolid, const Vector *pPrevAbsOrigin )
+{
+	if ( !sv_trigger_broadphase.GetBool() )
+		return true;
+
+	if ( !m_nTriggers )
+		return false;
+
+	// The engine query would see the partition after dirty entities are
+	// moved, so make sure our copy of the trigger bounds is that current too
+	UpdateDirtySpatialPartitionEntities();
+
+	Vector vecMins, vecMaxs;
+	pSolid->CollisionProp()->WorldSpaceSurroundingBounds( &vecMins, &vecMaxs );
+	if ( pPrevAbsOrigin )
+	{
+		Vector vecDelta = *pPrevAbsOrigin - pSolid->GetAbsOrigin();
+		vecMins = vecMins.Min( vecMins + vecDelta );
+		vecMaxs = vecMaxs.Max( vecMaxs + vecDelta );
+	}
+	vecMins -= Vector( 1, 1, 1 );
+	vecMaxs += Vector( 1, 1, 1 );
+
+	FourVectors queryMins, queryMaxs;
+	queryMins.DuplicateVector( vecMins );
+	queryMaxs.DuplicateVector( vecMaxs );
+
+	int nCount = m_Mins.Count();
+	const FourVectors *pMins = m_Mins.Base();
+	const FourVectors *pMaxs = m_Maxs.Base();
+	for ( int i = 0; i < nCount; ++i )
+	{
+		fltx4 separated = OrSIMD( CmpGtSIMD( pMins[i].x, queryMaxs.x ), CmpLtSIMD( pMaxs[i].x, queryMins.x ) );
+		separated = OrSIMD( separated, OrSIMD( CmpGtSIMD( pMins[i].y, queryMaxs.y ), CmpLtSIMD( pMaxs[i].y, queryMins.y ) ) );
+		separated = OrSIMD( separated, OrSIMD( CmpGtSIMD( pMins[i].z, queryMaxs.z ), CmpLtSIMD( pMaxs[i].z, queryMins.z ) ) );
+		if ( TestSignSIMD( separated ) != 0xF )
+			return true;
+	}
+
+	return false;
+}
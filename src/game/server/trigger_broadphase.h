@@ -0,0 +1,41 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Game-side broadphase over the world bounds of every trigger.
+//			Lets moving solids skip the engine's trigger touch query when
+//			they can't possibly be touching a trigger.
+//
+// $NoKeywords: $
+//=============================================================================//
+
+#ifndef TRIGGER_BROADPHASE_H
+#define TRIGGER_BROADPHASE_H
+#ifdef _WIN32
+#pragma once
+#endif
+
+class CBaseEntity;
+
+//-----------------------------------------------------------------------------
+// Kept in sync with the PARTITION_ENGINE_TRIGGER_EDICTS partition list by
+// CCollisionProperty.
+//-----------------------------------------------------------------------------
+abstract_class ITriggerBroadphase
+{
+public:
+	// Called whenever the entity's partition lists are rebuilt
+	virtual void SetTriggerListed( CBaseEntity *pEntity, bool bIsTrigger ) = 0;
+
+	// Called whenever the entity's bounds in the partition change
+	virtual void ElementMoved( CBaseEntity *pEntity, const Vector &vecWorldMins, const Vector &vecWorldMaxs ) = 0;
+
+	// Called when the entity leaves the partition
+	virtual void RemoveElement( CBaseEntity *pEntity ) = 0;
+
+	// Returns false only if the solid, moving from pPrevAbsOrigin to its
+	// current position, cannot overlap any trigger
+	virtual bool MayTouchTriggers( CBaseEntity *pSolid, const Vector *pPrevAbsOrigin ) = 0;
+};
+
+extern ITriggerBroadphase *g_pTriggerBroadphase;
+
+#endif // TRIGGER_BROADPHASE_H
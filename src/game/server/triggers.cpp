@@ -91,6 +91,8 @@ void Cmd_ShowtriggersToggle_f( const CCommand &args )
 
 static ConCommand showtriggers_toggle( "showtriggers_toggle", Cmd_ShowtriggersToggle_f, "Toggle show triggers", FCVAR_CHEAT );
 
+ConVar sv_trigger_filter_cache( "sv_trigger_filter_cache", "0", 0, "Remember trigger filter results for the rest of the tick. Results go stale if a filter, an entity's name or team, or whether a player is in a vehicle changes during the tick." );
+
 // Global Savedata for base trigger
 BEGIN_DATADESC( CBaseTrigger )
 
@@ -126,6 +128,7 @@ LINK_ENTITY_TO_CLASS( trigger, CBaseTrigger );
 CBaseTrigger::CBaseTrigger()
 {
 	AddEFlags( EFL_USE_PARTITION_WHEN_NOT_SOLID );
+	m_nFilterCacheTick = -1;
 }
 
 //------------------------------------------------------------------------------
@@ -349,9 +352,38 @@ void CBaseTrigger::InitTrigger( )
 
 //-----------------------------------------------------------------------------
 // Purpose: Returns true if this entity passes the filter criteria, false if not.
+//			With sv_trigger_filter_cache, results are remembered for the rest
+//			of the tick, since the same pair is usually asked about from both
+//			Touch and StartTouch.
 // Input  : pOther - The entity to be filtered.
 //-----------------------------------------------------------------------------
 bool CBaseTrigger::PassesTriggerFilters(CBaseEntity *pOther)
+{
+	if ( !sv_trigger_filter_cache.GetBool() )
+		return PassesTriggerFiltersUncached( pOther );
+
+	if ( m_nFilterCacheTick != gpGlobals->tickcount )
+	{
+		m_FilterCache.RemoveAll();
+		m_nFilterCacheTick = gpGlobals->tickcount;
+	}
+
+	EHANDLE hOther = pOther;
+	for ( int i = 0; i < m_FilterCache.Count(); i++ )
+	{
+		if ( m_FilterCache[i].m_hOther == hOther )
+			return m_FilterCache[i].m_bPasses;
+	}
+
+	bool bPasses = PassesTriggerFiltersUncached( pOther );
+
+	int i = m_FilterCache.AddToTail();
+	m_FilterCache[i].m_hOther = hOther;
+	m_FilterCache[i].m_bPasses = bPasses;
+	return bPasses;
+}
+
+bool CBaseTrigger::PassesTriggerFiltersUncached(CBaseEntity *pOther)
 {
 	// First test spawn flag filters
 	if ( HasSpawnFlags(SF_TRIGGER_ALLOW_ALL) ||
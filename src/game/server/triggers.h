@@ -99,6 +99,18 @@ protected:
 	CUtlVector< EHANDLE >	m_hTouchingEntities;
 
 	DECLARE_DATADESC();
+
+private:
+	bool PassesTriggerFiltersUncached( CBaseEntity *pOther );
+
+	// PassesTriggerFilters results for the current tick
+	struct FilterCacheEntry_t
+	{
+		EHANDLE	m_hOther;
+		bool	m_bPasses;
+	};
+	CUtlVector< FilterCacheEntry_t > m_FilterCache;
+	int		m_nFilterCacheTick;
 };
 
 //-----------------------------------------------------------------------------
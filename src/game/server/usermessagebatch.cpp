@@ -0,0 +1,366 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Holds user messages back until the end of the tick so messages
+//			sent to the same recipients go out as one engine message. The
+//			client unpacks them in its UserMessageBatch hook (usermessages.cpp).
+//
+// $NoKeywords: $
+//=============================================================================//
+
+#include "cbase.h"
+#include "usermessagebatch.h"
+#include "usermessages.h"
+#include "recipientfilter.h"
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include "tier0/memdbgon.h"
+
+static ConVar sv_usermessage_batch( "sv_usermessage_batch", "0", 0, "Send the user messages of a tick that share recipients as one message." );
+static ConVar sv_usermessage_batch_dedup( "sv_usermessage_batch_dedup", "0", 0, "With sv_usermessage_batch, drop unreliable user messages identical to one already going to the same recipients this tick. Only for mods whose unreliable user messages are all safe to drop when repeated." );
+
+// What the engine spends on each svc_UserMessage: net message type, user message type and length
+#define USERMESSAGE_ENGINE_HEADER_BITS	( 6 + 8 + 11 )
+
+// What a message costs inside a batch
+#define USERMESSAGE_BATCH_ENTRY_BITS	( 8 + USERMESSAGE_BATCH_LENGTH_BITS )
+
+CUserMessageBatch g_UserMessageBatch;
+
+static int RecipientCompare( const int *pLeft, const int *pRight )
+{
+	return *pLeft - *pRight;
+}
+
+static int GetBatchMessageType()
+{
+	static int s_nBatchType = usermessages->LookupUserMessage( USERMESSAGE_BATCH_NAME );
+	return s_nBatchType;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose:
+//-----------------------------------------------------------------------------
+CUserMessageBatch::CUserMessageBatch()
+{
+	m_nCurrentType = -1;
+	m_bCurrentReliable = false;
+	m_nBatchesUsed = 0;
+	m_nBatchesSent = 0;
+}
+
+CUserMessageBatch::~CUserMessageBatch()
+{
+	m_Batches.PurgeAndDeleteElements();
+}
+
+bool CUserMessageBatch::IsEnabled() const
+{
+	return sv_usermessage_batch.GetBool();
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Starts a message if it can be held back
+//-----------------------------------------------------------------------------
+bf_write *CUserMessageBatch::Begin( IRecipientFilter &filter, int msg_type )
+{
+	Assert( m_nCurrentType == -1 );
+
+	// Init messages go into the signon data, which isn't sent per tick
+	if ( filter.IsInitMessage() )
+		return NULL;
+
+	int nBatchType = IsEnabled() ? GetBatchMessageType() : -1;
+	if ( nBatchType == -1 || msg_type == nBatchType || msg_type > 255 )
+	{
+		// This one goes straight to the engine, so send what's held back
+		// first or its recipients would get them out of order
+		Flush();
+		return NULL;
+	}
+
+	m_nCurrentType = msg_type;
+	m_bCurrentReliable = filter.IsReliable();
+
+	int nRecipients = filter.GetRecipientCount();
+	m_CurrentRecipients.SetCount( nRecipients );
+	for ( int i = 0; i < nRecipients; ++i )
+	{
+		m_CurrentRecipients[i] = filter.GetRecipientIndex( i );
+	}
+	m_CurrentRecipients.Sort( RecipientCompare );
+
+	// Zeroed so identical messages compare equal byte for byte
+	V_memset( m_CurrentData, 0, sizeof( m_CurrentData ) );
+	m_Current.StartWriting( m_CurrentData, sizeof( m_CurrentData ) );
+	m_Current.SetDebugName( "UserMessageBatch" );
+	return &m_Current;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Adds the finished message to a batch
+//-----------------------------------------------------------------------------
+void CUserMessageBatch::End()
+{
+	Assert( m_nCurrentType != -1 );
+
+	int nType = m_nCurrentType;
+	m_nCurrentType = -1;
+
+	if ( m_Current.IsOverflowed() )
+	{
+		Warning( "User message '%s' overflowed, not sent\n", usermessages->GetUserMessageName( nType ) );
+		return;
+	}
+
+	if ( !m_CurrentRecipients.Count() )
+		return;
+
+	int nBits = m_Current.GetNumBitsWritten();
+	int nRecipients = m_CurrentRecipients.Count();
+
+	Stats_t &stats = GetStats( nType );
+	++stats.m_nMessages;
+
+	if ( !m_bCurrentReliable && sv_usermessage_batch_dedup.GetBool() && IsDuplicate( m_bCurrentReliable, nType, m_CurrentData, nBits ) )
+	{
+		++stats.m_nDuplicates;
+		stats.m_nBitsSaved += nRecipients * ( USERMESSAGE_ENGINE_HEADER_BITS + nBits );
+		return;
+	}
+
+	Batch_t *pBatch = FindBatch( m_bCurrentReliable, nBits );
+
+	bf_write buf( pBatch->m_Data, sizeof( pBatch->m_Data ) );
+	buf.SeekToBit( pBatch->m_nBits );
+	buf.WriteByte( nType );
+	buf.WriteUBitLong( nBits, USERMESSAGE_BATCH_LENGTH_BITS );
+	buf.WriteBits( m_CurrentData, nBits );
+	Assert( !buf.IsOverflowed() );
+	pBatch->m_nBits = buf.GetNumBitsWritten();
+
+	int nBytes = BitByte( nBits );
+	Message_t &message = pBatch->m_Messages[ pBatch->m_Messages.AddToTail() ];
+	message.m_nType = nType;
+	message.m_nBits = nBits;
+	message.m_nDataOffset = pBatch->m_Payloads.Count();
+	pBatch->m_Payloads.AddMultipleToTail( nBytes, m_CurrentData );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose:
+//-----------------------------------------------------------------------------
+bool CUserMessageBatch::SameRecipients( const Batch_t *pBatch, bool bReliable ) const
+{
+	return pBatch->m_bReliable == bReliable &&
+		pBatch->m_Recipients.Count() == m_CurrentRecipients.Count() &&
+		!V_memcmp( pBatch->m_Recipients.Base(), m_CurrentRecipients.Base(), m_CurrentRecipients.Count() * sizeof( int ) );
+}
+
+bool CUserMessageBatch::IsDuplicate( bool bReliable, int nType, const byte *pData, int nBits ) const
+{
+	for ( int i = 0; i < m_nBatchesUsed; ++i )
+	{
+		const Batch_t *pBatch = m_Batches[i];
+		if ( !SameRecipients( pBatch, bReliable ) )
+			continue;
+
+		for ( int j = 0; j < pBatch->m_Messages.Count(); ++j )
+		{
+			const Message_t &message = pBatch->m_Messages[j];
+			if ( message.m_nType == nType && message.m_nBits == nBits &&
+				!V_memcmp( pBatch->m_Payloads.Base() + message.m_nDataOffset, pData, BitByte( nBits ) ) )
+				return true;
+		}
+	}
+	return false;
+}
+
+bool CUserMessageBatch::SharesRecipients( const Batch_t *pBatch ) const
+{
+	// Both lists are sorted
+	int i = 0, j = 0;
+	while ( i < pBatch->m_Recipients.Count() && j < m_CurrentRecipients.Count() )
+	{
+		if ( pBatch->m_Recipients[i] < m_CurrentRecipients[j] )
+		{
+			++i;
+		}
+		else if ( pBatch->m_Recipients[i] > m_CurrentRecipients[j] )
+		{
+			++j;
+		}
+		else
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Finds a batch for the current message with room for nBits more.
+//			Batches go out in the order they were started, so a message can't
+//			join a batch that's older than one already holding messages for
+//			any of its recipients, or those recipients would get it too early.
+//-----------------------------------------------------------------------------
+CUserMessageBatch::Batch_t *CUserMessageBatch::FindBatch( bool bReliable, int nBits )
+{
+	int nEntryBits = USERMESSAGE_BATCH_ENTRY_BITS + nBits;
+
+	for ( int i = m_nBatchesUsed; --i >= 0; )
+	{
+		Batch_t *pBatch = m_Batches[i];
+		if ( SameRecipients( pBatch, bReliable ) && pBatch->m_nBits + nEntryBits <= MAX_USER_MSG_DATA * 8 )
+			return pBatch;
+
+		if ( SharesRecipients( pBatch ) )
+			break;
+	}
+
+	if ( m_nBatchesUsed == m_Batches.Count() )
+	{
+		m_Batches.AddToTail( new Batch_t );
+	}
+
+	Batch_t *pBatch = m_Batches[m_nBatchesUsed++];
+	pBatch->m_bReliable = bReliable;
+	pBatch->m_Recipients.CopyArray( m_CurrentRecipients.Base(), m_CurrentRecipients.Count() );
+	V_memset( pBatch->m_Data, 0, sizeof( pBatch->m_Data ) );
+	pBatch->m_nBits = 0;
+	pBatch->m_Messages.RemoveAll();
+	pBatch->m_Payloads.RemoveAll();
+	return pBatch;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose:
+//-----------------------------------------------------------------------------
+void CUserMessageBatch::Flush()
+{
+	Assert( m_nCurrentType == -1 );
+
+	for ( int i = 0; i < m_nBatchesUsed; ++i )
+	{
+		SendBatch( m_Batches[i] );
+	}
+	m_nBatchesUsed = 0;
+}
+
+void CUserMessageBatch::RemoveRecipient( int iPlayer )
+{
+	Assert( m_nCurrentType == -1 );
+
+	for ( int i = 0; i < m_nBatchesUsed; ++i )
+	{
+		m_Batches[i]->m_Recipients.FindAndRemove( iPlayer );
+	}
+}
+
+void CUserMessageBatch::Clear()
+{
+	m_nBatchesUsed = 0;
+	m_nCurrentType = -1;
+}
+
+void CUserMessageBatch::SendBatch( Batch_t *pBatch )
+{
+	// Players may have dropped since the messages were sent
+	CRecipientFilter filter;
+	for ( int i = 0; i < pBatch->m_Recipients.Count(); ++i )
+	{
+		CBasePlayer *pPlayer = UTIL_PlayerByIndex( pBatch->m_Recipients[i] );
+		if ( pPlayer )
+		{
+			filter.AddRecipient( pPlayer );
+		}
+	}
+	if ( pBatch->m_bReliable )
+	{
+		filter.MakeReliable();
+	}
+
+	if ( !filter.GetRecipientCount() )
+		return;
+
+	// Not worth wrapping a message that's on its own
+	if ( pBatch->m_Messages.Count() == 1 )
+	{
+		const Message_t &message = pBatch->m_Messages[0];
+		bf_write *pBuf = engine->UserMessageBegin( &filter, message.m_nType );
+		pBuf->WriteBits( pBatch->m_Payloads.Base() + message.m_nDataOffset, message.m_nBits );
+		engine->MessageEnd();
+		return;
+	}
+
+	bf_write *pBuf = engine->UserMessageBegin( &filter, GetBatchMessageType() );
+	pBuf->WriteBits( pBatch->m_Data, pBatch->m_nBits );
+	engine->MessageEnd();
+
+	++m_nBatchesSent;
+
+	// The batch's own header is charged to its first message
+	int nRecipients = filter.GetRecipientCount();
+	for ( int i = 0; i < pBatch->m_Messages.Count(); ++i )
+	{
+		int nSaved = USERMESSAGE_ENGINE_HEADER_BITS - USERMESSAGE_BATCH_ENTRY_BITS;
+		if ( i == 0 )
+		{
+			nSaved -= USERMESSAGE_ENGINE_HEADER_BITS;
+		}
+		GetStats( pBatch->m_Messages[i].m_nType ).m_nBitsSaved += nRecipients * nSaved;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose:
+//-----------------------------------------------------------------------------
+CUserMessageBatch::Stats_t &CUserMessageBatch::GetStats( int nType )
+{
+	while ( m_Stats.Count() <= nType )
+	{
+		Stats_t &stats = m_Stats[ m_Stats.AddToTail() ];
+		stats.m_nMessages = 0;
+		stats.m_nDuplicates = 0;
+		stats.m_nBitsSaved = 0;
+	}
+	return m_Stats[nType];
+}
+
+void CUserMessageBatch::PrintStats() const
+{
+	Msg( "%-24s %10s %10s %12s\n", "message", "sent", "duplicates", "bytes saved" );
+
+	int64 nTotalBitsSaved = 0;
+	for ( int i = 0; i < m_Stats.Count(); ++i )
+	{
+		const Stats_t &stats = m_Stats[i];
+		if ( !stats.m_nMessages )
+			continue;
+
+		Msg( "%-24s %10d %10d %12d\n", usermessages->GetUserMessageName( i ), stats.m_nMessages, stats.m_nDuplicates, (int)( stats.m_nBitsSaved / 8 ) );
+		nTotalBitsSaved += stats.m_nBitsSaved;
+	}
+
+	Msg( "%d batches sent, %d bytes saved in all\n", m_nBatchesSent, (int)( nTotalBitsSaved / 8 ) );
+}
+
+void CUserMessageBatch::ResetStats()
+{
+	m_Stats.RemoveAll();
+	m_nBatchesSent = 0;
+}
+
+CON_COMMAND( sv_usermessage_batch_stats, "Print what sv_usermessage_batch has saved per user message. Usage: sv_usermessage_batch_stats [reset]" )
+{
+	if ( !UTIL_IsCommandIssuedByServerAdmin() )
+		return;
+
+	if ( args.ArgC() > 1 && !V_stricmp( args[1], "reset" ) )
+	{
+		g_UserMessageBatch.ResetStats();
+		return;
+	}
+
+	g_UserMessageBatch.PrintStats();
+}
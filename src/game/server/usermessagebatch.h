@@ -0,0 +1,108 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Holds user messages back until the end of the tick so messages
+//			sent to the same recipients go out as one engine message.
+//
+//			Batched user messages keep their order among themselves and
+//			against user and entity messages sent through UserMessageBegin
+//			and EntityMessageBegin, which send what's held back first.
+//			Messages the engine writes on its own (sounds, temp entities,
+//			string tables, entity state) can still arrive before batched
+//			user messages written earlier in the tick.
+//
+// $NoKeywords: $
+//=============================================================================//
+
+#ifndef USERMESSAGEBATCH_H
+#define USERMESSAGEBATCH_H
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include "irecipientfilter.h"
+#include "bitbuf.h"
+#include "utlvector.h"
+
+//-----------------------------------------------------------------------------
+// Purpose: Used by UserMessageBegin/MessageEnd when sv_usermessage_batch is on
+//-----------------------------------------------------------------------------
+class CUserMessageBatch
+{
+public:
+	CUserMessageBatch();
+	~CUserMessageBatch();
+
+	bool IsEnabled() const;
+
+	// Returns the buffer to write the message into, or NULL if the message
+	// has to go straight to the engine
+	bf_write *Begin( IRecipientFilter &filter, int msg_type );
+
+	// Finishes the message started by Begin()
+	void End();
+
+	// Sends everything held back this tick
+	void Flush();
+
+	// Throws away everything held back this tick
+	void Clear();
+
+	// Stops anything held back from going to a client that's leaving, so a
+	// new client in the same slot doesn't get it
+	void RemoveRecipient( int iPlayer );
+
+	void PrintStats() const;
+	void ResetStats();
+
+private:
+	struct Message_t
+	{
+		int	m_nType;
+		int	m_nBits;
+		int	m_nDataOffset;		// into Batch_t::m_Payloads
+	};
+
+	// Messages this tick with the same reliability and recipients, sent in a row
+	struct Batch_t
+	{
+		bool				m_bReliable;
+		CUtlVector< int >	m_Recipients;		// sorted
+		byte				m_Data[MAX_USER_MSG_DATA];
+		int					m_nBits;
+
+		// Each message on its own, to send unwrapped if it ends up alone and to find duplicates
+		CUtlVector< Message_t >	m_Messages;
+		CUtlVector< byte >		m_Payloads;
+	};
+
+	struct Stats_t
+	{
+		int		m_nMessages;
+		int		m_nDuplicates;
+		int64	m_nBitsSaved;
+	};
+
+	bool SameRecipients( const Batch_t *pBatch, bool bReliable ) const;
+	bool SharesRecipients( const Batch_t *pBatch ) const;
+	bool IsDuplicate( bool bReliable, int nType, const byte *pData, int nBits ) const;
+	Batch_t *FindBatch( bool bReliable, int nBits );
+	void SendBatch( Batch_t *pBatch );
+	Stats_t &GetStats( int nType );
+
+	// The message being written
+	bf_write			m_Current;
+	byte				m_CurrentData[MAX_USER_MSG_DATA];
+	int					m_nCurrentType;
+	bool				m_bCurrentReliable;
+	CUtlVector< int >	m_CurrentRecipients;
+
+	CUtlVector< Batch_t * >	m_Batches;
+	int						m_nBatchesUsed;
+
+	CUtlVector< Stats_t >	m_Stats;
+	int						m_nBatchesSent;
+};
+
+extern CUserMessageBatch g_UserMessageBatch;
+
+#endif // USERMESSAGEBATCH_H
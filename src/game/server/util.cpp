@@ -36,6 +36,7 @@
 #include "datacache/imdlcache.h"
 #include "util.h"
 #include "cdll_int.h"
+#include "entity_spatial_hash.h"
 
 #ifdef PORTAL
 #include "PortalSimulation.h"
@@ -282,8 +283,26 @@ float UTIL_GetSimulationInterval()
 //-----------------------------------------------------------------------------
 // Purpose: 
 //-----------------------------------------------------------------------------
+static void UTIL_EnumerateSpatialHashResults( const CUtlVector< unsigned short > &entities, IPartitionEnumerator *pEnum )
+{
+	for ( int i = 0; i < entities.Count(); ++i )
+	{
+		CBaseEntity *pEntity = UTIL_EntityByIndex( entities[i] );
+		if ( pEntity && pEnum->EnumElement( pEntity ) == ITERATION_STOP )
+			break;
+	}
+}
+
 int UTIL_EntitiesInBox( const Vector &mins, const Vector &maxs, CFlaggedEntitiesEnum *pEnum )
 {
+	if ( g_pEntitySpatialHash->IsEnabled() )
+	{
+		CUtlVector< unsigned short > entities;
+		g_pEntitySpatialHash->EntitiesInBox( mins, maxs, entities );
+		UTIL_EnumerateSpatialHashResults( entities, pEnum );
+		return pEnum->GetCount();
+	}
+
 	partition->EnumerateElementsInBox( PARTITION_ENGINE_NON_STATIC_EDICTS, mins, maxs, false, pEnum );
 	return pEnum->GetCount();
 }
@@ -296,6 +315,14 @@ int UTIL_EntitiesAlongRay( const Ray_t &ray, CFlaggedEntitiesEnum *pEnum )
 
 int UTIL_EntitiesInSphere( const Vector &center, float radius, CFlaggedEntitiesEnum *pEnum )
 {
+	if ( g_pEntitySpatialHash->IsEnabled() )
+	{
+		CUtlVector< unsigned short > entities;
+		g_pEntitySpatialHash->EntitiesInSphere( center, radius, entities );
+		UTIL_EnumerateSpatialHashResults( entities, pEnum );
+		return pEnum->GetCount();
+	}
+
 	partition->EnumerateElementsInSphere( PARTITION_ENGINE_NON_STATIC_EDICTS, center, radius, false, pEnum );
 	return pEnum->GetCount();
 }
@@ -24,6 +24,8 @@
 #include "baseanimating.h"
 #include "sendproxy.h"
 #include "hierarchy.h"
+#include "trigger_broadphase.h"
+#include "entity_spatial_hash.h"
 #endif
 
 #include "predictable_entity.h"
@@ -1298,6 +1300,10 @@ void CCollisionProperty::DestroyPartitionHandle()
 	{
 		partition->DestroyHandle( m_Partition );
 		m_Partition = PARTITION_INVALID_HANDLE;
+#ifndef CLIENT_DLL
+		g_pTriggerBroadphase->RemoveElement( m_pOuter );
+		g_pEntitySpatialHash->RemoveElement( m_pOuter );
+#endif
 	}
 }
 
@@ -1318,17 +1324,29 @@ void CCollisionProperty::UpdateServerPartitionMask( )
 
 	// Don't bother with deleted things
 	if ( !m_pOuter->edict() )
+	{
+		g_pTriggerBroadphase->SetTriggerListed( m_pOuter, false );
+		g_pEntitySpatialHash->SetListed( m_pOuter, false );
 		return;
+	}
 
 	// don't add the world
 	if ( m_pOuter->entindex() == 0 )
 		return;		
 
+	// Keep the trigger broadphase in step with PARTITION_ENGINE_TRIGGER_EDICTS
+	g_pTriggerBroadphase->SetTriggerListed( m_pOuter, IsSolidFlagSet(FSOLID_TRIGGER) );
+
 	// Make sure it's in the list of all entities
 	bool bIsSolid = IsSolid() || IsSolidFlagSet(FSOLID_TRIGGER);
 	if ( bIsSolid || m_pOuter->IsEFlagSet(EFL_USE_PARTITION_WHEN_NOT_SOLID) )
 	{
 		partition->Insert( PARTITION_ENGINE_NON_STATIC_EDICTS, handle );
+		g_pEntitySpatialHash->SetListed( m_pOuter, true );
+	}
+	else
+	{
+		g_pEntitySpatialHash->SetListed( m_pOuter, false );
 	}
 
 	if ( !bIsSolid )
@@ -1410,10 +1428,18 @@ void CCollisionProperty::UpdatePartition( )
 				vecSurroundMins -= Vector( 1, 1, 1 );
 				vecSurroundMaxs += Vector( 1, 1, 1 );
 				partition->ElementMoved( GetPartitionHandle(), vecSurroundMins,  vecSurroundMaxs );
+#ifndef CLIENT_DLL
+				g_pTriggerBroadphase->ElementMoved( m_pOuter, vecSurroundMins, vecSurroundMaxs );
+				g_pEntitySpatialHash->ElementMoved( m_pOuter, vecSurroundMins, vecSurroundMaxs );
+#endif
 			}
 			else
 			{
 				partition->ElementMoved( GetPartitionHandle(), GetCollisionOrigin(),  GetCollisionOrigin() );
+#ifndef CLIENT_DLL
+				g_pTriggerBroadphase->ElementMoved( m_pOuter, GetCollisionOrigin(), GetCollisionOrigin() );
+				g_pEntitySpatialHash->ElementMoved( m_pOuter, GetCollisionOrigin(), GetCollisionOrigin() );
+#endif
 			}
 		}
 	}
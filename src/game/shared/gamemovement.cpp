@@ -50,6 +50,8 @@ ConVar xc_uncrouch_on_jump( "xc_uncrouch_on_jump", "1", FCVAR_ARCHIVE, "Uncrouch
 ConVar player_limit_jump_speed( "player_limit_jump_speed", "1", FCVAR_REPLICATED );
 #endif
 
+ConVar sv_movement_tracelist( "sv_movement_tracelist", "0", FCVAR_REPLICATED, "Gather the world leaves and entities around each player move once and run the move's hull traces against only those." );
+
 // option_duck_method is a carrier convar. Its sole purpose is to serve an easy-to-flip
 // convar which is ONLY set by the X360 controller menu to tell us which way to bind the
 // duck controls. Its value is meaningless anytime we don't have the options window open.
@@ -624,6 +626,9 @@ CGameMovement::CGameMovement( void )
 
 	mv					= NULL;
 
+	m_pTraceListData	= NULL;
+	m_bTraceListValid	= false;
+
 	memset( m_flStuckCheckTime, 0, sizeof(m_flStuckCheckTime) );
 }
 
@@ -632,6 +637,7 @@ CGameMovement::CGameMovement( void )
 //-----------------------------------------------------------------------------
 CGameMovement::~CGameMovement( void )
 {
+	delete m_pTraceListData;
 }
 
 //-----------------------------------------------------------------------------
@@ -1141,6 +1147,7 @@ void CGameMovement::ProcessMovement( CBasePlayer *pPlayer, CMoveData *pMove )
 	gpGlobals->frametime *= pPlayer->GetLaggedMovementValue();
 
 	ResetGetPointContentsCache();
+	ResetTraceListData();
 
 	// Cropping movement speed scales mv->m_fForwardSpeed etc. globally
 	// Once we crop, we don't want to recursively crop again, so we set the crop
@@ -4909,11 +4916,67 @@ void CGameMovement::TracePlayerBBox( const Vector& start, const Vector& end, uns
 
 	Ray_t ray;
 	ray.Init( start, end, GetPlayerMins(), GetPlayerMaxs() );
-	UTIL_TraceRay( ray, fMask, mv->m_nPlayerHandle.Get(), collisionGroup, &pm );
+	TraceHullAgainstMoveList( ray, fMask, collisionGroup, pm );
 
 }
 
 
+//-----------------------------------------------------------------------------
+// Purpose: Same result as UTIL_TraceRay, but the first trace of a command
+//			gathers the leaves and entities around everywhere the command can
+//			reach, and traces that stay inside that box only test against them.
+//-----------------------------------------------------------------------------
+void CGameMovement::TraceHullAgainstMoveList( const Ray_t &ray, unsigned int fMask, int collisionGroup, trace_t &pm )
+{
+	if ( !sv_movement_tracelist.GetBool() )
+	{
+		UTIL_TraceRay( ray, fMask, mv->m_nPlayerHandle.Get(), collisionGroup, &pm );
+		return;
+	}
+
+	Vector vecRayEnd = ray.m_Start + ray.m_Delta;
+	Vector vecRayMins, vecRayMaxs;
+	VectorMin( ray.m_Start, vecRayEnd, vecRayMins );
+	VectorMax( ray.m_Start, vecRayEnd, vecRayMaxs );
+	vecRayMins -= ray.m_Extents;
+	vecRayMaxs += ray.m_Extents;
+
+	if ( !m_bTraceListValid ||
+		vecRayMins.x < m_vecTraceListMins.x || vecRayMins.y < m_vecTraceListMins.y || vecRayMins.z < m_vecTraceListMins.z ||
+		vecRayMaxs.x > m_vecTraceListMaxs.x || vecRayMaxs.y > m_vecTraceListMaxs.y || vecRayMaxs.z > m_vecTraceListMaxs.z )
+	{
+		// Big enough for the rest of the move, stepping and ground checks included
+		float flReach = player->GetStepSize() + mv->m_vecVelocity.Length() * gpGlobals->frametime;
+		Vector vecReach( flReach, flReach, flReach );
+		m_vecTraceListMins = vecRayMins - vecReach;
+		m_vecTraceListMaxs = vecRayMaxs + vecReach;
+
+		if ( !m_pTraceListData )
+		{
+			m_pTraceListData = new CTraceListData;
+		}
+		enginetrace->SetupLeafAndEntityListBox( m_vecTraceListMins, m_vecTraceListMaxs, *m_pTraceListData );
+		m_bTraceListValid = true;
+	}
+
+	CTraceFilterSimple traceFilter( mv->m_nPlayerHandle.Get(), collisionGroup );
+	enginetrace->TraceRayAgainstLeafAndEntityList( ray, *m_pTraceListData, fMask, &traceFilter, &pm );
+
+	if ( r_visualizetraces.GetBool() )
+	{
+		DebugDrawLine( pm.startpos, pm.endpos, 255, 0, 0, true, -1.0f );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Other entities may have moved since the last command
+//-----------------------------------------------------------------------------
+void CGameMovement::ResetTraceListData()
+{
+	m_bTraceListValid = false;
+}
+
+
 
 //-----------------------------------------------------------------------------
 // Purpose: overridded by game classes to limit results (to standable objects for example)
@@ -4924,6 +4987,6 @@ void  CGameMovement::TryTouchGround( const Vector& start, const Vector& end, con
 
 	Ray_t ray;
 	ray.Init( start, end, mins, maxs );
-	UTIL_TraceRay( ray, fMask, mv->m_nPlayerHandle.Get(), collisionGroup, &pm );
+	TraceHullAgainstMoveList( ray, fMask, collisionGroup, pm );
 }
 
@@ -35,6 +35,7 @@ enum
 struct surfacedata_t;
 
 class CBasePlayer;
+class CTraceListData;
 
 class CGameMovement : public IGameMovement
 {
@@ -210,6 +211,11 @@ protected:
 	void ResetGetPointContentsCache();
 	int GetPointContentsCached( const Vector &point, int slot );
 
+	// Hull traces for the player, against the leaves and entities gathered
+	// around the current move instead of the whole world where possible
+	void			TraceHullAgainstMoveList( const Ray_t &ray, unsigned int fMask, int collisionGroup, trace_t &pm );
+	void			ResetTraceListData();
+
 	// Ducking
 	virtual void	Duck( void );
 	virtual void	HandleDuckingSpeedCrop();
@@ -268,6 +274,13 @@ protected:
 	int m_CachedGetPointContents[ MAX_PLAYERS ][ MAX_PC_CACHE_SLOTS ];
 	Vector m_CachedGetPointContentsPoint[ MAX_PLAYERS ][ MAX_PC_CACHE_SLOTS ];	
 
+	// Leaves and entities inside m_vecTraceListMins/Maxs, gathered once per
+	// usercmd and reused by every hull trace that fits inside that box.
+	CTraceListData	*m_pTraceListData;
+	Vector			m_vecTraceListMins;
+	Vector			m_vecTraceListMaxs;
+	bool			m_bTraceListValid;
+
 	Vector			m_vecProximityMins;		// Used to be globals in sv_user.cpp.
 	Vector			m_vecProximityMaxs;
 
@@ -8,6 +8,7 @@
 #include "cbase.h"
 
 #include "utlhashtable.h"
+#include "tier0/threadtools.h"
 #ifndef GC
 #include "igamesystem.h"
 #endif
@@ -16,6 +17,31 @@
 // memdbgon must be the last include file in a .cpp file!!!
 #include "tier0/memdbgon.h"
 
+// Strings are carved out of large arena blocks that live until level shutdown,
+// so pointers handed out as string_t are stable and never individually freed.
+#define GAMESTRINGPOOL_BLOCK_SIZE		( 64 * 1024 )
+#define GAMESTRINGPOOL_INITIAL_SLOTS	4096
+
+//-----------------------------------------------------------------------------
+// Purpose: Stored immediately in front of every pooled string
+//-----------------------------------------------------------------------------
+struct PooledStringHeader_t
+{
+	uint32	m_nHash;
+	uint32	m_nLength;
+};
+
+//-----------------------------------------------------------------------------
+// Purpose: Open addressed table of pooled strings. Slots only ever go from
+//			NULL to a string, so readers can probe without taking a lock.
+//-----------------------------------------------------------------------------
+struct PooledStringTable_t
+{
+	uint32				m_nMask;
+	uint32				m_nCount;
+	const char * volatile m_pSlots[1];
+};
+
 //-----------------------------------------------------------------------------
 // Purpose: The actual storage for pooled per-level strings
 //-----------------------------------------------------------------------------
@@ -28,31 +54,176 @@ class CGameStringPool : public CBaseGameSystem
 	virtual char const *Name() { return "CGameStringPool"; }
 	virtual void LevelShutdownPostEntity() { FreeAll(); }
 
+	// Must only be called when no other thread can be reading the pool
 	void FreeAll()
 	{
-#if 0 && _DEBUG
-		m_Strings.DbgCheckIntegrity();
-		m_KeyLookupCache.DbgCheckIntegrity();
-#endif
-		m_Strings.Purge();
+		AUTO_LOCK_FM( m_Mutex );
+
+		for ( int i = 0; i < m_Blocks.Count(); ++i )
+		{
+			free( m_Blocks[i] );
+		}
+		m_Blocks.Purge();
+		m_pCurBlock = NULL;
+		m_nCurBlockUsed = 0;
+		m_nCurBlockSize = 0;
+
+		for ( int i = 0; i < m_RetiredTables.Count(); ++i )
+		{
+			free( m_RetiredTables[i] );
+		}
+		m_RetiredTables.Purge();
+		free( (void *)m_pTable );
+		m_pTable = NULL;
+
 		m_KeyLookupCache.Purge();
+
+		m_nStringBytes = 0;
+		m_nCollisions = 0;
+	}
+
+	static PooledStringHeader_t *GetHeader( const char *pszPooled )
+	{
+		return (PooledStringHeader_t *)( pszPooled - sizeof( PooledStringHeader_t ) );
+	}
+
+	// FNV-1a; computes the length in the same pass
+	static uint32 HashPooledString( const char *pszString, uint32 *pLength )
+	{
+		const uint8 *p = (const uint8 *)pszString;
+		uint32 nHash = 2166136261u;
+		while ( *p )
+		{
+			nHash ^= *p++;
+			nHash *= 16777619u;
+		}
+		*pLength = (uint32)( (const char *)p - pszString );
+		return nHash;
+	}
+
+	static const char *Lookup( const PooledStringTable_t *pTable, const char *pszString, uint32 nHash, uint32 nLength )
+	{
+		if ( !pTable )
+			return NULL;
+
+		for ( uint32 i = nHash & pTable->m_nMask; ; i = ( i + 1 ) & pTable->m_nMask )
+		{
+			const char *pszSlot = pTable->m_pSlots[i];
+			if ( !pszSlot )
+				return NULL;
+
+			const PooledStringHeader_t *pHeader = GetHeader( pszSlot );
+			if ( pHeader->m_nHash == nHash && pHeader->m_nLength == nLength && !V_memcmp( pszSlot, pszString, nLength ) )
+				return pszSlot;
+		}
+	}
+
+	static PooledStringTable_t *AllocTable( uint32 nSlots )
+	{
+		size_t nBytes = sizeof( PooledStringTable_t ) + ( nSlots - 1 ) * sizeof( const char * );
+		PooledStringTable_t *pTable = (PooledStringTable_t *)malloc( nBytes );
+		V_memset( pTable, 0, nBytes );
+		pTable->m_nMask = nSlots - 1;
+		return pTable;
+	}
+
+	// Returns true if the string did not land in its home slot
+	static bool InsertIntoTable( PooledStringTable_t *pTable, const char *pszPooled )
+	{
+		uint32 nHome = GetHeader( pszPooled )->m_nHash & pTable->m_nMask;
+		uint32 i = nHome;
+		while ( pTable->m_pSlots[i] )
+		{
+			i = ( i + 1 ) & pTable->m_nMask;
+		}
+
+		// Make sure the string contents are visible before the slot is
+		ThreadMemoryBarrier();
+		pTable->m_pSlots[i] = pszPooled;
+		pTable->m_nCount++;
+		return ( i != nHome );
+	}
+
+	// Readers may still be probing the old table, so it is retired rather
+	// than freed and only released at level shutdown.
+	void GrowTable()
+	{
+		PooledStringTable_t *pOld = (PooledStringTable_t *)m_pTable;
+		uint32 nSlots = pOld ? ( pOld->m_nMask + 1 ) * 2 : GAMESTRINGPOOL_INITIAL_SLOTS;
+
+		PooledStringTable_t *pNew = AllocTable( nSlots );
+		if ( pOld )
+		{
+			for ( uint32 i = 0; i <= pOld->m_nMask; ++i )
+			{
+				const char *pszSlot = pOld->m_pSlots[i];
+				if ( pszSlot )
+				{
+					InsertIntoTable( pNew, pszSlot );
+				}
+			}
+			m_RetiredTables.AddToTail( pOld );
+		}
+
+		ThreadMemoryBarrier();
+		m_pTable = pNew;
+	}
+
+	char *AllocFromArena( uint32 nBytes )
+	{
+		// Keep headers aligned
+		nBytes = ( nBytes + sizeof( uint32 ) - 1 ) & ~( sizeof( uint32 ) - 1 );
+
+		if ( m_nCurBlockUsed + nBytes > m_nCurBlockSize )
+		{
+			uint32 nBlockSize = MAX( nBytes, (uint32)GAMESTRINGPOOL_BLOCK_SIZE );
+			m_pCurBlock = (char *)malloc( nBlockSize );
+			m_nCurBlockSize = nBlockSize;
+			m_nCurBlockUsed = 0;
+			m_Blocks.AddToTail( m_pCurBlock );
+		}
+
+		char *pResult = m_pCurBlock + m_nCurBlockUsed;
+		m_nCurBlockUsed += nBytes;
+		return pResult;
 	}
 
-	CUtlHashtable<CUtlConstString> m_Strings;
+	CThreadFastMutex m_Mutex;
+	PooledStringTable_t * volatile m_pTable;
+	CUtlVector<PooledStringTable_t *> m_RetiredTables;
+
+	CUtlVector<char *> m_Blocks;
+	char *m_pCurBlock;
+	uint32 m_nCurBlockUsed;
+	uint32 m_nCurBlockSize;
+
+	uint32 m_nStringBytes;
+	uint32 m_nCollisions;
+
 	CUtlHashtable<const void*, const char*> m_KeyLookupCache;
 
 public:
 
-	CGameStringPool() : m_Strings(256) { }
+	CGameStringPool() : m_pTable( NULL ), m_pCurBlock( NULL ), m_nCurBlockUsed( 0 ), m_nCurBlockSize( 0 ), m_nStringBytes( 0 ), m_nCollisions( 0 ) { }
 
 	~CGameStringPool() { FreeAll(); }
 
 	void Dump( void )
 	{
-		CUtlVector<const char*> strings( 0, m_Strings.Count() );
-		for (UtlHashHandle_t i = m_Strings.FirstHandle(); i != m_Strings.InvalidHandle(); i = m_Strings.NextHandle(i))
+		AUTO_LOCK_FM( m_Mutex );
+
+		const PooledStringTable_t *pTable = m_pTable;
+		CUtlVector<const char*> strings( 0, pTable ? pTable->m_nCount : 0 );
+		if ( pTable )
 		{
-			strings.AddToTail( strings[i] );
+			for ( uint32 i = 0; i <= pTable->m_nMask; ++i )
+			{
+				const char *pszSlot = pTable->m_pSlots[i];
+				if ( pszSlot )
+				{
+					strings.AddToTail( pszSlot );
+				}
+			}
 		}
 		struct _Local {
 			static int __cdecl F(const char * const *a, const char * const *b) { return strcmp(*a, *b); }
@@ -65,21 +236,59 @@ public:
 		}
 		DevMsg( "\n" );
 		DevMsg( "Size:  %d items\n", strings.Count() );
+		DevMsg( "Bytes: %u in strings, %d arena blocks (%u bytes reserved)\n", m_nStringBytes, m_Blocks.Count(), 
+			( m_Blocks.Count() ? ( m_Blocks.Count() - 1 ) * GAMESTRINGPOOL_BLOCK_SIZE : 0 ) + m_nCurBlockSize );
+		DevMsg( "Table: %u slots, %u collisions\n", pTable ? pTable->m_nMask + 1 : 0, m_nCollisions );
 	}
 
+	// Safe to call from any thread
 	const char *Find(const char *string)
 	{
-		UtlHashHandle_t i = m_Strings.Find( string );
-		return i == m_Strings.InvalidHandle() ? NULL : m_Strings[ i ].Get();
+		uint32 nLength;
+		uint32 nHash = HashPooledString( string, &nLength );
+		return Lookup( m_pTable, string, nHash, nLength );
 	}
 
+	// Safe to call from any thread; only takes the lock if the string is new
 	const char *Allocate(const char *string)
 	{
-		return m_Strings[ m_Strings.Insert( string ) ].Get();
+		uint32 nLength;
+		uint32 nHash = HashPooledString( string, &nLength );
+		const char *pszResult = Lookup( m_pTable, string, nHash, nLength );
+		if ( pszResult )
+			return pszResult;
+
+		AUTO_LOCK_FM( m_Mutex );
+
+		// Someone may have added it (or grown the table) while we were waiting
+		pszResult = Lookup( m_pTable, string, nHash, nLength );
+		if ( pszResult )
+			return pszResult;
+
+		if ( !m_pTable || ( m_pTable->m_nCount + 1 ) * 2 > m_pTable->m_nMask + 1 )
+		{
+			GrowTable();
+		}
+
+		char *pMem = AllocFromArena( sizeof( PooledStringHeader_t ) + nLength + 1 );
+		PooledStringHeader_t *pHeader = (PooledStringHeader_t *)pMem;
+		pHeader->m_nHash = nHash;
+		pHeader->m_nLength = nLength;
+		char *pszPooled = pMem + sizeof( PooledStringHeader_t );
+		V_memcpy( pszPooled, string, nLength + 1 );
+
+		if ( InsertIntoTable( m_pTable, pszPooled ) )
+		{
+			m_nCollisions++;
+		}
+		m_nStringBytes += nLength + 1;
+		return pszPooled;
 	}
 
 	const char *AllocateWithKey(const char *string, const void* key)
 	{
+		AUTO_LOCK_FM( m_Mutex );
+
 		const char * &cached = m_KeyLookupCache[ m_KeyLookupCache.Insert( key, NULL ) ];
 		if (cached == NULL)
 		{
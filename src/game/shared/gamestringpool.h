@@ -3,6 +3,7 @@
 // Purpose: Pool of all per-level strings. Allocates memory for strings, 
 //			consolodating duplicates. The memory is freed on behalf of clients
 //			at level transition. Strings are of type string_t.
+//			Lookups and allocations may be made from any thread.
 //
 // $NoKeywords: $
 //=============================================================================//
@@ -14,6 +14,9 @@
 #if defined( _X360 )
 #include "xbox/xbox_console.h"
 #endif
+#ifdef GAME_DLL
+#include "tickprofiler.h"
+#endif
 
 // memdbgon must be the last include file in a .cpp file!!!
 #include "tier0/memdbgon.h"
@@ -377,6 +380,9 @@ void InvokePerFrameMethod( PerFrameGameSystemFunc_t f, char const *timed /*=0*/
 	{
 		IGameSystemPerFrame *sys  = s_GameSystemsPerFrame[i];
 		MDLCACHE_CRITICAL_SECTION();
+#ifdef GAME_DLL
+		TICKPROF_SCOPE( TICKPROF_GAMESYSTEM, sys->Name() );
+#endif
 		(sys->*f)();
 	}
 }
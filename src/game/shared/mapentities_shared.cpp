@@ -116,17 +116,19 @@ const char *MapEntity_ParseToken( const char *data, char *newToken )
 	if (!data)
 		return NULL;
 
-	// build the new table if we have to
+	// build the new table if we have to. The flag is only cleared once the table
+	// is complete, so threads racing through here at worst build it twice.
 	if ( s_BuildReverseMap )
 	{
-		s_BuildReverseMap = false; 
-
 		Q_memset( s_BraceCharacters, 0, sizeof(s_BraceCharacters) );
 
 		for ( const char *c = s_BraceChars; *c; c++ )
 		{
 			s_BraceCharacters[(unsigned)*c] = true;
 		}
+
+		ThreadMemoryBarrier();
+		s_BuildReverseMap = false; 
 	}
 		
 // skip whitespace
@@ -207,22 +209,50 @@ skipwhite:
 
 bool CEntityMapData::ExtractValue( const char *keyName, char *value )
 {
+	if ( m_pKeyValues )
+	{
+		for ( int i = 0; i < m_nKeyValues; i++ )
+		{
+			if ( !strcmp( m_pKeyValues[i].m_pszKey, keyName ) )
+			{
+				Q_strncpy( value, m_pKeyValues[i].m_pszValue, MAPKEY_MAXLENGTH );
+				return true;
+			}
+		}
+		return false;
+	}
+
 	return MapEntity_ExtractValue( m_pEntData, keyName, value );
 }
 
 bool CEntityMapData::GetFirstKey( char *keyName, char *value )
 {
 	m_pCurrentKey = m_pEntData; // reset the status pointer
+	m_iCurrentKeyValue = 0;
 	return GetNextKey( keyName, value );
 }
 
 const char *CEntityMapData::CurrentBufferPosition( void )
 {
+	if ( m_pKeyValues )
+		return m_pKeysEnd;
+
 	return m_pCurrentKey;
 }
 
 bool CEntityMapData::GetNextKey( char *keyName, char *value )
 {
+	if ( m_pKeyValues )
+	{
+		if ( m_iCurrentKeyValue >= m_nKeyValues )
+			return false;
+
+		Q_strncpy( keyName, m_pKeyValues[m_iCurrentKeyValue].m_pszKey, MAPKEY_MAXLENGTH );
+		Q_strncpy( value, m_pKeyValues[m_iCurrentKeyValue].m_pszValue, MAPKEY_MAXLENGTH );
+		m_iCurrentKeyValue++;
+		return true;
+	}
+
 	char token[MAPKEY_MAXLENGTH];
 
 	// parse key
@@ -12,6 +12,15 @@
 
 #define MAPKEY_MAXLENGTH	2048
 
+//-----------------------------------------------------------------------------
+// Purpose: a key/value pair that has already been tokenized out of an
+//			entity block (see CEntityMapData's pre-parsed constructor)
+//-----------------------------------------------------------------------------
+struct MapEntityKeyValue_t
+{
+	const char	*m_pszKey;
+	const char	*m_pszValue;
+};
 
 //-----------------------------------------------------------------------------
 // Purpose: encapsulates the data string in the map file 
@@ -25,9 +34,21 @@ private:
 	int		m_nEntDataSize;
 	char	*m_pCurrentKey;
 
+	// Optional pre-tokenized keys; when set, key lookups don't touch the text block
+	const MapEntityKeyValue_t *m_pKeyValues;
+	int		m_nKeyValues;
+	int		m_iCurrentKeyValue;
+	char	*m_pKeysEnd;
+
 public:
 	explicit CEntityMapData( char *entBlock, int nEntBlockSize = -1 ) : 
-		m_pEntData(entBlock), m_nEntDataSize(nEntBlockSize), m_pCurrentKey(entBlock) {}
+		m_pEntData(entBlock), m_nEntDataSize(nEntBlockSize), m_pCurrentKey(entBlock),
+		m_pKeyValues(NULL), m_nKeyValues(0), m_iCurrentKeyValue(0), m_pKeysEnd(NULL) {}
+
+	// pKeysEnd is where a text parse of entBlock would have stopped (see CurrentBufferPosition)
+	CEntityMapData( char *entBlock, const MapEntityKeyValue_t *pKeyValues, int nKeyValues, char *pKeysEnd ) : 
+		m_pEntData(entBlock), m_nEntDataSize(-1), m_pCurrentKey(entBlock),
+		m_pKeyValues(pKeyValues), m_nKeyValues(nKeyValues), m_iCurrentKeyValue(0), m_pKeysEnd(pKeysEnd) {}
 
 	// find the keyName in the entdata and puts it's value into Value.  returns false if key is not found
 	bool ExtractValue( const char *keyName, char *Value );
@@ -13,6 +13,33 @@
 
 void RegisterUserMessages( void );
 
+#if defined( CLIENT_DLL )
+//-----------------------------------------------------------------------------
+// Purpose: Unpacks user messages the server sent together (usermessagebatch.cpp)
+//-----------------------------------------------------------------------------
+static void __MsgFunc_UserMessageBatch( bf_read &msg )
+{
+	int nBatchType = usermessages->LookupUserMessage( USERMESSAGE_BATCH_NAME );
+	byte data[MAX_USER_MSG_DATA];
+
+	while ( msg.GetNumBitsLeft() >= 8 + USERMESSAGE_BATCH_LENGTH_BITS )
+	{
+		int msg_type = msg.ReadByte();
+		int nBits = msg.ReadUBitLong( USERMESSAGE_BATCH_LENGTH_BITS );
+		if ( msg_type == nBatchType || nBits > msg.GetNumBitsLeft() || nBits > (int)sizeof( data ) * 8 )
+		{
+			DevMsg( "__MsgFunc_UserMessageBatch:  Bogus entry for msg type %i\n", msg_type );
+			Assert( 0 );
+			return;
+		}
+
+		msg.ReadBits( data, nBits );
+		bf_read entry( "UserMessageBatch", data, BitByte( nBits ), nBits );
+		usermessages->DispatchUserMessage( msg_type, entry );
+	}
+}
+#endif
+
 //-----------------------------------------------------------------------------
 // Purpose: Force registration on .dll load
 // FIXME:  Should this be a client/server system?
@@ -21,6 +48,11 @@ CUserMessages::CUserMessages()
 {
 	// Game specific registration function;
 	RegisterUserMessages();
+
+	Register( USERMESSAGE_BATCH_NAME, -1 );
+#if defined( CLIENT_DLL )
+	HookMessage( USERMESSAGE_BATCH_NAME, __MsgFunc_UserMessageBatch );
+#endif
 }
 
 CUserMessages::~CUserMessages()
@@ -15,6 +15,11 @@
 #include <bitbuf.h>
 
 
+// Registered after the game's own messages. Its payload is a list of
+// ( byte type, USERMESSAGE_BATCH_LENGTH_BITS length in bits, data ) entries.
+#define USERMESSAGE_BATCH_NAME			"UserMessageBatch"
+#define USERMESSAGE_BATCH_LENGTH_BITS	11
+
 // Client dispatch function for usermessages
 typedef void (*pfnUserMsgHook)(bf_read &msg);
 
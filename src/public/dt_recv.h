@@ -361,6 +361,61 @@ RecvProp RecvPropInt(
 	RecvVarProxyFn varProxy=0
 	);
 
+// The receiving side of SendPropAuto: RecvPropInt/RecvPropFloat/RecvPropVector
+// and the standard proxy picked from the variable's type.
+//
+//		RecvPropAuto( RECVINFO_AUTO( m_iAmmoID ) ),
+//
+#define RECVINFO_AUTO(varName)					#varName, offsetof(currentRecvDTClass, varName), &((currentRecvDTClass*)0)->varName
+
+class Vector;
+
+template< class T > struct RecvPropAutoType;
+
+template< class T >
+struct RecvPropAutoIntType
+{
+	static RecvProp Make( const char *pVarName, int offset, int flags )
+	{
+		return RecvPropInt( pVarName, offset, sizeof( T ), flags );
+	}
+};
+
+template<> struct RecvPropAutoType< bool > : RecvPropAutoIntType< bool > {};
+template<> struct RecvPropAutoType< char > : RecvPropAutoIntType< char > {};
+template<> struct RecvPropAutoType< int8 > : RecvPropAutoIntType< int8 > {};
+template<> struct RecvPropAutoType< uint8 > : RecvPropAutoIntType< uint8 > {};
+template<> struct RecvPropAutoType< int16 > : RecvPropAutoIntType< int16 > {};
+template<> struct RecvPropAutoType< uint16 > : RecvPropAutoIntType< uint16 > {};
+template<> struct RecvPropAutoType< int32 > : RecvPropAutoIntType< int32 > {};
+template<> struct RecvPropAutoType< uint32 > : RecvPropAutoIntType< uint32 > {};
+#ifdef SUPPORTS_INT64
+template<> struct RecvPropAutoType< int64 > : RecvPropAutoIntType< int64 > {};
+template<> struct RecvPropAutoType< uint64 > : RecvPropAutoIntType< uint64 > {};
+#endif
+
+template<> struct RecvPropAutoType< float >
+{
+	static RecvProp Make( const char *pVarName, int offset, int flags )
+	{
+		return RecvPropFloat( pVarName, offset, sizeof( float ), flags );
+	}
+};
+
+template<> struct RecvPropAutoType< Vector >
+{
+	static RecvProp Make( const char *pVarName, int offset, int flags )
+	{
+		return RecvPropVector( pVarName, offset, sizeof( float ) * 3, flags );
+	}
+};
+
+template< class T >
+inline RecvProp RecvPropAuto( const char *pVarName, int offset, const T *pVarType, int flags=0 )
+{
+	return RecvPropAutoType< T >::Make( pVarName, offset, flags );
+}
+
 RecvProp RecvPropString(
 	const char *pVarName,
 	int offset,
@@ -717,6 +717,82 @@ inline SendProp SendPropModelIndex( const char *pVarName, int offset, int sizeof
 	return SendPropInt( pVarName, offset, sizeofVar, SP_MODEL_INDEX_BITS, 0 );
 }
 
+// ------------------------------------------------------------------------ //
+// SendPropAuto picks SendPropInt/SendPropFloat/SendPropVector, the full
+// bit count, SPROP_UNSIGNED and the standard proxy from the C++ type of the
+// variable at compile time:
+//
+//		SendPropAuto( SENDINFO_AUTO( m_iAmmoID ), 5 ),
+//
+// The prop it builds is exactly what the equivalent hand-written call builds,
+// so switching a table over doesn't change its layout or CRC, as long as the
+// hand-written call already had SPROP_UNSIGNED on unsigned types. Types
+// without a SendPropAutoType specialization fail to compile.
+// ------------------------------------------------------------------------ //
+#define SENDINFO_AUTO(varName)				#varName, offsetof(currentSendDTClass::MakeANetworkVar_##varName, varName), &((currentSendDTClass*)0)->varName.m_Value
+
+class Vector;
+
+template< class T > struct SendPropAutoType;
+
+// The defaults match SendPropInt's, plus SPROP_UNSIGNED for unsigned types
+template< class T, int nTypeFlags >
+struct SendPropAutoIntType
+{
+	enum { DEFAULT_BITS = -1, DEFAULT_FLAGS = 0 };
+
+	static SendProp Make( const char *pVarName, int offset, int nBits, int flags )
+	{
+		return SendPropInt( pVarName, offset, sizeof( T ), nBits, nTypeFlags | flags );
+	}
+};
+
+template<> struct SendPropAutoType< char > : SendPropAutoIntType< char, 0 > {};
+template<> struct SendPropAutoType< int8 > : SendPropAutoIntType< int8, 0 > {};
+template<> struct SendPropAutoType< uint8 > : SendPropAutoIntType< uint8, SPROP_UNSIGNED > {};
+template<> struct SendPropAutoType< int16 > : SendPropAutoIntType< int16, 0 > {};
+template<> struct SendPropAutoType< uint16 > : SendPropAutoIntType< uint16, SPROP_UNSIGNED > {};
+template<> struct SendPropAutoType< int32 > : SendPropAutoIntType< int32, 0 > {};
+template<> struct SendPropAutoType< uint32 > : SendPropAutoIntType< uint32, SPROP_UNSIGNED > {};
+#ifdef SUPPORTS_INT64
+template<> struct SendPropAutoType< int64 > : SendPropAutoIntType< int64, 0 > {};
+template<> struct SendPropAutoType< uint64 > : SendPropAutoIntType< uint64, SPROP_UNSIGNED > {};
+#endif
+
+// Same as SendPropBool
+template<> struct SendPropAutoType< bool > : SendPropAutoIntType< bool, SPROP_UNSIGNED >
+{
+	enum { DEFAULT_BITS = 1, DEFAULT_FLAGS = 0 };
+};
+
+// The defaults match SendPropFloat's and SendPropVector's
+template<> struct SendPropAutoType< float >
+{
+	enum { DEFAULT_BITS = 32, DEFAULT_FLAGS = 0 };
+
+	static SendProp Make( const char *pVarName, int offset, int nBits, int flags )
+	{
+		return SendPropFloat( pVarName, offset, sizeof( float ), nBits, flags );
+	}
+};
+
+template<> struct SendPropAutoType< Vector >
+{
+	enum { DEFAULT_BITS = 32, DEFAULT_FLAGS = SPROP_NOSCALE };
+
+	static SendProp Make( const char *pVarName, int offset, int nBits, int flags )
+	{
+		return SendPropVector( pVarName, offset, sizeof( float ) * 3, nBits, flags );
+	}
+};
+
+template< class T >
+inline SendProp SendPropAuto( const char *pVarName, int offset, const T *pVarType,
+	int nBits=SendPropAutoType< T >::DEFAULT_BITS, int flags=SendPropAutoType< T >::DEFAULT_FLAGS )
+{
+	return SendPropAutoType< T >::Make( pVarName, offset, nBits, flags );
+}
+
 SendProp SendPropString(
 	const char *pVarName,
 	int offset,
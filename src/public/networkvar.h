@@ -121,19 +121,30 @@ inline int CheckDeclareClass_Access( T *, const char *pShouldBe )
 		CAutoInitEntPtr()
 		{
 			m_pEnt = NULL;
+			m_bInsideEntity = false;
 		}
 		CBaseEntity *m_pEnt;
+
+		// The chained object is embedded in m_pEnt, so changes to its vars can
+		// be tracked by their offset from the entity like any other var.
+		bool m_bInsideEntity;
 	};
 
-	//TODO: Currently, these don't get the benefit of tracking changes to individual vars.
-	// Would be nice if they did.
 	#define DECLARE_NETWORKVAR_CHAIN() \
 		CAutoInitEntPtr __m_pChainEntity; \
 		void NetworkStateChanged() { CHECK_USENETWORKVARS __m_pChainEntity.m_pEnt->NetworkStateChanged(); } \
-		void NetworkStateChanged( void *pVar ) { CHECK_USENETWORKVARS __m_pChainEntity.m_pEnt->NetworkStateChanged(); }
+		void NetworkStateChanged( void *pVar ) \
+		{ \
+			CHECK_USENETWORKVARS \
+			if ( __m_pChainEntity.m_bInsideEntity ) \
+				__m_pChainEntity.m_pEnt->NetworkStateChanged( pVar ); \
+			else \
+				__m_pChainEntity.m_pEnt->NetworkStateChanged(); \
+		}
 
 	#define IMPLEMENT_NETWORKVAR_CHAIN( varName ) \
-		(varName)->__m_pChainEntity.m_pEnt = this;
+		(varName)->__m_pChainEntity.m_pEnt = this; \
+		(varName)->__m_pChainEntity.m_bInsideEntity = ( (char*)(varName) > (char*)this && (char*)(varName) < (char*)this + sizeof( *this ) );
 
 
 
@@ -689,7 +700,7 @@ private:
 	protected: \
 		inline void NetworkStateChanged() \
 		{ \
-		CHECK_USENETWORKVARS ((ThisClass*)(((char*)this) - MyOffsetOf(ThisClass,name)))->NetworkStateChanged(); \
+		CHECK_USENETWORKVARS ((ThisClass*)(((char*)this) - MyOffsetOf(ThisClass,name)))->NetworkStateChanged( m_Value ); \
 		} \
 	private: \
 		char m_Value[length]; \
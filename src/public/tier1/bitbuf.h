@@ -191,6 +191,10 @@ public:
 	// Write a list of bits in.
 	bool			WriteBits(const void *pIn, int nBits);
 
+	// Write nCount values of numbits each. Same bits as calling WriteUBitLong
+	// on each one in turn, but packed through a 64-bit accumulator.
+	void			WriteUBitLongArray( const uint32 *pData, int nCount, int numbits );
+
 	// writes an unsigned integer with variable bit length
 	void			WriteUBitVar( unsigned int data );
 
@@ -567,6 +571,9 @@ public:
 
 	unsigned int	ReadUBitLong( int numbits ) RESTRICT;
 	unsigned int	ReadUBitLongNoInline( int numbits ) RESTRICT;
+
+	// Read nCount values of numbits each, the counterpart of bf_write::WriteUBitLongArray.
+	void			ReadUBitLongArray( uint32 *pOut, int nCount, int numbits );
 	unsigned int	PeekUBitLong( int numbits );
 	int				ReadSBitLong( int numbits );
 
@@ -534,13 +534,74 @@ bool bf_write::WriteBits(const void *pInData, int nBits)
 }
 
 
+void bf_write::WriteUBitLongArray( const uint32 *pData, int nCount, int numbits )
+{
+	Assert( numbits > 0 && numbits <= 32 );
+
+#ifdef _DEBUG
+	if ( numbits < 32 )
+	{
+		for ( int i = 0; i < nCount; ++i )
+		{
+			if ( pData[i] >= (unsigned long)(1 << numbits) )
+			{
+				CallErrorHandler( BITBUFERROR_VALUE_OUT_OF_RANGE, GetDebugName() );
+				break;
+			}
+		}
+	}
+#endif
+
+	// Values that don't fit go through WriteUBitLong so overflow is handled the same way
+	int nFit = MIN( nCount, GetNumBitsLeft() / numbits );
+	if ( nFit > 0 )
+	{
+		unsigned int mask = g_ExtraMasks[numbits];
+		int iDWord = m_iCurBit >> 5;
+		int nAccBits = m_iCurBit & 31;
+
+		// Keep whatever is already in the first dword below the current bit
+		uint64 acc = LoadLittleDWord( m_pData, iDWord ) & g_ExtraMasks[nAccBits];
+
+		for ( int i = 0; i < nFit; ++i )
+		{
+			acc |= (uint64)( pData[i] & mask ) << nAccBits;
+			nAccBits += numbits;
+			if ( nAccBits >= 32 )
+			{
+				StoreLittleDWord( m_pData, iDWord++, (uint32)acc );
+				acc >>= 32;
+				nAccBits -= 32;
+			}
+		}
+
+		// ...and whatever is in the last dword past the end of what we wrote
+		if ( nAccBits )
+		{
+			unsigned long dword = LoadLittleDWord( m_pData, iDWord ) & ~g_ExtraMasks[nAccBits];
+			StoreLittleDWord( m_pData, iDWord, dword | (uint32)acc );
+		}
+
+		m_iCurBit += nFit * numbits;
+	}
+
+	for ( int i = MAX( nFit, 0 ); i < nCount; ++i )
+	{
+		WriteUBitLong( pData[i], numbits, false );
+	}
+}
+
 bool bf_write::WriteBitsFromBuffer( bf_read *pIn, int nBits )
 {
-	// This could be optimized a little by
+	uint32 buf[64];
+
+	// Move whole dwords in batches, leaving the last 1-32 bits for the single write below
 	while ( nBits > 32 )
 	{
-		WriteUBitLong( pIn->ReadUBitLong( 32 ), 32 );
-		nBits -= 32;
+		int nDWords = MIN( ( nBits - 1 ) >> 5, (int)ARRAYSIZE( buf ) );
+		pIn->ReadUBitLongArray( buf, nDWords, 32 );
+		WriteUBitLongArray( buf, nDWords, 32 );
+		nBits -= nDWords << 5;
 	}
 
 	WriteUBitLong( pIn->ReadUBitLong( nBits ), nBits );
@@ -616,39 +677,69 @@ void bf_write::WriteBitCoordMP( const float f, bool bIntegral, bool bLowPrecisio
 	WriteUBitLong( bits, numbits );
 }
 
-void bf_write::WriteBitCoord (const float f)
+// Builds the bits WriteBitCoord sends, in stream order starting at bit 0, so
+// they can go out in a single WriteUBitLong. At most 3 + COORD_INTEGER_BITS +
+// COORD_FRACTIONAL_BITS bits.
+static inline unsigned int EncodeBitCoord( const float f, int *pNumBits )
 {
-#if defined( BB_PROFILING )
-	VPROF( "bf_write::WriteBitCoord" );
-#endif
 	int		signbit = (f <= -COORD_RESOLUTION);
 	int		intval = (int)abs(f);
 	int		fractval = abs((int)(f*COORD_DENOMINATOR)) & (COORD_DENOMINATOR-1);
 
-
-	// Send the bit flags that indicate whether we have an integer part and/or a fraction part.
-	WriteOneBit( intval );
-	WriteOneBit( fractval );
+	// The bit flags that indicate whether we have an integer part and/or a fraction part.
+	unsigned int bits = ( intval ? 1 : 0 ) | ( fractval ? 2 : 0 );
+	int numbits = 2;
 
 	if ( intval || fractval )
 	{
-		// Send the sign bit
-		WriteOneBit( signbit );
+		// The sign bit
+		bits |= signbit << numbits;
+		++numbits;
 
-		// Send the integer if we have one.
+		// The integer if we have one.
 		if ( intval )
 		{
 			// Adjust the integers from [1..MAX_COORD_VALUE] to [0..MAX_COORD_VALUE-1]
 			intval--;
-			WriteUBitLong( (unsigned int)intval, COORD_INTEGER_BITS );
+			bits |= ( (unsigned int)intval & ( ( 1 << COORD_INTEGER_BITS ) - 1 ) ) << numbits;
+			numbits += COORD_INTEGER_BITS;
 		}
-		
-		// Send the fraction if we have one
+
+		// The fraction if we have one
 		if ( fractval )
 		{
-			WriteUBitLong( (unsigned int)fractval, COORD_FRACTIONAL_BITS );
+			bits |= (unsigned int)fractval << numbits;
+			numbits += COORD_FRACTIONAL_BITS;
 		}
 	}
+
+	*pNumBits = numbits;
+	return bits;
+}
+
+// Same for WriteBitNormal: sign bit then NORMAL_FRACTIONAL_BITS of fraction
+static inline unsigned int EncodeBitNormal( float f )
+{
+	int	signbit = (f <= -NORMAL_RESOLUTION);
+
+	// NOTE: Since +/-1 are valid values for a normal, I'm going to encode that as all ones
+	unsigned int fractval = abs( (int)(f*NORMAL_DENOMINATOR) );
+
+	// clamp..
+	if (fractval > NORMAL_DENOMINATOR)
+		fractval = NORMAL_DENOMINATOR;
+
+	return signbit | ( fractval << 1 );
+}
+
+void bf_write::WriteBitCoord (const float f)
+{
+#if defined( BB_PROFILING )
+	VPROF( "bf_write::WriteBitCoord" );
+#endif
+	int numbits;
+	unsigned int bits = EncodeBitCoord( f, &numbits );
+	WriteUBitLong( bits, numbits );
 }
 
 void bf_write::WriteBitVec3Coord( const Vector& fa )
@@ -659,34 +750,45 @@ void bf_write::WriteBitVec3Coord( const Vector& fa )
 	yflag = (fa[1] >= COORD_RESOLUTION) || (fa[1] <= -COORD_RESOLUTION);
 	zflag = (fa[2] >= COORD_RESOLUTION) || (fa[2] <= -COORD_RESOLUTION);
 
-	WriteOneBit( xflag );
-	WriteOneBit( yflag );
-	WriteOneBit( zflag );
+	// Gather the flags and coords in a 64-bit accumulator and send them a dword at a time
+	uint64 acc = xflag | ( yflag << 1 ) | ( zflag << 2 );
+	int nAccBits = 3;
+	int numbits;
 
 	if ( xflag )
-		WriteBitCoord( fa[0] );
+	{
+		acc |= (uint64)EncodeBitCoord( fa[0], &numbits ) << nAccBits;
+		nAccBits += numbits;
+	}
 	if ( yflag )
-		WriteBitCoord( fa[1] );
+	{
+		acc |= (uint64)EncodeBitCoord( fa[1], &numbits ) << nAccBits;
+		nAccBits += numbits;
+	}
+	if ( nAccBits > 32 )
+	{
+		WriteUBitLong( (uint32)acc, 32, false );
+		acc >>= 32;
+		nAccBits -= 32;
+	}
 	if ( zflag )
-		WriteBitCoord( fa[2] );
+	{
+		acc |= (uint64)EncodeBitCoord( fa[2], &numbits ) << nAccBits;
+		nAccBits += numbits;
+	}
+	if ( nAccBits > 32 )
+	{
+		WriteUBitLong( (uint32)acc, 32, false );
+		acc >>= 32;
+		nAccBits -= 32;
+	}
+
+	WriteUBitLong( (uint32)acc, nAccBits, false );
 }
 
 void bf_write::WriteBitNormal( float f )
 {
-	int	signbit = (f <= -NORMAL_RESOLUTION);
-
-	// NOTE: Since +/-1 are valid values for a normal, I'm going to encode that as all ones
-	unsigned int fractval = abs( (int)(f*NORMAL_DENOMINATOR) );
-
-	// clamp..
-	if (fractval > NORMAL_DENOMINATOR)
-		fractval = NORMAL_DENOMINATOR;
-
-	// Send the sign bit
-	WriteOneBit( signbit );
-
-	// Send the fractional component
-	WriteUBitLong( fractval, NORMAL_FRACTIONAL_BITS );
+	WriteUBitLong( EncodeBitNormal( f ), 1 + NORMAL_FRACTIONAL_BITS );
 }
 
 void bf_write::WriteBitVec3Normal( const Vector& fa )
@@ -696,17 +798,27 @@ void bf_write::WriteBitVec3Normal( const Vector& fa )
 	xflag = (fa[0] >= NORMAL_RESOLUTION) || (fa[0] <= -NORMAL_RESOLUTION);
 	yflag = (fa[1] >= NORMAL_RESOLUTION) || (fa[1] <= -NORMAL_RESOLUTION);
 
-	WriteOneBit( xflag );
-	WriteOneBit( yflag );
+	// Everything fits in one dword: two flags, up to two normals and the z sign bit
+	unsigned int bits = xflag | ( yflag << 1 );
+	int numbits = 2;
 
 	if ( xflag )
-		WriteBitNormal( fa[0] );
+	{
+		bits |= EncodeBitNormal( fa[0] ) << numbits;
+		numbits += 1 + NORMAL_FRACTIONAL_BITS;
+	}
 	if ( yflag )
-		WriteBitNormal( fa[1] );
+	{
+		bits |= EncodeBitNormal( fa[1] ) << numbits;
+		numbits += 1 + NORMAL_FRACTIONAL_BITS;
+	}
 	
-	// Write z sign bit
+	// z sign bit
 	int	signbit = (fa[2] <= -NORMAL_RESOLUTION);
-	WriteOneBit( signbit );
+	bits |= signbit << numbits;
+	++numbits;
+
+	WriteUBitLong( bits, numbits, false );
 }
 
 void bf_write::WriteBitAngles( const QAngle& fa )
@@ -997,6 +1109,42 @@ unsigned int bf_read::ReadUBitLongNoInline( int numbits )
 	return ReadUBitLong( numbits );
 }
 
+void bf_read::ReadUBitLongArray( uint32 *pOut, int nCount, int numbits )
+{
+	Assert( numbits > 0 && numbits <= 32 );
+
+	// Values past the end go through ReadUBitLong so overflow is handled the same way
+	int nFit = MIN( nCount, GetNumBitsLeft() / numbits );
+	if ( nFit > 0 )
+	{
+		const unsigned long * RESTRICT pData = (const unsigned long *)m_pData;
+		unsigned int mask = g_ExtraMasks[numbits];
+		int iDWord = m_iCurBit >> 5;
+		int nAccBits = 32 - ( m_iCurBit & 31 );
+		uint64 acc = (uint32)LoadLittleDWord( pData, iDWord++ ) >> ( m_iCurBit & 31 );
+
+		// Only dwords holding bits we return are touched, same as ReadUBitLong
+		for ( int i = 0; i < nFit; ++i )
+		{
+			if ( nAccBits < numbits )
+			{
+				acc |= (uint64)(uint32)LoadLittleDWord( pData, iDWord++ ) << nAccBits;
+				nAccBits += 32;
+			}
+			pOut[i] = (uint32)acc & mask;
+			acc >>= numbits;
+			nAccBits -= numbits;
+		}
+
+		m_iCurBit += nFit * numbits;
+	}
+
+	for ( int i = MAX( nFit, 0 ); i < nCount; ++i )
+	{
+		pOut[i] = ReadUBitLong( numbits );
+	}
+}
+
 unsigned int bf_read::ReadUBitVarInternal( int encodingType )
 {
 	m_iCurBit -= 4;
@@ -1090,26 +1238,35 @@ float bf_read::ReadBitCoord (void)
 
 
 	// Read the required integer and fraction flags
-	intval = ReadOneBit();
-	fractval = ReadOneBit();
+	unsigned int flags = ReadUBitLong( 2 );
 
 	// If we got either parse them, otherwise it's a zero.
-	if ( intval || fractval )
+	if ( flags )
 	{
-		// Read the sign bit
-		signbit = ReadOneBit();
+		// The sign bit, integer and fraction all come in with one read
+		static const int numbits_table[3] =
+		{
+			COORD_INTEGER_BITS + 1,
+			COORD_FRACTIONAL_BITS + 1,
+			COORD_INTEGER_BITS + COORD_FRACTIONAL_BITS + 1
+		};
+		unsigned int bits = ReadUBitLong( numbits_table[ flags-1 ] );
 
-		// If there's an integer, read it in
-		if ( intval )
+		signbit = bits & 1;
+		bits >>= 1;
+
+		// If there's an integer, pull it out
+		if ( flags & 1 )
 		{
 			// Adjust the integers from [0..MAX_COORD_VALUE-1] to [1..MAX_COORD_VALUE]
-			intval = ReadUBitLong( COORD_INTEGER_BITS ) + 1;
+			intval = ( bits & ( ( 1 << COORD_INTEGER_BITS ) - 1 ) ) + 1;
+			bits >>= COORD_INTEGER_BITS;
 		}
 
-		// If there's a fraction, read it in
-		if ( fractval )
+		// If there's a fraction, pull it out
+		if ( flags & 2 )
 		{
-			fractval = ReadUBitLong( COORD_FRACTIONAL_BITS );
+			fractval = bits;
 		}
 
 		// Calculate the correct floating point value
@@ -1276,9 +1433,10 @@ void bf_read::ReadBitVec3Coord( Vector& fa )
 	// the corresponding component will not be read and will be stack garbage.
 	fa.Init( 0, 0, 0 );
 
-	xflag = ReadOneBit();
-	yflag = ReadOneBit(); 
-	zflag = ReadOneBit();
+	unsigned int flags = ReadUBitLong( 3 );
+	xflag = flags & 1;
+	yflag = flags & 2; 
+	zflag = flags & 4;
 
 	if ( xflag )
 		fa[0] = ReadBitCoord();
@@ -1290,11 +1448,10 @@ void bf_read::ReadBitVec3Coord( Vector& fa )
 
 float bf_read::ReadBitNormal (void)
 {
-	// Read the sign bit
-	int	signbit = ReadOneBit();
-
-	// Read the fractional part
-	unsigned int fractval = ReadUBitLong( NORMAL_FRACTIONAL_BITS );
+	// Read the sign bit and the fractional part
+	unsigned int bits = ReadUBitLong( 1 + NORMAL_FRACTIONAL_BITS );
+	int	signbit = bits & 1;
+	unsigned int fractval = bits >> 1;
 
 	// Calculate the correct floating point value
 	float value = (float)fractval * NORMAL_RESOLUTION;
@@ -1308,8 +1465,9 @@ float bf_read::ReadBitNormal (void)
 
 void bf_read::ReadBitVec3Normal( Vector& fa )
 {
-	int xflag = ReadOneBit();
-	int yflag = ReadOneBit(); 
+	unsigned int flags = ReadUBitLong( 2 );
+	int xflag = flags & 1;
+	int yflag = flags & 2; 
 
 	if (xflag)
 		fa[0] = ReadBitNormal();